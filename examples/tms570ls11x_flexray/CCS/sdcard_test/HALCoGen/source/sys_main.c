@@ -57,7 +57,12 @@
 #include "uartstdio.h"
 #include "mmc-test.h"
 #include "gio.h"
+#include "sys_vim.h"
+#include "reg_rti.h"
+#include "system.h"
 #include "Fr.h"
+#include "Fr_Cluster.h"
+#include "ff.h"
 /* USER CODE END */
 
 /** @fn void main(void)
@@ -72,6 +77,72 @@
 
 extern int SD_Test(void);
 void delay(unsigned int count);
+
+static fr_ctx fray1_ctx;    // driver context of FRAY1
+static int fray1_run;       // POC command handle of the RUN that starts FRAY1
+
+// bus trace of FRAY1 on the SD card, written out from the background loop
+static FATFS trace_fs;
+static FIL trace_file;
+static fr_trace fray1_trace;
+
+// VIM channel of FlexRay eray_int1 (cycle start, timers), see the device datasheet
+#define FRAY_INT1_CHANNEL 32U
+
+// node A's payloads are produced this many macroticks before their slots;
+// covers interrupt latency and the input buffer transfer
+#define FRAY1_JIT_LEAD 20
+
+// FRAY1's application tasks run in the NIT after Fr_ReconfigRun, at a
+// fixed point of the cycle (Fr_TaskAdd), and end within the budget
+#define FRAY1_TASK_AT     (FR_NIT_START + 200)
+#define FRAY1_TASK_BUDGET 400
+
+static volatile int fray1_report;   // status due, printed by the background loop
+
+// heartbeat LED, every 32nd cycle
+static void heartbeat_task(fr_ctx *Fr_CtxPtr, int cycle)
+{
+	(void)Fr_CtxPtr;
+	(void)cycle;
+	gioToggleBit(gioPORTB, 1U);
+}
+
+// every 64th cycle; the UART stays out of the cycle's time line
+static void report_task(fr_ctx *Fr_CtxPtr, int cycle)
+{
+	(void)Fr_CtxPtr;
+	(void)cycle;
+	fray1_report = 1;
+}
+
+#pragma CODE_STATE(frayInt1Interrupt, 32)
+#pragma INTERRUPT(frayInt1Interrupt, IRQ)
+void frayInt1Interrupt(void)
+{
+	Fr_EventIsr(&fray1_ctx);
+}
+
+// RTI free running counter 0, idle time and dispatch latency base
+static unsigned long rti_clock(void)
+{
+	return rtiREG1->CNT[0U].FRCx;
+}
+
+// FRC0 ticks per ms: RTICLK / (CPUC0 + 1), see rtiInit
+#define RTI_FRC0_KHZ ((unsigned long)(RTI_FREQ * 1000.0F) / 9U)
+
+// FRC0 ticks per macrotick of 1 us (Fr_Cluster.h)
+#define RTI_FRC0_PER_MT (RTI_FRC0_KHZ / 1000U)
+
+// between FRAY1 events: the buffered UART output goes to the SCI as fast as
+// it takes it, then the CPU sleeps until the next interrupt
+static void fray1_idle(fr_ctx *Fr_CtxPtr)
+{
+	(void)Fr_CtxPtr;
+	if (UARTTxPoll() == 0)
+		asm(" WFI");
+}
 /* USER CODE END */
 
 void delay(unsigned int count)
@@ -87,16 +158,88 @@ void delay(unsigned int count)
 void main(void)
 {
 /* USER CODE BEGIN (3) */
+	int i;
+
 	gioInit();
 	sciInit();
-	configure_initialize_node_a(FRAY1);
-	Fr_StartCommunication(FRAY1);
+	rtiInit();
+	rtiStartCounter(rtiCOUNTER_BLOCK0);
+	Fr_CtxInit(&fray1_ctx, FRAY1);
+	Fr_PocInit(&fray1_ctx, rti_clock);
+	if (configure_initialize_node_a(&fray1_ctx) != 0)
+		UARTprintf("--> FRAY configuration failed <--\r\n ");
+	Fr_EventInit(&fray1_ctx, rti_clock, fray1_idle);
+	if (jit_node_a(&fray1_ctx, FRAY1_JIT_LEAD) < 0)
+		UARTprintf("--> FRAY payload schedule failed <--\r\n ");
+	Fr_TaskAdd(&fray1_ctx, heartbeat_task, 0x20, FRAY1_TASK_AT, FRAY1_TASK_BUDGET);  // cycle code 32 | 0
+	Fr_TaskAdd(&fray1_ctx, report_task, 0x40, FRAY1_TASK_AT, FRAY1_TASK_BUDGET);     // 64 | 0
+	// the controller runs the startup while the SD card is mounted
+	fray1_run = Fr_PocCommand(&fray1_ctx, CMD_RUN, FR_POCS_NORMAL_ACTIVE, 1000 * RTI_FRC0_KHZ);
+	Fr_PocPoll(&fray1_ctx);
+	mmcSelectSpi(mibspiPORT5, mibspiREG5, 4);  // SD card is on the SPI5
+	if (f_mount(&trace_fs, "", 1) != FR_OK
+	    || Fr_TraceOpen(&fray1_ctx, &fray1_trace, &trace_file, "FRAY1.BIN", rti_clock) != 0)
+		UARTprintf("--> no SD card, bus trace off <--\r\n ");
+	vimChannelMap(FRAY_INT1_CHANNEL, FRAY_INT1_CHANNEL, &frayInt1Interrupt);
+	vimEnableInterrupt(FRAY_INT1_CHANNEL, SYS_IRQ);
+	_enable_IRQ();
+	if (Fr_PocAwait(&fray1_ctx, fray1_run) == FR_POC_DONE)
+		UARTprintf("--> FRAY NORMAL_ACTIVE %u ms after RUN <--\r\n ", Fr_PocTime(&fray1_ctx, fray1_run) / RTI_FRC0_KHZ);
+	else
+		UARTprintf("--> FRAY startup failed in POC state %u <--\r\n ", fray1_ctx.poc.state);
+	// a blocking UARTprintf takes longer than a cycle: from here on it only
+	// fills the buffer that fray1_idle empties
+	UARTBufferTx(1);
 
 	while(1)
 	{
-			transmit_check_node_a(FRAY1);
-			UARTprintf("--> FRAY Test running...<--\r\n ");
-			delay(0xFFFF);
+			// sleeps until the cycle start or timer interrupt, then runs node A's
+			// cycle work or the payloads due
+			Fr_EventWait(&fray1_ctx);
+			Fr_EventDispatch(&fray1_ctx, FR_EVENT_DEPTH);
+			// the SD card gets the time up to the next payload or task due,
+			// in the sectors that fit; Fr_TracePoll f_syncs the file now and
+			// then, so power off loses little. After a write error the file
+			// is closed with what reached the card, the bus runs on.
+			if (fray1_ctx.trace != 0
+			    && Fr_TracePoll(&fray1_trace, (unsigned long)Fr_JitSlack(&fray1_ctx) * RTI_FRC0_PER_MT) < 0)
+			{
+				Fr_TraceClose(&fray1_ctx, &fray1_trace);
+				UARTprintf("--> trace stopped, FatFs error %u, %u KB on the card <--\r\n ",
+				           fray1_trace.error, fray1_trace.bytes / 1024);
+			}
+			// NORMAL_PASSIVE or HALT after a bus fault: back to NORMAL_ACTIVE
+			// from the cached configuration, the SD card served meanwhile
+			if ((FRAY1->CCSV_UN.CCSV_UL & 0x3F) != FR_POCS_NORMAL_ACTIVE
+			    && Fr_Recover(&fray1_ctx, 1000 * RTI_FRC0_KHZ) >= 0)
+			{
+				while (Fr_RecoverPoll(&fray1_ctx) == FR_POC_BUSY)
+					if (fray1_ctx.trace != 0)
+						Fr_TracePoll(&fray1_trace, FR_TRACE_ANY_TIME);
+				if (fray1_ctx.recovery.status == FR_POC_DONE)
+					UARTprintf("--> FRAY resync from POC state %u in %u ms <--\r\n ",
+					           fray1_ctx.recovery.from, fray1_ctx.recovery.last_time / RTI_FRC0_KHZ);
+				else
+					UARTprintf("--> FRAY resync failed in POC state %u <--\r\n ", fray1_ctx.poc.state);
+			}
+			if (fray1_report)
+			{
+				fray1_report = 0;
+				UARTprintf("--> FRAY Test running, idle %u ticks...<--\r\n ", fray1_ctx.events.idle_time);
+				for (i = 0; i < fray1_ctx.jit.tasks; i++)
+					UARTprintf("--> task %u: %u runs, wcet %u ticks, start delay max %u mt, %u overruns <--\r\n ",
+					           i, fray1_ctx.jit.task[i].runs, fray1_ctx.jit.task[i].wcet,
+					           fray1_ctx.jit.task[i].delay_max, fray1_ctx.jit.task[i].overruns);
+				// node B's slot 2 frame, buffers #2 (A) and #3 (B) merged by jit_node_a
+				UARTprintf("--> slot 2: %u frames, missing on A %u, on B %u, %u disagree; sync frames A %u B %u <--\r\n ",
+				           fray1_ctx.dual.pair[0].frames, fray1_ctx.dual.pair[0].missing[0],
+				           fray1_ctx.dual.pair[0].missing[1], fray1_ctx.dual.pair[0].disagree,
+				           fray1_ctx.dual.sync[0], fray1_ctx.dual.sync[1]);
+				if (fray1_ctx.trace != 0 && fray1_trace.write_time != 0)
+					UARTprintf("--> trace %u records, %u dropped, %u KB/s to SD <--\r\n ",
+					           fray1_trace.records, fray1_trace.dropped,
+					           (unsigned long)((unsigned long long)fray1_trace.bytes * RTI_FRC0_KHZ / fray1_trace.write_time));
+			}
 	}
 #if 0
     /** - Initialize LIN/SCI2 Routines to receive Command and transmit data */
@@ -36,6 +36,42 @@ static const char * const g_pcHex = "0123456789abcdef";
 
 #define SCI_REG		sciREG
 
+//*****************************************************************************
+//
+// The transmit buffer of the buffered mode (UARTBufferTx), emptied by
+// UARTTxPoll.  The size must be a power of 2.
+//
+//*****************************************************************************
+#define UART_TX_BUFFER_SIZE 1024
+
+static char g_pcUARTTxBuffer[UART_TX_BUFFER_SIZE];
+static unsigned int g_ui32UARTTxWriteIndex;
+static unsigned int g_ui32UARTTxReadIndex;
+static int g_bUARTBuffered;
+
+//*****************************************************************************
+//
+// Puts a character into the transmit buffer, or sends it in non-buffered
+// mode.  Returns 0 if the buffer was full and the character is lost.
+//
+//*****************************************************************************
+static int
+UARTPutc(char cChar)
+{
+    if(!g_bUARTBuffered)
+    {
+        sciSendByte(SCI_REG, (uint8)cChar);
+        return(1);
+    }
+    if(g_ui32UARTTxWriteIndex - g_ui32UARTTxReadIndex == UART_TX_BUFFER_SIZE)
+    {
+        return(0);
+    }
+    g_pcUARTTxBuffer[g_ui32UARTTxWriteIndex & (UART_TX_BUFFER_SIZE - 1)] = cChar;
+    g_ui32UARTTxWriteIndex++;
+    return(1);
+}
+
 //*****************************************************************************
 //
 //! Writes a string of characters to the UART output.
@@ -79,13 +115,13 @@ UARTwrite(const char *pcBuf, unsigned int ui32Len)
         //
         if(pcBuf[uIdx] == '\n')
         {
-        	sciSendByte(SCI_REG, '\r');
+        	UARTPutc('\r');
         }
 
         //
         // Send the character to the UART output.
         //
-        sciSendByte(SCI_REG, pcBuf[uIdx]);
+        UARTPutc(pcBuf[uIdx]);
     }
 
     //
@@ -756,3 +792,52 @@ UARTprintf(const char *pcString, ...)
     //
     va_end(vaArgP);
 }
+
+//*****************************************************************************
+//
+//! Switches the output between blocking and buffered mode.
+//!
+//! \param bBuffered is non-zero for buffered mode.
+//!
+//! In buffered mode, UARTwrite and UARTprintf only put the characters into a
+//! RAM buffer of UART_TX_BUFFER_SIZE bytes and return; UARTTxPoll hands them
+//! to the SCI as its transmit register becomes free.  Characters that find
+//! the buffer full are discarded.  Switching back to blocking mode first sends
+//! what is left in the buffer.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+UARTBufferTx(int bBuffered)
+{
+    if(!bBuffered)
+    {
+        while(UARTTxPoll() != 0)
+        {
+        }
+    }
+    g_bUARTBuffered = bBuffered;
+}
+
+//*****************************************************************************
+//
+//! Sends buffered characters without waiting.
+//!
+//! Writes characters from the transmit buffer to the SCI for as long as its
+//! transmit register is free, so it never waits for the line.  Call it
+//! whenever the application has time to spare, for example while it idles.
+//!
+//! \return Returns the count of characters still waiting in the buffer.
+//
+//*****************************************************************************
+int
+UARTTxPoll(void)
+{
+    while(g_ui32UARTTxReadIndex != g_ui32UARTTxWriteIndex && sciIsTxReady(SCI_REG) != 0U)
+    {
+        SCI_REG->TD = (uint8)g_pcUARTTxBuffer[g_ui32UARTTxReadIndex & (UART_TX_BUFFER_SIZE - 1)];
+        g_ui32UARTTxReadIndex++;
+    }
+    return((int)(g_ui32UARTTxWriteIndex - g_ui32UARTTxReadIndex));
+}
@@ -41,6 +41,8 @@ extern unsigned char UARTgetc(void);
 extern int UARTwrite(const char *pcBuf, unsigned int ui32Len);
 extern void UARTprintf(const char *pcString, ...);
 extern void UARTvprintf(const char *pcString, va_list vaArgP);
+extern void UARTBufferTx(int bBuffered);
+extern int UARTTxPoll(void);
 
 //*****************************************************************************
 //
@@ -10,214 +10,160 @@
 
 
 #include "Fr.h"
-	wrhs Fr_LPdu;
-	cfg Fr_Config;
-	bc Fr_LSdu1;
-	bc Fr_LSdu2;
+#include "Fr_Cluster.h"
 
-void configure_initialize_node_a(FRAY_ST *Fray_PST)
-{
-	wrhs *Fr_LPduPtr=&Fr_LPdu;
-	cfg *Fr_ConfigPtr=&Fr_Config;
-	bc *Fr_LSduPtr=&Fr_LSdu1;
-
-	// GTUs (Global Time Unit ), PRTC configuration
-	Fr_ConfigPtr->gtu1  = 0x00036B00; // pMicroPerCycle = 224000d = 36B00h (has to be x40 of MacroPerCyle)
-	                                  // [19:0]: These bits configure the duration of the communication cycle in microticks
-	Fr_ConfigPtr->gtu2  = 0x000F15E0; // gSyncodeMax = Fh, gMacroPerCycle = 5600d = 15E0h  (cycle period, 5.6us)
-	                                  //[13:0]: Macrotick per cycle (in macroticks). These bits configure the duration of one communication cycle
-	                                  //	    in macroticks. The cycle length must be identical in all nodes of a cluster.
-	                                  //[19:16]: Sync node max (in frames). These bits configure the maximum number of frames within a cluster
-	                                  //	     with sync frame indicator bit SYN set. The number of frames must be identical in all nodes of a cluster.
-	Fr_ConfigPtr->gtu3  = 0x00061818; // gMacroInitialOffset = 6h, pMicroInitialOffset = 24d = 18h
-	Fr_ConfigPtr->gtu4  = 0x0AE40AE3; // gOffsetCorrectionStart - 1 = 2788d = AE4h, gMacroPerCycle - gdNIT - 1 = 2787d = AE3h
-	Fr_ConfigPtr->gtu5  = 0x33010303; // pDecodingCorrection = 51d = 33h, pClusterDriftDamping = 1h, pDelayCompensation = 3h
-	Fr_ConfigPtr->gtu6  = 0x01510081; // pdMaxDrift = 337d = 151h, pdAcceptedStartupRange = 129d = 81h
-
-	Fr_ConfigPtr->gtu7  = 0x00080056; // gNumberOfStaticSlots = 8h, gdStaticSlot = 86d = 56h
-	                                  // [25:16]: These bits configure the number of static slots in a cycle.
-                                      // [9:0]: These bits configure the duration of a static slot (macroticks).
-
-	Fr_ConfigPtr->gtu8  = 0x015A0004; // gNumberOfMinislots = 346d = 15Ah, gdMinislot = 4h
-	                                  // [28:16]:These bits configure the number of minislots in the dynamic segment of a cycle
-	                                  // [5:0]: These bits configure the duration of a minislot
-
-	Fr_ConfigPtr->gtu9  = 0x00010204; // gdDynamicSlotIdlePhase = 1, gdMinislotActionPointOffset = 2, gdActionPointOffset = 4h
-	Fr_ConfigPtr->gtu10 = 0x015100CD; // pRateCorrectionOut = 337d = 151h, pOffsetCorrectionOut = 205d = CDh
-	Fr_ConfigPtr->gtu11 = 0x00000000; // pExternRateCorrection = 0, pExternOffsetCorrection = 0, no ext. clk. corr.
-
-
-	Fr_ConfigPtr->succ2 = 0x0F036DA2; // gListenNoise = Fh, pdListenTimeout = 224674d = 36DA2h
-										//LTN [27:24]: Listen timeout noise. Configures the upper limit for the startup and wakeup listen timeout in the
-										//presence of noise. Must be identical in all nodes of a cluster.
-										//The wakeup / startup noise timeout is calculated as follows: LT[20:0]  (LTN[3:0] + 1)
-	                                    // LT[20:0]: Listen timeout. Configures the upper limit of the startup and wakeup listen timeout.
-
-	Fr_ConfigPtr->succ3 = 0x000000FF; // gMaxWithoutClockCorrectionFatal = Fh , passive = Fh
-										//WCF[7:4]: Maximum without clock correction fatal. These bits define the number of consecutive even/odd
-										//cycle pairs with missing clock correction terms that will cause a transition from
-										//NORMAL_ACTIVE or NORMAL_PASSIVE state.
-
-										//WCP[3:0]: Maximum without clock correction passive. These bits define the number of consecutive
-										//even/odd cycle pairs with missing clock correction terms that will cause a transition from
-										//NORMAL_ACTIVE to NORMAL_PASSIVE to HALT state.
-
-	Fr_ConfigPtr->prtc1 = 0x084C000A; // pWakeupPattern = 2h, gdWakeupSymbolRxWindow = 76d, BRP = 0, gdTSSTransmitter = Ah
-										//BRP[15:14]; Baud rate prescaler. These bits configure the baud rate on the FlexRay bus. The baud rates
-										//listed below are valid with a sample clock of 80 MHz. One bit time always consists of 8 samples
-										//independent of the configured baud rate.  =0 ->10Mb/s
-
-	Fr_ConfigPtr->prtc2 = 0x3CB41212; // gdWakeupSymbolTxLow = 60d, gdWakeupSymbolTxIdle = 180d, gdWakeupSymbolRxLow = 18d, gdWakeupSymbolRxIdle = 18d
-
-	Fr_ConfigPtr->mhdc  = 0x010D0009; // pLatestTransmit = 269d = 010Dh, gPayloadLengthStatic = 9h
-										//Start of latest transmit (in minislots). These bits configure the maximum minislot value allowed
-										//minislots before inhibiting new frame transmissions in the Dynamic Segment of the cycle.
-	                                    //[7:0]: Static frame data length.
-
-	Fr_ConfigPtr->mrc   = 0x00174004; // LCB=23d, FFB=64d, FDB=4d (0..3 static, 4..23 dyn., 0 fifo)
+#define FR_NODE_BUFFERS   (FR_LAST_BUFFER + 1)
+
+FR_SCHEDULE_CHECKS;
+FR_CLUSTER_CHECKS;
+
+// message RAM layout of each node, data sections behind the header sections
+struct fr_node_a_mram { FR_NODE_A_BUFFERS(FR_MRAM_SECTION) };
+struct fr_node_b_mram { FR_NODE_B_BUFFERS(FR_MRAM_SECTION) };
+
+FR_SCHEDULE_ASSERT(fr_check_node_a, 1 FR_NODE_A_BUFFERS(FR_MBUF_VALID));
+FR_SCHEDULE_ASSERT(fr_check_node_b, 1 FR_NODE_B_BUFFERS(FR_MBUF_VALID));
+FR_SCHEDULE_ASSERT(fr_check_node_a_reconfig, 1 FR_NODE_A_RECONFIG(FR_MBUF_VALID));
+FR_MRAM_ASSERT(fr_node_a_fits, FR_NODE_BUFFERS, sizeof(struct fr_node_a_mram));
+FR_MRAM_ASSERT(fr_node_b_fits, FR_NODE_BUFFERS, sizeof(struct fr_node_b_mram));
+
+#define NODE_A_IMAGE(buffer, fid, dir, ch, cyc, pl, sync) \
+	FR_MBUF_IMAGE(fr_node_a_mram, FR_LAST_BUFFER, buffer, fid, dir, ch, cyc, pl, sync),
+#define NODE_B_IMAGE(buffer, fid, dir, ch, cyc, pl, sync) \
+	FR_MBUF_IMAGE(fr_node_b_mram, FR_LAST_BUFFER, buffer, fid, dir, ch, cyc, pl, sync),
+// a multiplexed frame must fit the data section of its buffer
+#define NODE_A_FITS(buffer, fid, dir, ch, cyc, pl, sync) \
+	&& FR_DATA_WORDS(pl) <= sizeof(((struct fr_node_a_mram *)0)->data_##buffer)
+
+FR_SCHEDULE_ASSERT(fr_check_node_a_sections, 1 FR_NODE_A_RECONFIG(NODE_A_FITS));
+
+static const mbuf_image Fr_NodeABuffers[] = { FR_NODE_A_BUFFERS(NODE_A_IMAGE) };
+static const mbuf_image Fr_NodeBBuffers[] = { FR_NODE_B_BUFFERS(NODE_B_IMAGE) };
+static const mbuf_image Fr_NodeAReconfig[] = { FR_NODE_A_RECONFIG(NODE_A_IMAGE) };
+
+#define FR_IMAGES(images) (int)(sizeof(images) / sizeof(images[0]))
 
+// TX buffers whose payload goes through Fr_TxWrite/Fr_TxCommit
+static const int Fr_NodeATx[] = { 0, 9, 11, 12 };
+static const int Fr_NodeBTx[] = { 0, 10 };
+
+static const fr_startup_image Fr_NodeAStartup =
+	FR_STARTUP_IMAGE(FR_NODE_MRC, Fr_NodeABuffers, FR_IMAGES(Fr_NodeABuffers));
+static const fr_startup_image Fr_NodeBStartup =
+	FR_STARTUP_IMAGE(FR_NODE_MRC, Fr_NodeBBuffers, FR_IMAGES(Fr_NodeBBuffers));
+
+int configure_initialize_node_a(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
 
 	// Wait for PBSY bit to clear - POC not busy.
 	// 1: Signals that the POC is busy and cannot accept a command from the host. CMD(3-0) is locked against write accesses.
 	while(((Fray_PST->SUCC1_UN.SUCC1_UL) & 0x00000080) != 0);
-	
-	// Initialize
-	Fr_Init(Fray_PST, Fr_ConfigPtr);
-
-	// Output Buffer config initialization
-	//Write Header Section Register 1 (WRHS1)
-	Fr_LPduPtr->mbi  = 1;   // message buffer interrupt
-	Fr_LPduPtr->txm  = 0;   // transmission mode - continuous mode
-	Fr_LPduPtr->ppit = 0;   // network management Enable
-	Fr_LPduPtr->cfg  = 0;   // message buffer configuration bit (0=RX, 1 = TX)
-	Fr_LPduPtr->chb  = 1;   // Ch B
-	Fr_LPduPtr->cha  = 1;   // Ch A
-	Fr_LPduPtr->cyc  = 0;   // Cycle Filtering Code (no cycle filtering)
-	Fr_LPduPtr->fid  = 0;   // Frame ID
-
-	//Write Header Section 2 (WRHS2)
-	Fr_LPduPtr->pl   = 0;   // Payload Length
-
-	//Write Header Section 3 (WRHS3)
-	Fr_LPduPtr->dp   = 0;   // Pointer to start of data in message RAM
-
-	Fr_LPduPtr->sfi  = 0;   // startup frame indicator
-	Fr_LPduPtr->sync = 0;   // sync frame indicator
-
-	//input buffer configuration
-	Fr_LSduPtr->ibrh = 0;  // input buffer number
-	Fr_LSduPtr->ibsyh = 1; // check for input buffer busy host
-	Fr_LSduPtr->ibsys = 1; // check for input buffer busy shadow
-
-	Fr_LSduPtr->stxrh= 0;  // set transmission request
-	Fr_LSduPtr->ldsh = 0;  // load data section
-	Fr_LSduPtr->lhsh = 0;  // load header section
-	Fr_LSduPtr->obrs = 0;  // output buffer number
-	Fr_LSduPtr->rdss = 0;  // read data section
-	Fr_LSduPtr->rhss = 0;  // read header section
-
-
-	// Message buffers
-
-	// Buffer #1
-	Fr_LPduPtr->fid  = 1;    // frame ID
-	Fr_LPduPtr->dp   = 0x80; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 1;    // TX frame
-	Fr_LPduPtr->sync = 1;    // sync frame indicator
-	Fr_LPduPtr->sfi  = 1;    // startup frame indicator
-	Fr_LPduPtr->pl   = 9;	 // 18 byte payload
-	Fr_LPduPtr->crc  = header_crc_calc(Fr_LPduPtr);
-
-	Fr_LSduPtr->lhsh = 1;  // load header section
-	Fr_LSduPtr->ibrh = 0;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
-
-	// Buffer #2
-	Fr_LPduPtr->fid  = 2;    // frame ID
-	Fr_LPduPtr->dp   = 0x85; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 0;    // RX frame
-	Fr_LPduPtr->sync = 0;    // sync frame indicator
-	Fr_LPduPtr->sfi  = 0;    // startup frame indicator
-	Fr_LPduPtr->crc  = 0;
-
-	Fr_LSduPtr->ibrh = 2;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
-
-    // buffer #9
-	Fr_LPduPtr->fid  = 9;   // frame ID
-	Fr_LPduPtr->dp   = 0x200; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 1;    // TX frame
-	Fr_LPduPtr->chb  = 0;    // No transmission on Ch B
-	Fr_LPduPtr->pl   = 127;	 // 254 byte payload
-	Fr_LPduPtr->crc  = header_crc_calc(Fr_LPduPtr);
-
-	Fr_LSduPtr->ibrh = 9;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
-
-	// buffer #10
-	Fr_LPduPtr->fid  = 10;     // frame ID
-	Fr_LPduPtr->dp   = 0x240; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 0;    // RX frame
-	Fr_LPduPtr->crc  = 0;
-
-	Fr_LSduPtr->ibrh = 10;  // input buffer number
 
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
+	// Initialize GTU, PRTC, MHDC, SUCC and MRC from the compiled cluster schedule
+	Fr_CtxLoadImage(Fr_CtxPtr, &Fr_NodeAStartup);
+	Fr_Init(Fray_PST, &Fr_CtxPtr->config);
 
+	// Message buffers #0 (slot 1 TX), #2 and #3 (slot 2 RX A, B), #9 (frame 9 TX), #10 (frame 10 RX),
+	// #11 and #12 (frames 20..31 TX, multiplexed)
+	Fr_LoadBufferImages(Fray_PST, Fr_CtxPtr->image->buffers, Fr_CtxPtr->image->count);
+	if (Fr_CtxPtr->fifo != 0 && Fr_ConfigureFifo(Fr_CtxPtr, Fr_CtxPtr->fifo) < 0) return 1;
+	if (Fr_ReconfigInit(Fr_CtxPtr, Fr_NodeAReconfig, FR_IMAGES(Fr_NodeAReconfig)) < 0) return 1;
+	if (Fr_TxTrackInit(Fr_CtxPtr, Fr_NodeATx, FR_IMAGES(Fr_NodeATx)) < 0) return 1;
 
 	Fr_ControllerInit(Fray_PST);
 	// Initialize Interrupts
 	Fray_PST->EIR_UN.EIR_UL       = 0xFFFFFFFF; // Clear Error Int.
 	Fray_PST->SIR_UN.SIR_UL       = 0xFFFFFFFF; // Clear Status Int.
-	Fray_PST->SILS_UN.SILS_UL     = 0x00000000; // all Status Int. to eray_int0
+	Fray_PST->SILS_UN.SILS_UL     = 0x00000104; // CYCS, TI0 Int. to eray_int1, others to eray_int0
 	Fray_PST->SIER_UN.SIER_UL     = 0xFFFFFFFF; // Disable all Status Int.
-	Fray_PST->SIES_UN.SIES_UL     = 0x00000004; // Enable CYCSE Int.
+	Fray_PST->SIES_UN.SIES_UL     = 0x00000104; // Enable CYCSE, TI0E Int.
 	Fray_PST->ILE_UN.ILE_UL       = 0x00000002; // enable eray_int1
 
 	Fr_AllowColdStart(Fray_PST);
+	return 0;
 }
 	
 
-int transmit_check_node_a(FRAY_ST *Fray_PST)
+// Fast path of configure_initialize_node_a + Fr_StartCommunication, returns in NORMAL_ACTIVE
+int fast_startup_node_a(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock, unsigned long timeout, fr_startup_log *Fr_LogPtr)
+{
+	Fr_CtxLoadImage(Fr_CtxPtr, &Fr_NodeAStartup);
+	if (Fr_ReconfigInit(Fr_CtxPtr, Fr_NodeAReconfig, FR_IMAGES(Fr_NodeAReconfig)) < 0) return 1;
+	if (Fr_TxTrackInit(Fr_CtxPtr, Fr_NodeATx, FR_IMAGES(Fr_NodeATx)) < 0) return 1;
+	return Fr_FastStartup(Fr_CtxPtr->regs, Fr_CtxPtr->image, Fr_Clock, timeout, Fr_LogPtr);
+}
+
+// Payload of node A's TX buffers #0 (slot 1), #9 (frame 9) and the frames on
+// #11 and #12 in this cycle. Only words that change are written.
+static void produce_node_a(fr_ctx *Fr_CtxPtr, int buffer, int cycle)
+{
+	switch (buffer)
+	{
+	case 0:
+		Fr_TxWrite(Fr_CtxPtr, 0, 0, 0x00000001);     // Data 1
+		Fr_TxWrite(Fr_CtxPtr, 0, 1, 0x000000FF);     // Data 2
+		break;
+	case 9:
+		Fr_TxWrite(Fr_CtxPtr, 9, 0, 0xFF);           // Data 1
+		Fr_TxWrite(Fr_CtxPtr, 9, 1, 0xFFFF);         // Data 2
+		Fr_TxWrite(Fr_CtxPtr, 9, 2, 0xFFFFFF);       // Data 3
+		Fr_TxWrite(Fr_CtxPtr, 9, 3, 0xFFFFFFFF);     // Data 4
+		Fr_TxWrite(Fr_CtxPtr, 9, 4, 0xFFFFFF00);     // Data 5
+		Fr_TxWrite(Fr_CtxPtr, 9, 5, 0xFFFF0000);     // Data 6
+		break;
+	case 11:   // frame ID and cycle
+		Fr_TxWrite(Fr_CtxPtr, 11, 0, 20 + (cycle & 0x3));
+		Fr_TxWrite(Fr_CtxPtr, 11, 1, cycle);
+		break;
+	case 12:
+		Fr_TxWrite(Fr_CtxPtr, 12, 0, 24 + (cycle & 0x7));
+		Fr_TxWrite(Fr_CtxPtr, 12, 1, cycle);
+		break;
+	}
+}
+
+// All of node A's payloads at cycle start; unchanged buffers are not
+// transferred
+static void update_node_a(fr_ctx *Fr_CtxPtr, int cycle)
+{
+	int i;
+
+	for (i = 0; i < FR_IMAGES(Fr_NodeATx); i++)
+	{
+		produce_node_a(Fr_CtxPtr, Fr_NodeATx[i], cycle);
+		Fr_TxCommit(Fr_CtxPtr, Fr_NodeATx[i]);
+	}
+	Fr_CtxPtr->stats.cycles++;
+}
+
+static void count_node_a(fr_ctx *Fr_CtxPtr, int cycle)
+{
+	(void)cycle;
+	Fr_CtxPtr->stats.cycles++;
+}
+
+// Node B's slot 2 frame, received in buffer #2
+static void check_node_a(fr_ctx *Fr_CtxPtr, int buffer, volatile unsigned long *rdds)
 {
-	bc *write_buffer=&Fr_LSdu1;
-	bc *read_buffer=&Fr_LSdu2;
+	(void)buffer;
+	Fr_CtxPtr->stats.rx_frames++;
+	if (rdds[1] != 0x87654321) Fr_CtxPtr->stats.rx_errors++;
+}
+
+int transmit_check_node_a(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	bc *read_buffer=&Fr_CtxPtr->read_buffer;
+	unsigned long errors = Fr_CtxPtr->stats.rx_errors;
 	unsigned int  ndat1;
-	int error=0;
-	write_buffer->ibrh = 0;  // input buffer number
-	write_buffer->stxrh= 1;  // set transmission request
-	write_buffer->ldsh = 1;  // load data section
-	write_buffer->lhsh = 0;  // load header section
-	write_buffer->ibsys = 0; // check for input buffer busy shadow
-	write_buffer->ibsyh = 1; // check for input buffer busy host
 
     // wait for cycle start interrupt flag
     Fray_PST->SIR_UN.SIR_UL = 0xFFFFFFFF;            // clear all status int. flags
     while ((Fray_PST->SIR_UN.SIR_UL & 0x4) == 0x0);    // wait for CYCS interrupt flag
     Fray_PST->SIR_UN.SIR_UL = 0xFFFFFFFF;            // clear all status int. flags
 
-	// write payload for buffers
-	// buffer #1
-	(Fray_PST->WRDS[0] = 0x00000001);    // Data 1
-    (Fray_PST->WRDS[1] = 0x000000FF);    // Data 2
-	Fr_TransmitTxLPdu(Fray_PST, write_buffer);
-
-	// buffer #9
-	write_buffer->ibrh = 9;
-	(Fray_PST->WRDS[0] = 0xFF);    		 // Data 1
-    (Fray_PST->WRDS[1] = 0xFFFF);   	 // Data 2
-	(Fray_PST->WRDS[2] = 0xFFFFFF);      // Data 3
-    (Fray_PST->WRDS[3] = 0xFFFFFFFF);    // Data 4
-	(Fray_PST->WRDS[4] = 0xFFFFFF00);    // Data 5
-    (Fray_PST->WRDS[5] = 0xFFFF0000);    // Data 6
-	Fr_TransmitTxLPdu(Fray_PST, write_buffer);
+	update_node_a(Fr_CtxPtr, (Fray_PST->MTCCV_UN.MTCCV_UL >> 16) & 0x3F);
 
 	 // check received frames
     ndat1 = Fray_PST->NDAT1_UN.NDAT1_UL;
@@ -227,172 +173,125 @@ int transmit_check_node_a(FRAY_ST *Fray_PST)
     {
       read_buffer->obrs=2;  // output buffer number
 	  read_buffer->rdss=1;  // read data section
-	  read_buffer->rhss=0;  // read header section
+	  read_buffer->rhss=Fr_CtxPtr->trace != 0;  // read header section when tracing
       // Transfer message buffer 1 data to output buffer registers
       Fr_ReceiveRxLPdu(Fray_PST, read_buffer);
-      if (Fray_PST->RDDS[1] != 0x87654321) error++; 
+      Fr_TimeStamp(Fr_CtxPtr, &Fr_CtxPtr->rx_stamp);
+      if (Fr_CtxPtr->trace != 0) Fr_TraceRx(Fr_CtxPtr);
+      check_node_a(Fr_CtxPtr, 2, Fray_PST->RDDS);
 	}
-	return error;
+	return (int)(Fr_CtxPtr->stats.rx_errors - errors);
+}
+
+// Interrupt driven transmit_check_node_a: the same work from Fr_EventDispatch,
+// the CPU idles in Fr_EventWait between cycles instead of polling CYCS
+int events_node_a(fr_ctx *Fr_CtxPtr)
+{
+	Fr_OnBuffer(Fr_CtxPtr, 2, check_node_a);
+	return Fr_OnCycle(Fr_CtxPtr, update_node_a, 0);
 }
 
-void configure_initialize_node_b(FRAY_ST *Fray_PST)
+// Node B's slot 2 frame from either channel, once per cycle
+static void merge_node_a(fr_ctx *Fr_CtxPtr, int pair, int channel, volatile unsigned long *rdds)
 {
-	wrhs *Fr_LPduPtr=&Fr_LPdu;
-	cfg *Fr_ConfigPtr=&Fr_Config;
-	bc *Fr_LSduPtr=&Fr_LSdu1;
-
-	// GTUs, PRTC configuration
-	Fr_ConfigPtr->gtu1  = 0x00036B00; // pMicroPerCycle = 224000d = 36B00h
-	Fr_ConfigPtr->gtu2  = 0x000F15E0; // gSyncodeMax = Fh, gMacroPerCycle = 5600d = 15E0h
-	Fr_ConfigPtr->gtu3  = 0x00061818; // gMacroInitialOffset = 6h, pMicroInitialOffset = 24d = 18h
-	Fr_ConfigPtr->gtu4  = 0x0AE40AE3; // gOffsetCorrectionStart - 1 = 2788d = AE4h, gMacroPerCycle - gdNIT - 1 = 2787d = AE3h
-	Fr_ConfigPtr->gtu5  = 0x33010303; // pDecodingCorrection = 51d = 33h, pClusterDriftDamping = 1h, pDelayCompensation = 3h
-	Fr_ConfigPtr->gtu6  = 0x01510081; // pdMaxDrift = 337d = 151h, pdAcceptedStartupRange = 129d = 81h
-	Fr_ConfigPtr->gtu7  = 0x00080056; // gNumberOfStaticSlots = 8h, gdStaticSlot = 86d = 56h
-	Fr_ConfigPtr->gtu8  = 0x015A0004; // gNumberOfMinislots = 346d = 15Ah, gdMinislot = 4h
-	Fr_ConfigPtr->gtu9  = 0x00010204; // gdDynamicSlotIdlePhase = 1, gdMinislotActionPointOffset = 2, gdActionPointOffset = 4h
-	Fr_ConfigPtr->gtu10 = 0x015100CD; // pRateCorrectionOut = 337d = 151h, pOffsetCorrectionOut = 205d = CDh
-	Fr_ConfigPtr->gtu11 = 0x00000000; // pExternRateCorrection = 0, pExternOffsetCorrection = 0, no ext. clk. corr.
-	Fr_ConfigPtr->succ2 = 0x0F036DA2; // gListenNoise = Fh, pdListenTimeout = 224674d = 36DA2h
-	Fr_ConfigPtr->succ3 = 0x000000FF; // gMaxWithoutClockCorrectionFatal = Fh , passive = Fh
-	Fr_ConfigPtr->prtc1 = 0x084C000A; // pWakeupPattern = 2h, gdWakeupSymbolRxWindow = 76d, BRP = 0, gdTSSTransmitter = Ah
-	Fr_ConfigPtr->prtc2 = 0x3CB41212; // gdWakeupSymbolTxLow = 60d, gdWakeupSymbolTxIdle = 180d, gdWakeupSymbolRxLow = 18d, gdWakeupSymbolRxIdle = 18d
-	Fr_ConfigPtr->mhdc  = 0x010D0009; // pLatestTransmit = 269d = 010Dh, gPayloadLengthStatic = 9h
-	Fr_ConfigPtr->mrc   = 0x00174004; // LCB=23d, FFB=64d, FDB=4d (0..3 static, 4..23 dyn., 0 fifo)
+	(void)pair;
+	(void)channel;
+	check_node_a(Fr_CtxPtr, 2, rdds);
+}
 
+// events_node_a with each payload produced lead macroticks before its
+// action point (Fr_JitRun on timer 1) instead of all of them at cycle start,
+// and node B's slot 2 frame merged from buffers #2 (channel A) and #3 (channel B)
+int jit_node_a(fr_ctx *Fr_CtxPtr, int lead)
+{
+	int i;
+
+	Fr_JitInit(Fr_CtxPtr);
+	for (i = 0; i < FR_IMAGES(Fr_NodeATx); i++)
+		if (Fr_JitAdd(Fr_CtxPtr, Fr_NodeATx[i], produce_node_a, lead) < 0) return -1;
+	if (Fr_DualAdd(Fr_CtxPtr, 2, 3, merge_node_a) < 0) return -1;
+	return Fr_OnCycle(Fr_CtxPtr, count_node_a, 0);
+}
+
+int configure_initialize_node_b(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
 
 	// Wait for PBSY bit to clear - POC not busy
 	while(((Fray_PST->SUCC1_UN.SUCC1_UL) & 0x00000080) != 0);
-	
-	// Initialize
-	Fr_Init(Fray_PST, Fr_ConfigPtr);
-
-	// Buffer config initialization 
-	Fr_LPduPtr->mbi  = 1;   // message buffer interrupt
-	Fr_LPduPtr->txm  = 0;   // transmission mode - continuous mode
-	Fr_LPduPtr->ppit = 0;   // network management Enable
-	Fr_LPduPtr->cfg  = 0;   // message buffer configuration bit (0=RX, 1 = TX)
-	Fr_LPduPtr->chb  = 1;   // Ch B
-	Fr_LPduPtr->cha  = 1;   // Ch A
-	Fr_LPduPtr->cyc  = 0;   // Cycle Filtering Code (no cycle filtering)
-	Fr_LPduPtr->fid  = 0;   // Frame ID
-	Fr_LPduPtr->pl   = 0;   // Payload Length
-	Fr_LPduPtr->dp   = 0;   // Pointer to start of data in message RAM
-	Fr_LPduPtr->sfi  = 0;   // startup frame indicator
-	Fr_LPduPtr->sync = 0;   // sync frame indicator
-
-	Fr_LSduPtr->ibrh = 0;  // input buffer number
-	Fr_LSduPtr->stxrh= 0;  // set transmission request
-	Fr_LSduPtr->ldsh = 0;  // load data section
-	Fr_LSduPtr->lhsh = 0;  // load header section
-	Fr_LSduPtr->ibsyh = 1; // check for input buffer busy shadow
-	Fr_LSduPtr->ibsys = 1; // check for input buffer busy host
-	Fr_LSduPtr->obrs = 0;  // output buffer number
-	Fr_LSduPtr->rdss = 0;  // read data section
-	Fr_LSduPtr->rhss = 0;  // read header section
-
-
-	// Message buffers
-
-	// Buffer #2
-	Fr_LPduPtr->fid  = 2;    // frame ID
-	Fr_LPduPtr->dp   = 0x85; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 1;    // TX frame
-	Fr_LPduPtr->sync = 1;    // sync frame indicator
-	Fr_LPduPtr->sfi  = 1;    // startup frame indicator
-	Fr_LPduPtr->pl   = 9;	 // 18 byte payload
-	Fr_LPduPtr->crc  = header_crc_calc(Fr_LPduPtr);
-
-	Fr_LSduPtr->lhsh = 1;  // load header section
-	Fr_LSduPtr->ibrh = 0;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
-
-	// Buffer #1
-	Fr_LPduPtr->fid  = 1;    // frame ID
-	Fr_LPduPtr->dp   = 0x80; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 0;    // RX frame
-	Fr_LPduPtr->sync = 0;    // sync frame indicator
-	Fr_LPduPtr->sfi  = 0;    // startup frame indicator
-	Fr_LPduPtr->crc  = 0;
-
-	Fr_LSduPtr->ibrh = 1;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
-
-    // buffer #10
-	Fr_LPduPtr->fid  = 10;   // frame ID
-	Fr_LPduPtr->dp   = 0x240; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 1;    // TX frame
-	Fr_LPduPtr->chb  = 0;    // No transmission on Ch B
-	Fr_LPduPtr->pl   = 127;	 // 254 byte payload
-	Fr_LPduPtr->crc  = header_crc_calc(Fr_LPduPtr);
-
-	Fr_LSduPtr->ibrh = 10;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
-
-	// buffer #9
-	Fr_LPduPtr->fid  = 9;     // frame ID
-	Fr_LPduPtr->dp   = 0x200; // Pointer to start of data in message RAM
-	Fr_LPduPtr->cfg  = 0;    // RX frame
-	Fr_LPduPtr->crc  = 0;
-
-	Fr_LSduPtr->ibrh = 9;  // input buffer number
-
-	Fr_PrepareLPdu(Fray_PST, Fr_LPduPtr);
-	Fr_TransmitTxLPdu(Fray_PST, Fr_LSduPtr);
 
+	// Initialize GTU, PRTC, MHDC, SUCC and MRC from the compiled cluster schedule
+	Fr_CtxLoadImage(Fr_CtxPtr, &Fr_NodeBStartup);
+	Fr_Init(Fray_PST, &Fr_CtxPtr->config);
+
+	// Message buffers #0 (slot 2 TX), #1 (slot 1 RX), #9 (frame 9 RX), #10 (frame 10 TX)
+	Fr_LoadBufferImages(Fray_PST, Fr_CtxPtr->image->buffers, Fr_CtxPtr->image->count);
+	if (Fr_CtxPtr->fifo != 0 && Fr_ConfigureFifo(Fr_CtxPtr, Fr_CtxPtr->fifo) < 0) return 1;
+	if (Fr_TxTrackInit(Fr_CtxPtr, Fr_NodeBTx, FR_IMAGES(Fr_NodeBTx)) < 0) return 1;
 
 	Fr_ControllerInit(Fray_PST);
 	// Initialize Interrupts
 	Fray_PST->EIR_UN.EIR_UL       = 0xFFFFFFFF; // Clear Error Int.
 	Fray_PST->SIR_UN.SIR_UL       = 0xFFFFFFFF; // Clear Status Int.
-	Fray_PST->SILS_UN.SILS_UL     = 0x00000000; // all Status Int. to eray_int0
+	Fray_PST->SILS_UN.SILS_UL     = 0x00000104; // CYCS, TI0 Int. to eray_int1, others to eray_int0
 	Fray_PST->SIER_UN.SIER_UL     = 0xFFFFFFFF; // Disable all Status Int.
-	Fray_PST->SIES_UN.SIES_UL     = 0x00000004; // Enable CYCSE Int.
+	Fray_PST->SIES_UN.SIES_UL     = 0x00000104; // Enable CYCSE, TI0E Int.
 	Fray_PST->ILE_UN.ILE_UL       = 0x00000002; // enable eray_int1
 
 	Fr_AllowColdStart(Fray_PST);
+	return 0;
 }
 	
 
-int transmit_check_node_b(FRAY_ST *Fray_PST)
+// Fast path of configure_initialize_node_b + Fr_StartCommunication, returns in NORMAL_ACTIVE
+int fast_startup_node_b(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock, unsigned long timeout, fr_startup_log *Fr_LogPtr)
+{
+	Fr_CtxLoadImage(Fr_CtxPtr, &Fr_NodeBStartup);
+	if (Fr_TxTrackInit(Fr_CtxPtr, Fr_NodeBTx, FR_IMAGES(Fr_NodeBTx)) < 0) return 1;
+	return Fr_FastStartup(Fr_CtxPtr->regs, Fr_CtxPtr->image, Fr_Clock, timeout, Fr_LogPtr);
+}
+
+// Payload of node B's TX buffers #0 (slot 2) and #10 (frame 10), written at cycle start
+static void update_node_b(fr_ctx *Fr_CtxPtr, int cycle)
+{
+	(void)cycle;
+	// buffer #0
+	Fr_TxWrite(Fr_CtxPtr, 0, 0, 0x12345678);     // Data 1
+	Fr_TxWrite(Fr_CtxPtr, 0, 1, 0x87654321);     // Data 2
+	Fr_TxCommit(Fr_CtxPtr, 0);
+
+	// buffer #10
+	Fr_TxWrite(Fr_CtxPtr, 10, 0, 0xFF);          // Data 1
+	Fr_TxWrite(Fr_CtxPtr, 10, 1, 0xFFFF);        // Data 2
+	Fr_TxWrite(Fr_CtxPtr, 10, 2, 0xFFFFFF);      // Data 3
+	Fr_TxWrite(Fr_CtxPtr, 10, 3, 0xFFFFFFFF);    // Data 4
+	Fr_TxWrite(Fr_CtxPtr, 10, 4, 0xFFFFFF00);    // Data 5
+	Fr_TxWrite(Fr_CtxPtr, 10, 5, 0xFFFF0000);    // Data 6
+	Fr_TxCommit(Fr_CtxPtr, 10);
+	Fr_CtxPtr->stats.cycles++;
+}
+
+// Node A's slot 1 frame, received in buffer #1
+static void check_node_b(fr_ctx *Fr_CtxPtr, int buffer, volatile unsigned long *rdds)
 {
-	bc *write_buffer=&Fr_LSdu1;
-	bc *read_buffer=&Fr_LSdu2;
+	(void)buffer;
+	Fr_CtxPtr->stats.rx_frames++;
+	if (rdds[1] != 0x000000FF) Fr_CtxPtr->stats.rx_errors++;
+}
+
+int transmit_check_node_b(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	bc *read_buffer=&Fr_CtxPtr->read_buffer;
+	unsigned long errors = Fr_CtxPtr->stats.rx_errors;
 	unsigned int  ndat1;
-	int error=0;
-	write_buffer->ibrh = 0;  // input buffer number
-	write_buffer->stxrh= 1;  // set transmission request
-	write_buffer->ldsh = 1;  // load data section
-	write_buffer->lhsh = 0;  // load header section
-	write_buffer->ibsys = 0; // check for input buffer busy shadow
-	write_buffer->ibsyh = 1; // check for input buffer busy host
 
     // wait for cycle start interrupt flag
     Fray_PST->SIR_UN.SIR_UL = 0xFFFFFFFF;            // clear all status int. flags
     while ((Fray_PST->SIR_UN.SIR_UL & 0x4) == 0x0);    // wait for CYCS interrupt flag
     Fray_PST->SIR_UN.SIR_UL = 0xFFFFFFFF;            // clear all status int. flags
 
-	// write payload for buffers
-	// buffer #2
-	(Fray_PST->WRDS[0] = 0x12345678);    // Data 1
-    (Fray_PST->WRDS[1] = 0x87654321);    // Data 2
-	Fr_TransmitTxLPdu(Fray_PST, write_buffer);
-
-	// buffer #10
-	write_buffer->ibrh = 10;
-	(Fray_PST->WRDS[0] = 0xFF);    		 // Data 1
-    (Fray_PST->WRDS[1] = 0xFFFF);   	 // Data 2
-	(Fray_PST->WRDS[2] = 0xFFFFFF);      // Data 3
-    (Fray_PST->WRDS[3] = 0xFFFFFFFF);    // Data 4
-	(Fray_PST->WRDS[4] = 0xFFFFFF00);    // Data 5
-    (Fray_PST->WRDS[5] = 0xFFFF0000);    // Data 6
-	Fr_TransmitTxLPdu(Fray_PST, write_buffer);
+	update_node_b(Fr_CtxPtr, 0);
 
 	 // check received frames
     ndat1 = Fray_PST->NDAT1_UN.NDAT1_UL;
@@ -402,10 +301,19 @@ int transmit_check_node_b(FRAY_ST *Fray_PST)
     {
       read_buffer->obrs=1;  // output buffer number
 	  read_buffer->rdss=1;  // read data section
-	  read_buffer->rhss=0;  // read header section
+	  read_buffer->rhss=Fr_CtxPtr->trace != 0;  // read header section when tracing
       // Transfer message buffer 1 data to output buffer registers
       Fr_ReceiveRxLPdu(Fray_PST, read_buffer);
-      if (Fray_PST->RDDS[1] != 0x000000FF) error++; 
+      Fr_TimeStamp(Fr_CtxPtr, &Fr_CtxPtr->rx_stamp);
+      if (Fr_CtxPtr->trace != 0) Fr_TraceRx(Fr_CtxPtr);
+      check_node_b(Fr_CtxPtr, 1, Fray_PST->RDDS);
 	}
-	  return error;		
+	return (int)(Fr_CtxPtr->stats.rx_errors - errors);
+}
+
+// Interrupt driven transmit_check_node_b
+int events_node_b(fr_ctx *Fr_CtxPtr)
+{
+	Fr_OnBuffer(Fr_CtxPtr, 1, check_node_b);
+	return Fr_OnCycle(Fr_CtxPtr, update_node_b, 0);
 }
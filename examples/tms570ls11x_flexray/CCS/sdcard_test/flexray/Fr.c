@@ -10,20 +10,32 @@
 
 #include"Fr.h"
 
+// count leading zeros
+#if defined(__TI_COMPILER_VERSION__)
+#define FR_CLZ(x) _norm(x)
+#else
+#define FR_CLZ(x) __builtin_clz(x)
+#endif
+
+// sleep until an interrupt; IRQ masked around the check so a wakeup is not lost
+#if defined(__TI_COMPILER_VERSION__)
+#define FR_IRQ_OFF() _disable_IRQ()
+#define FR_IRQ_ON()  _enable_IRQ()
+#define FR_WFI()     asm(" WFI")
+#else
+#define FR_IRQ_OFF()
+#define FR_IRQ_ON()
+#define FR_WFI()
+#endif
+
 /***********************************************************************
-	Fr_PrepareLPdu
-	The function Fr_PrepareLPdu shall perform the following tasks on FlexRay
-	CC Fr_CtrIdx:
-	1. Figure out the physical resource (e.g., a buffer) mapped to the processing of
-	the FlexRay frame identified by Fr_LPduIdx.
-	2. Configure the physical resource (a buffer) appropriate for Fr_LPduPtr
-	operation (SlotId, Cycle filter, payload length, header CRC, etc.) if the MCG
-	uses the reconfiguration feature.
+	Fr_HeaderWords
+	Packs the header of Fr_LPduPtr into the WRHS1..3 words w[0..2].
 ***********************************************************************/
-void Fr_PrepareLPdu(FRAY_ST *Fray_PST, wrhs *Fr_LPduPtr)
+
+static void Fr_HeaderWords(wrhs *Fr_LPduPtr, unsigned long *w)
 {
-	int wrhs1;
-	int wrhs2;
+	unsigned long wrhs1;
 	wrhs1  = ((Fr_LPduPtr->mbi) & 0x1)  <<29;
 	wrhs1 |= (Fr_LPduPtr->txm & 0x1)  << 28;
 	wrhs1 |= (Fr_LPduPtr->ppit & 0x1) << 27;
@@ -32,12 +44,30 @@ void Fr_PrepareLPdu(FRAY_ST *Fray_PST, wrhs *Fr_LPduPtr)
 	wrhs1 |= (Fr_LPduPtr->cha & 0x1)  << 24;
 	wrhs1 |= (Fr_LPduPtr->cyc & 0x7F) << 16;
 	wrhs1 |= (Fr_LPduPtr->fid & 0x7FF);
-	Fray_PST->WRHS1_UN.WRHS1_UL = wrhs1;
+	w[0] = wrhs1;
+	w[1] = ((Fr_LPduPtr->pl & 0x7F) << 16) | (Fr_LPduPtr->crc & 0x7FF);
+	w[2] = (Fr_LPduPtr->dp & 0x7FF);
+}
 
-	wrhs2  = ((Fr_LPduPtr->pl & 0x7F) << 16) | (Fr_LPduPtr->crc & 0x7FF);
-	Fray_PST->WRHS2_UN.WRHS2_UL = wrhs2;
+/***********************************************************************
+	Fr_PrepareLPdu
+	The function Fr_PrepareLPdu shall perform the following tasks on FlexRay
+	CC Fr_CtrIdx:
+	1. Figure out the physical resource (e.g., a buffer) mapped to the processing of
+	the FlexRay frame identified by Fr_LPduIdx.
+	2. Configure the physical resource (a buffer) appropriate for Fr_LPduPtr
+	operation (SlotId, Cycle filter, payload length, header CRC, etc.) if the MCG
+	uses the reconfiguration feature.
+***********************************************************************/
+
+void Fr_PrepareLPdu(FRAY_ST *Fray_PST, wrhs *Fr_LPduPtr)
+{
+	unsigned long w[3];
 
-	Fray_PST->WRHS3_UN.WRHS3_UL = (Fr_LPduPtr->dp & 0x7FF);
+	Fr_HeaderWords(Fr_LPduPtr, w);
+	Fray_PST->WRHS1_UN.WRHS1_UL = w[0];
+	Fray_PST->WRHS2_UN.WRHS2_UL = w[1];
+	Fray_PST->WRHS3_UN.WRHS3_UL = w[2];
 }
 
 /***********************************************************************
@@ -109,112 +139,2324 @@ void Fr_ReceiveRxLPdu(FRAY_ST *Fray_PST, bc *Fr_LSduPtr)
 
 
 /***********************************************************************
-	Fr_ControllerInit
-	
+	Fr_ReceiveRxBatch
+	Reads every buffer flagged in NDAT1/NDAT2 in one pass. Flagged
+	buffers are found lowest first with a bit scan; while the host reads
+	buffer n from RDDS the next one is already being transferred into
+	the output shadow, so each step costs one OBCR write (VIEW | REQ)
+	instead of a full request / wait / view round trip.
+	Fr_RxCallbacks is indexed by buffer number, NULL entries are skipped.
+	Returns the number of buffers read.
+***********************************************************************/
+
+static int Fr_NextBuffer(unsigned long *ndat)
+{
+	unsigned long low;
+	int word;
+
+	for (word = 0; word < 2; word++)
+	{
+		if (ndat[word] != 0)
+		{
+			low = ndat[word] & (0UL - ndat[word]);   // lowest set bit
+			ndat[word] &= ~low;
+			return word * 32 + 31 - FR_CLZ((unsigned int)low);
+		}
+	}
+	return -1;
+}
+
+// Pipelined read of the buffers flagged in ndat; handlers from Fr_RxCallbacks,
+// or from the context's per-buffer callbacks when Fr_CtxPtr is set
+static int Fr_ReceiveFlagged(FRAY_ST *Fray_PST, bc *Fr_LSduPtr, unsigned long *ndat,
+                             rx_callback *Fr_RxCallbacks, fr_ctx *Fr_CtxPtr)
+{
+	int buffer, next;
+	int count = 0;
+
+	buffer = Fr_NextBuffer(ndat);
+	if (buffer < 0) return 0;
+
+	// ensure no transfer in progress on shadow registers
+	while (((Fray_PST->OBCR_UN.OBCR_UL) & 0x00008000) != 0);
+	Fray_PST->OBCM_UN.OBCM_UL=(((Fr_LSduPtr->rdss & 0x1) << 1) | (Fr_LSduPtr->rhss & 0x1));
+	Fray_PST->OBCR_UN.OBCR_UL=((1 << 9) | (buffer & 0x3F)); //req=1, view=0
+
+	while (buffer >= 0)
+	{
+		next = Fr_NextBuffer(ndat);
+		// wait for completion on shadow registers
+		while (((Fray_PST->OBCR_UN.OBCR_UL) & 0x00008000) != 0);
+		// swap buffer into the host view and start fetching the next one
+		if (next >= 0)
+			Fray_PST->OBCR_UN.OBCR_UL=((1 << 9) | (1 << 8) | (next & 0x3F)); //req=1, view=1
+		else
+			Fray_PST->OBCR_UN.OBCR_UL=(1 << 8); //req=0, view=1
+
+		if (Fr_CtxPtr != 0)
+		{
+			Fr_TimeStamp(Fr_CtxPtr, &Fr_CtxPtr->rx_stamp);
+			if (Fr_CtxPtr->trace != 0) Fr_TraceRx(Fr_CtxPtr);
+			Fr_CtxPtr->events.buffer[buffer](Fr_CtxPtr, buffer, Fray_PST->RDDS);
+		}
+		else if (Fr_RxCallbacks[buffer] != 0)
+			Fr_RxCallbacks[buffer](buffer, Fray_PST->RDDS);
+		count++;
+		buffer = next;
+	}
+	return count;
+}
+
+int Fr_ReceiveRxBatch(FRAY_ST *Fray_PST, bc *Fr_LSduPtr, rx_callback *Fr_RxCallbacks)
+{
+	unsigned long ndat[2];
+
+	ndat[0] = Fray_PST->NDAT1_UN.NDAT1_UL & 0xFFFFFFFF;
+	ndat[1] = Fray_PST->NDAT2_UN.NDAT2_UL & 0xFFFFFFFF;
+	return Fr_ReceiveFlagged(Fray_PST, Fr_LSduPtr, ndat, Fr_RxCallbacks, 0);
+}
+
 
+/***********************************************************************
+	Fr_LoadBufferImages
+	Writes precompiled header sections (WRHS1..3 images with data pointer
+	and header CRC already in place) into the message RAM. Must be called
+	in POC state CONFIG.
 ***********************************************************************/
 
-int Fr_ControllerInit(FRAY_ST *Fray_PST)
+void Fr_LoadBufferImages(FRAY_ST *Fray_PST, const mbuf_image *Fr_ImagePtr, int count)
 {
-	unsigned int error=0;
-	// write SUCC1 configuration
-	Fray_PST->SUCC1_UN.SUCC1_UL = 0x0F1FFB00 | CMD_CONFIG;
-	// Check if POC has accepted last command 
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		// ensure no transfer in progress on shadow registers
+		while (((Fray_PST->IBCR_UN.IBCR_UL) & 0x80008000) != 0);
+		Fray_PST->WRHS1_UN.WRHS1_UL = Fr_ImagePtr[i].wrhs1;
+		Fray_PST->WRHS2_UN.WRHS2_UL = Fr_ImagePtr[i].wrhs2;
+		Fray_PST->WRHS3_UN.WRHS3_UL = Fr_ImagePtr[i].wrhs3;
+		Fray_PST->IBCM_UN.IBCM_UL = 0x1;   // lhsh=1
+		Fray_PST->IBCR_UN.IBCR_UL = (Fr_ImagePtr[i].buffer & 0x3F);
+	}
+	while (((Fray_PST->IBCR_UN.IBCR_UL) & 0x80008000) != 0);
+}
+
+
+/***********************************************************************
+	Fr_CycleCode
+	Cycle code (WRHS1.CYC) of a frame sent every repetition-th cycle
+	starting at cycle base. Returns -1 unless repetition is a power of 2
+	up to 64 and base is below it.
+***********************************************************************/
+
+int Fr_CycleCode(int repetition, int base)
+{
+	if (repetition < 1 || repetition > 64 || (repetition & (repetition - 1)) != 0) return -1;
+	if (base < 0 || base >= repetition) return -1;
+	return repetition | base;
+}
+
+static void Fr_CycleMask(int repetition, int base, unsigned long *mask)
+{
+	int cycle;
+
+	mask[0] = mask[1] = 0;
+	for (cycle = base; cycle < 64; cycle += repetition)
+		mask[cycle >> 5] |= 1UL << (cycle & 0x1F);
+}
+
+
+/***********************************************************************
+	Fr_PackSlots
+	Places the frames into the slots of Fr_SlotPtr (fid set by the
+	caller), first fit, highest rate first so the low-rate frames fill
+	the gaps. A frame with base -1 takes the first base that is free in
+	a slot. Sets fid and cyc in each frame's lpdu; the caller places the
+	data sections and loads the headers (Fr_UpdateLPdu with lhsh). A
+	frame that does not fit or has an invalid repetition or base gets
+	fid 0. Returns the number of frames placed.
+***********************************************************************/
+
+int Fr_PackSlots(mux_frame *Fr_FramePtr, int count, slot_use *Fr_SlotPtr, int nslots)
+{
+	unsigned long mask[2];
+	mux_frame *f;
+	slot_use *s;
+	int repetition, base, first, last, i, k, placed, packed = 0;
+
+	for (k = 0; k < nslots; k++)
+	{
+		Fr_SlotPtr[k].frames = 0;
+		Fr_SlotPtr[k].cycles[0] = Fr_SlotPtr[k].cycles[1] = 0;
+	}
+	for (i = 0; i < count; i++)
+		Fr_FramePtr[i].lpdu->fid = 0;
+
+	for (repetition = 1; repetition <= 64; repetition <<= 1)
+		for (i = 0; i < count; i++)
+		{
+			f = &Fr_FramePtr[i];
+			if (f->repetition != repetition || f->base >= repetition) continue;
+			first = f->base < 0 ? 0 : f->base;
+			last  = f->base < 0 ? repetition - 1 : f->base;
+			placed = 0;
+			for (k = 0; k < nslots && !placed; k++)
+			{
+				s = &Fr_SlotPtr[k];
+				for (base = first; base <= last && !placed; base++)
+				{
+					Fr_CycleMask(repetition, base, mask);
+					if (((mask[0] & s->cycles[0]) | (mask[1] & s->cycles[1])) != 0) continue;
+					s->cycles[0] |= mask[0];
+					s->cycles[1] |= mask[1];
+					s->frames++;
+					f->lpdu->fid = s->fid;
+					f->lpdu->cyc = repetition | base;
+					placed = 1;
+				}
+			}
+			packed += placed;
+		}
+	return packed;
+}
+
+
+/***********************************************************************
+	Fr_SlotUtilisation
+	Share of the slot cycles taken in the slots that carry at least one
+	frame, in percent.
+***********************************************************************/
+
+int Fr_SlotUtilisation(const slot_use *Fr_SlotPtr, int nslots)
+{
+	unsigned long m;
+	int k, j, slots = 0, used = 0;
+
+	for (k = 0; k < nslots; k++)
+	{
+		if (Fr_SlotPtr[k].frames == 0) continue;
+		slots++;
+		for (j = 0; j < 2; j++)
+			for (m = Fr_SlotPtr[k].cycles[j]; m != 0; m &= m - 1)
+				used++;
+	}
+	return slots ? used * 100 / (slots * 64) : 0;
+}
+
+
+/***********************************************************************
+	Fr_FastStartup
+	Brings the controller from reset to NORMAL_ACTIVE from a packed image
+	(Fr_Schedule.h FR_STARTUP_IMAGE): the configuration registers are
+	copied in two tight loops and the buffer headers are pipelined through
+	the input buffer, waiting only for the host side (IBSYH) so that the
+	transfer of one header overlaps writing the next. Every POC state seen
+	on the way is logged with its entry time. Every wait shares one
+	deadline: timeout clock ticks from the call, or timeout register
+	polls when Fr_Clock is 0 (the log then holds poll counts).
+	Returns 0 in NORMAL_ACTIVE, 1 if a POC command was not accepted,
+	2 when the deadline passes.
+***********************************************************************/
+
+static void Fr_LogState(fr_startup_log *Fr_LogPtr, int state, unsigned long time)
+{
+	int n = Fr_LogPtr->count;
+
+	if (n > 0 && Fr_LogPtr->state[n - 1] == state) return;
+	if (n == FR_STARTUP_STEPS) return;
+	Fr_LogPtr->state[n] = state;
+	Fr_LogPtr->time[n] = time;
+	Fr_LogPtr->count = n + 1;
+}
+
+// Wait for PBSY bit to clear - POC not busy; 1 if it is still set after FR_PBSY_POLLS reads
+static int Fr_PbsyWait(FRAY_ST *Fray_PST)
+{
+	unsigned long n;
+
+	for (n = 0; n < FR_PBSY_POLLS; n++)
+		if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0x00000080) == 0x0) return 0;
+	return 1;
+}
+
+// Wait for the IBCR busy bits in mask to clear; 1 if still set after FR_PBSY_POLLS reads
+static int Fr_IbWait(FRAY_ST *Fray_PST, unsigned long mask)
+{
+	unsigned long n;
+
+	for (n = 0; n < FR_PBSY_POLLS; n++)
+		if ((Fray_PST->IBCR_UN.IBCR_UL & mask) == 0x0) return 0;
+	return 1;
+}
+
+static int Fr_StartupCommand(FRAY_ST *Fray_PST, unsigned long succ1)
+{
+	Fray_PST->SUCC1_UN.SUCC1_UL = succ1;
+	// Check if POC has accepted last command
+	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) return 1;
+	return Fr_PbsyWait(Fray_PST) ? 2 : 0;
+}
+
+// Time since the start of Fr_FastStartup: clock ticks, or polls without a clock
+static unsigned long Fr_StartupTime(fr_clock Fr_Clock, unsigned long t0, unsigned long *polls)
+{
+	(*polls)++;
+	return Fr_Clock ? Fr_Clock() - t0 : *polls;
+}
+
+// Wait for the mask bits of reg to clear; 1 if the startup deadline passes first
+static int Fr_StartupWait(volatile unsigned long *reg, unsigned long mask, fr_clock Fr_Clock,
+                          unsigned long t0, unsigned long timeout, unsigned long *polls)
+{
+	while ((*reg & mask) != 0)
+		if (Fr_StartupTime(Fr_Clock, t0, polls) > timeout) return 1;
+	return 0;
+}
+
+// Fr_StartupCommand with the PBSY wait bounded by the startup deadline
+static int Fr_FastCommand(FRAY_ST *Fray_PST, unsigned long succ1, fr_clock Fr_Clock,
+                          unsigned long t0, unsigned long timeout, unsigned long *polls)
+{
+	Fray_PST->SUCC1_UN.SUCC1_UL = succ1;
 	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) return 1;
-	// Wait for PBSY bit to clear - POC not busy
-	while ((Fray_PST->SUCC1_UN.SUCC1_UL & 0x00000080) != 0x0);
+	return Fr_StartupWait(&Fray_PST->SUCC1_UN.SUCC1_UL, 0x00000080, Fr_Clock, t0, timeout, polls) ? 2 : 0;
+}
+
+int Fr_FastStartup(FRAY_ST *Fray_PST, const fr_startup_image *Fr_ImagePtr, fr_clock Fr_Clock,
+                   unsigned long timeout, fr_startup_log *Fr_LogPtr)
+{
+	volatile unsigned long *reg;
+	volatile unsigned long *ibcr = &Fray_PST->IBCR_UN.IBCR_UL;
+	unsigned long t0 = Fr_Clock ? Fr_Clock() : 0, now, polls = 0;
+	int i, state, error;
+
+	Fr_LogPtr->count = 0;
+	Fr_LogState(Fr_LogPtr, Fray_PST->CCSV_UN.CCSV_UL & 0x3F, 0);
+	if (Fr_StartupWait(&Fray_PST->SUCC1_UN.SUCC1_UL, 0x00000080, Fr_Clock, t0, timeout, &polls)) return 2;
+	if ((error = Fr_FastCommand(Fray_PST, Fr_ImagePtr->succ1 | CMD_CONFIG, Fr_Clock, t0, timeout, &polls)) != 0)
+		return error;
+	Fr_LogState(Fr_LogPtr, Fray_PST->CCSV_UN.CCSV_UL & 0x3F, Fr_StartupTime(Fr_Clock, t0, &polls));
+
+	// configuration registers
+	Fray_PST->MRC_UN.MRC_UL = Fr_ImagePtr->mrc;
+	reg = &Fray_PST->SUCC2_UN.SUCC2_UL;
+	for (i = 0; i < FR_IMAGE_SUCC_WORDS; i++)
+		reg[i] = Fr_ImagePtr->succ[i];
+	reg = &Fray_PST->GTUC1_UN.GTUC1_UL;
+	for (i = 0; i < FR_IMAGE_GTU_WORDS; i++)
+		reg[i] = Fr_ImagePtr->gtu[i];
+
+	// buffer headers
+	for (i = 0; i < Fr_ImagePtr->count; i++)
+	{
+		if (Fr_StartupWait(ibcr, 0x00008000, Fr_Clock, t0, timeout, &polls)) return 2;
+		Fray_PST->WRHS1_UN.WRHS1_UL = Fr_ImagePtr->buffers[i].wrhs1;
+		Fray_PST->WRHS2_UN.WRHS2_UL = Fr_ImagePtr->buffers[i].wrhs2;
+		Fray_PST->WRHS3_UN.WRHS3_UL = Fr_ImagePtr->buffers[i].wrhs3;
+		Fray_PST->IBCM_UN.IBCM_UL = 0x1;   // lhsh=1
+		Fray_PST->IBCR_UN.IBCR_UL = (Fr_ImagePtr->buffers[i].buffer & 0x3F);
+	}
+	if (Fr_StartupWait(ibcr, 0x80008000, Fr_Clock, t0, timeout, &polls)) return 2;
 
 	// unlock CONFIG and enter READY state
 	Fray_PST->LCK_UN.LCK_ST.clk_B8=0xCE;
 	Fray_PST->LCK_UN.LCK_ST.clk_B8=0x31;
-	// write SUCC1 configuration
-	Fray_PST->SUCC1_UN.SUCC1_ST.cmd_B4=(0xFB00 | CMD_READY);
-	// Check if POC has accepted last command 
-	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) error = 1;
-	// Wait for PBSY bit to clear - POC not busy
-	while ((Fray_PST->SUCC1_UN.SUCC1_UL & 0x00000080) != 0x0);	 
-	return error;
+	if ((error = Fr_FastCommand(Fray_PST, Fr_ImagePtr->succ1 | CMD_READY, Fr_Clock, t0, timeout, &polls)) != 0)
+		return error;
+	Fr_LogState(Fr_LogPtr, Fray_PST->CCSV_UN.CCSV_UL & 0x3F, Fr_StartupTime(Fr_Clock, t0, &polls));
+
+	// Initialize Interrupts
+	Fray_PST->EIR_UN.EIR_UL   = 0xFFFFFFFF; // Clear Error Int.
+	Fray_PST->SIR_UN.SIR_UL   = 0xFFFFFFFF; // Clear Status Int.
+	Fray_PST->SILS_UN.SILS_UL = Fr_ImagePtr->sils;
+	Fray_PST->SIER_UN.SIER_UL = 0xFFFFFFFF; // Disable all Status Int.
+	Fray_PST->SIES_UN.SIES_UL = Fr_ImagePtr->sies;
+	Fray_PST->ILE_UN.ILE_UL   = Fr_ImagePtr->ile;
+
+	if ((error = Fr_FastCommand(Fray_PST, CMD_ALLOW_COLDSTART, Fr_Clock, t0, timeout, &polls)) != 0)
+		return error;
+	Fray_PST->SUCC1_UN.SUCC1_UL = CMD_RUN;
+	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) return 1;
+
+	// follow the POC through startup, one CCSV read per poll
+	do
+	{
+		state = Fray_PST->CCSV_UN.CCSV_UL & 0x3F;
+		now = Fr_StartupTime(Fr_Clock, t0, &polls);
+		if (now > timeout) return 2;
+		Fr_LogState(Fr_LogPtr, state, now);
+	} while (state != FR_POCS_NORMAL_ACTIVE);
+	return 0;
 }
 
 
 /***********************************************************************
-	Fr_AllowColdStart
+	Fr_TxQueueInit
 	
 
 ***********************************************************************/
 
-int Fr_AllowColdStart(FRAY_ST *Fray_PST)
+void Fr_TxQueueInit(txq *Fr_TxQueuePtr)
 {
-	unsigned int error=0;
-	// write SUCC1 configuration
-	(Fray_PST->SUCC1_UN.SUCC1_UL = CMD_ALLOW_COLDSTART);
-	// Check if POC has accepted last command 
-	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) error = 1;
-	// Wait for PBSY bit to clear - POC not busy
-	while ((Fray_PST->SUCC1_UN.SUCC1_UL & 0x00000080) != 0x0);
-	return error;
+	Fr_TxQueuePtr->head   = 0;
+	Fr_TxQueuePtr->count  = 0;
+	Fr_TxQueuePtr->direct = 0;
+	Fr_TxQueuePtr->queued = 0;
+	Fr_TxQueuePtr->full   = 0;
 }
 
 
 /***********************************************************************
-	Fr_StartCommunication
-	
+	Fr_TxQueueSubmit
+	Non-blocking version of Fr_TransmitTxLPdu for data updates. When the
+	input buffer host side is free the payload goes straight to WRDS and
+	the transfer is requested; the CC then swaps it into the shadow and
+	moves it to the message RAM while the CPU carries on. Otherwise the
+	payload waits in the queue for Fr_TxQueuePoll.
+	Header loads are not queued (lhsh is ignored), use Fr_PrepareLPdu and
+	Fr_TransmitTxLPdu for those.
+	Returns 1 if the queue is full.
+***********************************************************************/
+
+int Fr_TxQueueSubmit(FRAY_ST *Fray_PST, txq *Fr_TxQueuePtr, bc *Fr_LSduPtr, const unsigned long *data, int words)
+{
+	txq_entry *entry;
+	int ibcm;
+	int i;
+
+	ibcm = ((Fr_LSduPtr->stxrh & 0x1) << 2) | ((Fr_LSduPtr->ldsh & 0x1) << 1);
+	if (words > 64) words = 64;
+
+	// keep submission order: only bypass the queue when it is empty
+	if ((Fr_TxQueuePoll(Fray_PST, Fr_TxQueuePtr) == 0) &&
+	    ((Fray_PST->IBCR_UN.IBCR_UL & 0x00008000) == 0))
+	{
+		for (i = 0; i < words; i++)
+			Fray_PST->WRDS[i] = data[i];
+		Fray_PST->IBCM_UN.IBCM_UL = ibcm;
+		Fray_PST->IBCR_UN.IBCR_UL = (Fr_LSduPtr->ibrh & 0x3F);
+		Fr_TxQueuePtr->direct++;
+		return 0;
+	}
 
+	if (Fr_TxQueuePtr->count == FR_TXQ_DEPTH)
+	{
+		Fr_TxQueuePtr->full++;
+		return 1;
+	}
+	entry = &Fr_TxQueuePtr->entry[(Fr_TxQueuePtr->head + Fr_TxQueuePtr->count) % FR_TXQ_DEPTH];
+	entry->ibrh  = Fr_LSduPtr->ibrh & 0x3F;
+	entry->ibcm  = ibcm;
+	entry->words = words;
+	for (i = 0; i < words; i++)
+		entry->data[i] = data[i];
+	Fr_TxQueuePtr->count++;
+	Fr_TxQueuePtr->queued++;
+	return 0;
+}
+
+
+/***********************************************************************
+	Fr_TxQueuePoll
+	Moves queued transfers to the input buffer while its host side is
+	free, without waiting. Returns the number still queued.
 ***********************************************************************/
 
-int Fr_StartCommunication(FRAY_ST *Fray_PST)
+int Fr_TxQueuePoll(FRAY_ST *Fray_PST, txq *Fr_TxQueuePtr)
 {
-	unsigned int error=0;
-	// write SUCC1 configuration
-	(Fray_PST->SUCC1_UN.SUCC1_UL = CMD_RUN);
-	// Check if POC has accepted last command 
-	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) error = 1;
-	return error;
+	txq_entry *entry;
+	int i;
+
+	while ((Fr_TxQueuePtr->count != 0) && ((Fray_PST->IBCR_UN.IBCR_UL & 0x00008000) == 0))
+	{
+		entry = &Fr_TxQueuePtr->entry[Fr_TxQueuePtr->head];
+		for (i = 0; i < entry->words; i++)
+			Fray_PST->WRDS[i] = entry->data[i];
+		Fray_PST->IBCM_UN.IBCM_UL = entry->ibcm;
+		Fray_PST->IBCR_UN.IBCR_UL = entry->ibrh;
+		Fr_TxQueuePtr->head = (Fr_TxQueuePtr->head + 1) % FR_TXQ_DEPTH;
+		Fr_TxQueuePtr->count--;
+	}
+	return Fr_TxQueuePtr->count;
 }
 
+
 /***********************************************************************
-	header_crc_calc
-	This function calculates the header CRC.
+	Fr_TxQueueFlush
+	Waits until every queued transfer has reached the message RAM.
 ***********************************************************************/
 
-int header_crc_calc(wrhs *Fr_LPduPtr)
+void Fr_TxQueueFlush(FRAY_ST *Fray_PST, txq *Fr_TxQueuePtr)
 {
-  unsigned int header;
+	while (Fr_TxQueuePoll(Fray_PST, Fr_TxQueuePtr) != 0);
+	// wait for completion on host and shadow registers
+	while ((Fray_PST->IBCR_UN.IBCR_UL & 0x80008000) != 0);
+}
 
-  int CrcInit = 0x1A;
-  int length  = 20;
-  int CrcNext;
-  unsigned long CrcPoly  = 0x385;
-  unsigned long CrcReg_X = CrcInit;
-  unsigned long header_temp, reg_temp;
 
-  header  = ((Fr_LPduPtr->sync & 0x1)  << 19) | ((Fr_LPduPtr->sfi & 0x1) << 18);
-  header |= ((Fr_LPduPtr->fid & 0x7FF) <<  7) |  (Fr_LPduPtr->pl & 0x7F);
-  
-  header   <<= 11;
-  CrcReg_X <<= 21;
-  CrcPoly  <<= 21;
-
-  while(length--) {
-    header    <<= 1;
-    header_temp = header & 0x80000000;
-    reg_temp    = CrcReg_X & 0x80000000;
-
-    if(header_temp ^ reg_temp){  // Step 1
-      CrcNext = 1;
-    } else {	
-      CrcNext = 0;
-    }
-		
-    CrcReg_X <<= 1;              // Step 2
-	
-    if(CrcNext) {
-      CrcReg_X ^= CrcPoly;       // Step 3
-    }	
-  }
-	
-  CrcReg_X >>= 21;
+/***********************************************************************
+	Fr_CtxInit
+	Clears a driver context and binds it to one controller. Call once
+	per controller before configure_initialize_node_x/fast_startup_node_x.
+***********************************************************************/
+
+void Fr_CtxInit(fr_ctx *Fr_CtxPtr, FRAY_ST *Fray_PST)
+{
+	unsigned char *p = (unsigned char *)Fr_CtxPtr;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(fr_ctx); i++)
+		p[i] = 0;
+	Fr_CtxPtr->regs = Fray_PST;
+	Fr_TxQueueInit(&Fr_CtxPtr->tx_queue);
+	Fr_CtxPtr->recovery.status = FR_POC_UNKNOWN;
+}
+
+
+/***********************************************************************
+	Fr_CtxLoadImage
+	Selects the node image of a context: unpacks the Fr_Init register
+	image from it and derives the message RAM layout from its buffers
+	(header sections of buffers 0..LCB, then the data sections).
+***********************************************************************/
+
+void Fr_CtxLoadImage(fr_ctx *Fr_CtxPtr, const fr_startup_image *Fr_ImagePtr)
+{
+	cfg *config = &Fr_CtxPtr->config;
+	mram_layout *layout = &Fr_CtxPtr->layout;
+	int i;
+
+	Fr_CtxPtr->image = Fr_ImagePtr;
+
+	// succ[] is SUCC2, SUCC3, NEMC, PRTC1, PRTC2, MHDC
+	config->mrc   = Fr_ImagePtr->mrc;
+	config->prtc1 = Fr_ImagePtr->succ[3];
+	config->prtc2 = Fr_ImagePtr->succ[4];
+	config->mhdc  = Fr_ImagePtr->succ[5];
+	config->gtu1  = Fr_ImagePtr->gtu[0];
+	config->gtu2  = Fr_ImagePtr->gtu[1];
+	config->gtu3  = Fr_ImagePtr->gtu[2];
+	config->gtu4  = Fr_ImagePtr->gtu[3];
+	config->gtu5  = Fr_ImagePtr->gtu[4];
+	config->gtu6  = Fr_ImagePtr->gtu[5];
+	config->gtu7  = Fr_ImagePtr->gtu[6];
+	config->gtu8  = Fr_ImagePtr->gtu[7];
+	config->gtu9  = Fr_ImagePtr->gtu[8];
+	config->gtu10 = Fr_ImagePtr->gtu[9];
+	config->gtu11 = Fr_ImagePtr->gtu[10];
+	config->succ2 = Fr_ImagePtr->succ[0];
+	config->succ3 = Fr_ImagePtr->succ[1];
+
+	layout->buffers      = ((Fr_ImagePtr->mrc >> 16) & 0x7F) + 1;   // LCB
+	layout->used         = Fr_ImagePtr->count;
+	layout->header_words = layout->buffers * FR_HEADER_WORDS;
+	layout->data_words   = 0;
+	for (i = 0; i < Fr_ImagePtr->count; i++)
+		layout->data_words += FR_DATA_WORDS((Fr_ImagePtr->buffers[i].wrhs2 >> 16) & 0x7F);
+	layout->unused_words = (layout->buffers - layout->used) * FR_HEADER_WORDS;
+	layout->free_words   = FR_MRAM_WORDS - layout->header_words - layout->data_words;
+
+	Fr_CtxPtr->time.cycles = 0;
+	Fr_CtxPtr->time.cycle = -1;
+	Fr_CtxPtr->time.macro_per_cycle = config->gtu2 & 0x3FFF;   // MPC
+}
+
+
+/***********************************************************************
+	Fr_ConfigureFifo
+	Turns the top Fr_FifoPtr->depth buffers below LCB into the receive
+	FIFO, in CONFIG state after the node's buffers are loaded: moves
+	MRC.FFB, writes the rejection filter (FRF, FRFM) and critical level
+	(FCL) and loads the FIFO headers with data sections packed behind the
+	node's. Returns the message RAM words left, -1 if the FIFO overlaps
+	a dedicated buffer, does not fit or the input buffer stays busy.
+***********************************************************************/
+
+// Filter, critical level and FIFO headers, data sections from dp on; 1 if the input buffer stays busy
+static int Fr_FifoLoad(fr_ctx *Fr_CtxPtr, const fifo_cfg *Fr_FifoPtr, int first, int dp)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	int words = FR_DATA_WORDS(Fr_FifoPtr->pl & 0x7F);
+	int i;
+
+	Fray_PST->FRF_UN.FRF_UL   = ((Fr_FifoPtr->rnf & 0x1) << 24) | ((Fr_FifoPtr->rss & 0x1) << 23)
+	                          | ((Fr_FifoPtr->cyf & 0x7F) << 16) | ((Fr_FifoPtr->fid & 0x7FF) << 2)
+	                          | (Fr_FifoPtr->ch & 0x3);
+	Fray_PST->FRFM_UN.FRFM_UL = (Fr_FifoPtr->mfid & 0x7FF) << 2;
+	Fray_PST->FCL_UN.FCL_UL   = Fr_FifoPtr->critical & 0xFF;
+
+	// FIFO headers only carry the data pointer and payload length
+	for (i = 0; i < Fr_FifoPtr->depth; i++)
+	{
+		if (Fr_IbWait(Fray_PST, 0x00008000)) return 1;
+		Fray_PST->WRHS1_UN.WRHS1_UL = 0;
+		Fray_PST->WRHS2_UN.WRHS2_UL = (Fr_FifoPtr->pl & 0x7F) << 16;
+		Fray_PST->WRHS3_UN.WRHS3_UL = (dp + i * words) & 0x7FF;
+		Fray_PST->IBCM_UN.IBCM_UL = 0x1;   // lhsh=1
+		Fray_PST->IBCR_UN.IBCR_UL = (first + i) & 0x3F;
+	}
+	return Fr_IbWait(Fray_PST, 0x80008000);
+}
 
-  return CrcReg_X;
+int Fr_ConfigureFifo(fr_ctx *Fr_CtxPtr, const fifo_cfg *Fr_FifoPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	mram_layout *layout = &Fr_CtxPtr->layout;
+	unsigned long mrc = Fr_CtxPtr->config.mrc;
+	int depth = Fr_FifoPtr->depth;
+	int first = (int)((mrc >> 16) & 0x7F) - depth + 1;
+	int words = FR_DATA_WORDS(Fr_FifoPtr->pl & 0x7F);
+	int dp = layout->header_words + layout->data_words;
+	int i;
+
+	if (depth < 1 || first < 1) return -1;
+	if (layout->free_words < depth * words) return -1;
+	if (Fr_CtxPtr->image != 0)
+		for (i = 0; i < Fr_CtxPtr->image->count; i++)
+			if (Fr_CtxPtr->image->buffers[i].buffer >= first) return -1;
+
+	mrc = (mrc & ~0x00007F00UL) | ((unsigned long)first << 8);
+	Fr_CtxPtr->config.mrc = mrc;
+	Fray_PST->MRC_UN.MRC_UL   = mrc;
+	if (Fr_FifoLoad(Fr_CtxPtr, Fr_FifoPtr, first, dp)) return -1;
+
+	Fr_CtxPtr->fifo_first = first;
+	Fr_CtxPtr->fifo_depth = depth;
+	layout->used         += depth;
+	layout->unused_words -= depth * FR_HEADER_WORDS;
+	layout->data_words   += depth * words;
+	layout->free_words   -= depth * words;
+	return layout->free_words;
+}
+
+
+/***********************************************************************
+	Fr_FifoDrain
+	Pops the entries pending in the FIFO (FSR.RFFL, at most max) into
+	Fr_EntryPtr, header, payload and readout time, oldest first. Each
+	read of the first FIFO buffer moves the next entry to the output
+	buffer, so as in Fr_ReceiveRxBatch the next transfer runs while the
+	host copies the current one. Returns the number of entries.
+***********************************************************************/
+
+int Fr_FifoDrain(fr_ctx *Fr_CtxPtr, fifo_entry *Fr_EntryPtr, int max)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fifo_entry *e;
+	fr_trace_record rec;
+	unsigned long fsr = Fray_PST->FSR_UN.FSR_UL;
+	int first = Fr_CtxPtr->fifo_first;
+	int count = (int)((fsr >> 8) & 0xFF);
+	int i, k, pl, words;
+
+	if (fsr & 0x4) Fr_CtxPtr->stats.fifo_overruns++;   // RFO
+	if (count > max) count = max;
+	if (Fr_CtxPtr->fifo_depth == 0 || count == 0) return 0;
+
+	// ensure no transfer in progress on shadow registers
+	while (((Fray_PST->OBCR_UN.OBCR_UL) & 0x00008000) != 0);
+	Fray_PST->OBCM_UN.OBCM_UL = 0x3;                    // header and data
+	Fray_PST->OBCR_UN.OBCR_UL = (1 << 9) | first;       // req=1, view=0
+
+	for (i = 0; i < count; i++)
+	{
+		// wait for completion on shadow registers
+		while (((Fray_PST->OBCR_UN.OBCR_UL) & 0x00008000) != 0);
+		if (i + 1 < count)
+			Fray_PST->OBCR_UN.OBCR_UL = (1 << 9) | (1 << 8) | first;   // req=1, view=1
+		else
+			Fray_PST->OBCR_UN.OBCR_UL = (1 << 8);                      // req=0, view=1
+
+		e = &Fr_EntryPtr[i];
+		e->header[0] = Fray_PST->RDHS1_UN.RDHS1_UL;
+		e->header[1] = Fray_PST->RDHS2_UN.RDHS2_UL;
+		e->header[2] = Fray_PST->RDHS3_UN.RDHS3_UL;
+		e->header[3] = Fray_PST->MBS_UN.MBS_UL;
+		e->fid      = e->header[0] & 0x7FF;
+		e->cycle    = (e->header[2] >> 16) & 0x3F;
+		e->channels = e->header[3] & 0x3;
+		e->pl       = (e->header[1] >> 24) & 0x7F;
+		Fr_TimeStamp(Fr_CtxPtr, &e->stamp);
+		pl = e->pl < (int)((e->header[1] >> 16) & 0x7F) ? e->pl : (int)((e->header[1] >> 16) & 0x7F);
+		words = FR_DATA_WORDS(pl);
+		for (k = 0; k < words; k++)
+			e->data[k] = Fray_PST->RDDS[k];
+		if (Fr_CtxPtr->trace != 0)
+		{
+			rec.time[0] = (unsigned int)e->stamp.time;
+			rec.time[1] = (unsigned int)(e->stamp.time >> 32);
+			rec.fid    = (unsigned short)e->fid;
+			rec.cycle  = (unsigned char)e->cycle;
+			rec.flags  = (unsigned char)e->channels;
+			rec.status = (unsigned short)(e->header[3] & 0xFFFF);
+			rec.pl     = (unsigned char)pl;
+			rec.words  = (unsigned char)words;
+			Fr_TraceFrame(Fr_CtxPtr->trace, &rec, e->data);
+		}
+	}
+	Fray_PST->SIR_UN.SIR_UL = 0x00000060;   // clear RFNE, RFCL
+	Fr_CtxPtr->stats.fifo_frames += count;
+	return count;
+}
+
+
+/***********************************************************************
+	Fr_TimeNow
+	Global time in macroticks from one MTCCV read: the cycles counted so
+	far (rollovers of the 6-bit cycle counter included) times GTUC2.MPC
+	plus the macrotick in the cycle. Requires Fr_CtxLoadImage.
+***********************************************************************/
+
+static unsigned long long Fr_TimeFrom(fr_ctx *Fr_CtxPtr, unsigned long mtccv)
+{
+	fr_time *t = &Fr_CtxPtr->time;
+	int cycle = (mtccv >> 16) & 0x3F;
+
+	if (t->cycle < 0)
+		t->cycles = cycle;
+	else
+		t->cycles += (cycle - t->cycle) & 0x3F;
+	t->cycle = cycle;
+	return t->cycles * t->macro_per_cycle + (mtccv & 0x3FFF);
+}
+
+unsigned long long Fr_TimeNow(fr_ctx *Fr_CtxPtr)
+{
+	return Fr_TimeFrom(Fr_CtxPtr, Fr_CtxPtr->regs->MTCCV_UN.MTCCV_UL);
+}
+
+
+/***********************************************************************
+	Fr_TimeStamp
+	Tags a frame being read out with cycle, macrotick and global time,
+	all from a single MTCCV read. Returns the global time.
+***********************************************************************/
+
+unsigned long long Fr_TimeStamp(fr_ctx *Fr_CtxPtr, fr_rxstamp *Fr_StampPtr)
+{
+	unsigned long mtccv = Fr_CtxPtr->regs->MTCCV_UN.MTCCV_UL;
+
+	Fr_StampPtr->cycle = (mtccv >> 16) & 0x3F;
+	Fr_StampPtr->macrotick = mtccv & 0x3FFF;
+	Fr_StampPtr->time = Fr_TimeFrom(Fr_CtxPtr, mtccv);
+	return Fr_StampPtr->time;
+}
+
+
+/***********************************************************************
+	Fr_EventInit
+	Clears the cycle start event layer of a context. Fr_Clock (may be 0)
+	timestamps interrupts and measures idle time; Fr_Idle replaces WFI
+	in Fr_EventWait (0 on the target).
+	The cycle start interrupt must be routed to the line that calls
+	Fr_EventIsr: CYCS on eray_int1 (SILS, ILE) as set up by
+	configure_initialize_node_x and Fr_FastStartup.
+***********************************************************************/
+
+void Fr_EventInit(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock, idle_hook Fr_Idle)
+{
+	fr_events *ev = &Fr_CtxPtr->events;
+	int i;
+
+	ev->put = ev->get = 0;
+	ev->cycles = 0;
+	for (i = 0; i < 64; i++)
+		ev->buffer[i] = 0;
+	ev->buffer_mask[0] = ev->buffer_mask[1] = 0;
+	Fr_CtxPtr->dual.count = 0;   // the pairs' buffer handlers are gone
+	ev->clock = Fr_Clock;
+	ev->idle = Fr_Idle;
+	ev->interrupts = ev->dispatched = ev->overruns = 0;
+	ev->idle_time = ev->max_latency = 0;
+}
+
+
+/***********************************************************************
+	Fr_OnCycle
+	Registers a handler for cycle start. cyc selects the cycles as the
+	cycle code of a buffer header (repetition | base), 0 for every cycle.
+	Returns 1 if all FR_CYCLE_CALLBACKS slots are taken.
+***********************************************************************/
+
+int Fr_OnCycle(fr_ctx *Fr_CtxPtr, cycle_callback Fr_Callback, int cyc)
+{
+	fr_events *ev = &Fr_CtxPtr->events;
+
+	if (ev->cycles == FR_CYCLE_CALLBACKS) return 1;
+	ev->cycle[ev->cycles] = Fr_Callback;
+	ev->cycle_filter[ev->cycles] = cyc & 0x7F;
+	ev->cycles++;
+	return 0;
+}
+
+
+/***********************************************************************
+	Fr_OnBuffer
+	Registers a handler for new data in an RX buffer, 0 removes it.
+	Only buffers with a handler are read by Fr_EventDispatch.
+***********************************************************************/
+
+void Fr_OnBuffer(fr_ctx *Fr_CtxPtr, int buffer, buffer_callback Fr_Callback)
+{
+	fr_events *ev = &Fr_CtxPtr->events;
+
+	buffer &= 0x3F;
+	ev->buffer[buffer] = Fr_Callback;
+	if (Fr_Callback != 0)
+		ev->buffer_mask[buffer >> 5] |= 1UL << (buffer & 31);
+	else
+		ev->buffer_mask[buffer >> 5] &= ~(1UL << (buffer & 31));
 }
 
+
+/***********************************************************************
+	Fr_DualAdd
+	Merges the copies of a frame received on channel A into buffer_a
+	and on channel B into buffer_b (same frame ID); pass the same buffer
+	twice for one on both channels. Fr_Callback gets the first valid
+	copy of each frame, the lower buffer number first; the other copy is
+	compared with it. A buffer paired with itself only holds one copy:
+	it reports the channels from MBS but can never count a
+	disagreement. Call after Fr_EventInit. Returns the pair's index in
+	dual.pair, -1 if all FR_DUAL_PAIRS are taken.
+***********************************************************************/
+
+static fr_dual_pair *Fr_DualPair(fr_dual *dual, int buffer)
+{
+	int i;
+
+	for (i = 0; i < dual->count; i++)
+		if (dual->pair[i].buffer[0] == buffer || dual->pair[i].buffer[1] == buffer)
+			return &dual->pair[i];
+	return 0;
+}
+
+static void Fr_DualRx(fr_ctx *Fr_CtxPtr, int buffer, volatile unsigned long *rdds)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_dual_pair *p = Fr_DualPair(&Fr_CtxPtr->dual, buffer);
+	unsigned long mbs = Fray_PST->MBS_UN.MBS_UL;
+	unsigned long rdhs2 = Fray_PST->RDHS2_UN.RDHS2_UL;
+	int cycle = (int)((Fray_PST->RDHS3_UN.RDHS3_UL >> 16) & 0x3F);
+	int pl = (int)((rdhs2 >> 24) & 0x7F), words;
+	int ch, valid = 0, differ, i;
+
+	if (p == 0) return;
+	for (ch = 0; ch < 2; ch++)
+	{
+		if (p->buffer[ch] != buffer || ((mbs >> ch) & 0x1) == 0) continue;   // VFRA, VFRB
+		if (((mbs >> (2 + ch)) & 0x15) != 0)      // SEOx, CEOx, SVOx
+			p->invalid[ch]++;
+		else
+		{
+			valid |= 1 << ch;
+			p->copies[ch]++;
+		}
+	}
+	if (valid == 0) return;
+	// RDDS holds no more than the buffer's data section (PLC)
+	if (pl > (int)((rdhs2 >> 16) & 0x7F)) pl = (int)((rdhs2 >> 16) & 0x7F);
+	words = FR_DATA_WORDS(pl);
+
+	// the other copy of the frame delivered: same cycle, read out in the same dispatch
+	if (p->cycle == cycle && Fr_CtxPtr->rx_stamp.time - p->time < Fr_CtxPtr->time.macro_per_cycle)
+	{
+		differ = words != p->words;
+		for (i = 0; i < words && !differ; i++)
+			differ = rdds[i] != p->data[i];
+		if (differ) p->disagree++;
+		p->channels |= valid;
+		return;
+	}
+
+	// a new frame, the previous one has all its copies
+	for (ch = 0; ch < 2; ch++)
+		if (p->cycle >= 0 && ((p->channels >> ch) & 0x1) == 0) p->missing[ch]++;
+	p->cycle = cycle;
+	p->channels = valid;
+	p->time = Fr_CtxPtr->rx_stamp.time;
+	p->words = words;
+	for (i = 0; i < words; i++)
+		p->data[i] = rdds[i];
+	p->frames++;
+	p->handler(Fr_CtxPtr, (int)(p - Fr_CtxPtr->dual.pair), valid & FR_DUAL_A ? FR_DUAL_A : FR_DUAL_B, rdds);
+}
+
+// SFS of the double cycle that ended, read at an even cycle start
+static void Fr_DualSync(fr_ctx *Fr_CtxPtr)
+{
+	fr_dual *dual = &Fr_CtxPtr->dual;
+	unsigned long sfs = Fr_CtxPtr->regs->SFS_UN.SFS_UL;
+	unsigned long a = (sfs & 0xF) + ((sfs >> 4) & 0xF);     // VSAE + VSAO
+	unsigned long b = ((sfs >> 8) & 0xF) + ((sfs >> 12) & 0xF);   // VSBE + VSBO
+
+	dual->sync[0] += a;
+	dual->sync[1] += b;
+	if (a != b) dual->sync_differ++;
+}
+
+int Fr_DualAdd(fr_ctx *Fr_CtxPtr, int buffer_a, int buffer_b, dual_callback Fr_Callback)
+{
+	fr_dual *dual = &Fr_CtxPtr->dual;
+	fr_dual_pair *p;
+
+	if (dual->count == FR_DUAL_PAIRS) return -1;
+	p = &dual->pair[dual->count];
+	p->buffer[0] = buffer_a & 0x3F;
+	p->buffer[1] = buffer_b & 0x3F;
+	p->handler = Fr_Callback;
+	p->cycle = -1;
+	p->channels = 0;
+	p->frames = p->disagree = 0;
+	p->copies[0] = p->copies[1] = p->invalid[0] = p->invalid[1] = p->missing[0] = p->missing[1] = 0;
+	Fr_OnBuffer(Fr_CtxPtr, buffer_a, Fr_DualRx);
+	Fr_OnBuffer(Fr_CtxPtr, buffer_b, Fr_DualRx);
+	return dual->count++;
+}
+
+
+/***********************************************************************
+	Fr_EventIsr
+	Top half, call from the eray_int1 handler. Takes the enabled status
+	flags and queues one event per cycle start or timer; constant time, no
+	message RAM transfers. Only this function advances put, so the queue
+	needs no locking against Fr_EventDispatch.
+***********************************************************************/
+
+void Fr_EventIsr(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_events *ev = &Fr_CtxPtr->events;
+	fr_event *e;
+	unsigned long sir;
+
+	sir = Fray_PST->SIR_UN.SIR_UL & Fray_PST->SIES_UN.SIES_UL;
+	Fray_PST->SIR_UN.SIR_UL = sir;   // clear the flags taken
+	ev->interrupts++;
+	if ((sir & 0x304) == 0) return;  // CYCS, TI0, TI1
+
+	if (ev->put - ev->get == FR_EVENT_DEPTH)
+	{
+		ev->overruns++;
+		return;
+	}
+	e = &ev->queue[ev->put & (FR_EVENT_DEPTH - 1)];
+	e->sir   = sir;
+	e->cycle = (Fray_PST->MTCCV_UN.MTCCV_UL >> 16) & 0x3F;   // CCV
+	e->time  = ev->clock ? ev->clock() : 0;
+	ev->put++;
+}
+
+
+/***********************************************************************
+	Fr_EventDispatch
+	Bottom half, call from the background loop. Handles at most max
+	queued events, oldest first. A cycle start runs the matching cycle
+	handlers, then one pipelined read (as Fr_ReceiveRxBatch) of the
+	buffers that have new data and a handler; timer 0 (the NIT) runs
+	Fr_ReconfigRun, timer 1 Fr_JitRun. Returns the number of events
+	handled.
+***********************************************************************/
+
+static int Fr_CycleMatch(int cyc, int cycle)
+{
+	int rep;
+
+	if (cyc == 0) return 1;
+	rep = 1 << (31 - FR_CLZ((unsigned int)cyc));   // highest set bit
+	return (cycle & (rep - 1)) == (cyc & (rep - 1));
+}
+
+int Fr_EventDispatch(fr_ctx *Fr_CtxPtr, int max)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_events *ev = &Fr_CtxPtr->events;
+	fr_event *e;
+	unsigned long ndat[2], latency;
+	int i, n = 0;
+
+	while (n < max && ev->get != ev->put)
+	{
+		e = &ev->queue[ev->get & (FR_EVENT_DEPTH - 1)];
+		if (ev->clock)
+		{
+			latency = ev->clock() - e->time;
+			if (latency > ev->max_latency) ev->max_latency = latency;
+		}
+		if (e->sir & 0x100)    // TI0
+			Fr_ReconfigRun(Fr_CtxPtr);
+		if (e->sir & 0x200)    // TI1
+			Fr_JitRun(Fr_CtxPtr);
+		if (e->sir & 0x4)      // CYCS
+		{
+			Fr_TimeNow(Fr_CtxPtr);   // one MTCCV read per cycle keeps the global time monotonic
+			// nothing planned yet (Fr_JitInit, restart): start timer 1; once
+			// running, Fr_JitRun always leaves it armed
+			if (Fr_CtxPtr->jit.count + Fr_CtxPtr->jit.tasks != 0 && Fr_CtxPtr->jit.cycle < 0)
+				Fr_JitRun(Fr_CtxPtr);
+			if (Fr_CtxPtr->dual.count != 0 && (e->cycle & 0x1) == 0)
+				Fr_DualSync(Fr_CtxPtr);
+			for (i = 0; i < ev->cycles; i++)
+				if (Fr_CycleMatch(ev->cycle_filter[i], e->cycle))
+					ev->cycle[i](Fr_CtxPtr, e->cycle);
+
+			ndat[0] = Fray_PST->NDAT1_UN.NDAT1_UL & ev->buffer_mask[0];
+			ndat[1] = Fray_PST->NDAT2_UN.NDAT2_UL & ev->buffer_mask[1];
+			if ((ndat[0] | ndat[1]) != 0)
+			{
+				Fr_CtxPtr->read_buffer.rdss = 1;  // read data section
+				// and the header when tracing or merging channels
+				Fr_CtxPtr->read_buffer.rhss = Fr_CtxPtr->trace != 0 || Fr_CtxPtr->dual.count != 0;
+				Fr_ReceiveFlagged(Fray_PST, &Fr_CtxPtr->read_buffer, ndat, 0, Fr_CtxPtr);
+			}
+		}
+		ev->get++;
+		ev->dispatched++;
+		n++;
+	}
+	return n;
+}
+
+
+/***********************************************************************
+	Fr_EventWait
+	Idles until Fr_EventIsr has queued an event. The time spent here is
+	added to events.idle_time, so idle_time over elapsed clock ticks is
+	the CPU share left for background work.
+***********************************************************************/
+
+void Fr_EventWait(fr_ctx *Fr_CtxPtr)
+{
+	fr_events *ev = &Fr_CtxPtr->events;
+	unsigned long t0 = ev->clock ? ev->clock() : 0;
+
+	for (;;)
+	{
+		FR_IRQ_OFF();
+		if (ev->get != ev->put) break;
+		if (ev->idle)
+			ev->idle(Fr_CtxPtr);
+		else
+			FR_WFI();
+		FR_IRQ_ON();
+	}
+	FR_IRQ_ON();
+	if (ev->clock) ev->idle_time += ev->clock() - t0;
+}
+
+
+/***********************************************************************
+	Fr_TraceFrame
+	Appends one record and its payload words to the trace ring. Runs in
+	the cycle work: no file access, a record that does not fit is counted
+	in dropped and lost. Fr_TracePoll writes the ring out. Returns 1 if
+	recorded, 0 if dropped.
+***********************************************************************/
+
+int Fr_TraceFrame(fr_trace *Fr_TracePtr, const fr_trace_record *Fr_RecordPtr, const volatile unsigned long *data)
+{
+	union { fr_trace_record r; unsigned int w[4]; } rec;
+	unsigned long head = Fr_TracePtr->head;
+	unsigned long size = sizeof(fr_trace_record) + Fr_RecordPtr->words * 4;
+	unsigned long fill = head - Fr_TracePtr->tail;
+	unsigned int *ring = Fr_TracePtr->ring;
+	int i, k = (int)(head >> 2);
+
+	if (fill + size > FR_TRACE_RING)
+	{
+		Fr_TracePtr->dropped++;
+		return 0;
+	}
+	rec.r = *Fr_RecordPtr;
+	for (i = 0; i < 4; i++, k++)
+		ring[k & (FR_TRACE_RING / 4 - 1)] = rec.w[i];
+	for (i = 0; i < Fr_RecordPtr->words; i++, k++)
+		ring[k & (FR_TRACE_RING / 4 - 1)] = (unsigned int)data[i];
+	if (fill + size > Fr_TracePtr->max_fill) Fr_TracePtr->max_fill = fill + size;
+	Fr_TracePtr->records++;
+	Fr_TracePtr->head = head + size;   // published after the record is complete
+	return 1;
+}
+
+
+/***********************************************************************
+	Fr_TraceRx
+	Records the frame in the output buffer host view (read with header,
+	OBCM.RHSS), stamped with Fr_CtxPtr->rx_stamp.
+***********************************************************************/
+
+void Fr_TraceRx(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_trace_record r;
+	unsigned long rdhs2 = Fray_PST->RDHS2_UN.RDHS2_UL;
+	unsigned long mbs = Fray_PST->MBS_UN.MBS_UL;
+	int pl = (int)((rdhs2 >> 24) & 0x7F);
+
+	// RDDS holds no more than the buffer's data section (PLC)
+	if (pl > (int)((rdhs2 >> 16) & 0x7F)) pl = (int)((rdhs2 >> 16) & 0x7F);
+	r.time[0] = (unsigned int)Fr_CtxPtr->rx_stamp.time;
+	r.time[1] = (unsigned int)(Fr_CtxPtr->rx_stamp.time >> 32);
+	r.fid    = (unsigned short)(Fray_PST->RDHS1_UN.RDHS1_UL & 0x7FF);
+	r.cycle  = (unsigned char)((Fray_PST->RDHS3_UN.RDHS3_UL >> 16) & 0x3F);
+	r.flags  = (unsigned char)(mbs & 0x3);      // VFRA, VFRB
+	r.status = (unsigned short)(mbs & 0xFFFF);
+	r.pl     = (unsigned char)pl;
+	r.words  = (unsigned char)FR_DATA_WORDS(pl);
+	Fr_TraceFrame(Fr_CtxPtr->trace, &r, Fray_PST->RDDS);
+}
+
+// A payload committed to a TX buffer through the input buffer, stamped
+// with the time of the commit; fid, channels and pl from the header cache.
+// Records the hand-over only: whether and in which cycle the frame went
+// out is not known here (a buffer updated twice before its slot sends once)
+static void Fr_TraceTx(fr_ctx *Fr_CtxPtr, int buffer, const volatile unsigned long *data, int words)
+{
+	fr_hdrcache *hc = &Fr_CtxPtr->hdr_cache;
+	fr_trace_record r;
+	unsigned long long time = Fr_TimeNow(Fr_CtxPtr);
+	int pl = 0;
+
+	r.fid = 0;
+	r.flags = FR_TRACE_COMMIT;
+	if ((hc->valid[buffer >> 5] >> (buffer & 0x1F)) & 0x1)
+	{
+		r.fid = (unsigned short)(hc->wrhs[buffer][0] & 0x7FF);
+		r.flags |= (unsigned char)((hc->wrhs[buffer][0] >> 24) & 0x3);   // CHA, CHB
+		pl = (int)((hc->wrhs[buffer][1] >> 16) & 0x7F);
+		if (FR_DATA_WORDS(pl) < words) words = FR_DATA_WORDS(pl);
+	}
+	r.time[0] = (unsigned int)time;
+	r.time[1] = (unsigned int)(time >> 32);
+	r.cycle  = (unsigned char)Fr_CtxPtr->time.cycle;
+	r.status = 0;
+	r.pl     = (unsigned char)pl;
+	r.words  = (unsigned char)words;
+	Fr_TraceFrame(Fr_CtxPtr->trace, &r, data);
+}
+
+
+// Header of a buffer as now in the message RAM
+static void Fr_HeaderLoaded(fr_ctx *Fr_CtxPtr, int buffer, unsigned long wrhs1, unsigned long wrhs2, unsigned long wrhs3)
+{
+	fr_hdrcache *hc = &Fr_CtxPtr->hdr_cache;
+
+	buffer &= 0x3F;
+	hc->wrhs[buffer][0] = wrhs1;
+	hc->wrhs[buffer][1] = wrhs2;
+	hc->wrhs[buffer][2] = wrhs3;
+	hc->valid[buffer >> 5] |= 1UL << (buffer & 0x1F);
+}
+
+
+/***********************************************************************
+	Fr_TxTrackInit
+	Tracks the payload of the TX buffers listed in Fr_BufferPtr, data
+	section lengths taken from the context's node image. Every buffer
+	starts pending, so its first Fr_TxCommit writes and transfers all of
+	its words; the header cache starts from the image's headers.
+	Returns the number of buffers tracked, -1 if one is not a
+	TX buffer of the image or there are too many.
+***********************************************************************/
+
+int Fr_TxTrackInit(fr_ctx *Fr_CtxPtr, const int *Fr_BufferPtr, int count)
+{
+	fr_txtrack *t = &Fr_CtxPtr->tx_track;
+	const fr_startup_image *image = Fr_CtxPtr->image;
+	int i, k;
+
+	t->count = 0;
+	for (i = 0; i < 64; i++)
+		t->index[i] = FR_TX_NONE;
+	if (count > FR_TX_TRACKED) return -1;
+
+	for (i = 0; i < count; i++)
+	{
+		for (k = 0; k < image->count && image->buffers[k].buffer != Fr_BufferPtr[i]; k++);
+		if (k == image->count || (image->buffers[k].wrhs1 & 0x04000000) == 0) return -1;
+		t->buf[i].buffer = Fr_BufferPtr[i];
+		t->buf[i].words = FR_DATA_WORDS((image->buffers[k].wrhs2 >> 16) & 0x7F);
+		t->index[Fr_BufferPtr[i] & 0x3F] = i;
+		t->count++;
+	}
+	Fr_TxTrackReset(Fr_CtxPtr);
+	for (k = 0; k < image->count; k++)
+		Fr_HeaderLoaded(Fr_CtxPtr, image->buffers[k].buffer, image->buffers[k].wrhs1,
+		                image->buffers[k].wrhs2, image->buffers[k].wrhs3);
+	return t->count;
+}
+
+
+/***********************************************************************
+	Fr_TxTrackReset
+	Forgets what the message RAM and the input buffer hold: every
+	tracked buffer is transferred in full on its next Fr_TxCommit and
+	the next header load of every buffer is written. Call
+	after input buffer transfers that bypass the context (Fr_TransmitTxLPdu,
+	Fr_TxQueueSubmit, a restart).
+***********************************************************************/
+
+// Payload part of Fr_TxTrackReset, the header cache is kept
+static void Fr_TxForget(fr_ctx *Fr_CtxPtr)
+{
+	fr_txtrack *t = &Fr_CtxPtr->tx_track;
+	int i;
+
+	for (i = 0; i < t->count; i++)
+	{
+		t->buf[i].pending = 1;
+		t->buf[i].dirty[0] = t->buf[i].dirty[1] = 0;
+	}
+	t->known[0][0] = t->known[0][1] = 0;
+	t->known[1][0] = t->known[1][1] = 0;
+	t->host = 0;
+}
+
+void Fr_TxTrackReset(fr_ctx *Fr_CtxPtr)
+{
+	int i;
+
+	Fr_TxForget(Fr_CtxPtr);
+	Fr_CtxPtr->hdr_cache.valid[0] = Fr_CtxPtr->hdr_cache.valid[1] = 0;
+	for (i = 0; i < 64; i++)
+		Fr_CtxPtr->hdr_cache.crc_key[i] = FR_CRC_KEY_NONE;
+}
+
+// An input buffer transfer swapped host and shadow; a header load on a
+// tracked buffer also cleared its transmission request
+static void Fr_TxSwapped(fr_ctx *Fr_CtxPtr, int buffer, int header)
+{
+	fr_txtrack *t = &Fr_CtxPtr->tx_track;
+
+	t->host ^= 1;
+	if (header && t->index[buffer & 0x3F] != FR_TX_NONE)
+		t->buf[(int)t->index[buffer & 0x3F]].pending = 1;
+}
+
+
+/***********************************************************************
+	Fr_TxWrite
+	Sets one payload word of a tracked buffer; marks it dirty only if the
+	value changed.
+***********************************************************************/
+
+void Fr_TxWrite(fr_ctx *Fr_CtxPtr, int buffer, int word, unsigned long value)
+{
+	fr_txtrack *t = &Fr_CtxPtr->tx_track;
+	fr_txbuf *b;
+
+	if (t->index[buffer & 0x3F] == FR_TX_NONE) return;
+	b = &t->buf[(int)t->index[buffer & 0x3F]];
+	if (word >= b->words || b->data[word] == value) return;
+	b->data[word] = value;
+	b->dirty[word >> 5] |= 1UL << (word & 0x1F);
+}
+
+
+/***********************************************************************
+	Fr_TxCommit
+	Sends a tracked buffer's payload: nothing when no word changed since
+	the last commit (the buffer keeps transmitting it), otherwise the
+	words the input buffer host half does not already hold are written
+	to WRDS and the data section is transferred with a transmission
+	request. Returns 1 if a transfer was made, 0 if it was skipped, -1
+	for an untracked buffer.
+***********************************************************************/
+
+int Fr_TxCommit(fr_ctx *Fr_CtxPtr, int buffer)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_txtrack *t = &Fr_CtxPtr->tx_track;
+	bc *write_buffer = &Fr_CtxPtr->write_buffer;
+	fr_txbuf *b;
+	unsigned long *ibf, *known;
+	int i, written = 0;
+
+	if (t->index[buffer & 0x3F] == FR_TX_NONE) return -1;
+	b = &t->buf[(int)t->index[buffer & 0x3F]];
+	if (!b->pending && (b->dirty[0] | b->dirty[1]) == 0)
+	{
+		Fr_CtxPtr->stats.tx_skipped++;
+		return 0;
+	}
+
+	// ensure no transfer in progress on the input buffer host side
+	while (((Fray_PST->IBCR_UN.IBCR_UL) & 0x00008000) != 0);
+	ibf = t->ibf[t->host];
+	known = t->known[t->host];
+	for (i = 0; i < b->words; i++)
+	{
+		if (((known[i >> 5] >> (i & 0x1F)) & 0x1) && ibf[i] == b->data[i]) continue;
+		Fray_PST->WRDS[i] = b->data[i];
+		ibf[i] = b->data[i];
+		known[i >> 5] |= 1UL << (i & 0x1F);
+		written++;
+	}
+
+	if (Fr_CtxPtr->trace != 0) Fr_TraceTx(Fr_CtxPtr, buffer & 0x3F, b->data, b->words);
+
+	write_buffer->ibrh  = buffer;
+	write_buffer->stxrh = 1;  // set transmission request
+	write_buffer->ldsh  = 1;  // load data section
+	write_buffer->lhsh  = 0;
+	write_buffer->ibsys = 0;
+	write_buffer->ibsyh = 1;  // WRDS free again on return
+	Fr_TransmitTxLPdu(Fray_PST, write_buffer);
+	Fr_TxSwapped(Fr_CtxPtr, buffer, 0);
+
+	b->pending = 0;
+	b->dirty[0] = b->dirty[1] = 0;
+	Fr_CtxPtr->stats.tx_frames++;
+	Fr_CtxPtr->stats.tx_words += written;
+	Fr_CtxPtr->stats.tx_words_kept += b->words - written;
+	return 1;
+}
+
+
+/***********************************************************************
+	Fr_UpdateLPdu
+	Fr_PrepareLPdu + Fr_TransmitTxLPdu through the header cache. With
+	Fr_LSduPtr->lhsh set the header is written only if it differs from
+	the one last loaded into the buffer, otherwise lhsh is dropped for
+	this transfer (the caller's bc is left as it is) and the buffer keeps
+	its transmission request. TX headers get their CRC from the cache
+	unless sync, sfi, pl or fid changed. Data words, if any, are expected
+	in WRDS. Returns 1 if a transfer was made, 0 if nothing was left to
+	transfer.
+***********************************************************************/
+
+int Fr_UpdateLPdu(fr_ctx *Fr_CtxPtr, wrhs *Fr_LPduPtr, bc *Fr_LSduPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_hdrcache *hc = &Fr_CtxPtr->hdr_cache;
+	fr_txtrack *t = &Fr_CtxPtr->tx_track;
+	bc *write_buffer = &Fr_CtxPtr->write_buffer;
+	int buffer = Fr_LSduPtr->ibrh & 0x3F;
+	int lhsh = Fr_LSduPtr->lhsh & 0x1;
+	unsigned long key, w[3];
+
+	if (lhsh)
+	{
+		if (Fr_LPduPtr->cfg & 0x1)
+		{
+			key = ((Fr_LPduPtr->sync & 0x1) << 19) | ((Fr_LPduPtr->sfi & 0x1) << 18)
+			    | ((Fr_LPduPtr->pl & 0x7F) << 11) | (Fr_LPduPtr->fid & 0x7FF);
+			if (key != hc->crc_key[buffer])
+			{
+				hc->crc[buffer] = header_crc_calc(Fr_LPduPtr);
+				hc->crc_key[buffer] = key;
+				Fr_CtxPtr->stats.crc_calcs++;
+			}
+			Fr_LPduPtr->crc = hc->crc[buffer];
+		}
+		Fr_HeaderWords(Fr_LPduPtr, w);
+		if (((hc->valid[buffer >> 5] >> (buffer & 0x1F)) & 0x1) && hc->wrhs[buffer][0] == w[0]
+		    && hc->wrhs[buffer][1] == w[1] && hc->wrhs[buffer][2] == w[2])
+		{
+			lhsh = 0;
+			Fr_CtxPtr->stats.headers_kept++;
+		}
+		else
+		{
+			// ensure no transfer in progress on the input buffer host side
+			while (((Fray_PST->IBCR_UN.IBCR_UL) & 0x00008000) != 0);
+			Fray_PST->WRHS1_UN.WRHS1_UL = w[0];
+			Fray_PST->WRHS2_UN.WRHS2_UL = w[1];
+			Fray_PST->WRHS3_UN.WRHS3_UL = w[2];
+			Fr_HeaderLoaded(Fr_CtxPtr, buffer, w[0], w[1], w[2]);
+			Fr_CtxPtr->stats.headers++;
+		}
+	}
+	if (!lhsh && !(Fr_LSduPtr->ldsh & 0x1) && !(Fr_LSduPtr->stxrh & 0x1)) return 0;
+	if (Fr_CtxPtr->trace != 0 && (Fr_LSduPtr->ldsh & 0x1))
+		Fr_TraceTx(Fr_CtxPtr, buffer, Fray_PST->WRDS, 64);
+
+	write_buffer->ibrh  = buffer;
+	write_buffer->stxrh = Fr_LSduPtr->stxrh;
+	write_buffer->ldsh  = Fr_LSduPtr->ldsh;
+	write_buffer->lhsh  = lhsh;
+	write_buffer->ibsys = Fr_LSduPtr->ibsys;
+	write_buffer->ibsyh = Fr_LSduPtr->ibsyh;
+	Fr_TransmitTxLPdu(Fray_PST, write_buffer);
+	// the caller's WRDS words are unknown to Fr_TxCommit
+	if (write_buffer->ldsh & 0x1)
+		t->known[t->host][0] = t->known[t->host][1] = 0;
+	Fr_TxSwapped(Fr_CtxPtr, buffer, lhsh);
+	return 1;
+}
+
+
+/***********************************************************************
+	Fr_ReconfigInit
+	Plans the headers of the buffers shared by Fr_ImagePtr: for every
+	cycle the image whose WRHS1.CYC matches it, buffers keep their header
+	in cycles no image selects. Arms timer 0 (continuous, every cycle) at
+	the first macrotick of the NIT; Fr_EventDispatch runs Fr_ReconfigRun
+	from it. Returns the number of reconfigurable buffers, -1 if two
+	images of a buffer select the same cycle or there are too many.
+***********************************************************************/
+
+static void Fr_ReconfigTimer(fr_ctx *Fr_CtxPtr)
+{
+	// T0MO = first macrotick of the NIT (GTUC4.NIT + 1), T0CC = every cycle, T0MS, T0RC
+	Fr_CtxPtr->regs->T0C_UN.T0C_UL = (((Fr_CtxPtr->config.gtu4 & 0x3FFF) + 1) << 16) | 0x00000003;
+}
+
+int Fr_ReconfigInit(fr_ctx *Fr_CtxPtr, const mbuf_image *Fr_ImagePtr, int count)
+{
+	fr_reconfig *rc = &Fr_CtxPtr->reconfig;
+	int i, k, cycle;
+
+	rc->images = Fr_ImagePtr;
+	rc->count = 0;
+	rc->buffers = 0;
+	if (count >= FR_RECONFIG_NONE) return -1;
+	for (cycle = 0; cycle < 64; cycle++)
+		for (k = 0; k < FR_RECONFIG_BUFFERS; k++)
+			rc->plan[cycle][k] = FR_RECONFIG_NONE;
+
+	for (i = 0; i < count; i++)
+	{
+		for (k = 0; k < rc->buffers && rc->buffer[k] != Fr_ImagePtr[i].buffer; k++);
+		if (k == rc->buffers)
+		{
+			if (k == FR_RECONFIG_BUFFERS) return -1;
+			rc->buffer[k] = Fr_ImagePtr[i].buffer;
+			rc->current[k] = FR_RECONFIG_NONE;
+			rc->buffers++;
+		}
+		for (cycle = 0; cycle < 64; cycle++)
+		{
+			if (!Fr_CycleMatch((Fr_ImagePtr[i].wrhs1 >> 16) & 0x7F, cycle)) continue;
+			if (rc->plan[cycle][k] != FR_RECONFIG_NONE) return -1;
+			rc->plan[cycle][k] = i;
+		}
+	}
+	rc->count = count;
+	Fr_ReconfigTimer(Fr_CtxPtr);
+	return rc->buffers;
+}
+
+
+/***********************************************************************
+	Fr_ReconfigRun
+	Call in the NIT of cycle n: loads the headers planned for cycle n+1
+	that differ from the ones in place, one header transfer each (lhsh
+	only, the image already carries data pointer and header CRC). TX
+	buffers come out of the swap without a transmission request (tracked
+	ones are transferred again by their next Fr_TxCommit), buffers that
+	were RX lose data not read yet (counted in reconfig.lost, also when
+	the new header is TX). A run that starts before the NIT or ends in
+	the next cycle is counted as late.
+	Returns the number of headers written.
+***********************************************************************/
+
+int Fr_ReconfigRun(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_reconfig *rc = &Fr_CtxPtr->reconfig;
+	fr_hdrcache *hc = &Fr_CtxPtr->hdr_cache;
+	const mbuf_image *image;
+	unsigned long start = Fray_PST->MTCCV_UN.MTCCV_UL, end, ndat, old;
+	int nit = Fr_CtxPtr->config.gtu4 & 0x3FFF;
+	int cycle = (start >> 16) & 0x3F;
+	int k, i, n = 0;
+
+	for (k = 0; k < rc->buffers; k++)
+	{
+		i = rc->plan[(cycle + 1) & 0x3F][k];
+		if (i == FR_RECONFIG_NONE || i == rc->current[k]) continue;
+		image = &rc->images[i];
+		// unread data goes with an RX header in place, whatever replaces it;
+		// a header not known is not counted
+		if (rc->current[k] != FR_RECONFIG_NONE)
+			old = rc->images[rc->current[k]].wrhs1;
+		else if ((hc->valid[image->buffer >> 5] >> (image->buffer & 0x1F)) & 0x1)
+			old = hc->wrhs[image->buffer][0];
+		else
+			old = 0x04000000;
+		if ((old & 0x04000000) == 0)
+		{
+			ndat = image->buffer < 32 ? Fray_PST->NDAT1_UN.NDAT1_UL : Fray_PST->NDAT2_UN.NDAT2_UL;
+			if ((ndat >> (image->buffer & 0x1F)) & 0x1) rc->lost++;
+		}
+		// ensure no transfer in progress on the input buffer host side
+		while (((Fray_PST->IBCR_UN.IBCR_UL) & 0x00008000) != 0);
+		Fray_PST->WRHS1_UN.WRHS1_UL = image->wrhs1;
+		Fray_PST->WRHS2_UN.WRHS2_UL = image->wrhs2;
+		Fray_PST->WRHS3_UN.WRHS3_UL = image->wrhs3;
+		Fray_PST->IBCM_UN.IBCM_UL = 0x1;   // lhsh=1
+		Fray_PST->IBCR_UN.IBCR_UL = (image->buffer & 0x3F);
+		Fr_TxSwapped(Fr_CtxPtr, image->buffer, 1);
+		Fr_HeaderLoaded(Fr_CtxPtr, image->buffer, image->wrhs1, image->wrhs2, image->wrhs3);
+		rc->current[k] = i;
+		n++;
+	}
+	if (n == 0) return 0;
+	while (((Fray_PST->IBCR_UN.IBCR_UL) & 0x80008000) != 0);
+
+	end = Fray_PST->MTCCV_UN.MTCCV_UL;
+	if ((int)(start & 0x3FFF) <= nit || ((end >> 16) & 0x3F) != (unsigned long)cycle)
+		rc->late++;
+	else if ((end & 0x3FFF) - (start & 0x3FFF) > rc->max_time)
+		rc->max_time = (end & 0x3FFF) - (start & 0x3FFF);
+	rc->swaps += n;
+	return n;
+}
+
+
+/***********************************************************************
+	Fr_JitInit
+	Clears the just-in-time schedule and routes TI1 to eray_int1 with
+	the cycle start (Fr_EventIsr). Call after the node's interrupt setup
+	and Fr_TxTrackInit, then Fr_JitAdd for each buffer; the first cycle
+	start dispatched arms timer 1.
+***********************************************************************/
+
+void Fr_JitInit(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_jit *jit = &Fr_CtxPtr->jit;
+
+	jit->count = jit->tasks = 0;
+	jit->cycle = -1;
+	jit->due = jit->next = 0;
+	jit->runs = jit->resyncs = 0;
+	Fray_PST->T1C_UN.T1C_UL   = 0;      // stop timer 1
+	Fray_PST->SILS_UN.SILS_UL |= 0x00000200;
+	Fray_PST->SIES_UN.SIES_UL |= 0x00000200;  // TI1E
+}
+
+
+/***********************************************************************
+	Fr_JitAdd
+	Produces the payload of a tracked TX buffer lead macroticks before
+	its action point. Returns the frame's index in jit.frame, -1 if the
+	buffer is not tracked or there are too many.
+***********************************************************************/
+
+int Fr_JitAdd(fr_ctx *Fr_CtxPtr, int buffer, jit_producer Fr_Producer, int lead)
+{
+	fr_jit *jit = &Fr_CtxPtr->jit;
+	fr_jit_frame *f;
+
+	if (jit->count == FR_JIT_FRAMES || Fr_CtxPtr->tx_track.index[buffer & 0x3F] == FR_TX_NONE) return -1;
+	f = &jit->frame[jit->count];
+	f->buffer = buffer;
+	f->producer = Fr_Producer;
+	f->lead = lead;
+	f->at = 0;
+	f->runs = f->late = 0;
+	f->age = f->age_max = 0;
+	f->age_sum = 0;
+	jit->cycle = -1;
+	return jit->count++;
+}
+
+
+/***********************************************************************
+	Fr_TaskAdd
+	Runs Fr_Task offset macroticks after the start of the cycles cyc
+	selects (cycle code as in WRHS1.CYC, 0 = every cycle), from the
+	Fr_JitRun schedule. budget is the macroticks after offset the task
+	must end in. Returns the task's index in jit.task, -1 if there are
+	FR_JIT_TASKS already.
+***********************************************************************/
+
+int Fr_TaskAdd(fr_ctx *Fr_CtxPtr, task_callback Fr_Task, int cyc, int offset, int budget)
+{
+	fr_jit *jit = &Fr_CtxPtr->jit;
+	fr_task *t;
+
+	if (jit->tasks == FR_JIT_TASKS) return -1;
+	t = &jit->task[jit->tasks];
+	t->task = Fr_Task;
+	t->cyc = cyc & 0x7F;
+	t->offset = offset;
+	t->budget = budget;
+	t->runs = t->overruns = t->wcet = 0;
+	t->delay = t->delay_max = 0;
+	t->delay_sum = t->time_sum = 0;
+	jit->cycle = -1;
+	return jit->tasks++;
+}
+
+
+/***********************************************************************
+	Fr_JitRun
+	Call on TI1 (Fr_EventDispatch does). Produces and commits every frame
+	and runs every task of the planned cycle that is due within a
+	macrotick, plans the next cycle once all are done and restarts timer
+	1 for the next one; a cycle with nothing to run only has timer 1
+	fire at its start, to plan the one after. A frame counts as
+	committed when the input buffer has finished its transfer to the
+	message RAM (IBCR.IBSYS clear): it is late if that is at or after
+	its action point, else its data age
+	is the time from there to the action point. Returns the number of
+	frames and tasks run.
+***********************************************************************/
+
+// Macroticks of MTCCV from the start of the planned cycle, negative
+// before it
+static int Fr_JitTime(fr_ctx *Fr_CtxPtr, unsigned long mtccv)
+{
+	int behind = ((Fr_CtxPtr->jit.cycle - (int)((mtccv >> 16) & 0x3F) + 32) & 0x3F) - 32;
+
+	return (int)(mtccv & 0x3FFF) - behind * (int)(Fr_CtxPtr->config.gtu2 & 0x3FFF);
+}
+
+// WRHS1 of the buffer in the cycle: the reconfiguration plan, else the
+// header cache, else the node image
+static unsigned long Fr_JitHeader(fr_ctx *Fr_CtxPtr, int buffer, int cycle)
+{
+	fr_reconfig *rc = &Fr_CtxPtr->reconfig;
+	fr_hdrcache *hc = &Fr_CtxPtr->hdr_cache;
+	const fr_startup_image *image = Fr_CtxPtr->image;
+	int k, c, i;
+
+	for (k = 0; k < rc->buffers; k++)
+	{
+		if (rc->buffer[k] != buffer) continue;
+		// FR_RECONFIG_NONE keeps the header of an earlier cycle
+		for (c = 0; c < 64; c++)
+		{
+			i = rc->plan[(cycle - c) & 0x3F][k];
+			if (i != FR_RECONFIG_NONE) return rc->images[i].wrhs1;
+		}
+	}
+	if ((hc->valid[buffer >> 5] >> (buffer & 0x1F)) & 0x1) return hc->wrhs[buffer][0];
+	for (i = 0; image != 0 && i < image->count; i++)
+		if (image->buffers[i].buffer == buffer) return image->buffers[i].wrhs1;
+	return 0;
+}
+
+// Timer 1 in wait macroticks: T1MC, T1RC, single shot; a longer wait
+// fires early and restarts
+static void Fr_JitArm(FRAY_ST *Fray_PST, int wait)
+{
+	if (wait > 0x3FFF) wait = 0x3FFF;
+	Fray_PST->T1C_UN.T1C_UL = 0;
+	Fray_PST->T1C_UN.T1C_UL = ((unsigned long)wait << 16) | 0x00000001;
+}
+
+// Time to run of an order[] entry: action point - lead, or a task's offset
+static int Fr_JitFire(fr_jit *Fr_JitPtr, int entry)
+{
+	if (entry >= FR_JIT_FRAMES) return Fr_JitPtr->task[entry - FR_JIT_FRAMES].offset;
+	return Fr_JitPtr->frame[entry].at - Fr_JitPtr->frame[entry].lead;
+}
+
+static void Fr_JitOrder(fr_jit *Fr_JitPtr, int entry)
+{
+	int fire = Fr_JitFire(Fr_JitPtr, entry), k;
+
+	for (k = Fr_JitPtr->due; k > 0; k--)
+	{
+		if (Fr_JitFire(Fr_JitPtr, Fr_JitPtr->order[k - 1]) <= fire) break;
+		Fr_JitPtr->order[k] = Fr_JitPtr->order[k - 1];
+	}
+	Fr_JitPtr->order[k] = (unsigned char)entry;
+	Fr_JitPtr->due++;
+}
+
+// Action points of the frames sent in cycle and the tasks of cycle,
+// ordered by their time to run
+static void Fr_JitPlan(fr_ctx *Fr_CtxPtr, int cycle)
+{
+	fr_jit *jit = &Fr_CtxPtr->jit;
+	cfg *c = &Fr_CtxPtr->config;
+	int ssl = c->gtu7 & 0x3FF, nss = (c->gtu7 >> 16) & 0x3FF;
+	int msl = c->gtu8 & 0x3F, apo = c->gtu9 & 0x3F, mapo = (c->gtu9 >> 8) & 0x1F;
+	fr_jit_frame *f;
+	unsigned long wrhs1;
+	int i, fid;
+
+	jit->cycle = cycle;
+	jit->due = jit->next = 0;
+	for (i = 0; i < jit->count; i++)
+	{
+		f = &jit->frame[i];
+		wrhs1 = Fr_JitHeader(Fr_CtxPtr, f->buffer, cycle);
+		fid = (int)(wrhs1 & 0x7FF);
+		if (fid == 0 || !Fr_CycleMatch((wrhs1 >> 16) & 0x7F, cycle)) continue;
+		if (fid <= nss)
+			f->at = (fid - 1) * ssl + apo;
+		else
+			f->at = nss * ssl + (fid - nss - 1) * msl + mapo;
+		Fr_JitOrder(jit, i);
+	}
+	for (i = 0; i < jit->tasks; i++)
+		if (Fr_CycleMatch(jit->task[i].cyc, cycle))
+			Fr_JitOrder(jit, FR_JIT_FRAMES + i);
+}
+
+// A task of the planned cycle, started now macroticks into it: start
+// delay, run time in events clock ticks, overrun past offset + budget
+static void Fr_JitTask(fr_ctx *Fr_CtxPtr, fr_task *t, int now)
+{
+	fr_clock clock = Fr_CtxPtr->events.clock;
+	unsigned long start = clock != 0 ? clock() : 0, time;
+	int end;
+
+	t->task(Fr_CtxPtr, Fr_CtxPtr->jit.cycle);
+	if (clock != 0)
+	{
+		time = clock() - start;
+		t->time_sum += time;
+		if (time > t->wcet) t->wcet = time;
+	}
+	t->runs++;
+	t->delay = now > t->offset ? (unsigned long)(now - t->offset) : 0;
+	t->delay_sum += t->delay;
+	if (t->delay > t->delay_max) t->delay_max = t->delay;
+	end = Fr_JitTime(Fr_CtxPtr, Fr_CtxPtr->regs->MTCCV_UN.MTCCV_UL);
+	if (end > t->offset + t->budget) t->overruns++;
+}
+
+int Fr_JitRun(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_jit *jit = &Fr_CtxPtr->jit;
+	unsigned long mtccv;
+	fr_jit_frame *f;
+	int cycle, ahead, now, entry, fire, busy, done, plans = 0, n = 0;
+
+	jit->runs++;
+	if (jit->count == 0 && jit->tasks == 0) return 0;
+	for (;;)
+	{
+		mtccv = Fray_PST->MTCCV_UN.MTCCV_UL;
+		cycle = (mtccv >> 16) & 0x3F;
+		ahead = (jit->cycle - cycle) & 0x3F;
+		if (jit->cycle < 0 || ahead > 1)
+		{
+			if (plans++ == 64) return n;
+			Fr_JitPlan(Fr_CtxPtr, (cycle + 1) & 0x3F);
+			jit->resyncs++;
+			continue;
+		}
+		now = Fr_JitTime(Fr_CtxPtr, mtccv);
+		if (jit->next == jit->due)
+		{
+			// the next cycle's plan is done or empty: plan the one after
+			// at its start, so the plan stays on this or the next cycle
+			if (ahead == 1)
+			{
+				if (now < -1)
+				{
+					Fr_JitArm(Fray_PST, -now);
+					return n;
+				}
+				continue;
+			}
+			if (plans++ == 64) return n;
+			Fr_JitPlan(Fr_CtxPtr, (jit->cycle + 1) & 0x3F);
+			continue;
+		}
+		entry = jit->order[jit->next];
+		fire = Fr_JitFire(jit, entry);
+		if (fire > now + 1)
+		{
+			Fr_JitArm(Fray_PST, fire - now);
+			return n;
+		}
+
+		if (entry >= FR_JIT_FRAMES)
+		{
+			Fr_JitTask(Fr_CtxPtr, &jit->task[entry - FR_JIT_FRAMES], now);
+			jit->next++;
+			n++;
+			continue;
+		}
+		f = &jit->frame[entry];
+		f->producer(Fr_CtxPtr, f->buffer, jit->cycle);
+		Fr_TxCommit(Fr_CtxPtr, f->buffer);
+		f->runs++;
+		// Fr_TxCommit only waits for the host side, the frame is in the
+		// message RAM once the transfer has finished
+		busy = Fr_IbWait(Fray_PST, 0x80000000);
+		done = Fr_JitTime(Fr_CtxPtr, Fray_PST->MTCCV_UN.MTCCV_UL);
+		if (busy || done >= f->at)
+			f->late++;
+		else
+		{
+			f->age = (unsigned long)(f->at - done);
+			f->age_sum += f->age;
+			if (f->age > f->age_max) f->age_max = f->age;
+		}
+		jit->next++;
+		n++;
+	}
+}
+
+
+/***********************************************************************
+	Fr_JitSlack
+	Macroticks until Fr_JitRun next has work: the next frame or task of
+	the plan, the start of a planned cycle that has none, or the next
+	cycle start while nothing is planned. The background loop fits its
+	blocking work (SD card, UART) into this. 0 when it is due.
+***********************************************************************/
+
+int Fr_JitSlack(fr_ctx *Fr_CtxPtr)
+{
+	fr_jit *jit = &Fr_CtxPtr->jit;
+	unsigned long mtccv = Fr_CtxPtr->regs->MTCCV_UN.MTCCV_UL;
+	int ahead = (jit->cycle - (int)((mtccv >> 16) & 0x3F)) & 0x3F, slack;
+
+	if (jit->count + jit->tasks == 0 || jit->cycle < 0 || ahead > 1)
+		slack = (int)(Fr_CtxPtr->config.gtu2 & 0x3FFF) - (int)(mtccv & 0x3FFF);
+	else if (jit->next == jit->due)
+		slack = -Fr_JitTime(Fr_CtxPtr, mtccv);
+	else
+		slack = Fr_JitFire(jit, jit->order[jit->next]) - Fr_JitTime(Fr_CtxPtr, mtccv);
+	return slack > 0 ? slack : 0;
+}
+
+
+/***********************************************************************
+	Fr_ControllerInit
+	CONFIG, then READY. Returns 0 in READY, 1 if a command was not
+	accepted or READY was not reached, 2 if PBSY did not clear.
+***********************************************************************/
+
+int Fr_ControllerInit(FRAY_ST *Fray_PST)
+{
+	unsigned int error=0;
+	// write SUCC1 configuration
+	Fray_PST->SUCC1_UN.SUCC1_UL = 0x0F1FFB00 | CMD_CONFIG;
+	// Check if POC has accepted last command 
+	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) return 1;
+	if (Fr_PbsyWait(Fray_PST)) return 2;
+
+	// unlock CONFIG and enter READY state
+	Fray_PST->LCK_UN.LCK_ST.clk_B8=0xCE;
+	Fray_PST->LCK_UN.LCK_ST.clk_B8=0x31;
+	// write SUCC1 configuration
+	Fray_PST->SUCC1_UN.SUCC1_ST.cmd_B4=(0xFB00 | CMD_READY);
+	// Check if POC has accepted last command 
+	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) error = 1;
+	if (Fr_PbsyWait(Fray_PST)) return 2;
+	if ((Fray_PST->CCSV_UN.CCSV_UL & 0x3F) != FR_POCS_READY) error = 1;
+	return error;
+}
+
+
+/***********************************************************************
+	Fr_AllowColdStart
+	Returns 0, 1 if the command was not accepted, 2 if PBSY did not
+	clear.
+***********************************************************************/
+
+int Fr_AllowColdStart(FRAY_ST *Fray_PST)
+{
+	unsigned int error=0;
+	// write SUCC1 configuration
+	(Fray_PST->SUCC1_UN.SUCC1_UL = CMD_ALLOW_COLDSTART);
+	// Check if POC has accepted last command 
+	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) error = 1;
+	if (Fr_PbsyWait(Fray_PST)) return 2;
+	return error;
+}
+
+
+/***********************************************************************
+	Fr_StartCommunication
+	Issues RUN and returns; startup to NORMAL_ACTIVE takes several
+	cycles. Fr_PocCommand(CMD_RUN, FR_POCS_NORMAL_ACTIVE) tells when
+	it is done.
+***********************************************************************/
+
+int Fr_StartCommunication(FRAY_ST *Fray_PST)
+{
+	unsigned int error=0;
+	// write SUCC1 configuration
+	(Fray_PST->SUCC1_UN.SUCC1_UL = CMD_RUN);
+	// Check if POC has accepted last command 
+	if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0) error = 1;
+	return error;
+}
+
+/***********************************************************************
+	POC command engine
+	Fr_PocPoll never waits: it writes the next queued command once PBSY
+	is clear and finishes the commands whose target state is reached,
+	so the caller can poll between other work (SD card mount, sensor
+	init) or block in Fr_PocAwait. Times are in Fr_Clock ticks, or in
+	polls without a clock. A command's deadline runs from its SUCC1
+	write; before that, from when it reached the head of the queue, so
+	the time spent behind other commands does not count.
+***********************************************************************/
+
+static unsigned long Fr_PocNow(fr_poc *Fr_PocPtr)
+{
+	return Fr_PocPtr->clock ? Fr_PocPtr->clock() : Fr_PocPtr->polls;
+}
+
+void Fr_PocInit(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock)
+{
+	fr_poc *poc = &Fr_CtxPtr->poc;
+	unsigned char *p = (unsigned char *)poc;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(fr_poc); i++)
+		p[i] = 0;
+	poc->clock = Fr_Clock;
+	poc->t0 = Fr_PocNow(poc);
+	poc->state = Fr_CtxPtr->regs->CCSV_UN.CCSV_UL & 0x3F;
+	Fr_LogState(&poc->log, poc->state, 0);
+}
+
+// Queues a command: succ1 is written to SUCC1 (configuration bits and CMD,
+// FR_POC_UNLOCK for the LCK sequence), target the POC state that completes
+// it. Returns a handle, -1 when FR_POC_OPS commands are unfinished.
+int Fr_PocCommand(fr_ctx *Fr_CtxPtr, unsigned long succ1, int target, unsigned long timeout)
+{
+	fr_poc *poc = &Fr_CtxPtr->poc;
+	fr_poc_op *op;
+
+	if (poc->tail - poc->head == FR_POC_OPS) return -1;
+	op = &poc->op[poc->tail & (FR_POC_OPS - 1)];
+	op->succ1 = succ1;
+	op->target = target;
+	op->status = FR_POC_QUEUED;
+	op->timeout = timeout;
+	op->queued = Fr_PocNow(poc);
+	op->issued = op->done = 0;
+	if (poc->tail == poc->head) poc->head_time = op->queued;
+	return (int)(poc->tail++ & 0x7FFFFFFF);
+}
+
+static void Fr_PocFinish(fr_poc *Fr_PocPtr, fr_poc_op *Fr_OpPtr, int status, unsigned long now)
+{
+	if (Fr_OpPtr->status == FR_POC_QUEUED) Fr_OpPtr->issued = now;
+	Fr_OpPtr->status = status;
+	Fr_OpPtr->done = now;
+	Fr_PocPtr->head++;
+	Fr_PocPtr->head_time = now;
+	if (status == FR_POC_DONE) return;
+	while (Fr_PocPtr->head != Fr_PocPtr->tail)
+	{
+		Fr_OpPtr = &Fr_PocPtr->op[Fr_PocPtr->head++ & (FR_POC_OPS - 1)];
+		Fr_OpPtr->status = FR_POC_CANCELLED;
+		Fr_OpPtr->issued = Fr_OpPtr->done = now;
+	}
+}
+
+// Advances the queue; returns CCSV.POCS
+int Fr_PocPoll(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_poc *poc = &Fr_CtxPtr->poc;
+	fr_poc_op *op;
+	unsigned long now, succ1;
+
+	poc->polls++;
+	now = Fr_PocNow(poc);
+	while (poc->head != poc->tail)
+	{
+		op = &poc->op[poc->head & (FR_POC_OPS - 1)];
+		succ1 = Fray_PST->SUCC1_UN.SUCC1_UL;
+		if ((succ1 & 0x00000080) == 0x0)
+		{
+			if (op->status == FR_POC_QUEUED)
+			{
+				if (op->succ1 & FR_POC_UNLOCK)
+				{
+					Fray_PST->LCK_UN.LCK_ST.clk_B8=0xCE;
+					Fray_PST->LCK_UN.LCK_ST.clk_B8=0x31;
+				}
+				Fray_PST->SUCC1_UN.SUCC1_UL = op->succ1 & ~(unsigned long)FR_POC_UNLOCK;
+				op->issued = now;
+				// Check if POC has accepted last command
+				if ((Fray_PST->SUCC1_UN.SUCC1_UL & 0xF) == 0x0)
+					Fr_PocFinish(poc, op, FR_POC_REJECTED, now);
+				else
+					op->status = FR_POC_BUSY;
+				continue;
+			}
+			poc->state = Fray_PST->CCSV_UN.CCSV_UL & 0x3F;
+			if (op->target == FR_POC_ANY || poc->state == op->target)
+			{
+				Fr_PocFinish(poc, op, FR_POC_DONE, now);
+				continue;
+			}
+		}
+		if (now - (op->status == FR_POC_QUEUED ? poc->head_time : op->issued) > op->timeout)
+		{
+			Fr_PocFinish(poc, op, FR_POC_TIMEOUT, now);
+			continue;
+		}
+		break;
+	}
+	poc->state = Fray_PST->CCSV_UN.CCSV_UL & 0x3F;
+	Fr_LogState(&poc->log, poc->state, now - poc->t0);
+	return poc->state;
+}
+
+int Fr_PocStatus(fr_ctx *Fr_CtxPtr, int handle)
+{
+	fr_poc *poc = &Fr_CtxPtr->poc;
+	unsigned int h = (unsigned int)handle;
+
+	if (handle < 0 || poc->tail - h - 1 >= FR_POC_OPS) return FR_POC_UNKNOWN;
+	return poc->op[h & (FR_POC_OPS - 1)].status;
+}
+
+// Polls until the command has finished, returns its status
+int Fr_PocAwait(fr_ctx *Fr_CtxPtr, int handle)
+{
+	int status;
+
+	while ((status = Fr_PocStatus(Fr_CtxPtr, handle)) == FR_POC_QUEUED || status == FR_POC_BUSY)
+		Fr_PocPoll(Fr_CtxPtr);
+	return status;
+}
+
+// Time from the SUCC1 write to completion, 0 while unfinished
+unsigned long Fr_PocTime(fr_ctx *Fr_CtxPtr, int handle)
+{
+	fr_poc_op *op = &Fr_CtxPtr->poc.op[(unsigned int)handle & (FR_POC_OPS - 1)];
+	int status = Fr_PocStatus(Fr_CtxPtr, handle);
+
+	if (status != FR_POC_DONE && status != FR_POC_REJECTED && status != FR_POC_TIMEOUT) return 0;
+	return op->done - op->issued;
+}
+
+/***********************************************************************
+	Fr_Recover
+	Brings a controller that left NORMAL_ACTIVE (NORMAL_PASSIVE at the
+	SUCC3 WCP limit, HALT at WCF, a reset) back without the full
+	configure_initialize_node_x. The configuration registers are read
+	back and compared with the context's Fr_Init image. When all match,
+	a node in NORMAL_PASSIVE or startup only goes through READY, one in
+	READY straight to RUN. Otherwise, and from HALT, it goes through
+	CONFIG and only the registers that differ are written. A changed MRC
+	means a reset, which also cleared the message RAM: then the buffer
+	headers are loaded again from the header cache (the image for
+	buffers it does not know, no CRC computed), the FIFO, timer 0 and
+	the interrupt registers set up again. READY, ALLOW_COLDSTART and RUN
+	are queued on the POC command engine (Fr_PocInit first), RUN with
+	timeout. Returns the handle of RUN, -1 if CONFIG was not reached,
+	the input buffer stayed busy while reloading the message RAM
+	(FR_PBSY_POLLS reads per wait) or the commands could not be queued.
+	Poll with Fr_RecoverPoll.
+***********************************************************************/
+
+// 1 if the register differs from value, written again when write is set
+static int Fr_RecoverReg(volatile unsigned long *reg, unsigned long value, int write)
+{
+	if (*reg == value) return 0;
+	if (write) *reg = value;
+	return 1;
+}
+
+static int Fr_RecoverRegisters(fr_ctx *Fr_CtxPtr, int write)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	cfg *c = &Fr_CtxPtr->config;
+	int n = 0;
+
+	n += Fr_RecoverReg(&Fray_PST->MRC_UN.MRC_UL,     c->mrc,   write);
+	n += Fr_RecoverReg(&Fray_PST->PRTC1_UN.PRTC1_UL, c->prtc1, write);
+	n += Fr_RecoverReg(&Fray_PST->PRTC2_UN.PRTC2_UL, c->prtc2, write);
+	n += Fr_RecoverReg(&Fray_PST->MHDC_UN.MHDC_UL,   c->mhdc,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC1_UN.GTUC1_UL, c->gtu1,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC2_UN.GTUC2_UL, c->gtu2,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC3_UN.GTUC3_UL, c->gtu3,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC4_UN.GTUC4_UL, c->gtu4,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC5_UN.GTUC5_UL, c->gtu5,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC6_UN.GTUC6_UL, c->gtu6,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC7_UN.GTUC7_UL, c->gtu7,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC8_UN.GTUC8_UL, c->gtu8,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC9_UN.GTUC9_UL, c->gtu9,  write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC10_UN.GTUC10_UL, c->gtu10, write);
+	n += Fr_RecoverReg(&Fray_PST->GTUC11_UN.GTUC11_UL, c->gtu11, write);
+	n += Fr_RecoverReg(&Fray_PST->SUCC2_UN.SUCC2_UL, c->succ2, write);
+	n += Fr_RecoverReg(&Fray_PST->SUCC3_UN.SUCC3_UL, c->succ3, write);
+	return n;
+}
+
+// 1 if the input buffer stays busy
+static int Fr_RecoverHeader(fr_ctx *Fr_CtxPtr, int buffer, unsigned long wrhs1, unsigned long wrhs2, unsigned long wrhs3)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+
+	if (Fr_IbWait(Fray_PST, 0x00008000)) return 1;
+	Fray_PST->WRHS1_UN.WRHS1_UL = wrhs1;
+	Fray_PST->WRHS2_UN.WRHS2_UL = wrhs2;
+	Fray_PST->WRHS3_UN.WRHS3_UL = wrhs3;
+	Fray_PST->IBCM_UN.IBCM_UL = 0x1;   // lhsh=1
+	Fray_PST->IBCR_UN.IBCR_UL = buffer & 0x3F;
+	Fr_HeaderLoaded(Fr_CtxPtr, buffer, wrhs1, wrhs2, wrhs3);
+	Fr_CtxPtr->recovery.headers++;
+	return 0;
+}
+
+// The message RAM after a reset: headers, FIFO, timer 0, interrupts; -1 if the input buffer stays busy
+static int Fr_RecoverMram(fr_ctx *Fr_CtxPtr)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	const fr_startup_image *image = Fr_CtxPtr->image;
+	fr_hdrcache *hc = &Fr_CtxPtr->hdr_cache;
+	const fifo_cfg *fifo = Fr_CtxPtr->fifo;
+	const mbuf_image *b;
+	int i, words;
+
+	for (i = 0; image != 0 && i < image->count; i++)
+	{
+		b = &image->buffers[i];
+		if (((hc->valid[(b->buffer & 0x3F) >> 5] >> (b->buffer & 0x1F)) & 0x1) == 0
+		    && Fr_RecoverHeader(Fr_CtxPtr, b->buffer, b->wrhs1, b->wrhs2, b->wrhs3))
+			return -1;
+	}
+	for (i = 0; i < 64; i++)
+		if (((hc->valid[i >> 5] >> (i & 0x1F)) & 0x1)
+		    && Fr_RecoverHeader(Fr_CtxPtr, i, hc->wrhs[i][0], hc->wrhs[i][1], hc->wrhs[i][2]))
+			return -1;
+	if (fifo != 0 && Fr_CtxPtr->fifo_depth != 0)
+	{
+		words = FR_DATA_WORDS(fifo->pl & 0x7F);
+		if (Fr_FifoLoad(Fr_CtxPtr, fifo, Fr_CtxPtr->fifo_first,
+		                Fr_CtxPtr->layout.header_words + Fr_CtxPtr->layout.data_words - fifo->depth * words))
+			return -1;
+		Fr_CtxPtr->recovery.headers += fifo->depth;
+	}
+	if (Fr_IbWait(Fray_PST, 0x80008000)) return -1;
+	// the input buffer was cleared too, tracked TX buffers go out in full
+	Fr_TxForget(Fr_CtxPtr);
+	if (Fr_CtxPtr->reconfig.count != 0) Fr_ReconfigTimer(Fr_CtxPtr);
+
+	if (image == 0) return 0;
+	Fray_PST->EIR_UN.EIR_UL   = 0xFFFFFFFF; // Clear Error Int.
+	Fray_PST->SIR_UN.SIR_UL   = 0xFFFFFFFF; // Clear Status Int.
+	Fray_PST->SILS_UN.SILS_UL = image->sils;
+	Fray_PST->SIER_UN.SIER_UL = 0xFFFFFFFF; // Disable all Status Int.
+	Fray_PST->SIES_UN.SIES_UL = image->sies;
+	Fray_PST->ILE_UN.ILE_UL   = image->ile;
+	if (Fr_CtxPtr->jit.count + Fr_CtxPtr->jit.tasks != 0)
+	{
+		// timer 1 is restarted from the first cycle start dispatched
+		Fray_PST->SILS_UN.SILS_UL |= 0x00000200;
+		Fray_PST->SIES_UN.SIES_UL |= 0x00000200;
+	}
+	return 0;
+}
+
+int Fr_Recover(fr_ctx *Fr_CtxPtr, unsigned long timeout)
+{
+	FRAY_ST *Fray_PST = Fr_CtxPtr->regs;
+	fr_recovery *rc = &Fr_CtxPtr->recovery;
+	unsigned long succ1 = Fr_CtxPtr->image != 0 ? Fr_CtxPtr->image->succ1 : 0;
+	int state = Fray_PST->CCSV_UN.CCSV_UL & 0x3F;
+	int lost, i, h;
+
+	rc->start = Fr_PocNow(&Fr_CtxPtr->poc);
+	rc->from = state;
+	Fr_CtxPtr->jit.cycle = -1;   // timer 1 stops with the cycle, plan again after RUN
+	rc->via_config = 0;
+	rc->busy = 0;
+	rc->status = FR_POC_UNKNOWN;
+	rc->attempts++;
+
+	h = 0;
+	if (state == FR_POCS_HALT || state == FR_POCS_DEFAULT_CONFIG || state == FR_POCS_CONFIG
+	    || Fr_RecoverRegisters(Fr_CtxPtr, 0) != 0)
+	{
+		// HALT goes to DEFAULT_CONFIG first
+		for (i = 0; i < 2 && state != FR_POCS_CONFIG; i++)
+		{
+			if (Fr_PbsyWait(Fray_PST) || Fr_StartupCommand(Fray_PST, succ1 | CMD_CONFIG) != 0) return -1;
+			state = Fray_PST->CCSV_UN.CCSV_UL & 0x3F;
+		}
+		if (state != FR_POCS_CONFIG) return -1;
+		rc->via_config = 1;
+		lost = Fray_PST->MRC_UN.MRC_UL != (unsigned long)Fr_CtxPtr->config.mrc;
+		rc->registers += Fr_RecoverRegisters(Fr_CtxPtr, 1);
+		if (lost && Fr_RecoverMram(Fr_CtxPtr) < 0) return -1;
+		h = Fr_PocCommand(Fr_CtxPtr, succ1 | CMD_READY | FR_POC_UNLOCK, FR_POCS_READY, timeout);
+	}
+	else if (state != FR_POCS_READY)
+		h = Fr_PocCommand(Fr_CtxPtr, CMD_READY, FR_POCS_READY, timeout);
+	if (h >= 0) h = Fr_PocCommand(Fr_CtxPtr, CMD_ALLOW_COLDSTART, FR_POC_ANY, timeout);
+	if (h >= 0) h = Fr_PocCommand(Fr_CtxPtr, CMD_RUN, FR_POCS_NORMAL_ACTIVE, timeout);
+	if (h < 0) return -1;
+	rc->busy = 1;
+	rc->handle = h;
+	return h;
+}
+
+
+/***********************************************************************
+	Fr_RecoverPoll
+	Fr_PocPoll, then the state of the last Fr_Recover: FR_POC_BUSY until
+	its RUN has finished, then that command's Fr_PocStatus (FR_POC_DONE
+	back in NORMAL_ACTIVE, the time from Fr_Recover in last_time).
+***********************************************************************/
+
+int Fr_RecoverPoll(fr_ctx *Fr_CtxPtr)
+{
+	fr_recovery *rc = &Fr_CtxPtr->recovery;
+	int status;
+
+	Fr_PocPoll(Fr_CtxPtr);
+	if (!rc->busy) return rc->status;
+	status = Fr_PocStatus(Fr_CtxPtr, rc->handle);
+	if (status == FR_POC_QUEUED || status == FR_POC_BUSY) return FR_POC_BUSY;
+	rc->busy = 0;
+	rc->status = status;
+	if (status != FR_POC_DONE)
+	{
+		rc->failed++;
+		return status;
+	}
+	rc->resyncs++;
+	rc->last_time = Fr_CtxPtr->poc.op[rc->handle & (FR_POC_OPS - 1)].done - rc->start;
+	if (rc->last_time > rc->max_time) rc->max_time = rc->last_time;
+	return status;
+}
+
+/***********************************************************************
+	Header CRC tables
+	CRC-11 (polynomial 0x385) register update for 4 and 8 header bits
+	shifted in at once, indexed by the top bits of the CRC register
+	XOR the incoming bits.
+***********************************************************************/
+
+static const unsigned short header_crc_table4[16] =
+{
+	0x000, 0x385, 0x70A, 0x48F, 0x591, 0x614, 0x29B, 0x11E,
+	0x0A7, 0x322, 0x7AD, 0x428, 0x536, 0x6B3, 0x23C, 0x1B9
+};
+
+static const unsigned short header_crc_table8[256] =
+{
+	0x000, 0x385, 0x70A, 0x48F, 0x591, 0x614, 0x29B, 0x11E,
+	0x0A7, 0x322, 0x7AD, 0x428, 0x536, 0x6B3, 0x23C, 0x1B9,
+	0x14E, 0x2CB, 0x644, 0x5C1, 0x4DF, 0x75A, 0x3D5, 0x050,
+	0x1E9, 0x26C, 0x6E3, 0x566, 0x478, 0x7FD, 0x372, 0x0F7,
+	0x29C, 0x119, 0x596, 0x613, 0x70D, 0x488, 0x007, 0x382,
+	0x23B, 0x1BE, 0x531, 0x6B4, 0x7AA, 0x42F, 0x0A0, 0x325,
+	0x3D2, 0x057, 0x4D8, 0x75D, 0x643, 0x5C6, 0x149, 0x2CC,
+	0x375, 0x0F0, 0x47F, 0x7FA, 0x6E4, 0x561, 0x1EE, 0x26B,
+	0x538, 0x6BD, 0x232, 0x1B7, 0x0A9, 0x32C, 0x7A3, 0x426,
+	0x59F, 0x61A, 0x295, 0x110, 0x00E, 0x38B, 0x704, 0x481,
+	0x476, 0x7F3, 0x37C, 0x0F9, 0x1E7, 0x262, 0x6ED, 0x568,
+	0x4D1, 0x754, 0x3DB, 0x05E, 0x140, 0x2C5, 0x64A, 0x5CF,
+	0x7A4, 0x421, 0x0AE, 0x32B, 0x235, 0x1B0, 0x53F, 0x6BA,
+	0x703, 0x486, 0x009, 0x38C, 0x292, 0x117, 0x598, 0x61D,
+	0x6EA, 0x56F, 0x1E0, 0x265, 0x37B, 0x0FE, 0x471, 0x7F4,
+	0x64D, 0x5C8, 0x147, 0x2C2, 0x3DC, 0x059, 0x4D6, 0x753,
+	0x1F5, 0x270, 0x6FF, 0x57A, 0x464, 0x7E1, 0x36E, 0x0EB,
+	0x152, 0x2D7, 0x658, 0x5DD, 0x4C3, 0x746, 0x3C9, 0x04C,
+	0x0BB, 0x33E, 0x7B1, 0x434, 0x52A, 0x6AF, 0x220, 0x1A5,
+	0x01C, 0x399, 0x716, 0x493, 0x58D, 0x608, 0x287, 0x102,
+	0x369, 0x0EC, 0x463, 0x7E6, 0x6F8, 0x57D, 0x1F2, 0x277,
+	0x3CE, 0x04B, 0x4C4, 0x741, 0x65F, 0x5DA, 0x155, 0x2D0,
+	0x227, 0x1A2, 0x52D, 0x6A8, 0x7B6, 0x433, 0x0BC, 0x339,
+	0x280, 0x105, 0x58A, 0x60F, 0x711, 0x494, 0x01B, 0x39E,
+	0x4CD, 0x748, 0x3C7, 0x042, 0x15C, 0x2D9, 0x656, 0x5D3,
+	0x46A, 0x7EF, 0x360, 0x0E5, 0x1FB, 0x27E, 0x6F1, 0x574,
+	0x583, 0x606, 0x289, 0x10C, 0x012, 0x397, 0x718, 0x49D,
+	0x524, 0x6A1, 0x22E, 0x1AB, 0x0B5, 0x330, 0x7BF, 0x43A,
+	0x651, 0x5D4, 0x15B, 0x2DE, 0x3C0, 0x045, 0x4CA, 0x74F,
+	0x6F6, 0x573, 0x1FC, 0x279, 0x367, 0x0E2, 0x46D, 0x7E8,
+	0x71F, 0x49A, 0x015, 0x390, 0x28E, 0x10B, 0x584, 0x601,
+	0x7B8, 0x43D, 0x0B2, 0x337, 0x229, 0x1AC, 0x523, 0x6A6
+};
+
+/***********************************************************************
+	Header CRC byte tables
+	The header CRC is affine in the header bits: the CRC of the all-zero
+	header XOR one term per nibble/byte, each independent of the others.
+	These hold the terms of header bits 19..16 and 15..8; bits 7..0 use
+	header_crc_table8.
+***********************************************************************/
+
+#define HEADER_CRC_ZERO  0x76A   // CRC of sync, sfi, fid and pl all 0
+
+static const unsigned short header_crc_bits16[16] =
+{
+	0x000, 0x259, 0x4B2, 0x6EB, 0x2E1, 0x0B8, 0x653, 0x40A,
+	0x5C2, 0x79B, 0x170, 0x329, 0x723, 0x57A, 0x391, 0x1C8
+};
+
+static const unsigned short header_crc_bits8[256] =
+{
+	0x000, 0x3EA, 0x7D4, 0x43E, 0x42D, 0x7C7, 0x3F9, 0x013,
+	0x3DF, 0x035, 0x40B, 0x7E1, 0x7F2, 0x418, 0x026, 0x3CC,
+	0x7BE, 0x454, 0x06A, 0x380, 0x393, 0x079, 0x447, 0x7AD,
+	0x461, 0x78B, 0x3B5, 0x05F, 0x04C, 0x3A6, 0x798, 0x472,
+	0x4F9, 0x713, 0x32D, 0x0C7, 0x0D4, 0x33E, 0x700, 0x4EA,
+	0x726, 0x4CC, 0x0F2, 0x318, 0x30B, 0x0E1, 0x4DF, 0x735,
+	0x347, 0x0AD, 0x493, 0x779, 0x76A, 0x480, 0x0BE, 0x354,
+	0x098, 0x372, 0x74C, 0x4A6, 0x4B5, 0x75F, 0x361, 0x08B,
+	0x277, 0x19D, 0x5A3, 0x649, 0x65A, 0x5B0, 0x18E, 0x264,
+	0x1A8, 0x242, 0x67C, 0x596, 0x585, 0x66F, 0x251, 0x1BB,
+	0x5C9, 0x623, 0x21D, 0x1F7, 0x1E4, 0x20E, 0x630, 0x5DA,
+	0x616, 0x5FC, 0x1C2, 0x228, 0x23B, 0x1D1, 0x5EF, 0x605,
+	0x68E, 0x564, 0x15A, 0x2B0, 0x2A3, 0x149, 0x577, 0x69D,
+	0x551, 0x6BB, 0x285, 0x16F, 0x17C, 0x296, 0x6A8, 0x542,
+	0x130, 0x2DA, 0x6E4, 0x50E, 0x51D, 0x6F7, 0x2C9, 0x123,
+	0x2EF, 0x105, 0x53B, 0x6D1, 0x6C2, 0x528, 0x116, 0x2FC,
+	0x4EE, 0x704, 0x33A, 0x0D0, 0x0C3, 0x329, 0x717, 0x4FD,
+	0x731, 0x4DB, 0x0E5, 0x30F, 0x31C, 0x0F6, 0x4C8, 0x722,
+	0x350, 0x0BA, 0x484, 0x76E, 0x77D, 0x497, 0x0A9, 0x343,
+	0x08F, 0x365, 0x75B, 0x4B1, 0x4A2, 0x748, 0x376, 0x09C,
+	0x017, 0x3FD, 0x7C3, 0x429, 0x43A, 0x7D0, 0x3EE, 0x004,
+	0x3C8, 0x022, 0x41C, 0x7F6, 0x7E5, 0x40F, 0x031, 0x3DB,
+	0x7A9, 0x443, 0x07D, 0x397, 0x384, 0x06E, 0x450, 0x7BA,
+	0x476, 0x79C, 0x3A2, 0x048, 0x05B, 0x3B1, 0x78F, 0x465,
+	0x699, 0x573, 0x14D, 0x2A7, 0x2B4, 0x15E, 0x560, 0x68A,
+	0x546, 0x6AC, 0x292, 0x178, 0x16B, 0x281, 0x6BF, 0x555,
+	0x127, 0x2CD, 0x6F3, 0x519, 0x50A, 0x6E0, 0x2DE, 0x134,
+	0x2F8, 0x112, 0x52C, 0x6C6, 0x6D5, 0x53F, 0x101, 0x2EB,
+	0x260, 0x18A, 0x5B4, 0x65E, 0x64D, 0x5A7, 0x199, 0x273,
+	0x1BF, 0x255, 0x66B, 0x581, 0x592, 0x678, 0x246, 0x1AC,
+	0x5DE, 0x634, 0x20A, 0x1E0, 0x1F3, 0x219, 0x627, 0x5CD,
+	0x601, 0x5EB, 0x1D5, 0x23F, 0x22C, 0x1C6, 0x5F8, 0x612
+};
+
+/***********************************************************************
+	header_crc_calc
+	This function calculates the header CRC over the 20 bits sync frame
+	indicator, startup frame indicator, frame ID and payload length,
+	one nibble and two bytes at a time.
+***********************************************************************/
+
+int header_crc_calc(wrhs *Fr_LPduPtr)
+{
+  unsigned int header;
+  unsigned int crc = 0x1A;       // CrcInit
+
+  header  = ((Fr_LPduPtr->sync & 0x1)  << 19) | ((Fr_LPduPtr->sfi & 0x1) << 18);
+  header |= ((Fr_LPduPtr->fid & 0x7FF) <<  7) |  (Fr_LPduPtr->pl & 0x7F);
+
+  crc = ((crc << 4) & 0x7FF) ^ header_crc_table4[((crc >> 7) ^ (header >> 16)) & 0xF];
+  crc = ((crc << 8) & 0x7FF) ^ header_crc_table8[((crc >> 3) ^ (header >> 8)) & 0xFF];
+  crc = ((crc << 8) & 0x7FF) ^ header_crc_table8[((crc >> 3) ^ header) & 0xFF];
+
+  return crc;
+}
+
+/***********************************************************************
+	header_crc_calc_batch
+	Calculates the header CRC of count buffer descriptors and stores it
+	in their crc field. Uses the byte tables, whose three lookups do not
+	wait for each other as those of header_crc_calc do, so consecutive
+	descriptors overlap in the pipeline.
+***********************************************************************/
+
+void header_crc_calc_batch(wrhs *Fr_LPduPtr, int count)
+{
+  unsigned int header;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    header  = ((Fr_LPduPtr[i].sync & 0x1)  << 19) | ((Fr_LPduPtr[i].sfi & 0x1) << 18);
+    header |= ((Fr_LPduPtr[i].fid & 0x7FF) <<  7) |  (Fr_LPduPtr[i].pl & 0x7F);
+    Fr_LPduPtr[i].crc = HEADER_CRC_ZERO ^ header_crc_bits16[header >> 16]
+                      ^ header_crc_bits8[(header >> 8) & 0xFF] ^ header_crc_table8[header & 0xFF];
+  }
+}
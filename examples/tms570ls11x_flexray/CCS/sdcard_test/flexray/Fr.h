@@ -8,6 +8,8 @@
  *
  *******************************************************************/
 
+#ifndef FR_H
+#define FR_H
 
 // CMD constants (SUCC1)
 //
@@ -982,8 +984,18 @@ union frfm
     } FRFM_ST;
 } FRFM_UN;
 
+/* FIFO Critical Level                                                       */
+/* 0x30C */
+union fcl
+{
+  unsigned long FCL_UL;
+  struct
+    {
+      unsigned           : 24;
+      unsigned cl_B8     : 8;
+    } FCL_ST;
+} FCL_UN;
 
-unsigned      : 32;
 
 /* Message Buffer Status Registers                                           */
 
@@ -1013,7 +1025,23 @@ union mhds
 
 
 unsigned      : 32;
-unsigned      : 32;
+
+/* FIFO Status Register                                                      */
+/* 0x318 */
+union fsr
+{
+  unsigned long FSR_UL;
+  struct
+    {
+      unsigned           : 16;
+      unsigned rffl_B8   : 8;
+      unsigned           : 5;
+      unsigned rfo_B1    : 1;
+      unsigned rfcl_B1   : 1;
+      unsigned rfne_B1   : 1;
+    } FSR_ST;
+} FSR_UN;
+
 unsigned      : 32;
 
 
@@ -1360,9 +1388,559 @@ typedef volatile struct bc
 		int rhss;
 	} bc;
 
+// Message RAM layout - Fr_CtxLoadImage - Fr_CtxPtr->layout
+#define FR_MRAM_WORDS        2048                 // 8 KB message RAM
+#define FR_HEADER_WORDS      4                    // header section per message buffer
+#define FR_DATA_WORDS(pl)    (((pl) + 1) / 2)     // data section for pl 2-byte words
+
+// Build time check that buffers header sections plus data_words fit
+// e.g. FR_MRAM_ASSERT(node_a_fits, 24, FR_DATA_WORDS(9) + FR_DATA_WORDS(127));
+#define FR_MRAM_ASSERT(name, buffers, data_words) \
+	typedef char name[((buffers) * FR_HEADER_WORDS + (data_words) <= FR_MRAM_WORDS) ? 1 : -1]
+
+typedef volatile struct mram_layout
+	{
+		int buffers;        // header sections reserved (buffers 0..LCB)
+		int used;           // buffers with a frame assigned
+		int header_words;
+		int data_words;
+		int unused_words;   // header sections of buffers without a frame
+		int free_words;     // left after the last data section, < 0 if it does not fit
+	} mram_layout;
+
+// Precompiled message buffer header - Fr_LoadBufferImages, see Fr_Schedule.h
+typedef struct mbuf_image
+	{
+		int buffer;
+		unsigned long wrhs1;
+		unsigned long wrhs2;
+		unsigned long wrhs3;
+	} mbuf_image;
+
+// Packed controller image for the fast startup path - Fr_FastStartup, see Fr_Schedule.h
+#define FR_IMAGE_SUCC_WORDS  6     // SUCC2, SUCC3, NEMC, PRTC1, PRTC2, MHDC (contiguous)
+#define FR_IMAGE_GTU_WORDS   11    // GTUC1..GTUC11 (contiguous)
+
+typedef struct fr_startup_image
+	{
+		unsigned long succ1;                        // SUCC1 without CMD
+		unsigned long mrc;
+		unsigned long succ[FR_IMAGE_SUCC_WORDS];
+		unsigned long gtu[FR_IMAGE_GTU_WORDS];
+		unsigned long sies;                         // status interrupts enabled
+		unsigned long sils;                         // status interrupts on eray_int1
+		unsigned long ile;                          // interrupt lines enabled
+		const mbuf_image *buffers;
+		int count;
+	} fr_startup_image;
+
+// Free running time base for startup measurements, any unit
+typedef unsigned long (*fr_clock)(void);
+
+// POC states passed through by Fr_FastStartup and when they were entered
+#define FR_STARTUP_STEPS 16
+
+typedef volatile struct fr_startup_log
+	{
+		int count;
+		int state[FR_STARTUP_STEPS];            // CCSV.POCS
+		unsigned long time[FR_STARTUP_STEPS];   // clock ticks since the call
+	} fr_startup_log;
+
+// POC states, CCSV.POCS
+#define FR_POCS_DEFAULT_CONFIG  0x00
+#define FR_POCS_READY           0x01
+#define FR_POCS_NORMAL_ACTIVE   0x02
+#define FR_POCS_NORMAL_PASSIVE  0x03
+#define FR_POCS_HALT            0x04
+#define FR_POCS_CONFIG          0x0F
+
+// SUCC1 or IBCR reads before a PBSY or input buffer wait gives up
+// (Fr_ControllerInit, Fr_AllowColdStart return 2, Fr_ConfigureFifo, Fr_Recover -1)
+#define FR_PBSY_POLLS           100000
+
+// Non-blocking POC commands - Fr_PocInit, Fr_PocCommand, Fr_PocPoll,
+// Fr_PocStatus, Fr_PocAwait. Commands are queued and each is written to
+// SUCC1 by Fr_PocPoll once PBSY is clear; it is done when PBSY has cleared
+// again and CCSV.POCS is its target state. One that is not accepted or
+// misses its deadline cancels the commands queued behind it. A handle
+// stays valid for the last FR_POC_OPS commands.
+#define FR_POC_OPS              4        // commands per controller, power of 2
+#define FR_POC_ANY              (-1)     // target: done when PBSY clears
+#define FR_POC_UNLOCK           0x80     // in succ1 (PBSY, read only): LCK sequence first, READY from CONFIG
+
+// Fr_PocStatus
+#define FR_POC_QUEUED           0
+#define FR_POC_BUSY             1        // written, PBSY set or target state not reached
+#define FR_POC_DONE             2
+#define FR_POC_REJECTED         3        // CMD read back as command_not_accepted
+#define FR_POC_TIMEOUT          4
+#define FR_POC_CANCELLED        5        // an earlier command failed
+#define FR_POC_UNKNOWN          6        // not a handle of the last FR_POC_OPS commands
+
+typedef struct fr_poc_op
+	{
+		unsigned long succ1;        // written to SUCC1, FR_POC_UNLOCK
+		int target;                 // CCSV.POCS, FR_POC_ANY
+		int status;
+		unsigned long timeout;      // ticks from issued (while queued, from reaching the head)
+		unsigned long queued;       // time of Fr_PocCommand
+		unsigned long issued;       // time of the SUCC1 write
+		unsigned long done;         // time it finished
+	} fr_poc_op;
+
+typedef struct fr_poc
+	{
+		fr_clock clock;             // 0: time counts Fr_PocPoll calls
+		unsigned long polls;
+		unsigned long t0;           // time of Fr_PocInit
+		unsigned int head;          // oldest unfinished command
+		unsigned long head_time;    // time it became the oldest
+		unsigned int tail;          // handle of the next command
+		int state;                  // CCSV.POCS at the last poll
+		fr_poc_op op[FR_POC_OPS];
+		fr_startup_log log;         // states seen, times since Fr_PocInit
+	} fr_poc;
+
+// Reintegration after HALT or NORMAL_PASSIVE - Fr_Recover, Fr_RecoverPoll
+// The context's register image and buffer headers are compared with the
+// controller and only what was lost is written again; times in Fr_PocInit
+// clock ticks.
+typedef struct fr_recovery
+	{
+		int busy;                   // RUN of the last Fr_Recover not finished
+		int handle;                 // of that RUN
+		int status;                 // its Fr_PocStatus once finished
+		int from;                   // CCSV.POCS at Fr_Recover
+		int via_config;             // went through CONFIG
+		unsigned long start;        // time of Fr_Recover
+		unsigned long attempts;
+		unsigned long resyncs;      // back in NORMAL_ACTIVE
+		unsigned long failed;
+		unsigned long last_time;    // Fr_Recover to NORMAL_ACTIVE
+		unsigned long max_time;
+		unsigned long registers;    // registers written again, all attempts
+		unsigned long headers;      // buffer headers loaded again
+	} fr_recovery;
+
+// Queue of input buffer transfers waiting for the host buffer - Fr_TxQueueSubmit
+#define FR_TXQ_DEPTH 8
+
+typedef volatile struct txq_entry
+	{
+		int ibrh;
+		int ibcm;
+		int words;
+		unsigned long data[64];
+	} txq_entry;
+
+typedef volatile struct txq
+	{
+		txq_entry entry[FR_TXQ_DEPTH];
+		int head;
+		int count;
+		int direct;     // submits written straight to the input buffer
+		int queued;     // submits that had to wait in the queue
+		int full;       // submits rejected, queue full
+	} txq;
+
+// Per-buffer receive handler - Fr_ReceiveRxBatch
+// Called with the buffer number and the output buffer data section (RDDS)
+typedef void (*rx_callback)(int buffer, volatile unsigned long *rdds);
+
+// Receive FIFO - Fr_ConfigureFifo
+// Frames without a dedicated RX buffer are stored in the FIFO unless the
+// rejection filter matches: ID equal to fid in the bits not set in mfid,
+// in a cycle selected by cyf. fid = mfid = 0 rejects nothing.
+typedef volatile struct fifo_cfg
+	{
+		int depth;      // FIFO buffers, taken from the top: MRC.FFB = LCB - depth + 1
+		int pl;         // payload stored per entry, 2-byte words
+		int fid;        // FRF.FID
+		int mfid;       // FRFM.MFID, 1 = ID bit not compared
+		int cyf;        // FRF.CYF, cycle code as in WRHS1.CYC
+		int ch;         // FRF.CH: 0 channels A and B, 1 B only, 2 A only, 3 none
+		int rss;        // FRF.RSS, reject the static segment
+		int rnf;        // FRF.RNF, reject null frames
+		int critical;   // FCL.CL, fill level that raises RFCL
+	} fifo_cfg;
+
+// Readout time of a received frame - Fr_TimeStamp
+typedef volatile struct fr_rxstamp
+	{
+		int cycle;                  // MTCCV.CCV when read out
+		int macrotick;              // MTCCV.MTV when read out
+		unsigned long long time;    // global time when read out, macroticks
+	} fr_rxstamp;
+
+// One FIFO entry - Fr_FifoDrain
+typedef volatile struct fifo_entry
+	{
+		int fid;
+		int cycle;                  // RDHS3.RCC
+		int channels;               // MBS.VFRA (0x1), MBS.VFRB (0x2)
+		int pl;                     // RDHS2.PLR, 2-byte words
+		unsigned long header[4];    // RDHS1..3, MBS
+		fr_rxstamp stamp;
+		unsigned long data[64];
+	} fifo_entry;
+
+// Cycle multiplexed frames - Fr_PackSlots
+// A frame sent every repetition-th cycle from cycle base takes the cycles
+// base, base + repetition, ... of its slot. Frames whose cycles do not
+// overlap share a slot, each in its own buffer with cycle code
+// repetition | base (Fr_CycleCode).
+typedef struct mux_frame
+	{
+		int repetition;     // 1, 2, 4, .. 64 cycles
+		int base;           // first cycle, below repetition; -1 = any that fits
+		wrhs *lpdu;         // fid and cyc filled in, fid 0 if the frame did not fit
+	} mux_frame;
+
+typedef volatile struct slot_use
+	{
+		int fid;                    // slot offered to Fr_PackSlots
+		int frames;                 // frames packed into it
+		unsigned long cycles[2];    // cycles taken, cycle n is bit n % 32 of cycles[n / 32]
+	} slot_use;
+
+// Driver statistics of one controller - fr_ctx
+typedef volatile struct fr_stats
+	{
+		unsigned long cycles;       // transmit_check calls
+		unsigned long tx_frames;    // input buffer transfers with a transmission request
+		unsigned long rx_frames;    // output buffer transfers of new data
+		unsigned long rx_errors;    // received payloads that did not match
+		unsigned long fifo_frames;  // FIFO entries drained
+		unsigned long fifo_overruns;// drains that found FSR.RFO set
+		unsigned long tx_skipped;   // Fr_TxCommit calls with nothing to transfer
+		unsigned long tx_words;     // WRDS words written by Fr_TxCommit
+		unsigned long tx_words_kept;// data section words already in the input buffer
+		unsigned long headers;      // header sections loaded by Fr_UpdateLPdu
+		unsigned long headers_kept; // header loads dropped, header unchanged
+		unsigned long crc_calcs;    // header CRCs computed by Fr_UpdateLPdu
+	} fr_stats;
+
+// Cycle start event layer - Fr_EventIsr (top half), Fr_EventDispatch (bottom half)
+#define FR_EVENT_DEPTH       8     // bottom-half queue, power of 2
+#define FR_CYCLE_CALLBACKS   4
+
+struct fr_ctx;
+
+// Per-cycle handler, called with the cycle counter of the cycle just started
+typedef void (*cycle_callback)(struct fr_ctx *Fr_CtxPtr, int cycle);
+// Per-buffer handler, called with the buffer number and its data section (RDDS);
+// Fr_CtxPtr->rx_stamp holds the time it was read out
+typedef void (*buffer_callback)(struct fr_ctx *Fr_CtxPtr, int buffer, volatile unsigned long *rdds);
+// Waits for the next interrupt - Fr_EventWait, WFI when not set
+typedef void (*idle_hook)(struct fr_ctx *Fr_CtxPtr);
+
+typedef volatile struct fr_event
+	{
+		unsigned long sir;      // status flags taken by the ISR
+		int cycle;
+		unsigned long time;     // clock at interrupt entry
+	} fr_event;
+
+typedef volatile struct fr_events
+	{
+		fr_event queue[FR_EVENT_DEPTH];
+		unsigned int put;       // advanced by the ISR only
+		unsigned int get;       // advanced by Fr_EventDispatch only
+		cycle_callback cycle[FR_CYCLE_CALLBACKS];
+		int cycle_filter[FR_CYCLE_CALLBACKS];   // cycle code as in WRHS1.CYC, 0 = every cycle
+		int cycles;
+		buffer_callback buffer[64];
+		unsigned long buffer_mask[2];           // buffers with a handler, as NDAT1/NDAT2
+		fr_clock clock;
+		idle_hook idle;
+		unsigned long interrupts;
+		unsigned long dispatched;
+		unsigned long overruns;                 // cycle starts lost, queue full
+		unsigned long idle_time;                // clock ticks spent waiting in Fr_EventWait
+		unsigned long max_latency;              // clock ticks from interrupt to dispatch
+	} fr_events;
+
+// Runtime buffer reconfiguration - Fr_ReconfigInit, Fr_ReconfigRun
+// Several precompiled headers (Fr_Schedule.h FR_MBUF_IMAGE, CRC in place)
+// share one buffer, each selecting its cycles with WRHS1.CYC. The header
+// for every cycle is worked out once; at runtime each change is a single
+// header transfer in the NIT before the cycle it is needed in.
+#define FR_RECONFIG_BUFFERS  8
+#define FR_RECONFIG_NONE     0xFF
+
+typedef volatile struct fr_reconfig
+	{
+		const mbuf_image *images;
+		int count;
+		int buffers;                                     // reconfigurable buffers
+		unsigned char buffer[FR_RECONFIG_BUFFERS];
+		unsigned char current[FR_RECONFIG_BUFFERS];      // image loaded, FR_RECONFIG_NONE if unknown
+		unsigned char plan[64][FR_RECONFIG_BUFFERS];     // image per cycle, FR_RECONFIG_NONE keeps it
+		unsigned long swaps;
+		unsigned long lost;      // RX buffers swapped with unread data (NDAT)
+		unsigned long late;      // runs that did not finish inside the NIT
+		unsigned long max_time;  // longest run, macroticks
+	} fr_reconfig;
+
+// Transmit payload tracking - Fr_TxTrackInit, Fr_TxWrite, Fr_TxCommit
+// A copy of each tracked TX buffer's payload with a dirty bit per word.
+// The node images put TX buffers in continuous mode, so a buffer whose
+// payload did not change keeps its transmission request and needs no
+// transfer at all. The input buffer host and shadow halves swap on every
+// transfer; both are mirrored so only the words that differ from what
+// the host half already holds are written to WRDS.
+#define FR_TX_TRACKED        8
+#define FR_TX_NONE           (-1)
+
+typedef struct fr_txbuf
+	{
+		int buffer;
+		int words;                  // data section length
+		int pending;                // transfer due even if clean, TXRQ cleared by a header load
+		unsigned long dirty[2];     // words that differ from the message RAM, as NDAT1/NDAT2
+		unsigned long data[64];
+	} fr_txbuf;
+
+typedef struct fr_txtrack
+	{
+		fr_txbuf buf[FR_TX_TRACKED];
+		int count;
+		signed char index[64];      // buffer number -> buf[], FR_TX_NONE if untracked
+		unsigned long ibf[2][64];   // data words of the two input buffer halves
+		unsigned long known[2][2];  // words of ibf[] that match the hardware
+		int host;                   // ibf[] half on the host side (WRDS)
+	} fr_txtrack;
+
+// Header cache - Fr_UpdateLPdu
+// The last header written to each buffer (WRHS1..3, also from node images
+// and Fr_ReconfigRun) and the sync, sfi, payload length and frame ID its
+// CRC was computed for. A header load that would write the same words is
+// dropped, the CRC is only computed again when one of its inputs changed.
+#define FR_CRC_KEY_NONE      0xFFFFFFFF
+
+typedef struct fr_hdrcache
+	{
+		unsigned long valid[2];      // buffers with a known header, as NDAT1/NDAT2
+		unsigned long wrhs[64][3];
+		unsigned long crc_key[64];   // FR_CRC_KEY_NONE until a CRC is computed
+		unsigned short crc[64];
+	} fr_hdrcache;
+
+// Just-in-time payload updates - Fr_JitInit, Fr_JitAdd, Fr_JitRun
+// Each tracked TX buffer's producer runs lead macroticks before the action
+// point of its frame (the earliest start in the dynamic segment) and the
+// buffer is committed right after, instead of all payloads at cycle start.
+// Timer 1 (relative, T1MC) is restarted for the next frame due from every
+// TI1 event. Data age is the time from the producer call to the action
+// point; a frame committed after it went out with the old payload.
+// Tasks (Fr_TaskAdd) share the schedule and the timer: a task runs at a
+// macrotick offset in the cycles its cycle code selects, so application
+// work keeps its phase to the bus. Its run time is kept in events clock
+// ticks, and one that ends after offset + budget is an overrun.
+#define FR_JIT_FRAMES        8
+#define FR_JIT_TASKS         8
+
+// Writes the payload of buffer for the frame sent in cycle (Fr_TxWrite)
+typedef void (*jit_producer)(struct fr_ctx *Fr_CtxPtr, int buffer, int cycle);
+
+// The application work of a task in cycle
+typedef void (*task_callback)(struct fr_ctx *Fr_CtxPtr, int cycle);
+
+typedef struct fr_jit_frame
+	{
+		int buffer;
+		jit_producer producer;
+		int lead;                   // macroticks before the action point
+		int at;                     // action point in the planned cycle, macroticks
+		unsigned long runs;
+		unsigned long late;         // in the message RAM (IBSYS clear) at or after the action point
+		unsigned long age;          // last data age, message RAM to action point, macroticks
+		unsigned long age_max;
+		unsigned long long age_sum; // over runs - late
+	} fr_jit_frame;
+
+typedef struct fr_task
+	{
+		task_callback task;
+		int cyc;                    // cycle code as in WRHS1.CYC, 0 = every cycle
+		int offset;                 // macroticks after cycle start
+		int budget;                 // macroticks after offset it must end in
+		unsigned long runs;
+		unsigned long delay;        // last start delay after offset, macroticks
+		unsigned long delay_max;
+		unsigned long long delay_sum;
+		unsigned long overruns;     // ended after offset + budget
+		unsigned long wcet;         // longest run, events clock ticks
+		unsigned long long time_sum;
+	} fr_task;
+
+typedef struct fr_jit
+	{
+		int count;                  // frames
+		int tasks;
+		int cycle;                  // cycle planned, -1 before the first plan
+		int due;                    // frames and tasks in order[] for that cycle
+		int next;                   // order[] index of the next one
+		// by time to run: frame[] index, FR_JIT_FRAMES + task[] index for a task
+		unsigned char order[FR_JIT_FRAMES + FR_JIT_TASKS];
+		fr_jit_frame frame[FR_JIT_FRAMES];
+		fr_task task[FR_JIT_TASKS];
+		unsigned long runs;         // Fr_JitRun calls
+		unsigned long resyncs;      // planned again, the plan was not for this or the next cycle
+	} fr_jit;
+
+// Dual-channel receive - Fr_DualAdd
+// A frame sent on both channels is received into one buffer per channel
+// (same frame ID, CHA only and CHB only) and both copies are read out by
+// the same cycle start dispatch, header and slot status included. The
+// first valid copy goes to the handler, once per cycle; the second is
+// compared with it. A buffer on both channels added as its own pair
+// reports the channels from MBS.VFRA/VFRB, its copies cannot be compared.
+// SFS gives the valid sync frames of each channel per double cycle.
+#define FR_DUAL_PAIRS        4
+#define FR_DUAL_A            0x1     // MBS.VFRA
+#define FR_DUAL_B            0x2     // MBS.VFRB
+
+// The frame of a pair in a cycle, first valid copy; channel FR_DUAL_A or
+// FR_DUAL_B, Fr_CtxPtr->rx_stamp holds the time it was read out
+typedef void (*dual_callback)(struct fr_ctx *Fr_CtxPtr, int pair, int channel, volatile unsigned long *rdds);
+
+typedef struct fr_dual_pair
+	{
+		int buffer[2];              // channel A, channel B (the same buffer for both channels)
+		dual_callback handler;
+		int cycle;                  // RDHS3.RCC of the frame delivered, -1 for none
+		int channels;               // valid copies of that frame, FR_DUAL_A | FR_DUAL_B
+		unsigned long long time;    // its readout time, rx_stamp.time
+		int words;
+		unsigned long data[64];     // its payload, for the other copy
+		unsigned long frames;       // delivered, one per cycle
+		unsigned long copies[2];    // valid copies per channel
+		unsigned long invalid[2];   // copies with a syntax, content or boundary error (SEO, CEO, SVO)
+		unsigned long missing[2];   // frames delivered without a valid copy on the channel
+		unsigned long disagree;     // both copies valid, payloads differ
+	} fr_dual_pair;
+
+typedef struct fr_dual
+	{
+		int count;
+		fr_dual_pair pair[FR_DUAL_PAIRS];
+		unsigned long sync[2];      // valid sync frames received per channel, SFS
+		unsigned long sync_differ;  // double cycles with more on one channel than the other
+	} fr_dual;
+
+// Global time - Fr_TimeNow, Fr_TimeStamp
+// Macroticks since cycle 0 of the first 64-cycle round seen: MTCCV gives
+// cycle and macrotick, cycle counter rollovers are counted here. Stays
+// monotonic as long as MTCCV is read at least once every 64 cycles, which
+// the cycle start dispatch does.
+typedef volatile struct fr_time
+	{
+		unsigned long long cycles;      // cycles since cycle 0 of the first round
+		int cycle;                      // last MTCCV.CCV seen, -1 before the first read
+		unsigned long macro_per_cycle;  // GTUC2.MPC
+	} fr_time;
+
+// Bus trace - Fr_TraceFrame (Fr.c) fills a RAM ring from the cycle work,
+// Fr_TraceOpen, Fr_TracePoll, Fr_TraceClose (Fr_Trace.c) empty it into a
+// FatFs file from the background loop. The file is a fr_trace_file header
+// followed by records, each a fr_trace_record and words payload words,
+// all in the byte order of the recording CPU (see magic).
+// Two kinds of record, told apart by FR_TRACE_COMMIT in flags:
+// - received frame: stamped with the time it was read out (rx_stamp);
+//   fid, cycle and slot status from the receive buffer, channels that
+//   had a valid frame (VFRA, VFRB).
+// - commit (FR_TRACE_COMMIT): a payload handed to a TX buffer through
+//   the input buffer (Fr_TxCommit, Fr_UpdateLPdu), stamped with the time
+//   of the hand-over. fid, channels and pl are the buffer's configured
+//   header (0 if not cached), cycle is the cycle of the commit and
+//   status is 0. It does not say whether or in which cycle the frame
+//   went out: a buffer committed twice before its slot sends once.
+#define FR_TRACE_SECTOR      512
+#define FR_TRACE_RING        (32 * FR_TRACE_SECTOR)  // bytes, power of 2
+#define FR_TRACE_FLUSH       (8 * FR_TRACE_SECTOR)   // Fr_TracePoll writes from this fill on
+#define FR_TRACE_ANY_TIME    0xFFFFFFFFUL            // Fr_TracePoll budget without a limit
+#define FR_TRACE_SYNC        (64 * FR_TRACE_SECTOR)  // Fr_TracePoll f_syncs the file after this many bytes
+#define FR_TRACE_MAGIC       0x52544652              // "FRTR" in a little-endian file
+#define FR_TRACE_VERSION     1
+
+// fr_trace_record.flags
+#define FR_TRACE_CH_A        0x01
+#define FR_TRACE_CH_B        0x02
+#define FR_TRACE_COMMIT      0x80                    // payload committed to a TX buffer, not a sent frame
+
+typedef struct fr_trace_file
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned int macro_per_cycle;   // GTUC2.MPC
+		unsigned int macrotick_ns;
+	} fr_trace_file;
+
+typedef struct fr_trace_record
+	{
+		unsigned int time[2];       // global time, macroticks: low, high word
+		unsigned short fid;
+		unsigned char cycle;
+		unsigned char flags;        // FR_TRACE_CH_A, FR_TRACE_CH_B, FR_TRACE_COMMIT
+		unsigned short status;      // MBS bits 15:0 (slot status) of RX frames
+		unsigned char pl;           // payload length, 2-byte words
+		unsigned char words;        // payload words of 4 bytes that follow
+	} fr_trace_record;
+
+typedef struct fr_trace
+	{
+		unsigned int ring[FR_TRACE_RING / 4];
+		volatile unsigned long head;    // bytes put, advanced by Fr_TraceFrame only
+		volatile unsigned long tail;    // bytes written out, advanced by Fr_TracePoll only
+		void *file;                     // FatFs FIL of Fr_TraceOpen
+		fr_clock clock;                 // times the writes, may be 0
+		int error;                      // first FatFs error, writing stops
+		unsigned long records;
+		unsigned long dropped;          // records that found the ring full
+		unsigned long max_fill;         // ring high-water mark, bytes
+		unsigned long bytes;            // bytes written to the file
+		unsigned long writes;           // f_write calls
+		unsigned long write_time;       // clock ticks spent in f_write
+		unsigned long sector_time;      // longest f_write per sector, clock ticks
+		unsigned long synced;           // bytes the FAT and directory entry cover (f_sync)
+	} fr_trace;
+
+// Per-controller driver context - Fr_CtxInit, Fr_CtxLoadImage
+// All state of one E-Ray; nothing is shared between contexts, so each
+// controller (or simulated node) can be driven from its own thread
+typedef struct fr_ctx
+	{
+		FRAY_ST *regs;                  // FRAY1 on the TMS570
+		const fr_startup_image *image;  // buffer map and register image of the node
+		cfg config;                     // Fr_Init image, unpacked from image
+		mram_layout layout;
+		const fifo_cfg *fifo;           // set up by configure_initialize_node_x, 0 for none
+		int fifo_first;                 // MRC.FFB once configured
+		int fifo_depth;
+		wrhs lpdu;                      // header work area for Fr_PrepareLPdu
+		bc write_buffer;                // input buffer transfers
+		bc read_buffer;                 // output buffer transfers
+		txq tx_queue;
+		fr_events events;
+		fr_reconfig reconfig;
+		fr_txtrack tx_track;
+		fr_hdrcache hdr_cache;
+		fr_jit jit;
+		fr_dual dual;
+		fr_time time;
+		fr_rxstamp rx_stamp;            // readout time of the frame passed to a buffer_callback
+		fr_trace *trace;                // frames recorded when set - Fr_TraceOpen
+		fr_poc poc;                     // POC commands in flight - Fr_PocCommand
+		fr_recovery recovery;           // Fr_Recover
+		fr_stats stats;
+	} fr_ctx;
+
 //**********************************************************
 // Functions
 int header_crc_calc(wrhs *Fr_LPduPtr);
+void header_crc_calc_batch(wrhs *Fr_LPduPtr, int count);
 void Fr_Init(FRAY_ST *Fray_PST, cfg *Fr_ConfigPtr);
 int Fr_ControllerInit(FRAY_ST *Fray_PST);
 void Fr_PrepareLPdu(FRAY_ST *Fray_PST, wrhs *Fr_LPduPtr);
@@ -1370,8 +1948,63 @@ int Fr_AllowColdStart(FRAY_ST *Fray_PST);
 int Fr_StartCommunication(FRAY_ST *Fray_PST);
 void Fr_TransmitTxLPdu(FRAY_ST *Fray_PST, bc *Fr_LSduPtr);
 void Fr_ReceiveRxLPdu(FRAY_ST *Fray_PST, bc *Fr_LSduPtr);
-void configure_initialize_node_a(FRAY_ST *Fray_PST);
-void configure_initialize_node_b(FRAY_ST *Fray_PST);
-int transmit_check_node_a(FRAY_ST *Fray_PST);
-int transmit_check_node_b(FRAY_ST *Fray_PST);
-
+int Fr_ReceiveRxBatch(FRAY_ST *Fray_PST, bc *Fr_LSduPtr, rx_callback *Fr_RxCallbacks);
+void Fr_LoadBufferImages(FRAY_ST *Fray_PST, const mbuf_image *Fr_ImagePtr, int count);
+int Fr_CycleCode(int repetition, int base);
+int Fr_PackSlots(mux_frame *Fr_FramePtr, int count, slot_use *Fr_SlotPtr, int nslots);
+int Fr_SlotUtilisation(const slot_use *Fr_SlotPtr, int nslots);
+int Fr_FastStartup(FRAY_ST *Fray_PST, const fr_startup_image *Fr_ImagePtr, fr_clock Fr_Clock,
+                   unsigned long timeout, fr_startup_log *Fr_LogPtr);
+void Fr_TxQueueInit(txq *Fr_TxQueuePtr);
+int Fr_TxQueueSubmit(FRAY_ST *Fray_PST, txq *Fr_TxQueuePtr, bc *Fr_LSduPtr, const unsigned long *data, int words);
+int Fr_TxQueuePoll(FRAY_ST *Fray_PST, txq *Fr_TxQueuePtr);
+void Fr_TxQueueFlush(FRAY_ST *Fray_PST, txq *Fr_TxQueuePtr);
+void Fr_CtxInit(fr_ctx *Fr_CtxPtr, FRAY_ST *Fray_PST);
+void Fr_CtxLoadImage(fr_ctx *Fr_CtxPtr, const fr_startup_image *Fr_ImagePtr);
+int Fr_ConfigureFifo(fr_ctx *Fr_CtxPtr, const fifo_cfg *Fr_FifoPtr);
+int Fr_FifoDrain(fr_ctx *Fr_CtxPtr, fifo_entry *Fr_EntryPtr, int max);
+int Fr_ReconfigInit(fr_ctx *Fr_CtxPtr, const mbuf_image *Fr_ImagePtr, int count);
+int Fr_ReconfigRun(fr_ctx *Fr_CtxPtr);
+void Fr_JitInit(fr_ctx *Fr_CtxPtr);
+int Fr_JitAdd(fr_ctx *Fr_CtxPtr, int buffer, jit_producer Fr_Producer, int lead);
+int Fr_TaskAdd(fr_ctx *Fr_CtxPtr, task_callback Fr_Task, int cyc, int offset, int budget);
+int Fr_JitRun(fr_ctx *Fr_CtxPtr);
+int Fr_JitSlack(fr_ctx *Fr_CtxPtr);
+int Fr_TxTrackInit(fr_ctx *Fr_CtxPtr, const int *Fr_BufferPtr, int count);
+void Fr_TxTrackReset(fr_ctx *Fr_CtxPtr);
+void Fr_TxWrite(fr_ctx *Fr_CtxPtr, int buffer, int word, unsigned long value);
+int Fr_TxCommit(fr_ctx *Fr_CtxPtr, int buffer);
+int Fr_UpdateLPdu(fr_ctx *Fr_CtxPtr, wrhs *Fr_LPduPtr, bc *Fr_LSduPtr);
+unsigned long long Fr_TimeNow(fr_ctx *Fr_CtxPtr);
+unsigned long long Fr_TimeStamp(fr_ctx *Fr_CtxPtr, fr_rxstamp *Fr_StampPtr);
+int Fr_TraceFrame(fr_trace *Fr_TracePtr, const fr_trace_record *Fr_RecordPtr, const volatile unsigned long *data);
+void Fr_TraceRx(fr_ctx *Fr_CtxPtr);
+int Fr_TraceOpen(fr_ctx *Fr_CtxPtr, fr_trace *Fr_TracePtr, void *Fr_FilePtr, const char *path, fr_clock Fr_Clock);
+int Fr_TracePoll(fr_trace *Fr_TracePtr, unsigned long budget);
+int Fr_TraceClose(fr_ctx *Fr_CtxPtr, fr_trace *Fr_TracePtr);
+void Fr_PocInit(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock);
+int Fr_PocCommand(fr_ctx *Fr_CtxPtr, unsigned long succ1, int target, unsigned long timeout);
+int Fr_PocPoll(fr_ctx *Fr_CtxPtr);
+int Fr_PocStatus(fr_ctx *Fr_CtxPtr, int handle);
+int Fr_PocAwait(fr_ctx *Fr_CtxPtr, int handle);
+unsigned long Fr_PocTime(fr_ctx *Fr_CtxPtr, int handle);
+int Fr_Recover(fr_ctx *Fr_CtxPtr, unsigned long timeout);
+int Fr_RecoverPoll(fr_ctx *Fr_CtxPtr);
+void Fr_EventInit(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock, idle_hook Fr_Idle);
+int Fr_OnCycle(fr_ctx *Fr_CtxPtr, cycle_callback Fr_Callback, int cyc);
+void Fr_OnBuffer(fr_ctx *Fr_CtxPtr, int buffer, buffer_callback Fr_Callback);
+int Fr_DualAdd(fr_ctx *Fr_CtxPtr, int buffer_a, int buffer_b, dual_callback Fr_Callback);
+void Fr_EventIsr(fr_ctx *Fr_CtxPtr);
+int Fr_EventDispatch(fr_ctx *Fr_CtxPtr, int max);
+void Fr_EventWait(fr_ctx *Fr_CtxPtr);
+int configure_initialize_node_a(fr_ctx *Fr_CtxPtr);
+int configure_initialize_node_b(fr_ctx *Fr_CtxPtr);
+int fast_startup_node_a(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock, unsigned long timeout, fr_startup_log *Fr_LogPtr);
+int fast_startup_node_b(fr_ctx *Fr_CtxPtr, fr_clock Fr_Clock, unsigned long timeout, fr_startup_log *Fr_LogPtr);
+int transmit_check_node_a(fr_ctx *Fr_CtxPtr);
+int transmit_check_node_b(fr_ctx *Fr_CtxPtr);
+int events_node_a(fr_ctx *Fr_CtxPtr);
+int jit_node_a(fr_ctx *Fr_CtxPtr, int lead);
+int events_node_b(fr_ctx *Fr_CtxPtr);
+
+#endif
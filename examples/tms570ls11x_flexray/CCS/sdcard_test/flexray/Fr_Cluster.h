@@ -0,0 +1,128 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Cluster schedule of the two node FlexRay example
+ *
+ *    Shared by node A and node B. The segment lengths are those of the
+ *    original hand written configuration; Fr_Schedule.h derives the
+ *    rest (gMacroPerCycle, gdSymbolWindow, pdListenTimeout, ...) and
+ *    checks the segments against the frame lengths at build time.
+ *
+ *******************************************************************/
+
+#ifndef FR_CLUSTER_H
+#define FR_CLUSTER_H
+
+// Timing base
+#define FR_BIT_NS                  100     // 10 Mbit/s
+#define FR_MICROTICK_NS            25      // pdMicrotick
+#define FR_MICRO_PER_MACRO         40      // 1 us macrotick
+#define FR_CYCLE_US                5600    // gdCycle
+#define FR_CLOCK_DEVIATION_PPM     1500    // cClockDeviationMax
+#define FR_PROPAGATION_DELAY_NS    2500    // gdMaxPropagationDelay
+
+// Static segment
+#define FR_STATIC_SLOTS            8       // gNumberOfStaticSlots
+#define FR_STATIC_SLOT             86      // gdStaticSlot
+#define FR_PAYLOAD_STATIC          9       // gPayloadLengthStatic, 18 bytes
+#define FR_ACTION_POINT            4       // gdActionPointOffset
+#define FR_SYNC_NODE_MAX           15      // gSyncNodeMax
+
+// Dynamic segment; the symbol window takes what is left before the NIT
+#define FR_MINISLOTS               346     // gNumberOfMinislots
+#define FR_MINISLOT                4       // gdMinislot
+#define FR_MINISLOT_ACTION_POINT   2       // gdMinislotActionPointOffset
+#define FR_DYNAMIC_SLOT_IDLE       1       // gdDynamicSlotIdlePhase
+#define FR_LATEST_TRANSMIT         269     // pLatestTx
+#define FR_PAYLOAD_DYNAMIC_MAX     127     // longest dynamic frame, 254 bytes
+#define FR_NIT                     2812    // gdNIT
+
+// Clock synchronisation
+#define FR_MACRO_INITIAL_OFFSET_A  6       // gMacroInitialOffset, channel A
+#define FR_MACRO_INITIAL_OFFSET_B  0       // channel B, 0 as in the original configuration
+#define FR_MICRO_INITIAL_OFFSET    24      // pMicroInitialOffset
+#define FR_DECODING_CORRECTION     51      // pDecodingCorrection
+#define FR_CLUSTER_DRIFT_DAMPING   1       // pClusterDriftDamping
+#define FR_DELAY_COMPENSATION      3       // pDelayCompensation
+#define FR_MAX_DRIFT               337     // pdMaxDrift
+#define FR_ACCEPTED_STARTUP_RANGE  129     // pdAcceptedStartupRange
+#define FR_OFFSET_CORRECTION_OUT   205     // pOffsetCorrectionOut
+#define FR_MAX_WITHOUT_CLOCK_CORRECTION_FATAL    15
+#define FR_MAX_WITHOUT_CLOCK_CORRECTION_PASSIVE  15
+
+// Startup and wakeup
+#define FR_LISTEN_NOISE            15      // gListenNoise
+#define FR_TSS_TRANSMITTER         10      // gdTSSTransmitter
+#define FR_CAS_RX_LOW_MAX          0       // gdCASRxLowMax
+#define FR_WAKEUP_PATTERN          2       // pWakeupPattern
+#define FR_WAKEUP_RX_WINDOW        76      // gdWakeupSymbolRxWindow
+#define FR_WAKEUP_TX_LOW           60      // gdWakeupSymbolTxLow
+#define FR_WAKEUP_TX_IDLE          180     // gdWakeupSymbolTxIdle
+#define FR_WAKEUP_RX_LOW           18      // gdWakeupSymbolRxLow
+#define FR_WAKEUP_RX_IDLE          18      // gdWakeupSymbolRxIdle
+
+#include "Fr_Schedule.h"
+
+// The register image must stay the one every node of the cluster was
+// configured with by hand; a retune changes these on purpose
+#define FR_CLUSTER_CHECKS \
+	FR_SCHEDULE_ASSERT(fr_check_prtc1, FR_PRTC1 == 0x084C000A); \
+	FR_SCHEDULE_ASSERT(fr_check_prtc2, FR_PRTC2 == 0x3CB41212); \
+	FR_SCHEDULE_ASSERT(fr_check_mhdc,  FR_MHDC  == 0x010D0009); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu1,  FR_GTU1  == 0x00036B00); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu2,  FR_GTU2  == 0x000F15E0); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu3,  FR_GTU3  == 0x00061818); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu4,  FR_GTU4  == 0x0AE40AE3); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu5,  FR_GTU5  == 0x33010303); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu6,  FR_GTU6  == 0x01510081); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu7,  FR_GTU7  == 0x00080056); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu8,  FR_GTU8  == 0x015A0004); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu9,  FR_GTU9  == 0x00010204); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu10, FR_GTU10 == 0x015100CD); \
+	FR_SCHEDULE_ASSERT(fr_check_gtu11, FR_GTU11 == 0x00000000); \
+	FR_SCHEDULE_ASSERT(fr_check_succ2, FR_SUCC2 == 0x0F036DA2); \
+	FR_SCHEDULE_ASSERT(fr_check_succ3, FR_SUCC3 == 0x000000FF); \
+	FR_SCHEDULE_ASSERT(fr_check_mrc,   FR_NODE_MRC == 0x00174004)
+
+// Message RAM configuration of both nodes: buffers 0..3 static, 4..23 dynamic, no FIFO
+#define FR_LAST_BUFFER             23
+#define FR_NODE_MRC                FR_MRC(FR_LAST_BUFFER, 64, 4)
+
+// Node A sends slot 1 (sync) and dynamic frame 9, receives slot 2 (channel A
+// into #2, channel B into #3, merged by Fr_DualAdd) and frame 10; buffers #11
+// and #12 carry the multiplexed frames of FR_NODE_A_RECONFIG
+//      buffer fid  dir    channels  cyc                  pl                       sync
+#define FR_NODE_A_BUFFERS(X) \
+	X(0,     1,   FR_TX, FR_CH_AB, 0,                   FR_PAYLOAD_STATIC,      1) \
+	X(2,     2,   FR_RX, FR_CH_A,  0,                   FR_PAYLOAD_STATIC,      0) \
+	X(3,     2,   FR_RX, FR_CH_B,  0,                   FR_PAYLOAD_STATIC,      0) \
+	X(9,     9,   FR_TX, FR_CH_A,  0,                   FR_PAYLOAD_DYNAMIC_MAX, 0) \
+	X(10,    10,  FR_RX, FR_CH_A,  0,                   FR_PAYLOAD_DYNAMIC_MAX, 0) \
+	X(11,    20,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(4, 0), 16,                     0) \
+	X(12,    24,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 0), 16,                     0)
+
+// Frames 20..23 (every 4th cycle) share buffer #11, frames 24..31 (every 8th
+// cycle) buffer #12; Fr_ReconfigRun swaps the headers in the NIT. Payloads
+// must fit the data section of the buffer's entry in FR_NODE_A_BUFFERS.
+//      buffer fid  dir    channels  cyc                  pl  sync
+#define FR_NODE_A_RECONFIG(X) \
+	X(11,    20,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(4, 0), 16, 0) \
+	X(11,    21,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(4, 1), 16, 0) \
+	X(11,    22,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(4, 2), 16, 0) \
+	X(11,    23,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(4, 3), 16, 0) \
+	X(12,    24,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 0), 16, 0) \
+	X(12,    25,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 1), 16, 0) \
+	X(12,    26,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 2), 16, 0) \
+	X(12,    27,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 3), 16, 0) \
+	X(12,    28,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 4), 16, 0) \
+	X(12,    29,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 5), 16, 0) \
+	X(12,    30,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 6), 16, 0) \
+	X(12,    31,  FR_TX, FR_CH_A,  FR_CYCLE_CODE(8, 7), 16, 0)
+
+// Node B is the mirror image
+#define FR_NODE_B_BUFFERS(X) \
+	X(0,     2,   FR_TX, FR_CH_AB, 0,  FR_PAYLOAD_STATIC,      1) \
+	X(1,     1,   FR_RX, FR_CH_AB, 0,  FR_PAYLOAD_STATIC,      0) \
+	X(9,     9,   FR_RX, FR_CH_A,  0,  FR_PAYLOAD_DYNAMIC_MAX, 0) \
+	X(10,    10,  FR_TX, FR_CH_A,  0,  FR_PAYLOAD_DYNAMIC_MAX, 0)
+
+#endif
@@ -0,0 +1,193 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: FlexRay signal codec generator
+ *
+ *    Turns a frame's signal list (Fr_Signals.h) into a struct of
+ *    physical values and straight-line pack/unpack functions on the
+ *    WRDS/RDDS layout. Every signal position is a constant, so each
+ *    signal compiles to a few shifts and masks on the words it covers;
+ *    the payload words are written or read once per frame.
+ *
+ *******************************************************************/
+
+#ifndef FR_CODEC_H
+#define FR_CODEC_H
+
+#if defined(__TI_COMPILER_VERSION__)
+#define FR_INLINE static __inline
+#else
+#define FR_INLINE static inline
+#endif
+
+// Payload bit n is bit n % 32 of word n / 32, i.e. byte 0 in bits 7:0 of
+// WRDS[0]. A signal list is an X-macro of
+//     X(name, start, length, order, sign, factor, offset)
+// Intel signals give the least significant bit as start, Motorola signals
+// the most significant bit in the same numbering (DBC convention).
+// physical = raw * factor + offset, length 1..32 bits; float keeps 24 bits
+// of a raw value exactly.
+
+#define FR_INTEL      0
+#define FR_MOTOROLA   1
+#define FR_UNSIGNED   0
+#define FR_SIGNED     1
+
+// position in the big-endian bit stream (byte 0 bit 7 first) of a Motorola bit
+#define FR_SIG_LINEAR(start)       (((start) / 8) * 8 + 7 - (start) % 8)
+// first bit after the signal, checked against the payload length
+#define FR_SIG_END(start, length, order) \
+	((order) == FR_INTEL ? (start) + (length) : FR_SIG_LINEAR(start) + (length))
+
+FR_INLINE unsigned long Fr_SigSwap(unsigned long w)
+{
+	return ((w >> 24) & 0x000000FF) | ((w >> 8) & 0x0000FF00)
+	     | ((w << 8) & 0x00FF0000) | ((w << 24) & 0xFF000000);
+}
+
+FR_INLINE unsigned long Fr_SigMask(int length)
+{
+	return length >= 32 ? 0xFFFFFFFFUL : (1UL << length) - 1;
+}
+
+// raw value of one signal from the payload words
+FR_INLINE unsigned long Fr_SigGet(const unsigned long *w, int start, int length, int order)
+{
+	int i, bits;
+	unsigned long raw;
+
+	if (order == FR_INTEL)
+	{
+		i = start / 32;
+		bits = start % 32;
+		raw = (w[i] & 0xFFFFFFFFUL) >> bits;
+		if (bits + length > 32)
+			raw |= w[i + 1] << (32 - bits);
+	}
+	else
+	{
+		i = FR_SIG_LINEAR(start) / 32;
+		bits = FR_SIG_LINEAR(start) % 32;
+		if (bits + length <= 32)
+			raw = Fr_SigSwap(w[i]) >> (32 - bits - length);
+		else
+			raw = (Fr_SigSwap(w[i]) << (bits + length - 32)) | (Fr_SigSwap(w[i + 1]) >> (64 - bits - length));
+	}
+	return raw & Fr_SigMask(length);
+}
+
+// ors one raw value into zeroed payload words
+FR_INLINE void Fr_SigPut(unsigned long *w, int start, int length, int order, unsigned long raw)
+{
+	int i, bits;
+
+	raw &= Fr_SigMask(length);
+	if (order == FR_INTEL)
+	{
+		i = start / 32;
+		bits = start % 32;
+		w[i] |= (raw << bits) & 0xFFFFFFFFUL;
+		if (bits + length > 32)
+			w[i + 1] |= raw >> (32 - bits);
+	}
+	else
+	{
+		i = FR_SIG_LINEAR(start) / 32;
+		bits = FR_SIG_LINEAR(start) % 32;
+		if (bits + length <= 32)
+			w[i] |= Fr_SigSwap(raw << (32 - bits - length));
+		else
+		{
+			w[i]     |= Fr_SigSwap(raw >> (bits + length - 32));
+			w[i + 1] |= Fr_SigSwap((raw << (64 - bits - length)) & 0xFFFFFFFFUL);
+		}
+	}
+}
+
+FR_INLINE float Fr_SigPhys(unsigned long raw, int length, int sign, float factor, float offset)
+{
+	if (sign == FR_SIGNED && ((raw >> (length - 1)) & 0x1))
+		return (float)(long)(raw | ~Fr_SigMask(length)) * factor + offset;
+	return (float)raw * factor + offset;
+}
+
+// scale = 1 / factor, folded by the compiler. Rounds on the truncated
+// remainder: r + 0.5f would itself round above 2^23.
+FR_INLINE unsigned long Fr_SigRaw(float value, float scale, float offset)
+{
+	float r = (value - offset) * scale;
+	long n = (long)r;
+
+	if (r - (float)n >= 0.5f)
+		n++;
+	else if ((float)n - r >= 0.5f)
+		n--;
+	return (unsigned long)n;
+}
+
+//**********************************************************
+// Per-signal expansions
+
+#define FR_SIGNAL_MEMBER(name, start, length, order, sign, factor, offset) \
+	float name;
+// one member per signal sized by the words up to its last bit, the union of
+// them gives the words a frame's codec touches
+#define FR_SIGNAL_SPAN(name, start, length, order, sign, factor, offset) \
+	char name[(FR_SIG_END(start, length, order) + 31) / 32];
+#define FR_SIGNAL_PACK(name, start, length, order, sign, factor, offset) \
+	Fr_SigPut(w, start, length, order, Fr_SigRaw(s->name, 1.0f / (factor), offset));
+#define FR_SIGNAL_UNPACK(name, start, length, order, sign, factor, offset) \
+	s->name = Fr_SigPhys(Fr_SigGet(w, start, length, order), length, sign, factor, offset);
+// sized by the first bit after the signal, the union gives the frame's last bit
+#define FR_SIGNAL_END(name, start, length, order, sign, factor, offset) \
+	char name[FR_SIG_END(start, length, order)];
+// checks for one signal, chained with && after a leading 1
+#define FR_SIGNAL_VALID(name, start, length, order, sign, factor, offset) \
+	&& (length) >= 1 && (length) <= 32 && (start) >= 0
+
+// Host side description of a signal - fr_decode.h
+typedef struct fr_signal
+	{
+		const char *name;
+		int start;
+		int length;
+		int order;
+		int sign;
+		float factor;
+		float offset;
+	} fr_signal;
+
+#define FR_SIGNAL_ENTRY(name, start, length, order, sign, factor, offset) \
+	{ #name, start, length, order, sign, factor, offset },
+
+//**********************************************************
+// Codec of one frame with pl 2-byte words of payload:
+//     frame                          struct of physical values
+//     frame##_pack(wrds, s)          writes the payload words up to the last
+//                                    signal bit, to WRDS or memory
+//     frame##_unpack(rdds, s)        reads the words the signals cover, from
+//                                    RDDS or memory
+// RDDS holds still until the next output buffer view, so unpack reads it
+// through a plain pointer and each word shared by several signals is loaded
+// once.
+
+#define FR_FRAME_CODEC(frame, SIGNALS, pl) \
+	typedef struct frame { SIGNALS(FR_SIGNAL_MEMBER) } frame; \
+	union frame##_span { SIGNALS(FR_SIGNAL_SPAN) }; \
+	union frame##_end { SIGNALS(FR_SIGNAL_END) }; \
+	typedef char frame##_valid[(1 SIGNALS(FR_SIGNAL_VALID)) ? 1 : -1]; \
+	typedef char frame##_fits[sizeof(union frame##_end) <= (pl) * 16 ? 1 : -1]; \
+	FR_INLINE void frame##_pack(volatile unsigned long *wrds, const frame *s) \
+	{ \
+		unsigned long w[sizeof(union frame##_span)] = { 0 }; \
+		int i; \
+		SIGNALS(FR_SIGNAL_PACK) \
+		for (i = 0; i < (int)sizeof(union frame##_span); i++) \
+			wrds[i] = w[i]; \
+	} \
+	FR_INLINE void frame##_unpack(volatile unsigned long *rdds, frame *s) \
+	{ \
+		const unsigned long *w = (const unsigned long *)rdds; \
+		SIGNALS(FR_SIGNAL_UNPACK) \
+	}
+
+#endif
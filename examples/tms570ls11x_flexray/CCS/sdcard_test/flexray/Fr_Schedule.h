@@ -0,0 +1,153 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: FlexRay schedule compiler
+ *
+ *    Turns the cluster description in Fr_Cluster.h into the cfg
+ *    register image (Fr_Init) and precompiled message buffer header
+ *    images (Fr_LoadBufferImages). Every value is an integer constant
+ *    expression, so derived parameters, header CRCs and data pointers
+ *    are computed and checked by the compiler; nothing is packed at
+ *    runtime.
+ *
+ *******************************************************************/
+
+#ifndef FR_SCHEDULE_H
+#define FR_SCHEDULE_H
+
+#include <stddef.h>
+
+#define FR_DIV_CEIL(a, b)          (((a) + (b) - 1) / (b))
+
+// Build time check, fails with a negative array size
+#define FR_SCHEDULE_ASSERT(name, cond)  typedef char name[(cond) ? 1 : -1]
+
+//**********************************************************
+// Derived cluster parameters
+
+#define FR_MACROTICK_NS            (FR_MICROTICK_NS * FR_MICRO_PER_MACRO)
+#define FR_MACRO_PER_CYCLE         (FR_CYCLE_US * 1000 / FR_MACROTICK_NS)            // gMacroPerCycle
+#define FR_MICRO_PER_CYCLE         (FR_MACRO_PER_CYCLE * FR_MICRO_PER_MACRO)         // pMicroPerCycle
+#define FR_BAUD_PRESCALER          (FR_BIT_NS == 100 ? 0 : FR_BIT_NS == 200 ? 1 : 2) // BRP, 10/5/2.5 Mbit/s
+
+// add the worst case clock deviation to a duration in ns
+#define FR_WITH_DRIFT(ns)          ((ns) + FR_DIV_CEIL((ns) * FR_CLOCK_DEVIATION_PPM, 1000000))
+#define FR_MACROTICK_MIN_NS        (FR_MACROTICK_NS - FR_DIV_CEIL(FR_MACROTICK_NS * FR_CLOCK_DEVIATION_PPM, 1000000))
+
+// frame length in bits for pl 2-byte words: TSS, FSS, 5 header + payload + 3 trailer
+// bytes with BSS, FES and the channel idle delimiter
+#define FR_FRAME_BITS(pl)          (FR_TSS_TRANSMITTER + 1 + 10 * (8 + 2 * (pl)) + 2 + 11)
+#define FR_FRAME_MACROTICKS(bits) \
+	FR_DIV_CEIL(FR_WITH_DRIFT((bits) * FR_BIT_NS) + FR_PROPAGATION_DELAY_NS, FR_MACROTICK_MIN_NS)
+
+// shortest gdStaticSlot that holds a static frame between the action points
+#define FR_STATIC_SLOT_MIN         (2 * FR_ACTION_POINT + FR_FRAME_MACROTICKS(FR_FRAME_BITS(FR_PAYLOAD_STATIC)))
+#define FR_STATIC_SEGMENT          (FR_STATIC_SLOTS * FR_STATIC_SLOT)
+#define FR_DYNAMIC_SEGMENT         (FR_MINISLOTS * FR_MINISLOT)
+#define FR_SYMBOL_WINDOW           (FR_MACRO_PER_CYCLE - FR_STATIC_SEGMENT - FR_DYNAMIC_SEGMENT - FR_NIT)  // gdSymbolWindow
+
+// minislots taken by the longest dynamic frame (with DTS); pLatestTx must
+// leave that many for a frame started in its last minislot
+#define FR_MINISLOTS_PER_DYNAMIC_FRAME \
+	(1 + FR_DIV_CEIL(FR_FRAME_MACROTICKS(FR_FRAME_BITS(FR_PAYLOAD_DYNAMIC_MAX) + 2), FR_MINISLOT) + FR_DYNAMIC_SLOT_IDLE)
+#define FR_LATEST_TRANSMIT_MAX     (FR_MINISLOTS - FR_MINISLOTS_PER_DYNAMIC_FRAME + 1)
+
+#define FR_NIT_START               (FR_MACRO_PER_CYCLE - FR_NIT - 1)                 // gMacroPerCycle - gdNIT - 1
+#define FR_OFFSET_CORRECTION_START (FR_NIT_START + 1)
+#define FR_LISTEN_TIMEOUT          (FR_MICRO_PER_CYCLE + 2 * FR_MAX_DRIFT)           // pdListenTimeout
+#define FR_RATE_CORRECTION_OUT     FR_MAX_DRIFT
+
+//**********************************************************
+// Register images, field positions as in Fr.h
+
+#define FR_PRTC1   ((FR_WAKEUP_PATTERN << 26) | (FR_WAKEUP_RX_WINDOW << 16) | (FR_BAUD_PRESCALER << 14) | \
+                    (FR_CAS_RX_LOW_MAX << 4) | FR_TSS_TRANSMITTER)
+#define FR_PRTC2   ((FR_WAKEUP_TX_LOW << 24) | (FR_WAKEUP_TX_IDLE << 16) | (FR_WAKEUP_RX_LOW << 8) | FR_WAKEUP_RX_IDLE)
+#define FR_MHDC    ((FR_LATEST_TRANSMIT << 16) | FR_PAYLOAD_STATIC)
+#define FR_GTU1    FR_MICRO_PER_CYCLE
+#define FR_GTU2    ((FR_SYNC_NODE_MAX << 16) | FR_MACRO_PER_CYCLE)
+#define FR_GTU3    ((FR_MACRO_INITIAL_OFFSET_B << 24) | (FR_MACRO_INITIAL_OFFSET_A << 16) | \
+                    (FR_MICRO_INITIAL_OFFSET << 8) | FR_MICRO_INITIAL_OFFSET)
+#define FR_GTU4    ((FR_OFFSET_CORRECTION_START << 16) | FR_NIT_START)
+#define FR_GTU5    ((FR_DECODING_CORRECTION << 24) | (FR_CLUSTER_DRIFT_DAMPING << 16) | \
+                    (FR_DELAY_COMPENSATION << 8) | FR_DELAY_COMPENSATION)
+#define FR_GTU6    ((FR_MAX_DRIFT << 16) | FR_ACCEPTED_STARTUP_RANGE)
+#define FR_GTU7    ((FR_STATIC_SLOTS << 16) | FR_STATIC_SLOT)
+#define FR_GTU8    ((FR_MINISLOTS << 16) | FR_MINISLOT)
+#define FR_GTU9    ((FR_DYNAMIC_SLOT_IDLE << 16) | (FR_MINISLOT_ACTION_POINT << 8) | FR_ACTION_POINT)
+#define FR_GTU10   ((FR_RATE_CORRECTION_OUT << 16) | FR_OFFSET_CORRECTION_OUT)
+#define FR_GTU11   0x00000000   // no external clock correction
+#define FR_SUCC2   ((FR_LISTEN_NOISE << 24) | FR_LISTEN_TIMEOUT)
+#define FR_SUCC3   ((FR_MAX_WITHOUT_CLOCK_CORRECTION_FATAL << 4) | FR_MAX_WITHOUT_CLOCK_CORRECTION_PASSIVE)
+#define FR_MRC(last, first_fifo, first_dynamic) (((last) << 16) | ((first_fifo) << 8) | (first_dynamic))
+
+// Initializer for cfg, in member order
+#define FR_CFG_IMAGE(mrc) \
+	{ (mrc), FR_PRTC1, FR_PRTC2, FR_MHDC, FR_GTU1, FR_GTU2, FR_GTU3, FR_GTU4, FR_GTU5, FR_GTU6, \
+	  FR_GTU7, FR_GTU8, FR_GTU9, FR_GTU10, FR_GTU11, FR_SUCC2, FR_SUCC3 }
+
+// Initializer for fr_startup_image (Fr_FastStartup); SUCC1 as in Fr_ControllerInit,
+// cycle start and timer 0 interrupts routed to eray_int1 as in configure_initialize_node_a
+#define FR_STARTUP_IMAGE(mrc, buffers, count) \
+	{ 0x0F1FFB00, (mrc), \
+	  { FR_SUCC2, FR_SUCC3, 0x00000000, FR_PRTC1, FR_PRTC2, FR_MHDC }, \
+	  { FR_GTU1, FR_GTU2, FR_GTU3, FR_GTU4, FR_GTU5, FR_GTU6, FR_GTU7, FR_GTU8, FR_GTU9, FR_GTU10, FR_GTU11 }, \
+	  0x00000104, 0x00000104, 0x00000002, (buffers), (count) }
+
+// Checks on the derived values, used once per translation unit
+#define FR_SCHEDULE_CHECKS \
+	FR_SCHEDULE_ASSERT(fr_check_cycle, FR_MICRO_PER_CYCLE <= 640000 && FR_MACRO_PER_CYCLE <= 16000); \
+	FR_SCHEDULE_ASSERT(fr_check_static, FR_STATIC_SLOTS >= 2 && FR_STATIC_SLOT <= 659); \
+	FR_SCHEDULE_ASSERT(fr_check_static_frame, FR_STATIC_SLOT >= FR_STATIC_SLOT_MIN); \
+	FR_SCHEDULE_ASSERT(fr_check_dynamic, FR_MINISLOTS >= 0 && FR_MINISLOTS <= 7986); \
+	FR_SCHEDULE_ASSERT(fr_check_symbol_window, FR_SYMBOL_WINDOW >= 0); \
+	FR_SCHEDULE_ASSERT(fr_check_latest_tx, FR_MINISLOTS == 0 \
+	                   || (FR_LATEST_TRANSMIT > 0 && FR_LATEST_TRANSMIT <= FR_LATEST_TRANSMIT_MAX)); \
+	FR_SCHEDULE_ASSERT(fr_check_nit, FR_NIT >= 2 && FR_NIT < FR_MACRO_PER_CYCLE)
+
+//**********************************************************
+// Message buffers
+//
+// A node lists its buffers as an X-macro of
+//     X(buffer, fid, dir, channels, cyc, pl, sync)
+// sync = 1 also sets the startup frame indicator.
+
+#define FR_RX      0
+#define FR_TX      1
+#define FR_CH_A    0x1
+#define FR_CH_B    0x2
+#define FR_CH_AB   0x3
+
+// cyc of a frame sent every repetition-th cycle (power of 2 up to 64) from cycle
+// base, as Fr_CycleCode; 0 is every cycle
+#define FR_CYCLE_CODE(repetition, base)  ((repetition) | (base))
+
+// Header CRC, linear in the 20 header bits (sync, sfi, fid, pl) starting from
+// the CRC of the all-zero header; same result as header_crc_calc
+#define FR_CRC_BIT(v, bit, k)      ((((v) >> (bit)) & 0x1) ? (k) : 0)
+#define FR_HEADER_CRC(sync, sfi, fid, pl) (0x76A \
+	^ FR_CRC_BIT(pl,  0, 0x385) ^ FR_CRC_BIT(pl,  1, 0x70A) ^ FR_CRC_BIT(pl,  2, 0x591) \
+	^ FR_CRC_BIT(pl,  3, 0x0A7) ^ FR_CRC_BIT(pl,  4, 0x14E) ^ FR_CRC_BIT(pl,  5, 0x29C) \
+	^ FR_CRC_BIT(pl,  6, 0x538) \
+	^ FR_CRC_BIT(fid, 0, 0x1F5) ^ FR_CRC_BIT(fid, 1, 0x3EA) ^ FR_CRC_BIT(fid, 2, 0x7D4) \
+	^ FR_CRC_BIT(fid, 3, 0x42D) ^ FR_CRC_BIT(fid, 4, 0x3DF) ^ FR_CRC_BIT(fid, 5, 0x7BE) \
+	^ FR_CRC_BIT(fid, 6, 0x4F9) ^ FR_CRC_BIT(fid, 7, 0x277) ^ FR_CRC_BIT(fid, 8, 0x4EE) \
+	^ FR_CRC_BIT(fid, 9, 0x259) ^ FR_CRC_BIT(fid, 10, 0x4B2) \
+	^ FR_CRC_BIT(sfi, 0, 0x2E1) ^ FR_CRC_BIT(sync, 0, 0x5C2))
+
+// One data section per buffer, used to build the node's message RAM layout struct
+#define FR_MRAM_SECTION(buffer, fid, dir, ch, cyc, pl, sync) \
+	char data_##buffer[FR_DATA_WORDS(pl)];
+
+// Checks for one buffer, chained with && after a leading 1
+#define FR_MBUF_VALID(buffer, fid, dir, ch, cyc, pl, sync) \
+	&& (buffer) <= FR_LAST_BUFFER && (fid) >= 1 && (fid) <= 2047 && (pl) >= 1 && (pl) <= 127 \
+	&& ((fid) > FR_STATIC_SLOTS || (pl) == FR_PAYLOAD_STATIC) && ((fid) <= FR_STATIC_SLOTS || !(sync))
+
+// Header image for one buffer; data follows the header sections of buffers 0..last
+#define FR_MBUF_IMAGE(layout, last, buffer, fid, dir, ch, cyc, pl, sync) \
+	{ (buffer), \
+	  (1 << 29) | ((dir) << 26) | (((ch) >> 1) << 25) | (((ch) & 0x1) << 24) | ((cyc) << 16) | (fid), \
+	  ((pl) << 16) | ((dir) == FR_TX ? FR_HEADER_CRC(sync, sync, fid, pl) : 0), \
+	  ((last) + 1) * FR_HEADER_WORDS + offsetof(struct layout, data_##buffer) }
+
+#endif
@@ -0,0 +1,41 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Signal database of the two node FlexRay example
+ *
+ *    Signals of node A's slot 1 frame and dynamic frame 9, as used
+ *    by the host trace decoder. Fr_Codec.h turns each list into a
+ *    struct of physical values and pack/unpack functions.
+ *
+ *******************************************************************/
+
+#ifndef FR_SIGNALS_H
+#define FR_SIGNALS_H
+
+#include "Fr_Cluster.h"
+#include "Fr_Codec.h"
+
+// Slot 1, node A status, 18 bytes
+//      name          start len order        sign         factor   offset
+#define FR_SLOT1_SIGNALS(X) \
+	X(alive,        0,    4,  FR_INTEL,    FR_UNSIGNED, 1.0f,    0.0f) \
+	X(mode,         4,    4,  FR_INTEL,    FR_UNSIGNED, 1.0f,    0.0f) \
+	X(speed,        8,    16, FR_INTEL,    FR_UNSIGNED, 0.01f,   0.0f) \
+	X(torque,       24,   12, FR_INTEL,    FR_SIGNED,   0.5f,    0.0f) \
+	X(temperature,  39,   10, FR_MOTOROLA, FR_UNSIGNED, 0.5f,    -40.0f) \
+	X(voltage,      45,   14, FR_MOTOROLA, FR_UNSIGNED, 0.001f,  0.0f) \
+	X(current,      63,   20, FR_MOTOROLA, FR_SIGNED,   0.01f,   0.0f) \
+	X(status,       80,   24, FR_INTEL,    FR_UNSIGNED, 1.0f,    0.0f) \
+	X(distance,     112,  20, FR_INTEL,    FR_UNSIGNED, 0.5f,    0.0f)
+
+// Frame 9, node A diagnostics, 254 bytes
+//      name          start len order        sign         factor   offset
+#define FR_FRAME9_SIGNALS(X) \
+	X(sequence,     0,    16, FR_INTEL,    FR_UNSIGNED, 1.0f,    0.0f) \
+	X(pressure,     1000, 12, FR_INTEL,    FR_UNSIGNED, 0.25f,   0.0f) \
+	X(angle,        2007, 16, FR_MOTOROLA, FR_SIGNED,   0.01f,   0.0f) \
+	X(checksum,     2016, 16, FR_INTEL,    FR_UNSIGNED, 1.0f,    0.0f)
+
+FR_FRAME_CODEC(fr_slot1, FR_SLOT1_SIGNALS, FR_PAYLOAD_STATIC)
+FR_FRAME_CODEC(fr_frame9, FR_FRAME9_SIGNALS, FR_PAYLOAD_DYNAMIC_MAX)
+
+#endif
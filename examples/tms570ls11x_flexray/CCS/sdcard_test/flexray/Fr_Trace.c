@@ -0,0 +1,156 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: FlexRay bus trace to a FatFs file
+ *
+ *    Fr_TraceFrame (Fr.c) fills the RAM ring of a fr_trace from the
+ *    cycle work; the functions here run in the background loop and
+ *    write the ring out in whole sectors. The file position stays a
+ *    multiple of FR_TRACE_SECTOR, so f_write passes each chunk to
+ *    disk_write straight from the ring as one multi-block write.
+ *
+ *******************************************************************/
+
+#include "ff.h"
+#include "Fr.h"
+#include "Fr_Cluster.h"
+
+// writes count bytes from the tail, no further than the end of the ring
+static int Fr_TraceWrite(fr_trace *Fr_TracePtr, unsigned long count)
+{
+	unsigned long offset = Fr_TracePtr->tail & (FR_TRACE_RING - 1);
+	unsigned long start = 0;
+	UINT written = 0;
+	FRESULT res;
+
+	if (offset + count > FR_TRACE_RING) count = FR_TRACE_RING - offset;
+	if (Fr_TracePtr->clock != 0) start = Fr_TracePtr->clock();
+	res = f_write((FIL *)Fr_TracePtr->file, (const BYTE *)Fr_TracePtr->ring + offset, (UINT)count, &written);
+	if (Fr_TracePtr->clock != 0)
+	{
+		start = Fr_TracePtr->clock() - start;
+		Fr_TracePtr->write_time += start;
+		start /= (count + FR_TRACE_SECTOR - 1) / FR_TRACE_SECTOR;
+		if (start > Fr_TracePtr->sector_time) Fr_TracePtr->sector_time = start;
+	}
+	Fr_TracePtr->writes++;
+	Fr_TracePtr->bytes += written;
+	Fr_TracePtr->tail += written;
+	if (res != FR_OK || written != count)
+	{
+		Fr_TracePtr->error = res != FR_OK ? (int)res : (int)FR_DENIED;   // volume full
+		return -1;
+	}
+	return 0;
+}
+
+
+/***********************************************************************
+	Fr_TraceOpen
+	Creates the trace file path with Fr_FilePtr (a FIL on a mounted
+	volume), puts the fr_trace_file header in the ring and starts
+	recording the frames of Fr_CtxPtr. Fr_Clock times the writes and
+	may be 0. Returns 0 on success, the FRESULT of f_open otherwise.
+***********************************************************************/
+
+int Fr_TraceOpen(fr_ctx *Fr_CtxPtr, fr_trace *Fr_TracePtr, void *Fr_FilePtr, const char *path, fr_clock Fr_Clock)
+{
+	union { fr_trace_file f; unsigned int w[4]; } header;
+	FRESULT res;
+	int i;
+
+	res = f_open((FIL *)Fr_FilePtr, path, FA_WRITE | FA_CREATE_ALWAYS);
+	if (res != FR_OK) return (int)res;
+
+	Fr_TracePtr->head = 0;
+	Fr_TracePtr->tail = 0;
+	Fr_TracePtr->file = Fr_FilePtr;
+	Fr_TracePtr->clock = Fr_Clock;
+	Fr_TracePtr->error = 0;
+	Fr_TracePtr->records = 0;
+	Fr_TracePtr->dropped = 0;
+	Fr_TracePtr->max_fill = 0;
+	Fr_TracePtr->bytes = 0;
+	Fr_TracePtr->writes = 0;
+	Fr_TracePtr->write_time = 0;
+	Fr_TracePtr->sector_time = 0;
+	Fr_TracePtr->synced = 0;
+
+	header.f.magic = FR_TRACE_MAGIC;
+	header.f.version = FR_TRACE_VERSION;
+	header.f.macro_per_cycle = (unsigned int)Fr_CtxPtr->time.macro_per_cycle;
+	header.f.macrotick_ns = 0;
+	if (Fr_CtxPtr->time.macro_per_cycle != 0)   // GTUC1: microticks per cycle
+		header.f.macrotick_ns = (unsigned int)((Fr_CtxPtr->regs->GTUC1_UN.GTUC1_UL & 0xFFFFF) * FR_MICROTICK_NS
+		                                       / Fr_CtxPtr->time.macro_per_cycle);
+	for (i = 0; i < 4; i++)
+		Fr_TracePtr->ring[i] = header.w[i];
+	Fr_TracePtr->head = sizeof(fr_trace_file);
+
+	Fr_CtxPtr->trace = Fr_TracePtr;
+	return 0;
+}
+
+
+/***********************************************************************
+	Fr_TracePoll
+	Background loop part: once FR_TRACE_FLUSH bytes are waiting, writes
+	the whole sectors of them to the file, up to the end of the ring per
+	call, and only as many as the longest write per sector so far says
+	fit in budget clock ticks (one while that is not known yet, all of
+	them without a clock or with FR_TRACE_ANY_TIME). Every FR_TRACE_SYNC
+	bytes it f_syncs the file when two more sectors fit (FAT and
+	directory entry), so a reset or power cut loses no more than that
+	and the ring. Returns the bytes written, -1 after a file error
+	(recording goes on into the ring and is counted in dropped once it
+	is full).
+***********************************************************************/
+
+int Fr_TracePoll(fr_trace *Fr_TracePtr, unsigned long budget)
+{
+	unsigned long pending = Fr_TracePtr->head - Fr_TracePtr->tail;
+	unsigned long tail = Fr_TracePtr->tail;
+	unsigned long count = pending & ~(unsigned long)(FR_TRACE_SECTOR - 1);
+	unsigned long sectors = FR_TRACE_ANY_TIME;   // that fit in budget
+	FRESULT res;
+
+	if (Fr_TracePtr->error != 0) return -1;
+	if (Fr_TracePtr->clock != 0 && budget != FR_TRACE_ANY_TIME)
+		sectors = Fr_TracePtr->sector_time != 0 ? budget / Fr_TracePtr->sector_time : 1;
+	if (pending >= FR_TRACE_FLUSH && sectors != 0)
+	{
+		if (sectors < count / FR_TRACE_SECTOR) count = sectors * FR_TRACE_SECTOR;
+		if (Fr_TraceWrite(Fr_TracePtr, count) != 0) return -1;
+		sectors -= (Fr_TracePtr->tail - tail) / FR_TRACE_SECTOR;
+	}
+	if (Fr_TracePtr->bytes - Fr_TracePtr->synced >= FR_TRACE_SYNC && sectors >= 2)
+	{
+		res = f_sync((FIL *)Fr_TracePtr->file);
+		if (res != FR_OK)
+		{
+			Fr_TracePtr->error = (int)res;
+			return -1;
+		}
+		Fr_TracePtr->synced = Fr_TracePtr->bytes;
+	}
+	return (int)(Fr_TracePtr->tail - tail);
+}
+
+
+/***********************************************************************
+	Fr_TraceClose
+	Stops recording, writes what is left in the ring, including a last
+	partial sector, and closes the file. Returns 0 on success, -1 if a
+	write or f_close failed (see error).
+***********************************************************************/
+
+int Fr_TraceClose(fr_ctx *Fr_CtxPtr, fr_trace *Fr_TracePtr)
+{
+	FRESULT res;
+
+	Fr_CtxPtr->trace = 0;
+	while (Fr_TracePtr->error == 0 && Fr_TracePtr->head != Fr_TracePtr->tail)
+		Fr_TraceWrite(Fr_TracePtr, Fr_TracePtr->head - Fr_TracePtr->tail);
+	res = f_close((FIL *)Fr_TracePtr->file);
+	if (res != FR_OK && Fr_TracePtr->error == 0) Fr_TracePtr->error = (int)res;
+	return Fr_TracePtr->error != 0 ? -1 : 0;
+}
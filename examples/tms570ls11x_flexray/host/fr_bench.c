@@ -0,0 +1,1674 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Benchmark of the Fr driver against the FRAY_ST model
+ *
+ *    Reports host throughput (ops/s, dominated by the register trap)
+ *    and simulated microticks spent per API call.
+ *
+ *******************************************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ff.h"
+#include "fr_sim.h"
+#include "fr_disk.h"
+#include "Fr_Cluster.h"
+
+#define BENCH_THREADS 4
+
+static fr_sim *sim;
+static FRAY_ST *regs;
+static fr_ctx node;
+static long iterations = 2000;
+static unsigned long bench_failures;    // checks that did not hold, main returns 1
+
+static double bench_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_report(const char *name, long n, double secs, unsigned long long ut)
+{
+	printf("%-28s %10.0f ops/s %10.1f ut/call\n", name, n / secs, (double)ut / n);
+}
+
+// A check that did not hold: reported under the bench's numbers
+static void bench_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	printf("  FAILED: ");
+	vprintf(fmt, ap);
+	printf("\n");
+	va_end(ap);
+	bench_failures++;
+}
+
+static void bench_wait_pbsy(void)
+{
+	while ((regs->SUCC1_UN.SUCC1_UL & 0x00000080) != 0);
+}
+
+// the peer's static frame as checked by transmit_check_node_a (slot 2 from
+// node B) or transmit_check_node_b (slot 1 from node A)
+static void bench_queue_peer(fr_sim *s, int node_b)
+{
+	fr_sim_frame frame = { 0 };
+
+	frame.fid = node_b ? 1 : 2;
+	frame.cycle = -1;
+	frame.channels = FRSIM_CH_A | FRSIM_CH_B;
+	frame.pl = 9;
+	frame.data[0] = node_b ? 0x00000001 : 0x12345678;
+	frame.data[1] = node_b ? 0x000000FF : 0x87654321;
+	FrSim_QueueRx(s, &frame);
+}
+
+static void bench_queue_node_b(void)
+{
+	bench_queue_peer(sim, 0);
+}
+
+
+static void bench_configure(void)
+{
+	unsigned long long ut = 0, t0;
+	double start;
+	long i;
+
+	start = bench_seconds();
+	for (i = 0; i < iterations / 10 + 1; i++)
+	{
+		FrSim_Reset(sim);
+		t0 = FrSim_Now(sim);
+		configure_initialize_node_a(&node);
+		ut += FrSim_Now(sim) - t0;
+	}
+	bench_report("configure_initialize_node_a", i, bench_seconds() - start, ut);
+}
+
+static void bench_controller_init(void)
+{
+	unsigned long long ut = 0, t0;
+	double start, secs = 0;
+	long i;
+
+	for (i = 0; i < iterations; i++)
+	{
+		FrSim_Reset(sim);
+		bench_wait_pbsy();
+		t0 = FrSim_Now(sim);
+		start = bench_seconds();
+		if (Fr_ControllerInit(regs) != 0)
+		{
+			fprintf(stderr, "Fr_ControllerInit failed\n");
+			exit(1);
+		}
+		secs += bench_seconds() - start;
+		ut += FrSim_Now(sim) - t0;
+	}
+	bench_report("Fr_ControllerInit", i, secs, ut);
+}
+
+static unsigned long bench_clock(void)
+{
+	return (unsigned long)FrSim_Now(sim);
+}
+
+static const char *bench_poc_name(int state)
+{
+	switch (state)
+	{
+	case FRSIM_POC_DEFAULT_CONFIG:     return "DEFAULT_CONFIG";
+	case FRSIM_POC_READY:              return "READY";
+	case FRSIM_POC_NORMAL_ACTIVE:      return "NORMAL_ACTIVE";
+	case FRSIM_POC_NORMAL_PASSIVE:     return "NORMAL_PASSIVE";
+	case FRSIM_POC_HALT:               return "HALT";
+	case FRSIM_POC_CONFIG:             return "CONFIG";
+	case FRSIM_POC_COLDSTART_LISTEN:   return "COLDSTART_LISTEN";
+	case FRSIM_POC_INTEGRATION_LISTEN: return "INTEGRATION_LISTEN";
+	}
+	return "STARTUP";
+}
+
+static void bench_print_log(const char *name, fr_startup_log *log)
+{
+	int i;
+
+	printf("%s\n", name);
+	for (i = 0; i < log->count; i++)
+		printf("  %-26s %10lu ut %10.1f us\n", bench_poc_name(log->state[i]), log->time[i], log->time[i] * 0.025);
+}
+
+// reset -> NORMAL_ACTIVE: configure_initialize_node_a + Fr_StartCommunication
+// against the packed image of Fr_FastStartup
+static void bench_startup(void)
+{
+	fr_startup_log log = { 0 };
+	unsigned long long t0;
+	int state;
+
+	FrSim_Reset(sim);
+	t0 = FrSim_Now(sim);
+	log.state[0] = FrSim_PocState(sim);
+	log.count = 1;
+	configure_initialize_node_a(&node);
+	Fr_StartCommunication(regs);
+	while ((state = regs->CCSV_UN.CCSV_UL & 0x3F) != FRSIM_POC_NORMAL_ACTIVE || log.state[log.count - 1] != state)
+	{
+		if (state == log.state[log.count - 1] || log.count == FR_STARTUP_STEPS) continue;
+		log.state[log.count] = state;
+		log.time[log.count++] = FrSim_Now(sim) - t0;
+	}
+	bench_print_log("startup, configure_initialize_node_a", &log);
+
+	// a deadline shorter than the startup must end it with 2, in clock ticks
+	// and, without a clock, in polls (the simulator skips idle polls, so a
+	// whole startup takes a few dozen)
+	FrSim_Reset(sim);
+	if ((state = fast_startup_node_a(&node, bench_clock, 1000, &log)) != 2)
+	{
+		fprintf(stderr, "fast_startup_node_a did not time out: %d, %d states\n", state, log.count);
+		exit(1);
+	}
+	FrSim_Reset(sim);
+	if ((state = fast_startup_node_a(&node, 0, 10, &log)) != 2)
+	{
+		fprintf(stderr, "fast_startup_node_a did not time out without a clock: %d, %d states\n", state, log.count);
+		exit(1);
+	}
+
+	FrSim_Reset(sim);
+	if (fast_startup_node_a(&node, bench_clock, 64 * 224000, &log) != 0)
+	{
+		fprintf(stderr, "fast_startup_node_a failed\n");
+		exit(1);
+	}
+	bench_print_log("startup, fast_startup_node_a", &log);
+}
+
+static const char *bench_poc_status(int status)
+{
+	static const char *names[] = { "queued", "busy", "done", "rejected", "timeout", "cancelled", "unknown" };
+	return (status >= 0 && status <= FR_POC_UNKNOWN) ? names[status] : "?";
+}
+
+// RUN queued on the POC command engine and polled to NORMAL_ACTIVE once per
+// interrupt, the CPU free in between, with a command queued behind it whose
+// deadline is shorter than the startup (only counts once RUN is done), then a
+// command not accepted in NORMAL_ACTIVE (cancels the one queued behind it),
+// one that never reaches its target state and a handle that has expired
+static void bench_poc(void)
+{
+	int run, behind, config, allow, halt, status;
+	unsigned long polls;
+	int failed = 0;
+
+	FrSim_Reset(sim);
+	Fr_PocInit(&node, bench_clock);
+	if (configure_initialize_node_a(&node) != 0) failed = 1;
+	run = Fr_PocCommand(&node, CMD_RUN, FR_POCS_NORMAL_ACTIVE, 64 * 224000);
+	behind = Fr_PocCommand(&node, CMD_ALLOW_COLDSTART, FR_POC_ANY, 224000);
+	polls = node.poc.polls;
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+	while ((status = Fr_PocStatus(&node, run)) == FR_POC_QUEUED || status == FR_POC_BUSY)
+	{
+		if (Fr_PocPoll(&node) == FR_POCS_NORMAL_ACTIVE) continue;
+		FrSim_WaitForInterrupt(sim);
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	}
+	printf("Fr_PocCommand RUN           %s in %lu polls, %lu ut to NORMAL_ACTIVE\n",
+	       bench_poc_status(status), node.poc.polls - polls, Fr_PocTime(&node, run));
+	if (status != FR_POC_DONE) failed = 1;
+	Fr_PocAwait(&node, behind);
+	printf("  ALLOW_COLDSTART queued behind it %s, deadline 224000 ut\n", bench_poc_status(Fr_PocStatus(&node, behind)));
+	if (Fr_PocStatus(&node, behind) != FR_POC_DONE) failed = 1;
+
+	config = Fr_PocCommand(&node, 0x0F1FFB00 | CMD_CONFIG, FR_POCS_CONFIG, 224000);
+	allow = Fr_PocCommand(&node, CMD_ALLOW_COLDSTART, FR_POC_ANY, 224000);
+	Fr_PocAwait(&node, allow);
+	halt = Fr_PocCommand(&node, CMD_ALLOW_COLDSTART, FR_POCS_HALT, 2 * 224000);
+	Fr_PocAwait(&node, halt);
+	printf("  CONFIG %s, ALLOW_COLDSTART %s, waiting for HALT %s after %lu ut, RUN handle %s\n",
+	       bench_poc_status(Fr_PocStatus(&node, config)), bench_poc_status(Fr_PocStatus(&node, allow)),
+	       bench_poc_status(Fr_PocStatus(&node, halt)), Fr_PocTime(&node, halt),
+	       bench_poc_status(Fr_PocStatus(&node, run)));
+	if (Fr_PocStatus(&node, config) != FR_POC_REJECTED || Fr_PocStatus(&node, allow) != FR_POC_CANCELLED
+	    || Fr_PocStatus(&node, halt) != FR_POC_TIMEOUT || node.poc.state != FR_POCS_NORMAL_ACTIVE
+	    || Fr_PocStatus(&node, run) != FR_POC_UNKNOWN)
+		failed = 1;
+	bench_print_log("POC states seen by Fr_PocPoll", &node.poc.log);
+	if (failed)
+	{
+		fprintf(stderr, "POC command engine failed\n");
+		exit(1);
+	}
+}
+
+// Back to NORMAL_ACTIVE with Fr_RecoverPoll once per interrupt (cycle start
+// in startup), node B's frame checked in the 4 cycles after; returns the
+// register accesses up to startup, the polls after RUN left out
+static unsigned long long bench_resync(int full, int *failed)
+{
+	fr_sim_stats st;
+	unsigned long long accesses, to_run = 0;
+	unsigned long rx = node.stats.rx_frames, errors = node.stats.rx_errors, tx;
+	int i, status;
+
+	FrSim_GetStats(sim, &st);
+	accesses = st.reads + st.writes;
+	if (full)
+	{
+		// today's path: the whole configuration again
+		node.recovery.start = bench_clock();
+		if (configure_initialize_node_a(&node) != 0) *failed = 1;
+		node.recovery.handle = Fr_PocCommand(&node, CMD_RUN, FR_POCS_NORMAL_ACTIVE, 64 * 224000);
+		node.recovery.busy = node.recovery.handle >= 0;
+	}
+	else if (Fr_Recover(&node, 64 * 224000) < 0)
+		*failed = 1;
+	while ((status = Fr_RecoverPoll(&node)) == FR_POC_BUSY)
+		if (node.poc.state & 0x20)
+		{
+			if (to_run == 0)
+			{
+				FrSim_GetStats(sim, &st);
+				to_run = st.reads + st.writes - accesses;
+			}
+			FrSim_WaitForInterrupt(sim);
+			regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+		}
+	if (status != FR_POC_DONE) *failed = 1;
+
+	tx = st.tx_frames;
+	for (i = 0; i < 4; i++)
+	{
+		bench_queue_node_b();
+		transmit_check_node_a(&node);
+	}
+	FrSim_GetStats(sim, &st);
+	if (node.stats.rx_frames - rx < 3 || node.stats.rx_errors != errors || st.tx_frames == tx) *failed = 1;
+	return to_run;
+}
+
+// The node leaves NORMAL_ACTIVE at the next cycle start (NORMAL_PASSIVE,
+// HALT) or is reset and comes back with Fr_Recover, then from HALT with
+// configure_initialize_node_a for comparison
+static void bench_recover(void)
+{
+	static const int faults[] = { FRSIM_POC_NORMAL_PASSIVE, FRSIM_POC_HALT, FRSIM_POC_DEFAULT_CONFIG,
+	                              FRSIM_POC_HALT };
+	static const char *names[] = { "Fr_Recover, NORMAL_PASSIVE", "Fr_Recover, HALT", "Fr_Recover, reset",
+	                               "configure_initialize_node_a" };
+	unsigned long long accesses;
+	unsigned long registers, headers;
+	int i, failed = 0;
+
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+	for (i = 0; i < 4; i++)
+	{
+		if (faults[i] == FRSIM_POC_DEFAULT_CONFIG)
+			FrSim_Reset(sim);
+		else
+		{
+			FrSim_Fault(sim, faults[i]);
+			while (FrSim_PocState(sim) == FRSIM_POC_NORMAL_ACTIVE)
+			{
+				regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+				FrSim_WaitForInterrupt(sim);
+			}
+		}
+		registers = node.recovery.registers;
+		headers = node.recovery.headers;
+		accesses = bench_resync(i == 3, &failed);
+		printf("%-28s %-14s -> NORMAL_ACTIVE in %6.2f ms, RUN after %4lu ut and %3llu register accesses",
+		       names[i], bench_poc_name(faults[i]), node.recovery.last_time * 25e-6,
+		       node.recovery.last_time - Fr_PocTime(&node, node.recovery.handle), accesses);
+		if (i != 3)
+			printf("\n  %s, %lu registers, %lu headers written",
+			       node.recovery.via_config ? "via CONFIG" : "via READY",
+			       node.recovery.registers - registers, node.recovery.headers - headers);
+		printf("\n");
+	}
+	if (failed || node.recovery.resyncs != 4 || node.recovery.failed != 0)
+	{
+		fprintf(stderr, "recovery failed\n");
+		exit(1);
+	}
+}
+
+static void bench_prepare(void)
+{
+	unsigned long long t0 = FrSim_Now(sim);
+	double start = bench_seconds();
+	long i;
+
+	for (i = 0; i < iterations; i++)
+	{
+		node.lpdu.fid = 1 + (i & 7);
+		Fr_PrepareLPdu(regs, &node.lpdu);
+	}
+	bench_report("Fr_PrepareLPdu", i, bench_seconds() - start, FrSim_Now(sim) - t0);
+}
+
+static void bench_transmit(void)
+{
+	bc write_buffer = { 0 };
+	unsigned long long t0;
+	double start;
+	long i;
+
+	write_buffer.ibrh = 9;
+	write_buffer.ldsh = 1;
+	write_buffer.stxrh = 1;
+	write_buffer.ibsyh = 1;
+	write_buffer.ibsys = 1;
+
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	for (i = 0; i < iterations; i++)
+		Fr_TransmitTxLPdu(regs, &write_buffer);
+	bench_report("Fr_TransmitTxLPdu", i, bench_seconds() - start, FrSim_Now(sim) - t0);
+}
+
+static void bench_receive(void)
+{
+	bc read_buffer = { 0 };
+	unsigned long long t0;
+	double start;
+	long i;
+
+	read_buffer.obrs = 2;
+	read_buffer.rdss = 1;
+
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	for (i = 0; i < iterations; i++)
+		Fr_ReceiveRxLPdu(regs, &read_buffer);
+	bench_report("Fr_ReceiveRxLPdu", i, bench_seconds() - start, FrSim_Now(sim) - t0);
+}
+
+// eight data updates alternating between TX buffers #0 (18 bytes) and #9 (254 bytes)
+#define BENCH_UPDATES 8
+
+static void bench_tx_updates(void)
+{
+	static const int ibrh[2] = { 0, 9 };
+	static const int words[2] = { 5, 64 };
+	unsigned long data[64];
+	bc write_buffer = { 0 };
+	txq queue;
+	unsigned long long t0, busy = 0, flush = 0;
+	double start;
+	long i, n = iterations / 10 + 1;
+	int j, k;
+
+	for (k = 0; k < 64; k++)
+		data[k] = 0x01010101UL * k;
+	write_buffer.stxrh = 1;
+	write_buffer.ldsh = 1;
+	write_buffer.ibsyh = 1;
+	write_buffer.ibsys = 1;
+
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	for (i = 0; i < n; i++)
+		for (j = 0; j < BENCH_UPDATES; j++)
+		{
+			write_buffer.ibrh = ibrh[j & 1];
+			for (k = 0; k < words[j & 1]; k++)
+				regs->WRDS[k] = data[k];
+			Fr_TransmitTxLPdu(regs, &write_buffer);
+		}
+	bench_report("8x Fr_TransmitTxLPdu", i, bench_seconds() - start, FrSim_Now(sim) - t0);
+
+	Fr_TxQueueInit(&queue);
+	start = bench_seconds();
+	for (i = 0; i < n; i++)
+	{
+		t0 = FrSim_Now(sim);
+		for (j = 0; j < BENCH_UPDATES; j++)
+		{
+			write_buffer.ibrh = ibrh[j & 1];
+			Fr_TxQueueSubmit(regs, &queue, &write_buffer, data, words[j & 1]);
+		}
+		busy += FrSim_Now(sim) - t0;
+		t0 = FrSim_Now(sim);
+		Fr_TxQueueFlush(regs, &queue);
+		flush += FrSim_Now(sim) - t0;
+	}
+	bench_report("8x Fr_TxQueueSubmit", i, bench_seconds() - start, busy);
+	printf("  + Fr_TxQueueFlush %.1f ut/call, %d direct, %d queued, %d rejected\n",
+	       (double)flush / n, queue.direct, queue.queued, queue.full);
+}
+
+// RX buffers #11..#23 for dynamic frames 11..23, plus node A's buffer #2
+#define BENCH_RX_FIRST 11
+#define BENCH_RX_LAST  23
+
+static unsigned long bench_rx_sum;
+
+static void bench_rx_callback(int buffer, volatile unsigned long *rdds)
+{
+	int i;
+
+	for (i = 0; i < 5; i++)
+		bench_rx_sum += rdds[i];
+}
+
+static void bench_rx_setup(void)
+{
+	wrhs rx = { 0 };
+	bc load = { 0 };
+	int b;
+
+	rx.cha = 1;
+	rx.chb = 1;
+	rx.pl = 9;
+	load.lhsh = 1;
+	load.ibsyh = 1;
+	load.ibsys = 1;
+	for (b = BENCH_RX_FIRST; b <= BENCH_RX_LAST; b++)
+	{
+		rx.fid = b;
+		// free message RAM behind node A's data sections
+		rx.dp = node.layout.header_words + node.layout.data_words + FR_DATA_WORDS(9) * (b - BENCH_RX_FIRST);
+		load.ibrh = b;
+		Fr_PrepareLPdu(regs, &rx);
+		Fr_TransmitTxLPdu(regs, &load);
+	}
+}
+
+static void bench_rx_cycle(void)
+{
+	fr_sim_frame frame = { 0 };
+	int fid;
+
+	frame.cycle = -1;
+	frame.channels = FRSIM_CH_A;
+	frame.pl = 9;
+	for (fid = BENCH_RX_FIRST; fid <= BENCH_RX_LAST; fid++)
+	{
+		frame.fid = fid;
+		frame.data[0] = fid;
+		FrSim_QueueRx(sim, &frame);
+	}
+	bench_queue_node_b();
+
+	// wait for cycle start, all frames of the last cycle are in
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	while ((regs->SIR_UN.SIR_UL & 0x4) == 0x0);
+}
+
+static void bench_rx_batch(void)
+{
+	static rx_callback callbacks[64];
+	bc read_buffer = { 0 };
+	unsigned long long t0, loop = 0, batch = 0;
+	unsigned long ndat1, ndat2;
+	long i, n = iterations / 10 + 1;
+	int b, loop_buffers = 0, batch_buffers = 0;
+
+	bench_rx_setup();
+	callbacks[2] = bench_rx_callback;
+	for (b = BENCH_RX_FIRST; b <= BENCH_RX_LAST; b++)
+		callbacks[b] = bench_rx_callback;
+	read_buffer.rdss = 1;
+
+	for (i = 0; i < n; i++)
+	{
+		// per-buffer loop as in transmit_check_node_a
+		bench_rx_cycle();
+		t0 = FrSim_Now(sim);
+		ndat1 = regs->NDAT1_UN.NDAT1_UL;
+		ndat2 = regs->NDAT2_UN.NDAT2_UL;
+		for (b = 0; b < 64; b++)
+		{
+			if (((b < 32 ? ndat1 >> b : ndat2 >> (b - 32)) & 0x1) == 0) continue;
+			read_buffer.obrs = b;
+			Fr_ReceiveRxLPdu(regs, &read_buffer);
+			bench_rx_callback(b, regs->RDDS);
+			loop_buffers++;
+		}
+		loop += FrSim_Now(sim) - t0;
+
+		bench_rx_cycle();
+		t0 = FrSim_Now(sim);
+		batch_buffers += Fr_ReceiveRxBatch(regs, &read_buffer, callbacks);
+		batch += FrSim_Now(sim) - t0;
+	}
+	printf("%-28s %10.1f ut/buffer\n", "Fr_ReceiveRxLPdu loop", (double)loop / loop_buffers);
+	printf("%-28s %10.1f ut/buffer (%.2fx)\n", "Fr_ReceiveRxBatch", (double)batch / batch_buffers,
+	       ((double)loop / loop_buffers) / ((double)batch / batch_buffers));
+}
+
+static void bench_transmit_check(void)
+{
+	unsigned long long t0;
+	double start;
+	long i, n = iterations / 10 + 1;
+	unsigned long frames = node.stats.tx_frames, skipped = node.stats.tx_skipped;
+	unsigned long words = node.stats.tx_words, kept = node.stats.tx_words_kept;
+	int errors = 0;
+
+	// the benches above loaded the input buffer behind the tracker's back
+	Fr_TxTrackReset(&node);
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	for (i = 0; i < n; i++)
+	{
+		bench_queue_node_b();
+		errors += transmit_check_node_a(&node);
+	}
+	bench_report("transmit_check_node_a", i, bench_seconds() - start, FrSim_Now(sim) - t0);
+	printf("  %.2f transfers/cycle, %.2f avoided/cycle, %lu words written, %lu kept\n",
+	       (double)(node.stats.tx_frames - frames) / n, (double)(node.stats.tx_skipped - skipped) / n,
+	       node.stats.tx_words - words, node.stats.tx_words_kept - kept);
+	if (errors)
+		bench_fail("%d payload mismatches", errors);
+}
+
+// transmit_check_node_a driven by the cycle start interrupt: the CPU idles
+// in Fr_EventWait (FrSim_WaitForInterrupt here, WFI on the target) instead of
+// polling CYCS
+static void bench_idle(fr_ctx *ctx)
+{
+	(void)ctx;
+	FrSim_WaitForInterrupt(sim);
+}
+
+static void bench_isr(void *ctx)
+{
+	Fr_EventIsr(ctx);
+}
+
+static void bench_peer_cycle(fr_ctx *ctx, int cycle)
+{
+	(void)ctx;
+	(void)cycle;
+	bench_queue_node_b();
+}
+
+// multiplexed frames 20..31 of node A as sent on the bus
+static unsigned long bench_mux_frames, bench_mux_errors;
+
+static void bench_mux_hook(void *ctx, const fr_sim_frame *frame)
+{
+	(void)ctx;
+	if (frame->fid < 20 || frame->fid > 31) return;
+	bench_mux_frames++;
+	if (frame->fid != (frame->fid < 24 ? 20 + (frame->cycle & 0x3) : 24 + (frame->cycle & 0x7))
+	    || frame->data[0] != (unsigned int)frame->fid)
+		bench_mux_errors++;
+}
+
+static void bench_cycles(fr_ctx *ctx, int cycle)
+{
+	(void)cycle;
+	ctx->stats.cycles++;
+}
+
+// Buffer #2 (slot 2 RX) swapped to TX in odd cycles and back in even ones,
+// never read: each swap to TX takes node B's frame of the even cycle with it
+#define BENCH_LOST_SWAPS 16
+
+static unsigned long bench_lost_swaps(unsigned long swaps)
+{
+	unsigned long start = node.reconfig.swaps, cycles = node.stats.cycles;
+
+	while (node.reconfig.swaps - start < swaps && node.stats.cycles - cycles < 4 * swaps + 4)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+	}
+	return node.reconfig.swaps - start;
+}
+
+static void bench_reconfig_lost(void)
+{
+	static mbuf_image image[3];
+	const mbuf_image *images = node.reconfig.images;
+	int count = node.reconfig.count, i;
+	unsigned long swaps, lost;
+
+	for (i = 0; i < 3; i++)
+	{
+		image[i].buffer = 2;
+		image[i].wrhs1 = node.hdr_cache.wrhs[2][0];
+		image[i].wrhs2 = node.hdr_cache.wrhs[2][1];
+		image[i].wrhs3 = node.hdr_cache.wrhs[2][2];
+	}
+	// RX in even cycles, TX in odd ones; image 2 puts the header back
+	image[0].wrhs1 = (image[0].wrhs1 & ~0x007F0000UL) | (0x02UL << 16);
+	image[1].wrhs1 = (image[1].wrhs1 & ~0x007F0000UL) | (0x03UL << 16) | 0x04000000UL;
+
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	Fr_OnCycle(&node, bench_cycles, 0);
+	Fr_OnCycle(&node, bench_peer_cycle, 0);
+	Fr_ReconfigInit(&node, image, 2);
+	bench_lost_swaps(2);
+	lost = node.reconfig.lost;
+	swaps = bench_lost_swaps(BENCH_LOST_SWAPS);
+	lost = node.reconfig.lost - lost;
+	Fr_ReconfigInit(&node, &image[2], 1);
+	bench_lost_swaps(1);
+	Fr_ReconfigInit(&node, images, count);
+
+	printf("  reconfig of #2 RX/TX: %lu swaps, %lu lost (%d expected)\n", swaps, lost, BENCH_LOST_SWAPS / 2);
+	if (swaps != BENCH_LOST_SWAPS || lost != BENCH_LOST_SWAPS / 2)
+		bench_fail("reconfig: unread data of RX buffers swapped to TX not counted");
+}
+
+static void bench_events(void)
+{
+	unsigned long rx = node.stats.rx_frames, errors = node.stats.rx_errors, cycles;
+	unsigned long long t0, ut;
+	double start;
+	long n = iterations / 10 + 1;
+
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	events_node_a(&node);
+	Fr_OnCycle(&node, bench_peer_cycle, 0);
+	FrSim_SetIrqHandler(sim, 1, bench_isr, &node);
+	FrSim_SetTxHook(sim, bench_mux_hook, NULL);
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+
+	bench_queue_node_b();
+	cycles = node.stats.cycles;
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	while (node.stats.cycles - cycles < (unsigned long)n)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+	}
+	ut = FrSim_Now(sim) - t0;
+	bench_report("events_node_a", n, bench_seconds() - start, ut);
+	printf("  idle %.2f%%, busy %.1f ut/cycle, max latency %lu ut, %lu interrupts, %lu overruns, "
+	       "%lu rx, %lu errors\n",
+	       100.0 * node.events.idle_time / ut, (double)(ut - node.events.idle_time) / n,
+	       node.events.max_latency, node.events.interrupts, node.events.overruns,
+	       node.stats.rx_frames - rx, node.stats.rx_errors - errors);
+	printf("  reconfig: %d buffers, %lu swaps, max %lu mt, %lu late, %lu lost, "
+	       "frames 20..31: %lu sent, %lu wrong\n",
+	       node.reconfig.buffers, node.reconfig.swaps, node.reconfig.max_time, node.reconfig.late,
+	       node.reconfig.lost, bench_mux_frames, bench_mux_errors);
+	if (node.stats.rx_frames - rx != (unsigned long)n || node.stats.rx_errors != errors || node.events.overruns != 0)
+		bench_fail("events_node_a: slot 2 not received once a cycle");
+	if (node.reconfig.late != 0 || node.reconfig.lost != 0 || bench_mux_frames == 0 || bench_mux_errors != 0)
+		bench_fail("events_node_a: frames 20..31 not swapped in time");
+	bench_reconfig_lost();
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+	FrSim_SetTxHook(sim, NULL, NULL);
+}
+
+// Data age of node A's TX payloads: the producer stamps MTCCV into word 1
+// and the TX hook takes the time from the stamp to the frame's action
+// point on the bus. All four payloads at cycle start against each one
+// produced just in time by Fr_JitRun at several leads.
+static unsigned long long bench_age_sum;
+static unsigned long bench_age_frames, bench_age_max, bench_age_stale;
+
+static int bench_action_point(int fid)
+{
+	int ssl = node.config.gtu7 & 0x3FF, nss = (node.config.gtu7 >> 16) & 0x3FF;
+
+	if (fid <= nss)
+		return (fid - 1) * ssl + (node.config.gtu9 & 0x3F);
+	return nss * ssl + (fid - nss - 1) * (node.config.gtu8 & 0x3F) + ((node.config.gtu9 >> 8) & 0x1F);
+}
+
+static void bench_stamp(fr_ctx *ctx, int buffer, int cycle)
+{
+	(void)cycle;
+	Fr_TxWrite(ctx, buffer, 1, regs->MTCCV_UN.MTCCV_UL & 0x3F3FFF);
+}
+
+static void bench_stamp_cycle(fr_ctx *ctx, int cycle)
+{
+	static const int tx[] = { 0, 9, 11, 12 };
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		bench_stamp(ctx, tx[i], cycle);
+		Fr_TxCommit(ctx, tx[i]);
+	}
+}
+
+static void bench_age_hook(void *ctx, const fr_sim_frame *frame)
+{
+	unsigned long stamp = frame->data[1], age;
+	int mpc = node.config.gtu2 & 0x3FFF;
+
+	(void)ctx;
+	if (frame->fid != 1 && frame->fid != 9 && frame->fid < 20) return;
+	age = ((frame->cycle - (int)(stamp >> 16)) & 0x3F) * mpc + bench_action_point(frame->fid) - (stamp & 0x3FFF);
+	if (age >= (unsigned long)mpc) bench_age_stale++;   // produced for an earlier cycle
+	bench_age_sum += age;
+	bench_age_frames++;
+	if (age > bench_age_max) bench_age_max = age;
+}
+
+// lead 0: stamps at cycle start; returns the average data age on the bus
+static double bench_jit_run(int lead, long n, unsigned long *stale)
+{
+	unsigned long cycles, idle, late = 0, runs = 0, age_max = 0;
+	unsigned long long t0, ut, age_sum = 0;
+	static const int tx[] = { 0, 9, 11, 12 };
+	char name[32];
+	double start;
+	int i;
+
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	Fr_JitInit(&node);
+	if (lead == 0)
+		Fr_OnCycle(&node, bench_stamp_cycle, 0);
+	else
+		for (i = 0; i < 4; i++)
+			Fr_JitAdd(&node, tx[i], bench_stamp, lead);
+	Fr_OnCycle(&node, bench_cycles, 0);
+	Fr_OnCycle(&node, bench_peer_cycle, 0);
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	bench_queue_node_b();
+	// the first cycles run with the payloads of before
+	for (cycles = node.stats.cycles; node.stats.cycles - cycles < 3; Fr_EventDispatch(&node, FR_EVENT_DEPTH))
+		Fr_EventWait(&node);
+
+	bench_age_sum = 0;
+	bench_age_frames = bench_age_max = bench_age_stale = 0;
+	for (i = 0; i < node.jit.count; i++)
+	{
+		node.jit.frame[i].runs = node.jit.frame[i].late = node.jit.frame[i].age_max = 0;
+		node.jit.frame[i].age_sum = 0;
+	}
+	FrSim_SetTxHook(sim, bench_age_hook, NULL);
+	cycles = node.stats.cycles;
+	idle = node.events.idle_time;
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	while (node.stats.cycles - cycles < (unsigned long)n)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+	}
+	ut = FrSim_Now(sim) - t0;
+	FrSim_SetTxHook(sim, NULL, NULL);
+	for (i = 0; i < node.jit.count; i++)
+	{
+		runs += node.jit.frame[i].runs;
+		late += node.jit.frame[i].late;
+		age_sum += node.jit.frame[i].age_sum;
+		if (node.jit.frame[i].age_max > age_max) age_max = node.jit.frame[i].age_max;
+	}
+	snprintf(name, sizeof(name), lead == 0 ? "cycle start" : "jit lead %d mt", lead);
+	bench_report(name, n, bench_seconds() - start, ut);
+	printf("  bus: %lu frames, age avg %.1f mt, max %lu mt, %lu stale; idle %.2f%%",
+	       bench_age_frames, (double)bench_age_sum / (bench_age_frames ? bench_age_frames : 1),
+	       bench_age_max, bench_age_stale, 100.0 * (node.events.idle_time - idle) / ut);
+	if (lead != 0)
+		printf("; driver: %lu runs, age avg %.1f mt, max %lu mt, %lu late, %lu timer events, %lu resyncs",
+		       runs, (double)age_sum / (runs - late ? runs - late : 1), age_max, late,
+		       node.jit.runs, node.jit.resyncs);
+	printf("\n");
+	// a frame the driver has in the message RAM in time is never sent stale
+	if (lead != 0 && late != bench_age_stale)
+	{
+		fprintf(stderr, "jit lead %d mt: driver counts %lu late, the bus saw %lu stale frames\n",
+		        lead, late, bench_age_stale);
+		exit(1);
+	}
+	*stale = bench_age_stale;
+	return (double)bench_age_sum / (bench_age_frames ? bench_age_frames : 1);
+}
+
+static void bench_jit(void)
+{
+	static const int leads[] = { 0, 2, 5, 20 };
+	unsigned long frames, errors, stale[4];
+	double age[4];
+	long n = iterations / 10 + 1;
+	int i;
+
+	FrSim_SetIrqHandler(sim, 1, bench_isr, &node);
+	for (i = 0; i < 4; i++)
+		age[i] = bench_jit_run(leads[i], n, &stale[i]);
+	// a lead too short for the transfer sends stale frames and gains nothing
+	for (i = 1; i < 4; i++)
+		if (stale[i] == 0 && age[i] >= age[0])
+			bench_fail("jit lead %d mt: no gain over cycle start", leads[i]);
+
+	// node A's own payloads, frames 20..31 must still follow their cycles
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	jit_node_a(&node, 5);
+	Fr_OnCycle(&node, bench_peer_cycle, 0);
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	bench_queue_node_b();
+	for (frames = node.stats.cycles; node.stats.cycles - frames < 3; Fr_EventDispatch(&node, FR_EVENT_DEPTH))
+		Fr_EventWait(&node);
+	frames = bench_mux_frames;
+	errors = bench_mux_errors;
+	FrSim_SetTxHook(sim, bench_mux_hook, NULL);
+	for (i = 0; i < 16; i++)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+	}
+	FrSim_SetTxHook(sim, NULL, NULL);
+	printf("  jit_node_a: frames 20..31: %lu sent, %lu wrong\n",
+	       bench_mux_frames - frames, bench_mux_errors - errors);
+	if (bench_mux_frames == frames || bench_mux_errors != errors)
+		bench_fail("jit_node_a: frames 20..31 not sent in their cycles");
+
+	// timer 1 off for the polled benchmarks
+	Fr_JitInit(&node);
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+}
+
+// Time-triggered tasks next to jit_node_a: one every cycle in the static
+// segment, one every 2nd cycle in the NIT that runs over its budget, one in
+// cycles 1, 5, 9, .. in the dynamic segment. Checks the runs, the start
+// phase and the overruns, and reports the run times in microticks.
+#define BENCH_TASKS 3
+
+static const int bench_task_cyc[BENCH_TASKS] = { 0, 0x2, 0x5 };
+static const int bench_task_at[BENCH_TASKS] = { 100, FR_NIT_START + 200, 4500 };
+static const int bench_task_budget[BENCH_TASKS] = { 20, 20, 10 };
+static const int bench_task_work[BENCH_TASKS] = { 100, 500, 20 };   // 2 ut each
+static int bench_task_index[BENCH_TASKS];
+static unsigned long bench_task_wrong;
+
+static void bench_task_run(int task, int cycle)
+{
+	unsigned long mtccv = regs->MTCCV_UN.MTCCV_UL, x = 0;
+	int i, now;
+
+	// macroticks into the cycle the task was planned for
+	now = (int)(mtccv & 0x3FFF) - ((cycle - (int)((mtccv >> 16) & 0x3F)) & 0x3F) * (node.config.gtu2 & 0x3FFF);
+	if (now < bench_task_at[task] - 1 || now > bench_task_at[task] + 2)
+		bench_task_wrong++;
+	for (i = 0; i < bench_task_work[task]; i++)
+	{
+		x += regs->GTUC1_UN.GTUC1_UL;
+		x += regs->GTUC2_UN.GTUC2_UL;
+	}
+	(void)x;
+}
+
+static void bench_task0(fr_ctx *ctx, int cycle) { (void)ctx; bench_task_run(0, cycle); }
+static void bench_task1(fr_ctx *ctx, int cycle) { (void)ctx; bench_task_run(1, cycle); }
+static void bench_task2(fr_ctx *ctx, int cycle) { (void)ctx; bench_task_run(2, cycle); }
+
+static void bench_tasks(void)
+{
+	static const task_callback task[BENCH_TASKS] = { bench_task0, bench_task1, bench_task2 };
+	unsigned long cycles, frames, errors, expect;
+	unsigned long long t0, ut;
+	fr_task *t;
+	double start;
+	long n = iterations / 10 + 8;
+	int i;
+
+	FrSim_SetIrqHandler(sim, 1, bench_isr, &node);
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	jit_node_a(&node, 20);
+	for (i = 0; i < BENCH_TASKS; i++)
+		bench_task_index[i] = Fr_TaskAdd(&node, task[i], bench_task_cyc[i], bench_task_at[i], bench_task_budget[i]);
+	Fr_OnCycle(&node, bench_peer_cycle, 0);
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	bench_queue_node_b();
+	for (cycles = node.stats.cycles; node.stats.cycles - cycles < 2; Fr_EventDispatch(&node, FR_EVENT_DEPTH))
+		Fr_EventWait(&node);
+	// counted from the first cycle start on
+	for (i = 0; i < node.jit.tasks; i++)
+	{
+		t = &node.jit.task[i];
+		t->runs = t->overruns = t->wcet = t->delay_max = 0;
+		t->delay_sum = t->time_sum = 0;
+	}
+	bench_task_wrong = 0;
+	frames = bench_mux_frames;
+	errors = bench_mux_errors;
+	FrSim_SetTxHook(sim, bench_mux_hook, NULL);
+	cycles = node.stats.cycles;
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	while (node.stats.cycles - cycles < (unsigned long)n)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+	}
+	ut = FrSim_Now(sim) - t0;
+	FrSim_SetTxHook(sim, NULL, NULL);
+	bench_report("time-triggered tasks", n, bench_seconds() - start, ut);
+	for (i = 0; i < BENCH_TASKS; i++)
+	{
+		t = &node.jit.task[bench_task_index[i]];
+		expect = bench_task_cyc[i] == 0 ? (unsigned long)n : bench_task_cyc[i] == 0x2 ? (unsigned long)n / 2 : (unsigned long)n / 4;
+		printf("  task %d at %d mt: %lu runs (%lu expected), start delay avg %.1f max %lu mt, "
+		       "wcet %lu ut avg %.1f ut, %lu overruns of %d mt\n",
+		       i, bench_task_at[i], t->runs, expect, (double)t->delay_sum / (t->runs ? t->runs : 1), t->delay_max,
+		       t->wcet, (double)t->time_sum / (t->runs ? t->runs : 1), t->overruns, bench_task_budget[i]);
+		if (t->runs + 1 < expect || t->runs > expect + 1)
+			bench_fail("task %d: wrong number of runs", i);
+		if ((t->overruns != 0) != (bench_task_work[i] * 2 > bench_task_budget[i] * 40))
+			bench_fail("task %d: overruns not detected as expected", i);
+	}
+	printf("  %lu tasks out of phase, frames 20..31: %lu sent, %lu wrong, %lu timer events\n",
+	       bench_task_wrong, bench_mux_frames - frames, bench_mux_errors - errors, node.jit.runs);
+	if (bench_task_wrong != 0 || bench_mux_errors != errors)
+		bench_fail("tasks out of phase or frames 20..31 wrong");
+
+	Fr_JitInit(&node);
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+}
+
+// One task and no frames, so that cycles the task skips have nothing to run:
+// it must still run in every cycle its cycle code selects, 1000 mt in
+#define BENCH_ONLY_CYCLES 128
+#define BENCH_ONLY_AT     1000
+
+static int bench_only_cyc;
+static unsigned long bench_only_wrong;
+static unsigned long bench_only_slack, bench_only_off;
+
+static void bench_task_only(fr_ctx *ctx, int cycle)
+{
+	unsigned long mtccv = regs->MTCCV_UN.MTCCV_UL;
+	int rep = bench_only_cyc == 0 ? 1 : bench_only_cyc >= 4 ? 4 : 2, now;
+
+	(void)ctx;
+	now = (int)(mtccv & 0x3FFF) - ((cycle - (int)((mtccv >> 16) & 0x3F)) & 0x3F) * (node.config.gtu2 & 0x3FFF);
+	if (now < BENCH_ONLY_AT - 1 || now > BENCH_ONLY_AT + 2 || (cycle & (rep - 1)) != (bench_only_cyc & (rep - 1)))
+		bench_only_wrong++;
+}
+
+static void bench_tasks_only(void)
+{
+	static const int cyc[] = { 0, 0x2, 0x5 };
+	unsigned long cycles, expect;
+	unsigned long long due;
+	fr_event *e;
+	fr_task *t;
+	int i;
+
+	FrSim_SetIrqHandler(sim, 1, bench_isr, &node);
+	for (i = 0; i < 3; i++)
+	{
+		bench_only_cyc = cyc[i];
+		Fr_EventInit(&node, bench_clock, bench_idle);
+		Fr_JitInit(&node);
+		Fr_TaskAdd(&node, bench_task_only, cyc[i], BENCH_ONLY_AT, 100);
+		Fr_OnCycle(&node, bench_cycles, 0);
+		Fr_OnCycle(&node, bench_peer_cycle, 0);
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+		bench_queue_node_b();
+		for (cycles = node.stats.cycles; node.stats.cycles - cycles < 2; Fr_EventDispatch(&node, FR_EVENT_DEPTH))
+			Fr_EventWait(&node);
+		t = &node.jit.task[0];
+		t->runs = 0;
+		node.jit.resyncs = node.jit.runs = 0;
+		bench_only_wrong = 0;
+		bench_only_slack = bench_only_off = 0;
+		for (cycles = node.stats.cycles; node.stats.cycles - cycles < BENCH_ONLY_CYCLES; )
+		{
+			// timer 1 fires when Fr_JitSlack said, within 2 mt
+			due = FrSim_Now(sim) + (unsigned long long)Fr_JitSlack(&node) * FR_MICRO_PER_MACRO;
+			Fr_EventWait(&node);
+			e = &node.events.queue[node.events.get & (FR_EVENT_DEPTH - 1)];
+			if (e->sir & 0x200)
+			{
+				bench_only_slack++;
+				if (e->time + 2 * FR_MICRO_PER_MACRO < due || e->time > due + 2 * FR_MICRO_PER_MACRO)
+					bench_only_off++;
+			}
+			Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+		}
+		expect = BENCH_ONLY_CYCLES / (cyc[i] == 0 ? 1 : cyc[i] >= 4 ? 4 : 2);
+		printf("task alone, cycle code %d: %lu runs (%lu expected) in %d cycles, %lu out of phase, "
+		       "%lu timer events, %lu resyncs, %lu of %lu off Fr_JitSlack\n",
+		       cyc[i], t->runs, expect, BENCH_ONLY_CYCLES, bench_only_wrong, node.jit.runs, node.jit.resyncs,
+		       bench_only_off, bench_only_slack);
+		if (t->runs != expect || bench_only_wrong != 0 || node.jit.resyncs != 0)
+			bench_fail("task alone, cycle code %d: not run once in each of its cycles", cyc[i]);
+		if (bench_only_slack == 0 || bench_only_off != 0)
+			bench_fail("task alone, cycle code %d: timer 1 not due when Fr_JitSlack said", cyc[i]);
+	}
+
+	Fr_JitInit(&node);
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+}
+
+// Frame 40 on both channels into buffers #13 (A) and #14 (B), and node B's
+// slot 2 sync frame into #2 (A) and #3 (B). Over every 8 cycles frame 40
+// comes on both channels, on A only, on B only, with different payloads on
+// A and B, not at all, then three times on both; slot 2 misses channel A in
+// the B only cycle. Checks one frame per cycle, A first, and the counters.
+#define BENCH_DUAL_FID 40
+#define BENCH_DUAL_A   13
+#define BENCH_DUAL_B   14
+
+static unsigned long bench_dual_seq, bench_dual_frames[2], bench_dual_wrong;
+
+static void bench_dual_queue(int fid, int channels, unsigned long seq, unsigned long tag)
+{
+	fr_sim_frame frame = { 0 };
+
+	frame.fid = fid;
+	frame.cycle = -1;
+	frame.channels = channels;
+	frame.pl = 9;
+	frame.sync = fid == 2;
+	frame.data[0] = fid == 2 ? 0x12345678 : seq;
+	frame.data[1] = fid == 2 ? 0x87654321 : tag;
+	FrSim_QueueRx(sim, &frame);
+}
+
+static void bench_dual_cycle(fr_ctx *ctx, int cycle)
+{
+	unsigned long k = ++bench_dual_seq;
+
+	(void)ctx;
+	(void)cycle;
+	switch (k & 0x7)
+	{
+	case 1: bench_dual_queue(BENCH_DUAL_FID, FRSIM_CH_A, k, 0xAAAA); break;
+	case 2: bench_dual_queue(BENCH_DUAL_FID, FRSIM_CH_B, k, 0xBBBB); break;
+	case 3:
+		bench_dual_queue(BENCH_DUAL_FID, FRSIM_CH_A, k, 0xAAAA);
+		bench_dual_queue(BENCH_DUAL_FID, FRSIM_CH_B, k, 0xBBBB);
+		break;
+	case 4: break;
+	default: bench_dual_queue(BENCH_DUAL_FID, FRSIM_CH_A | FRSIM_CH_B, k, 0xAAAA); break;
+	}
+	bench_dual_queue(2, (k & 0x7) == 2 ? FRSIM_CH_B : FRSIM_CH_A | FRSIM_CH_B, 0, 0);
+}
+
+static void bench_dual_frame(fr_ctx *ctx, int pair, int channel, volatile unsigned long *rdds)
+{
+	static unsigned long last;
+
+	(void)ctx;
+	bench_dual_frames[pair]++;
+	if (pair == 1)
+	{
+		if (rdds[1] != 0x87654321) bench_dual_wrong++;
+		return;
+	}
+	// each frame once, from channel A whenever A had a copy
+	if (rdds[0] == last || rdds[1] != (channel == FR_DUAL_A ? 0xAAAA : 0xBBBB)
+	    || (channel == FR_DUAL_B && (rdds[0] & 0x7) != 2))
+		bench_dual_wrong++;
+	last = rdds[0];
+}
+
+static void bench_dual(void)
+{
+	wrhs rx = { 0 };
+	bc load = { 0 };
+	unsigned long cycles, mbs_frames;
+	unsigned long long t0, ut;
+	fr_dual_pair *p;
+	double start;
+	long n = (iterations / 10 + 8) & ~7L;
+	int i;
+
+	rx.fid = BENCH_DUAL_FID;
+	rx.pl = 9;
+	load.lhsh = 1;
+	load.ibsyh = 1;
+	load.ibsys = 1;
+	for (i = 0; i < 2; i++)
+	{
+		rx.cha = i == 0;
+		rx.chb = i == 1;
+		rx.dp = node.layout.header_words + node.layout.data_words + FR_DATA_WORDS(9) * i;
+		load.ibrh = i == 0 ? BENCH_DUAL_A : BENCH_DUAL_B;
+		Fr_UpdateLPdu(&node, &rx, &load);
+	}
+
+	FrSim_SetIrqHandler(sim, 1, bench_isr, &node);
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	Fr_DualAdd(&node, BENCH_DUAL_A, BENCH_DUAL_B, bench_dual_frame);
+	Fr_DualAdd(&node, 2, 3, bench_dual_frame);
+	Fr_OnCycle(&node, bench_cycles, 0);
+	// slot 2 frames the benchmarks before queued ahead are taken one per
+	// cycle; then start at an even cycle, with the cycle pattern
+	for (i = 0; i < 16 || ((regs->MTCCV_UN.MTCCV_UL >> 16) & 0x1) != 0; i++)
+	{
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+		while ((regs->SIR_UN.SIR_UL & 0x4) == 0x0);
+	}
+	Fr_OnCycle(&node, bench_dual_cycle, 0);
+	bench_dual_seq = 0;
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	bench_dual_cycle(&node, 0);
+	for (i = 0; i < 2; i++)
+	{
+		node.dual.pair[i].frames = 0;
+		bench_dual_frames[i] = 0;
+	}
+	node.dual.sync[0] = node.dual.sync[1] = node.dual.sync_differ = 0;
+	bench_dual_wrong = 0;
+
+	cycles = node.stats.cycles;
+	t0 = FrSim_Now(sim);
+	start = bench_seconds();
+	while (node.stats.cycles - cycles < (unsigned long)n)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+	}
+	ut = FrSim_Now(sim) - t0;
+	bench_report("Fr_DualAdd merge", n, bench_seconds() - start, ut);
+	for (i = 0; i < 2; i++)
+	{
+		p = &node.dual.pair[i];
+		printf("  pair %d (#%d, #%d): %lu frames, copies A %lu B %lu, missing A %lu B %lu, "
+		       "%lu invalid, %lu disagree\n",
+		       i, p->buffer[0], p->buffer[1], p->frames, p->copies[0], p->copies[1],
+		       p->missing[0], p->missing[1], p->invalid[0] + p->invalid[1], p->disagree);
+	}
+	printf("  sync frames A %lu B %lu, %lu double cycles differ, %lu wrong frames\n",
+	       node.dual.sync[0], node.dual.sync[1], node.dual.sync_differ, bench_dual_wrong);
+	// frame 40 is missing in 1 of 8 cycles, A and B disagree in 1
+	mbs_frames = (unsigned long)n - (unsigned long)n / 8;
+	p = &node.dual.pair[0];
+	if (bench_dual_frames[0] + 1 < mbs_frames || bench_dual_frames[0] > mbs_frames || bench_dual_wrong != 0
+	    || p->disagree + 1 < (unsigned long)n / 8 || p->disagree > (unsigned long)n / 8
+	    || p->missing[0] + 1 < (unsigned long)n / 8 || p->missing[1] + 1 < (unsigned long)n / 8
+	    || node.dual.sync_differ == 0)
+		bench_fail("dual-channel merge: unexpected counts");
+
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+}
+
+// Global time over 130 cycles (two cycle counter rollovers), read once per
+// cycle start, against the simulator's clock
+#define BENCH_TIME_CYCLES 130
+
+static void bench_time(void)
+{
+	unsigned long long t0, ut, first, now, last, mt_ut;
+	unsigned long mpc = node.time.macro_per_cycle, backwards = 0, gaps = 0;
+	double start;
+	long i;
+
+	mt_ut = (node.config.gtu1 & 0xFFFFF) / mpc;   // microticks per macrotick
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	while ((regs->SIR_UN.SIR_UL & 0x4) == 0x0);
+	t0 = FrSim_Now(sim);
+	first = last = Fr_TimeNow(&node);
+	for (i = 0; i < BENCH_TIME_CYCLES; i++)
+	{
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+		while ((regs->SIR_UN.SIR_UL & 0x4) == 0x0);
+		now = Fr_TimeNow(&node);
+		if (now < last) backwards++;
+		if (now - last < mpc - 2 || now - last > mpc + 2) gaps++;
+		last = now;
+	}
+	ut = FrSim_Now(sim) - t0;
+
+	start = bench_seconds();
+	for (i = 0; i < iterations * 10; i++)
+		Fr_TimeNow(&node);
+	bench_report("Fr_TimeNow", i, bench_seconds() - start, 0);
+	printf("  %d cycles (cycle counter at %d): %llu mt = %llu ut, simulator %llu ut, "
+	       "%lu backwards, %lu cycles off MPC\n",
+	       BENCH_TIME_CYCLES, node.time.cycle, last - first, (last - first) * mt_ut, ut,
+	       backwards, gaps);
+	if (backwards != 0 || gaps != 0)
+		bench_fail("global time not one cycle per cycle start");
+}
+
+// 11 frames at 11, 22 and 45 ms (every 2nd, 4th and 8th cycle) packed into
+// dynamic slots 40..50, sent from buffers 13..23 for 64 cycles
+#define BENCH_MUX_FRAMES 11
+#define BENCH_MUX_BUFFER 13
+
+static const int bench_mux_rep[BENCH_MUX_FRAMES] = { 2, 2, 4, 4, 4, 4, 8, 8, 8, 8, 8 };
+static wrhs bench_mux_lpdu[BENCH_MUX_FRAMES];
+static unsigned long bench_slot_frames, bench_slot_errors;
+
+static int bench_mux_due(int cyc, int cycle)
+{
+	int repetition = 64;
+
+	while ((cyc & repetition) == 0) repetition >>= 1;
+	return (cycle & (repetition - 1)) == (cyc & (repetition - 1));
+}
+
+static void bench_slot_hook(void *ctx, const fr_sim_frame *frame)
+{
+	unsigned int i = frame->data[0];
+
+	(void)ctx;
+	if (frame->fid < 40 || frame->fid >= 40 + BENCH_MUX_FRAMES) return;
+	bench_slot_frames++;
+	if (i >= BENCH_MUX_FRAMES || bench_mux_lpdu[i].fid != frame->fid
+	    || !bench_mux_due(bench_mux_lpdu[i].cyc, frame->cycle))
+		bench_slot_errors++;
+}
+
+static void bench_mux(void)
+{
+	static mux_frame frames[BENCH_MUX_FRAMES];
+	static slot_use slots[BENCH_MUX_FRAMES];
+	bc load = { 0 }, update = { 0 };
+	unsigned long headers = node.stats.headers, kept = node.stats.headers_kept, crcs = node.stats.crc_calcs;
+	double start;
+	int i, packed, used = 0, cycle;
+
+	for (i = 0; i < BENCH_MUX_FRAMES; i++)
+	{
+		bench_mux_lpdu[i].cfg = 1;
+		bench_mux_lpdu[i].cha = 1;
+		bench_mux_lpdu[i].pl = 4;
+		frames[i].repetition = bench_mux_rep[i];
+		frames[i].base = -1;
+		frames[i].lpdu = &bench_mux_lpdu[i];
+		slots[i].fid = 40 + i;
+	}
+	start = bench_seconds();
+	packed = Fr_PackSlots(frames, BENCH_MUX_FRAMES, slots, BENCH_MUX_FRAMES);
+	for (i = 0; i < BENCH_MUX_FRAMES; i++)
+		used += slots[i].frames != 0;
+	printf("Fr_PackSlots                 %10.1f us    %d frames in %d of %d slots, %d%% of their cycles used\n",
+	       (bench_seconds() - start) * 1e6, packed, used, BENCH_MUX_FRAMES, Fr_SlotUtilisation(slots, BENCH_MUX_FRAMES));
+
+	// headers loaded at runtime, data behind node A's sections
+	load.lhsh = 1;
+	load.ibsyh = 1;
+	load.ibsys = 1;
+	for (i = 0; i < BENCH_MUX_FRAMES; i++)
+	{
+		bench_mux_lpdu[i].dp = node.layout.header_words + node.layout.data_words + FR_DATA_WORDS(4) * i;
+		load.ibrh = BENCH_MUX_BUFFER + i;
+		Fr_UpdateLPdu(&node, &bench_mux_lpdu[i], &load);
+	}
+
+	// every update asks for the header too, the header cache drops those loads
+	FrSim_SetTxHook(sim, bench_slot_hook, NULL);
+	update.lhsh = 1;
+	update.ldsh = 1;
+	update.stxrh = 1;
+	update.ibsyh = 1;
+	for (cycle = 0; cycle < 64; cycle++)
+	{
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+		while ((regs->SIR_UN.SIR_UL & 0x4) == 0x0);
+		for (i = 0; i < BENCH_MUX_FRAMES; i++)
+		{
+			if (!bench_mux_due(bench_mux_lpdu[i].cyc, (regs->MTCCV_UN.MTCCV_UL >> 16) & 0x3F)) continue;
+			regs->WRDS[0] = i;
+			update.ibrh = BENCH_MUX_BUFFER + i;
+			Fr_UpdateLPdu(&node, &bench_mux_lpdu[i], &update);
+		}
+	}
+	FrSim_SetTxHook(sim, NULL, NULL);
+	printf("  64 cycles: %lu frames sent in slots 40..%d, %lu in the wrong slot or cycle\n",
+	       bench_slot_frames, 40 + used - 1, bench_slot_errors);
+	if (packed != BENCH_MUX_FRAMES || bench_slot_frames == 0 || bench_slot_errors != 0)
+		bench_fail("multiplexed frames not sent in their slots and cycles");
+	printf("  Fr_UpdateLPdu: %lu header loads, %lu dropped by the header cache, %lu CRCs computed\n",
+	       node.stats.headers - headers, node.stats.headers_kept - kept, node.stats.crc_calcs - crcs);
+}
+
+// Node A with the top 11 buffers as receive FIFO: per cycle BENCH_FIFO_FRAMES
+// dynamic frames without a dedicated buffer, two of them in the ID range
+// rejected by the filter, drained in one Fr_FifoDrain call
+#define BENCH_FIFO_FRAMES 12
+
+static void bench_fifo(void)
+{
+	static const fifo_cfg fifo = { 11, 32, 100, 0x3, 0, 0, 0, 0, 8 };   // rejects IDs 100..103
+	static fifo_entry entries[11];
+	fr_sim_frame frame = { 0 };
+	fr_sim_stats before, after;
+	unsigned long frames, overruns, errors = 0;
+	unsigned long long t0, ut = 0, age, age_sum = 0, age_max = 0, received;
+	double start;
+	long i, n = iterations / 10 + 1;
+	int j, k, count;
+
+	FrSim_Reset(sim);
+	node.fifo = &fifo;
+	if (configure_initialize_node_a(&node) != 0)
+	{
+		fprintf(stderr, "receive FIFO does not fit\n");
+		exit(1);
+	}
+	node.fifo = 0;
+	printf("message RAM with FIFO %d..%d: %d header + %d data words, %d words free\n",
+	       node.fifo_first, node.fifo_first + node.fifo_depth - 1,
+	       node.layout.header_words, node.layout.data_words, node.layout.free_words);
+	Fr_StartCommunication(regs);
+	while ((regs->CCSV_UN.CCSV_UL & 0x3F) != FRSIM_POC_NORMAL_ACTIVE);
+
+	frames = node.stats.fifo_frames;
+	overruns = node.stats.fifo_overruns;
+	FrSim_GetStats(sim, &before);
+	frame.cycle = -1;
+	frame.channels = FRSIM_CH_A | FRSIM_CH_B;
+	frame.pl = 32;
+	start = bench_seconds();
+	for (i = 0; i < n; i++)
+	{
+		for (j = 0; j < BENCH_FIFO_FRAMES; j++)
+		{
+			frame.fid = j < 2 ? 100 + j : 40 + j;
+			for (k = 0; k < 16; k++)
+				frame.data[k] = ((unsigned int)frame.fid << 16) | (unsigned int)k;
+			FrSim_QueueRx(sim, &frame);
+		}
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+		while ((regs->SIR_UN.SIR_UL & 0x4) == 0x0);
+
+		t0 = FrSim_Now(sim);
+		count = Fr_FifoDrain(&node, entries, 11);
+		ut += FrSim_Now(sim) - t0;
+		for (j = 0; j < count; j++)
+		{
+			if (entries[j].pl != 32 || entries[j].data[15] != (((unsigned long)entries[j].fid << 16) | 15))
+				errors++;
+			// readout time from the start of the cycle the frame was received in
+			received = node.time.cycles - ((entries[j].stamp.cycle - entries[j].cycle) & 0x3F);
+			age = entries[j].stamp.time - received * node.time.macro_per_cycle;
+			age_sum += age;
+			if (age > age_max) age_max = age;
+		}
+	}
+	FrSim_GetStats(sim, &after);
+	frames = node.stats.fifo_frames - frames;
+	bench_report("Fr_FifoDrain", i, bench_seconds() - start, ut);
+	printf("  %lu entries, %.1f ut/entry, %lu rejected, %lu overruns, %lu errors\n",
+	       frames, frames ? (double)ut / frames : 0.0, after.fifo_rejected - before.fifo_rejected,
+	       node.stats.fifo_overruns - overruns, errors);
+	printf("  read out %.0f mt after the start of their cycle on average, %llu mt at most\n",
+	       frames ? (double)age_sum / frames : 0.0, age_max);
+	// two IDs of every cycle are rejected by the filter
+	if (errors != 0 || node.stats.fifo_overruns != overruns || frames != (unsigned long)n * (BENCH_FIFO_FRAMES - 2)
+	    || after.fifo_rejected - before.fifo_rejected != (unsigned long)n * 2)
+		bench_fail("receive FIFO: unexpected counts");
+}
+
+// Bus trace of events_node_a through FatFs to a RAM disk (fr_disk.c), read
+// back and checked record by record; then the ring and file path alone at
+// full speed with pl 127 frames against what a fully loaded 10 Mbit/s
+// cluster needs
+#define BENCH_TRACE_BYTES (8L << 20)
+
+static fr_trace bench_trace_ring;
+
+static unsigned long bench_disk_clock(void)
+{
+	return FrDisk_Stats.sectors * 100;
+}
+
+static void bench_trace(void)
+{
+	static FATFS fs;
+	static FIL file;
+	static unsigned int buf[FR_TRACE_RING / 4];
+	static unsigned long payload[64];
+	union { fr_trace_file f; fr_trace_record r; unsigned int w[4]; } rec;
+	fr_trace *t = &bench_trace_ring;
+	fr_trace_record big = { { 0, 0 }, 60, 0, FR_TRACE_CH_A | FR_TRACE_CH_B, 0x0003, 127, 64 };
+	unsigned long cycles, records = 0, rx = 0, tx = 0, errors = 0, polls = 0;
+	unsigned long long last = 0;
+	double start, secs, need;
+	UINT got;
+	long n = iterations / 10 + 1;
+	int budget[4];
+	FILINFO info;
+
+	FrDisk_Format();
+	if (f_mount(&fs, "", 1) != FR_OK || Fr_TraceOpen(&node, t, &file, "TRACE.BIN", bench_clock) != 0)
+	{
+		fprintf(stderr, "trace file could not be created\n");
+		exit(1);
+	}
+	FrSim_Reset(sim);
+	configure_initialize_node_a(&node);
+	Fr_StartCommunication(regs);
+	while ((regs->CCSV_UN.CCSV_UL & 0x3F) != FRSIM_POC_NORMAL_ACTIVE);
+	Fr_EventInit(&node, bench_clock, bench_idle);
+	events_node_a(&node);
+	Fr_OnCycle(&node, bench_peer_cycle, 0);
+	FrSim_SetIrqHandler(sim, 1, bench_isr, &node);
+	regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+
+	bench_queue_node_b();
+	cycles = node.stats.cycles;
+	while (node.stats.cycles - cycles < (unsigned long)n)
+	{
+		Fr_EventWait(&node);
+		Fr_EventDispatch(&node, FR_EVENT_DEPTH);
+		if (Fr_TracePoll(t, FR_TRACE_ANY_TIME) > 0) polls++;
+	}
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+	printf("trace events_node_a: %lu records, %lu dropped, max fill %lu bytes, %lu flushes in %lu cycles\n",
+	       t->records, t->dropped, t->max_fill, polls, node.stats.cycles - cycles);
+	if (Fr_TraceClose(&node, t) != 0)
+		errors++;
+
+	// read back: header, then each record's timestamps going forward per direction
+	if (f_open(&file, "TRACE.BIN", FA_READ) != FR_OK
+	    || f_read(&file, &rec, sizeof(fr_trace_file), &got) != FR_OK || got != sizeof(fr_trace_file)
+	    || rec.f.magic != FR_TRACE_MAGIC || rec.f.macro_per_cycle != node.time.macro_per_cycle)
+		errors++;
+	while (f_read(&file, &rec, sizeof(fr_trace_record), &got) == FR_OK && got == sizeof(fr_trace_record))
+	{
+		unsigned long long time = ((unsigned long long)rec.r.time[1] << 32) | rec.r.time[0];
+		if (f_read(&file, buf, rec.r.words * 4, &got) != FR_OK || got != (UINT)rec.r.words * 4u)
+			errors++;
+		if (rec.r.flags & FR_TRACE_COMMIT)
+			tx++;
+		else
+		{
+			if (time < last || (rec.r.fid == 2 && buf[0] != 0x12345678)) errors++;
+			last = time;
+			rx++;
+		}
+		records++;
+	}
+	if (records != t->records || f_size(&file) != t->bytes) errors++;
+	f_close(&file);
+	printf("  read back %lu records (%lu rx, %lu committed), %lu bytes, %lu errors\n",
+	       records, rx, tx, t->bytes, errors);
+	if (errors != 0 || t->dropped != 0 || rx == 0)
+		bench_fail("trace: records lost or wrong");
+
+	// the ring and FatFs path at full speed, polled at every fill
+	if (Fr_TraceOpen(&node, t, &file, "LOAD.BIN", 0) != 0)
+		exit(1);
+	node.trace = 0;
+	FrDisk_Stats.writes = FrDisk_Stats.sectors = FrDisk_Stats.multi = 0;
+	start = bench_seconds();
+	while (t->head < BENCH_TRACE_BYTES)
+	{
+		big.time[0] += 100;
+		Fr_TraceFrame(t, &big, payload);
+		Fr_TracePoll(t, FR_TRACE_ANY_TIME);
+	}
+	// what f_sync put on the card before the close
+	info.lfname = NULL;
+	info.lfsize = 0;
+	if (f_stat("LOAD.BIN", &info) != FR_OK || info.fsize != t->synced || t->synced == 0
+	    || t->bytes - t->synced >= FR_TRACE_SYNC)
+		bench_fail("trace: %lu of %lu bytes in the directory entry before f_close", t->synced, t->bytes);
+	Fr_TraceClose(&node, t);
+	secs = bench_seconds() - start;
+	// both channels busy with back-to-back pl 127 frames
+	need = 2.0 * 1e9 / (FR_FRAME_BITS(127) * FR_BIT_NS) * (sizeof(fr_trace_record) + 64 * 4);
+	printf("  %lu pl 127 records: %.1f MB/s, %lu dropped, %lu disk writes, %.1f sectors/write, "
+	       "%lu multi-block; full 2-channel load needs %.2f MB/s\n",
+	       t->records, t->bytes / secs * 1e-6, t->dropped, FrDisk_Stats.writes,
+	       FrDisk_Stats.writes ? (double)FrDisk_Stats.sectors / FrDisk_Stats.writes : 0.0,
+	       FrDisk_Stats.multi, need * 1e-6);
+	if (t->dropped != 0)
+		bench_fail("trace: records dropped at full speed");
+
+	// time budget, with the RAM disk taking 100 ticks a sector
+	if (Fr_TraceOpen(&node, t, &file, "BUDGET.BIN", bench_disk_clock) != 0)
+		exit(1);
+	node.trace = 0;
+	while (t->head < 24 * FR_TRACE_SECTOR)
+		Fr_TraceFrame(t, &big, payload);
+	budget[0] = Fr_TracePoll(t, 0);          // learns the time per sector
+	budget[1] = Fr_TracePoll(t, t->sector_time - 1);
+	budget[2] = Fr_TracePoll(t, 350);
+	budget[3] = Fr_TracePoll(t, FR_TRACE_ANY_TIME);
+	printf("  budgeted polls: %d bytes (first), %d (under a sector), %d (350 ticks, %lu ticks/sector), %d (no limit)\n",
+	       budget[0], budget[1], budget[2], t->sector_time, budget[3]);
+	if (budget[0] != FR_TRACE_SECTOR || budget[1] != 0 || budget[2] <= 0
+	    || (unsigned long)budget[2] / FR_TRACE_SECTOR * t->sector_time > 350
+	    || t->head - t->tail >= FR_TRACE_SECTOR)
+		bench_fail("trace: Fr_TracePoll did not keep to its budget");
+	Fr_TraceClose(&node, t);
+	f_mount(NULL, "", 0);
+}
+
+// One controller per thread, each with its own simulator and driver context.
+// Nodes alternate between the node A and node B images; no locks are taken
+// between the threads.
+typedef struct bench_node
+{
+	pthread_t thread;
+	int node_b;
+	fr_ctx ctx;
+	int failed;
+} bench_node;
+
+static __thread fr_sim *bench_thread_sim;
+
+static unsigned long bench_thread_clock(void)
+{
+	return (unsigned long)FrSim_Now(bench_thread_sim);
+}
+
+static void *bench_node_thread(void *arg)
+{
+	bench_node *n = arg;
+	fr_startup_log log = { 0 };
+	fr_sim *s = FrSim_Create();
+	long i, cycles = iterations / 10 + 1;
+
+	if (s == NULL)
+	{
+		n->failed = 1;
+		return NULL;
+	}
+	bench_thread_sim = s;
+	Fr_CtxInit(&n->ctx, FrSim_Regs(s));
+	if ((n->node_b ? fast_startup_node_b : fast_startup_node_a)(&n->ctx, bench_thread_clock, 64 * 224000, &log) != 0)
+		n->failed = 1;
+	for (i = 0; i < cycles && !n->failed; i++)
+	{
+		bench_queue_peer(s, n->node_b);
+		if (n->node_b)
+			transmit_check_node_b(&n->ctx);
+		else
+			transmit_check_node_a(&n->ctx);
+	}
+	FrSim_Destroy(s);
+	return NULL;
+}
+
+static void bench_threads(int count)
+{
+	static bench_node nodes[BENCH_THREADS];
+	unsigned long cycles = 0, rx = 0, errors = 0;
+	double start;
+	int i, failed = 0;
+
+	start = bench_seconds();
+	for (i = 0; i < count; i++)
+	{
+		nodes[i].node_b = i & 1;
+		nodes[i].failed = 0;
+		if (pthread_create(&nodes[i].thread, NULL, bench_node_thread, &nodes[i]) != 0)
+			nodes[i].failed = 1;
+	}
+	for (i = 0; i < count; i++)
+	{
+		pthread_join(nodes[i].thread, NULL);
+		failed += nodes[i].failed;
+		cycles += nodes[i].ctx.stats.cycles;
+		rx += nodes[i].ctx.stats.rx_frames;
+		errors += nodes[i].ctx.stats.rx_errors;
+	}
+	printf("%d contexts on %d threads      %10.0f cycles/s, %lu rx, %lu errors, %d failed\n",
+	       count, count, cycles / (bench_seconds() - start), rx, errors, failed);
+	if (failed != 0 || errors != 0 || rx == 0)
+		bench_fail("%d contexts: startup failed or frames wrong", count);
+}
+
+int main(int argc, char **argv)
+{
+	fr_sim_stats stats;
+
+	if (argc > 1) iterations = atol(argv[1]);
+	if (iterations <= 0) iterations = 1;
+
+	sim = FrSim_Create();
+	if (sim == NULL)
+	{
+		fprintf(stderr, "FrSim_Create failed\n");
+		return 1;
+	}
+	regs = FrSim_Regs(sim);
+	Fr_CtxInit(&node, regs);
+
+	printf("%ld iterations, 1 ut = 25 ns\n", iterations);
+	bench_controller_init();
+	bench_configure();
+	bench_poc();
+	bench_recover();
+	printf("message RAM: %d/%d buffers, %d header + %d data words, %d unused header words, %d words free\n",
+	       node.layout.used, node.layout.buffers, node.layout.header_words, node.layout.data_words,
+	       node.layout.unused_words, node.layout.free_words);
+
+	// leaves the node in NORMAL_ACTIVE
+	bench_startup();
+
+	bench_prepare();
+	bench_transmit();
+	bench_receive();
+	bench_tx_updates();
+	bench_rx_batch();
+	bench_transmit_check();
+	bench_events();
+	bench_jit();
+	bench_tasks();
+	bench_tasks_only();
+	bench_dual();
+	bench_time();
+	bench_mux();
+	bench_fifo();
+	bench_trace();
+	bench_threads(1);
+	bench_threads(BENCH_THREADS);
+
+	FrSim_GetStats(sim, &stats);
+	printf("simulated %.3f ms, %lu cycles, %lu tx frames, %lu rx frames, "
+	       "%llu register accesses, %lu locked config writes\n",
+	       stats.now_ut * 25e-6, stats.cycles, stats.tx_frames, stats.rx_frames,
+	       stats.reads + stats.writes, stats.config_locked);
+
+	printf("%lu checks failed\n", bench_failures);
+	FrSim_Destroy(sim);
+	return bench_failures != 0;
+}
@@ -0,0 +1,354 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Cluster of simulated FlexRay nodes on one bus
+ *
+ *    All nodes serve the same slots (FrSim_SetBus), so they reach the
+ *    same sequence of cycle starts and slots and one barrier round per
+ *    slot keeps them in step. A slot's frames are written by the
+ *    transmit passes before the round and only read after it; the next
+ *    write of the same slot is a cycle later, after the cycle start
+ *    round, so the slot table needs no lock for readers.
+ *
+ *    The nodes run the node A and node B applications of FlexRay.c,
+ *    which carry the configuration of the TI example projects
+ *    (examples/ti/FlexRay_CCSv5_example_code_nodeA and _nodeB) on
+ *    fr_ctx. The TI programs themselves do not run here: on a 64-bit
+ *    host their Fr.h lays out FRAY_ST apart from the model's (0x318
+ *    is an anonymous 32-bit field there, FSR here, so TXRQ1 and every
+ *    register after it sit 8 bytes off; on the target both match),
+ *    their Fr.c exports the driver's names (Fr_Init,
+ *    Fr_StartCommunication, ..) with other signatures, and their main
+ *    loops forever on the fixed FRAY1 address.
+ *
+ *******************************************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fr_bus.h"
+
+typedef struct frbus_slot
+	{
+		unsigned long seq;              // cycle the entries belong to
+		int senders[2];                 // channel A, B
+		int sender[2];                  // node of the frame on the channel
+		fr_sim_frame frame[2];
+	} frbus_slot;
+
+typedef struct frbus frbus;
+
+typedef struct frbus_member
+	{
+		frbus *bus;
+		fr_bus_node *node;
+		int index;
+		fr_sim *sim;
+		pthread_t thread;
+		int started;
+		int joined;                     // in lockstep
+		int done;
+		unsigned long cycles;           // cycle starts since joining
+	} frbus_member;
+
+struct frbus
+	{
+		pthread_mutex_t lock;
+		pthread_cond_t cond;
+		int members;                    // threads taking part in the rounds
+		int arrived;
+		unsigned long gen;
+
+		int fids[FRSIM_MAX_BUFFERS];    // slots served, union of the images
+		int nfids;
+		short slot_of[2048];            // frame ID -> slots[], -1 when not served
+		frbus_slot slots[FRSIM_MAX_BUFFERS];
+
+		unsigned long cycles;
+		double start, end;
+		fr_bus_stats *stats;
+	};
+
+static __thread fr_sim *frbus_thread_sim;
+
+static double frbus_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long frbus_clock(void)
+{
+	return (unsigned long)FrSim_Now(frbus_thread_sim);
+}
+
+//**********************************************************
+// Barrier; threads that stop leave it
+
+static void frbus_release(frbus *bus)
+{
+	bus->arrived = 0;
+	bus->gen++;
+	bus->stats->barriers++;
+	pthread_cond_broadcast(&bus->cond);
+}
+
+static void frbus_wait(frbus *bus)
+{
+	unsigned long gen;
+
+	pthread_mutex_lock(&bus->lock);
+	gen = bus->gen;
+	if (++bus->arrived >= bus->members)
+		frbus_release(bus);
+	else
+		while (gen == bus->gen)
+			pthread_cond_wait(&bus->cond, &bus->lock);
+	pthread_mutex_unlock(&bus->lock);
+}
+
+static void frbus_leave(frbus *bus)
+{
+	pthread_mutex_lock(&bus->lock);
+	bus->members--;
+	if (bus->arrived != 0 && bus->arrived >= bus->members)
+		frbus_release(bus);
+	pthread_mutex_unlock(&bus->lock);
+}
+
+//**********************************************************
+// Model hooks, called in the node's trap handler
+
+static void frbus_tx(void *ctx, const fr_sim_frame *frame)
+{
+	frbus_member *m = ctx;
+	frbus *bus = m->bus;
+	frbus_slot *s;
+	int ch, n;
+
+	if (!m->joined || m->node->listen) return;
+	n = bus->slot_of[frame->fid & 0x7FF];
+	if (n < 0)
+	{
+		m->node->off_schedule++;
+		return;
+	}
+	s = &bus->slots[n];
+	m->node->tx_frames++;
+	pthread_mutex_lock(&bus->lock);
+	if (s->seq != m->cycles)
+	{
+		s->seq = m->cycles;
+		s->senders[0] = s->senders[1] = 0;
+	}
+	for (ch = 0; ch < 2; ch++)
+	{
+		if (!(frame->channels & (FRSIM_CH_A << ch))) continue;
+		if (++s->senders[ch] == 2) bus->stats->collisions++;
+		s->sender[ch] = m->index;
+		s->frame[ch] = *frame;
+	}
+	bus->stats->frames++;
+	pthread_mutex_unlock(&bus->lock);
+}
+
+// the other nodes' frames of the slot, one frame when both channels carry
+// the same node's frame
+static void frbus_deliver(frbus_member *m, frbus_slot *s)
+{
+	fr_sim_frame f;
+	int ch, ok[2];
+
+	if (s->seq != m->cycles) return;
+	for (ch = 0; ch < 2; ch++)
+		ok[ch] = s->senders[ch] == 1 && s->sender[ch] != m->index;
+	if (ok[0] && ok[1] && s->sender[0] == s->sender[1])
+	{
+		f = s->frame[0];
+		f.channels = FRSIM_CH_A | FRSIM_CH_B;
+		if (FrSim_QueueRx(m->sim, &f)) m->node->rx_frames++;
+		return;
+	}
+	for (ch = 0; ch < 2; ch++)
+	{
+		if (!ok[ch]) continue;
+		f = s->frame[ch];
+		f.channels = FRSIM_CH_A << ch;
+		if (FrSim_QueueRx(m->sim, &f)) m->node->rx_frames++;
+	}
+}
+
+static void frbus_mark(frbus *bus, double *t)
+{
+	pthread_mutex_lock(&bus->lock);
+	if (*t == 0) *t = frbus_seconds();
+	pthread_mutex_unlock(&bus->lock);
+}
+
+static void frbus_slot_hook(void *ctx, int cycle, int fid)
+{
+	frbus_member *m = ctx;
+	frbus *bus = m->bus;
+
+	if (fid < 0)
+	{
+		// halted: the others go on without the node
+		if (!m->done) frbus_leave(bus);
+		m->done = 1;
+		m->node->failed = 1;
+		return;
+	}
+	if (fid == 0)
+	{
+		if (!m->joined)
+		{
+			if (cycle != 0) return;
+			m->joined = 1;
+		}
+		// frames no buffer took in the last cycle
+		FrSim_FlushRx(m->sim, (cycle + 63) & 0x3F);
+		if (m->cycles++ == bus->cycles)
+		{
+			frbus_mark(bus, &bus->end);
+			m->done = 1;
+			FrSim_SetTxHook(m->sim, NULL, NULL);
+			FrSim_SetBus(m->sim, NULL, 0, NULL, NULL);
+			frbus_leave(bus);
+			return;
+		}
+		frbus_wait(bus);
+		if (m->cycles == 1) frbus_mark(bus, &bus->start);
+		return;
+	}
+	if (!m->joined || bus->slot_of[fid & 0x7FF] < 0) return;
+	frbus_wait(bus);
+	frbus_deliver(m, &bus->slots[bus->slot_of[fid & 0x7FF]]);
+}
+
+//**********************************************************
+// Node threads
+
+static void frbus_add_image(frbus *bus, const fr_ctx *ctx)
+{
+	int i, fid;
+
+	if (ctx->image == NULL) return;
+	for (i = 0; i < ctx->image->count && bus->nfids < FRSIM_MAX_BUFFERS; i++)
+	{
+		fid = (int)(ctx->image->buffers[i].wrhs1 & 0x7FF);
+		if (fid == 0 || bus->slot_of[fid] >= 0) continue;
+		bus->slot_of[fid] = (short)bus->nfids;
+		bus->fids[bus->nfids++] = fid;
+	}
+}
+
+static void *frbus_thread(void *arg)
+{
+	frbus_member *m = arg;
+	frbus *bus = m->bus;
+	fr_bus_node *n = m->node;
+
+	m->sim = FrSim_Create();
+	if (m->sim == NULL)
+	{
+		n->failed = 1;
+		frbus_leave(bus);
+		return NULL;
+	}
+	frbus_thread_sim = m->sim;
+	Fr_CtxInit(&n->ctx, FrSim_Regs(m->sim));
+	if (n->start(&n->ctx, frbus_clock) != 0)
+	{
+		n->failed = 1;
+		frbus_leave(bus);
+		FrSim_Destroy(m->sim);
+		return NULL;
+	}
+
+	// every node's slots, then on to the first cycle 0 without exchange
+	pthread_mutex_lock(&bus->lock);
+	frbus_add_image(bus, &n->ctx);
+	pthread_mutex_unlock(&bus->lock);
+	frbus_wait(bus);
+	FrSim_SetTxHook(m->sim, frbus_tx, m);
+	FrSim_SetBus(m->sim, bus->fids, bus->nfids, frbus_slot_hook, m);
+
+	while (!m->done)
+	{
+		n->step(&n->ctx);
+		if (!m->done && FrSim_PocState(m->sim) != FRSIM_POC_NORMAL_ACTIVE)
+		{
+			n->failed = 1;
+			m->done = 1;
+			frbus_leave(bus);
+		}
+	}
+	FrSim_Destroy(m->sim);
+	return NULL;
+}
+
+/***********************************************************************
+	FrBus_Run
+	One thread per node; the first barrier round waits for all of them
+	to start and collects the slots, the rounds of the slot hook then
+	keep them in step until each has seen cycles + 1 cycle starts in
+	lockstep. Waits for the threads. The bus and its members are
+	allocated per call, runs on other threads do not share them.
+***********************************************************************/
+
+int FrBus_Run(fr_bus_node *nodes, int count, unsigned long cycles, fr_bus_stats *stats)
+{
+	frbus *bus;
+	frbus_member *members;
+	int i, failed = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	if (count <= 0 || count > FRBUS_MAX_NODES) return -1;
+	bus = calloc(1, sizeof(*bus));
+	members = calloc((size_t)count, sizeof(*members));
+	if (bus == NULL || members == NULL)
+	{
+		free(bus);
+		free(members);
+		return -1;
+	}
+	pthread_mutex_init(&bus->lock, NULL);
+	pthread_cond_init(&bus->cond, NULL);
+	memset(bus->slot_of, 0xFF, sizeof(bus->slot_of));
+	bus->members = count;
+	bus->cycles = cycles;
+	bus->stats = stats;
+
+	for (i = 0; i < count; i++)
+	{
+		members[i].bus = bus;
+		members[i].node = &nodes[i];
+		members[i].index = i;
+		nodes[i].tx_frames = nodes[i].rx_frames = nodes[i].off_schedule = 0;
+		nodes[i].failed = 0;
+	}
+	for (i = 0; i < count; i++)
+		if (pthread_create(&members[i].thread, NULL, frbus_thread, &members[i]) == 0)
+			members[i].started = 1;
+		else
+		{
+			nodes[i].failed = 1;
+			frbus_leave(bus);
+		}
+	for (i = 0; i < count; i++)
+	{
+		if (members[i].started) pthread_join(members[i].thread, NULL);
+		failed |= nodes[i].failed;
+	}
+
+	stats->cycles = cycles;
+	stats->slots = bus->nfids;
+	stats->seconds = bus->end - bus->start;
+	pthread_cond_destroy(&bus->cond);
+	pthread_mutex_destroy(&bus->lock);
+	free(members);
+	free(bus);
+	return failed ? -1 : 0;
+}
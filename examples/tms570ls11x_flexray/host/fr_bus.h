@@ -0,0 +1,59 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Cluster of simulated FlexRay nodes on one bus
+ *
+ *    Runs N controllers on fr_sim, each node's application on its own
+ *    thread, connected by a shared bus: in every slot of the schedule
+ *    the nodes meet at a barrier after their transmit pass and each
+ *    node takes the other nodes' frames of that slot into its receive
+ *    pass; they meet again at every cycle start. Two nodes sending in
+ *    the same slot on the same channel collide and nobody receives
+ *    that channel.
+ *
+ *******************************************************************/
+
+#ifndef FR_BUS_H
+#define FR_BUS_H
+
+#include "fr_sim.h"
+
+#define FRBUS_MAX_NODES      64      // one fr_sim each, see FRSIM_MAX_SIMS
+
+// Configures and starts the node, returns 0 in NORMAL_ACTIVE; clock counts
+// microticks of the node's simulator
+typedef int (*fr_bus_start)(fr_ctx *ctx, fr_clock clock);
+
+// One cycle of the application: returns after handling the next cycle start
+typedef int (*fr_bus_step)(fr_ctx *ctx);
+
+typedef struct fr_bus_node
+	{
+		fr_bus_start start;
+		fr_bus_step step;
+		int listen;                     // 1: the node's frames are not put on the bus
+		// results
+		fr_ctx ctx;
+		unsigned long tx_frames;        // frames put on the bus
+		unsigned long rx_frames;        // frames of other nodes queued to the node
+		unsigned long off_schedule;     // frames sent in a slot the bus does not serve
+		int failed;                     // start failed or the node left NORMAL_ACTIVE
+	} fr_bus_node;
+
+typedef struct fr_bus_stats
+	{
+		unsigned long cycles;           // cycles run in lockstep
+		int slots;                      // slots per cycle with a barrier
+		unsigned long frames;           // frames on the bus
+		unsigned long collisions;       // slot and channel pairs with more than one sender
+		unsigned long long barriers;    // barrier rounds
+		double seconds;                 // wall-clock time of the lockstep cycles
+	} fr_bus_stats;
+
+// Starts count nodes on their own threads and, from the first cycle 0
+// after all of them are in NORMAL_ACTIVE, runs cycles cycles in lockstep.
+// The bus serves every frame ID of the nodes' buffer images; runs on
+// different nodes may overlap. Returns 0, -1 when a node failed or the
+// bus could not be allocated.
+int FrBus_Run(fr_bus_node *nodes, int count, unsigned long cycles, fr_bus_stats *stats);
+
+#endif
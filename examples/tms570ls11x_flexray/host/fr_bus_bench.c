@@ -0,0 +1,92 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Cluster simulation check and benchmark
+ *
+ *    Runs node A and node B (configure, fast startup and
+ *    transmit_check_node_x from FlexRay.c, in place of the TI example
+ *    programs, see fr_bus.c) on their own threads and
+ *    simulators connected by fr_bus, and checks that each sees the
+ *    other's frame every cycle. Two senders per slot must collide.
+ *    Then grows the cluster to 64 nodes, the pair plus listening nodes
+ *    of both images, and reports simulated cycles/s.
+ *
+ *******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fr_bus.h"
+
+static unsigned long cycles = 200;
+static unsigned long bus_errors;
+
+static int bus_start_a(fr_ctx *ctx, fr_clock clock)
+{
+	fr_startup_log log = { 0 };
+	return fast_startup_node_a(ctx, clock, 64 * 224000, &log);
+}
+
+static int bus_start_b(fr_ctx *ctx, fr_clock clock)
+{
+	fr_startup_log log = { 0 };
+	return fast_startup_node_b(ctx, clock, 64 * 224000, &log);
+}
+
+static void bus_setup(fr_bus_node *nodes, int count, int senders)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		nodes[i].start = (i & 1) ? bus_start_b : bus_start_a;
+		nodes[i].step = (i & 1) ? transmit_check_node_b : transmit_check_node_a;
+		nodes[i].listen = i >= senders;
+	}
+}
+
+// rx: frames each node's application must have checked, -1 for none
+static void bus_run(int count, int senders, long rx)
+{
+	static fr_bus_node nodes[FRBUS_MAX_NODES];
+	fr_bus_stats st;
+	unsigned long app_rx = 0, app_errors = 0, off = 0;
+	int i, bad = 0;
+
+	bus_setup(nodes, count, senders);
+	if (FrBus_Run(nodes, count, cycles, &st) != 0)
+		bus_errors++;
+	for (i = 0; i < count; i++)
+	{
+		app_rx += nodes[i].ctx.stats.rx_frames;
+		app_errors += nodes[i].ctx.stats.rx_errors;
+		off += nodes[i].off_schedule;
+		if (rx >= 0 && nodes[i].ctx.stats.rx_frames != (unsigned long)rx) bad++;
+		if (rx < 0 && nodes[i].ctx.stats.rx_frames != 0) bad++;
+	}
+	if (bad != 0 || app_errors != 0 || off != 0) bus_errors++;
+	if (senders > 2 && st.collisions == 0) bus_errors++;
+
+	printf("%2d nodes, %2d sending  %8.0f cycles/s %9.0f node-cycles/s  %d slots, %5.1f rounds/cycle, "
+	       "%lu frames, %lu collisions, %lu rx, %lu errors\n",
+	       count, senders, st.cycles / st.seconds, (double)st.cycles * count / st.seconds, st.slots,
+	       (double)st.barriers / st.cycles, st.frames, st.collisions, app_rx, app_errors);
+}
+
+int main(int argc, char **argv)
+{
+	int n;
+
+	if (argc > 1) cycles = strtoul(argv[1], NULL, 10);
+	if (cycles < 10) cycles = 10;
+	printf("%lu cycles in lockstep per run, node A and B images alternating\n", cycles);
+
+	// each node checks its peer's static frame once a cycle
+	bus_run(2, 2, (long)cycles);
+	// two node A and two node B: every slot collides, nothing is received
+	bus_run(4, 4, -1);
+	for (n = 2; n <= FRBUS_MAX_NODES; n *= 2)
+		bus_run(n, 2, (long)cycles);
+
+	printf("%lu errors\n", bus_errors);
+	return bus_errors != 0;
+}
@@ -0,0 +1,153 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Signal codec equivalence check and benchmark
+ *
+ *    Checks the generated pack/unpack functions of Fr_Signals.h and
+ *    FrDecode_Batch against a bit-by-bit reference extraction on
+ *    random payloads, then times per-frame unpack against the batch
+ *    decoder.
+ *
+ *******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Fr.h"
+#include "Fr_Signals.h"
+#include "fr_decode.h"
+
+#define CODEC_FRAMES  8192
+#define CODEC_WORDS   64      // recorded payload stride, pl 127
+#define CODEC_ROUNDS  20
+
+static const fr_signal codec_slot1[] = { FR_SLOT1_SIGNALS(FR_SIGNAL_ENTRY) };
+static const fr_signal codec_frame9[] = { FR_FRAME9_SIGNALS(FR_SIGNAL_ENTRY) };
+#define CODEC_SIGNALS(table) (int)(sizeof(table) / sizeof(table[0]))
+
+static unsigned int payload32[CODEC_FRAMES * CODEC_WORDS];
+static unsigned long payload[CODEC_FRAMES * CODEC_WORDS];
+static float decoded[16 * CODEC_FRAMES];
+
+static double codec_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/***********************************************************************
+	codec_reference
+	Raw value of a signal taken bit by bit: Intel from the lsb upwards
+	in payload bit order, Motorola msb first along the big-endian
+	stream.
+***********************************************************************/
+
+static unsigned long codec_reference(const unsigned long *w, const fr_signal *sig)
+{
+	unsigned long raw = 0;
+	int b, bit, lin;
+
+	for (b = 0; b < sig->length; b++)
+	{
+		if (sig->order == FR_INTEL)
+		{
+			bit = sig->start + b;
+			raw |= ((w[bit / 32] >> (bit % 32)) & 0x1) << b;
+		}
+		else
+		{
+			lin = FR_SIG_LINEAR(sig->start) + b;
+			bit = (lin / 8) * 8 + 7 - lin % 8;
+			raw = (raw << 1) | ((w[bit / 32] >> (bit % 32)) & 0x1);
+		}
+	}
+	return raw;
+}
+
+static float codec_phys(const unsigned long *w, const fr_signal *sig)
+{
+	return Fr_SigPhys(codec_reference(w, sig), sig->length, sig->sign, sig->factor, sig->offset);
+}
+
+#define CODEC_CHECK(name, start, length, order, sign, factor, offset) \
+	if (s.name != codec_phys(w, &table[i++])) errors++;
+#define CODEC_BATCH(name, start, length, order, sign, factor, offset) \
+	if (s.name != decoded[i++ * CODEC_FRAMES + k]) errors++;
+
+// generated unpack and pack against the reference, then the batch decoder
+// against the generated unpack
+#define CODEC_VERIFY(frame, SIGNALS, table, errors) \
+	{ \
+		frame s; \
+		unsigned long packed[CODEC_WORDS]; \
+		const unsigned long *w; \
+		int i, j, k; \
+		FrDecode_Batch(table, CODEC_SIGNALS(table), payload32, CODEC_WORDS, CODEC_FRAMES, decoded); \
+		for (k = 0; k < CODEC_FRAMES; k++) \
+		{ \
+			w = &payload[k * CODEC_WORDS]; \
+			frame##_unpack(&payload[k * CODEC_WORDS], &s); \
+			i = 0; \
+			SIGNALS(CODEC_CHECK) \
+			i = 0; \
+			SIGNALS(CODEC_BATCH) \
+			for (j = 0; j < CODEC_WORDS; j++) packed[j] = 0; \
+			frame##_pack(packed, &s); \
+			for (j = 0; j < CODEC_SIGNALS(table); j++) \
+				if (codec_reference(packed, &table[j]) != codec_reference(w, &table[j])) errors++; \
+		} \
+	}
+
+#define CODEC_TIME(label, frame, table) \
+	{ \
+		frame s; \
+		double start, unpack, batch; \
+		float sum = 0; \
+		int r, k, j; \
+		start = codec_seconds(); \
+		for (r = 0; r < CODEC_ROUNDS; r++) \
+			for (k = 0; k < CODEC_FRAMES; k++) \
+			{ \
+				frame##_unpack(&payload[k * CODEC_WORDS], &s); \
+				for (j = 0; j < (int)(sizeof(s) / sizeof(float)); j++) \
+					sum += ((float *)&s)[j]; \
+			} \
+		unpack = codec_seconds() - start; \
+		start = codec_seconds(); \
+		for (r = 0; r < CODEC_ROUNDS; r++) \
+		{ \
+			FrDecode_Batch(table, CODEC_SIGNALS(table), payload32, CODEC_WORDS, CODEC_FRAMES, decoded); \
+			for (k = 0; k < CODEC_SIGNALS(table) * CODEC_FRAMES; k++) \
+				sum += decoded[k]; \
+		} \
+		batch = codec_seconds() - start; \
+		printf("%-12s %2d signals  unpack %8.2f Mframes/s  FrDecode_Batch %8.2f Mframes/s (%.2fx)  (sum %g)\n", \
+		       label, CODEC_SIGNALS(table), CODEC_ROUNDS * CODEC_FRAMES / unpack * 1e-6, \
+		       CODEC_ROUNDS * CODEC_FRAMES / batch * 1e-6, unpack / batch, sum); \
+	}
+
+int main(void)
+{
+	const fr_signal *table;
+	unsigned long errors = 0;
+	int k;
+
+	srand(1);
+	for (k = 0; k < CODEC_FRAMES * CODEC_WORDS; k++)
+	{
+		payload32[k] = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+		payload[k] = payload32[k];
+	}
+
+	table = codec_slot1;
+	CODEC_VERIFY(fr_slot1, FR_SLOT1_SIGNALS, codec_slot1, errors);
+	table = codec_frame9;
+	CODEC_VERIFY(fr_frame9, FR_FRAME9_SIGNALS, codec_frame9, errors);
+	printf("%d frames x %d signals checked, %lu mismatches\n",
+	       CODEC_FRAMES, CODEC_SIGNALS(codec_slot1) + CODEC_SIGNALS(codec_frame9), errors);
+
+	CODEC_TIME("fr_slot1", fr_slot1, codec_slot1);
+	CODEC_TIME("fr_frame9", fr_frame9, codec_frame9);
+	return errors != 0;
+}
@@ -0,0 +1,147 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Header CRC equivalence check and benchmark
+ *
+ *    Compares header_crc_calc and the build time FR_HEADER_CRC
+ *    against the original bit-serial implementation for all 2^20
+ *    header inputs, then times the bit-serial, table-driven and batch
+ *    versions.
+ *
+ *******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Fr.h"
+#include "Fr_Schedule.h"
+
+#define CRC_HEADERS   (1 << 20)
+#define CRC_BATCH     64
+
+/***********************************************************************
+	header_crc_calc_serial
+	The original bit-serial header CRC, kept as the reference.
+***********************************************************************/
+
+static int header_crc_calc_serial(wrhs *Fr_LPduPtr)
+{
+  unsigned int header;
+
+  int CrcInit = 0x1A;
+  int length  = 20;
+  int CrcNext;
+  unsigned long CrcPoly  = 0x385;
+  unsigned long CrcReg_X = CrcInit;
+  unsigned long header_temp, reg_temp;
+
+  header  = ((Fr_LPduPtr->sync & 0x1)  << 19) | ((Fr_LPduPtr->sfi & 0x1) << 18);
+  header |= ((Fr_LPduPtr->fid & 0x7FF) <<  7) |  (Fr_LPduPtr->pl & 0x7F);
+
+  header   <<= 11;
+  CrcReg_X <<= 21;
+  CrcPoly  <<= 21;
+
+  while(length--) {
+    header    <<= 1;
+    header_temp = header & 0x80000000;
+    reg_temp    = CrcReg_X & 0x80000000;
+
+    if(header_temp ^ reg_temp){  // Step 1
+      CrcNext = 1;
+    } else {
+      CrcNext = 0;
+    }
+
+    CrcReg_X <<= 1;              // Step 2
+
+    if(CrcNext) {
+      CrcReg_X ^= CrcPoly;       // Step 3
+    }
+  }
+
+  CrcReg_X >>= 21;
+
+  // unsigned long is 32 bits on the target
+  return CrcReg_X & 0x7FF;
+}
+
+static void crc_header(wrhs *w, unsigned int header)
+{
+	w->sync = (header >> 19) & 0x1;
+	w->sfi  = (header >> 18) & 0x1;
+	w->fid  = (header >> 7) & 0x7FF;
+	w->pl   = header & 0x7F;
+}
+
+static double crc_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	static wrhs batch[CRC_BATCH];
+	wrhs w = { 0 };
+	unsigned int header, i;
+	unsigned long sum = 0;
+	double start, serial, table, batched;
+	int errors = 0;
+
+	for (header = 0; header < CRC_HEADERS; header++)
+	{
+		crc_header(&w, header);
+		if (header_crc_calc(&w) != header_crc_calc_serial(&w) ||
+		    FR_HEADER_CRC(header >> 19, header >> 18, header >> 7, header & 0x7F) != header_crc_calc_serial(&w))
+		{
+			if (errors++ < 10)
+				printf("mismatch for header 0x%05X: %03X != %03X\n",
+				       header, header_crc_calc(&w), header_crc_calc_serial(&w));
+		}
+	}
+	for (header = 0; header < CRC_HEADERS; header += CRC_BATCH)
+	{
+		for (i = 0; i < CRC_BATCH; i++)
+			crc_header(&batch[i], header + i);
+		header_crc_calc_batch(batch, CRC_BATCH);
+		for (i = 0; i < CRC_BATCH; i++)
+			if (batch[i].crc != header_crc_calc_serial(&batch[i]) && errors++ < 10)
+				printf("batch mismatch for header 0x%05X\n", header + i);
+	}
+	printf("header CRC: %d mismatches over %d headers\n", errors, CRC_HEADERS);
+
+	start = crc_seconds();
+	for (header = 0; header < CRC_HEADERS; header++)
+	{
+		crc_header(&w, header);
+		sum += header_crc_calc_serial(&w);
+	}
+	serial = crc_seconds() - start;
+
+	start = crc_seconds();
+	for (header = 0; header < CRC_HEADERS; header++)
+	{
+		crc_header(&w, header);
+		sum += header_crc_calc(&w);
+	}
+	table = crc_seconds() - start;
+
+	start = crc_seconds();
+	for (header = 0; header < CRC_HEADERS; header += CRC_BATCH)
+	{
+		for (i = 0; i < CRC_BATCH; i++)
+			crc_header(&batch[i], header + i);
+		header_crc_calc_batch(batch, CRC_BATCH);
+		sum += batch[CRC_BATCH - 1].crc;
+	}
+	batched = crc_seconds() - start;
+
+	printf("%-24s %8.1f Mcrc/s\n", "bit-serial", CRC_HEADERS / serial * 1e-6);
+	printf("%-24s %8.1f Mcrc/s\n", "header_crc_calc", CRC_HEADERS / table * 1e-6);
+	printf("%-24s %8.1f Mcrc/s\n", "header_crc_calc_batch", CRC_HEADERS / batched * 1e-6);
+	printf("(checksum %lu)\n", sum);
+
+	return errors != 0;
+}
@@ -0,0 +1,22 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Batch signal decoder for recorded FlexRay frames
+ *
+ *    Host side counterpart of the Fr_Codec.h unpack functions: decodes
+ *    one signal list over thousands of recorded payloads per call,
+ *    signal by signal, with the inner loops in a form the compiler
+ *    vectorizes.
+ *
+ *******************************************************************/
+
+#ifndef FR_DECODE_H
+#define FR_DECODE_H
+
+#include "Fr_Codec.h"
+
+// Decodes count payloads of 32-bit words (WRDS/RDDS layout), stride words
+// apart, into out[s * count + k] = physical value of signals[s] in frame k.
+void FrDecode_Batch(const fr_signal *signals, int nsignals, const unsigned int *payloads,
+                    int stride, int count, float *out);
+
+#endif
@@ -0,0 +1,123 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: RAM disk behind FatFs for the host build
+ *
+ *    diskio functions of drive 0 on a 32 MB image and a formatter,
+ *    since the ffconf.h of the target build has no f_mkfs. The
+ *    volume has no partition table: sector 0 is the FAT16 boot
+ *    sector, then two FATs, the root directory and the clusters.
+ *
+ *******************************************************************/
+
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "fr_disk.h"
+
+#define FR_DISK_SS        512
+#define FR_DISK_SECTORS   65536
+#define FR_DISK_CLUSTER   16                // sectors, 8 KB: 4091 clusters
+#define FR_DISK_FAT       16                // sectors per FAT, 2 bytes per cluster
+#define FR_DISK_ROOT      512               // root directory entries
+
+fr_disk_stats FrDisk_Stats;
+
+static unsigned char frdisk_image[FR_DISK_SECTORS][FR_DISK_SS];
+
+static void frdisk_word(unsigned char *p, unsigned int v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+}
+
+static void frdisk_dword(unsigned char *p, unsigned long v)
+{
+	frdisk_word(p, (unsigned int)(v & 0xFFFF));
+	frdisk_word(p + 2, (unsigned int)(v >> 16));
+}
+
+void FrDisk_Format(void)
+{
+	unsigned char *bs = frdisk_image[0];
+	int f;
+
+	memset(frdisk_image, 0, FR_DISK_SS * (1 + 2 * FR_DISK_FAT + FR_DISK_ROOT * 32 / FR_DISK_SS));
+	memcpy(bs, "\xEB\x3C\x90" "MSDOS5.0", 11);
+	frdisk_word(bs + 11, FR_DISK_SS);       // BPB_BytsPerSec
+	bs[13] = FR_DISK_CLUSTER;               // BPB_SecPerClus
+	frdisk_word(bs + 14, 1);                // BPB_RsvdSecCnt
+	bs[16] = 2;                             // BPB_NumFATs
+	frdisk_word(bs + 17, FR_DISK_ROOT);     // BPB_RootEntCnt
+	frdisk_word(bs + 19, 0);                // BPB_TotSec16, see BPB_TotSec32
+	bs[21] = 0xF8;                          // BPB_Media, fixed disk
+	frdisk_word(bs + 22, FR_DISK_FAT);      // BPB_FATSz16
+	frdisk_word(bs + 24, 63);               // BPB_SecPerTrk
+	frdisk_word(bs + 26, 255);              // BPB_NumHeads
+	frdisk_dword(bs + 32, FR_DISK_SECTORS); // BPB_TotSec32
+	bs[36] = 0x80;                          // BS_DrvNum
+	bs[38] = 0x29;                          // BS_BootSig
+	frdisk_dword(bs + 39, 0x46524452);      // BS_VolID
+	memcpy(bs + 43, "NO NAME    FAT16   ", 19);
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+	for (f = 0; f < 2; f++)                 // clusters 0 and 1 reserved
+	{
+		frdisk_word(frdisk_image[1 + f * FR_DISK_FAT], 0xFFF8);
+		frdisk_word(frdisk_image[1 + f * FR_DISK_FAT] + 2, 0xFFFF);
+	}
+	memset(&FrDisk_Stats, 0, sizeof(FrDisk_Stats));
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != 0 || sector + count > FR_DISK_SECTORS) return RES_PARERR;
+	memcpy(buff, frdisk_image[sector], (size_t)count * FR_DISK_SS);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != 0 || sector + count > FR_DISK_SECTORS) return RES_PARERR;
+	memcpy(frdisk_image[sector], buff, (size_t)count * FR_DISK_SS);
+	FrDisk_Stats.writes++;
+	FrDisk_Stats.sectors += count;
+	if (count > 1) FrDisk_Stats.multi++;
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	if (pdrv != 0) return RES_PARERR;
+	switch (cmd)
+	{
+	case CTRL_SYNC:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = FR_DISK_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = FR_DISK_SS;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+// 2015-01-01 00:00, as _NORTC_YEAR of ffconf.h
+DWORD get_fattime(void)
+{
+	return ((DWORD)(2015 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
@@ -0,0 +1,27 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: RAM disk behind FatFs for the host build
+ *
+ *    Stands in for the SD card (fatfs/port/mmc-test.c) so Fr_Trace.c
+ *    runs unchanged on the host: a FAT16 volume formatted in memory,
+ *    with the disk_write calls and sectors counted.
+ *
+ *******************************************************************/
+
+#ifndef FR_DISK_H
+#define FR_DISK_H
+
+typedef struct fr_disk_stats
+	{
+		unsigned long writes;           // disk_write calls
+		unsigned long sectors;          // sectors written
+		unsigned long multi;            // disk_write calls of more than one sector
+	} fr_disk_stats;
+
+extern fr_disk_stats FrDisk_Stats;
+
+// Creates an empty 32 MB FAT16 volume; mount it with
+// f_mount(&fs, "", 1). Clears FrDisk_Stats.
+void FrDisk_Format(void);
+
+#endif
@@ -0,0 +1,482 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Indexed FlexRay trace files
+ *
+ *    Writer, converter from Fr_Trace.c recordings and mmap based
+ *    reader of the format in fr_index.h. Times in a trace are not
+ *    strictly ordered (commit records are stamped at hand-over), so
+ *    the reader keeps the running maximum of the chunks' max_time and
+ *    the running minimum of their min_time from the end: both are
+ *    monotonic and bound the chunks a time range can touch by binary
+ *    search.
+ *
+ *******************************************************************/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fr_index.h"
+
+#define FRINDEX_RECORD_MAX (10 + 8 + 64 * 4)   // longest varint time, fields, payload
+
+struct frindex_writer
+	{
+		FILE *f;
+		frindex_file header;
+		unsigned long long offset;          // end of the file so far
+		unsigned char *buf;                 // open chunk
+		size_t used;
+		frindex_chunk chunk;
+		unsigned long long last_time;
+		frindex_chunk block[FRINDEX_BLOCK];
+		int blocked;                        // chunks in block
+		int error;
+	};
+
+struct frindex_reader
+	{
+		const unsigned char *map;
+		size_t size;
+		frindex_file header;
+		frindex_chunk *chunks;              // in file order
+		int count;
+		unsigned long long *prefix_max;     // max of max_time over chunks 0..i
+		unsigned long long *suffix_min;     // min of min_time over chunks i..count-1
+	};
+
+//**********************************************************
+// Writer
+
+static void frindex_write(frindex_writer *w, const void *p, size_t n)
+{
+	if (fwrite(p, 1, n, w->f) != n) w->error = 1;
+	w->offset += n;
+}
+
+static void frindex_write_block(frindex_writer *w)
+{
+	frindex_block b;
+
+	b.magic = FRINDEX_BLOCK_MAGIC;
+	b.count = (unsigned int)w->blocked;
+	b.previous = w->header.last_index;
+	w->header.last_index = w->offset;
+	frindex_write(w, &b, sizeof(b));
+	frindex_write(w, w->block, sizeof(frindex_chunk) * w->blocked);
+	w->blocked = 0;
+}
+
+static void frindex_write_chunk(frindex_writer *w)
+{
+	w->chunk.offset = w->offset;
+	w->chunk.bytes = (unsigned int)w->used;
+	frindex_write(w, w->buf, w->used);
+	w->block[w->blocked++] = w->chunk;
+	w->header.chunks++;
+	memset(&w->chunk, 0, sizeof(w->chunk));
+	w->used = 0;
+	if (w->blocked == FRINDEX_BLOCK) frindex_write_block(w);
+}
+
+frindex_writer *FrIndex_Create(const char *path, unsigned int flags, unsigned int macro_per_cycle,
+                               unsigned int macrotick_ns)
+{
+	frindex_writer *w = calloc(1, sizeof(*w));
+
+	if (w == NULL) return NULL;
+	w->buf = malloc((size_t)FRINDEX_CHUNK * FRINDEX_RECORD_MAX);
+	w->f = fopen(path, "wb");
+	if (w->buf == NULL || w->f == NULL)
+	{
+		if (w->f != NULL) fclose(w->f);
+		free(w->buf);
+		free(w);
+		return NULL;
+	}
+	w->header.magic = FRINDEX_MAGIC;
+	w->header.version = FRINDEX_VERSION;
+	w->header.flags = flags;
+	w->header.macro_per_cycle = macro_per_cycle;
+	w->header.macrotick_ns = macrotick_ns;
+	frindex_write(w, &w->header, sizeof(w->header));   // rewritten by FrIndex_Finish
+	return w;
+}
+
+int FrIndex_Append(frindex_writer *w, const fr_trace_record *rec, const unsigned int *data)
+{
+	unsigned long long time = ((unsigned long long)rec->time[1] << 32) | rec->time[0];
+	unsigned char *p = w->buf + w->used;
+	int words = rec->words > 64 ? 64 : rec->words;
+
+	if (w->chunk.records == 0)
+	{
+		w->chunk.first_time = w->chunk.min_time = w->chunk.max_time = time;
+		w->last_time = time;
+	}
+	if (w->header.flags & FRINDEX_DELTA)
+	{
+		long long d = (long long)(time - w->last_time);
+		unsigned long long z = ((unsigned long long)d << 1) ^ (unsigned long long)(d >> 63);
+		while (z >= 0x80)
+		{
+			*p++ = (unsigned char)(z | 0x80);
+			z >>= 7;
+		}
+		*p++ = (unsigned char)z;
+	}
+	else
+	{
+		memcpy(p, &time, 8);
+		p += 8;
+	}
+	memcpy(p, &rec->fid, 2);
+	p[2] = rec->cycle;
+	p[3] = rec->flags;
+	memcpy(p + 4, &rec->status, 2);
+	p[6] = rec->pl;
+	p[7] = (unsigned char)words;
+	memcpy(p + 8, data, (size_t)words * 4);
+	w->used = (size_t)(p + 8 + words * 4 - w->buf);
+
+	w->last_time = time;
+	if (time < w->chunk.min_time) w->chunk.min_time = time;
+	if (time > w->chunk.max_time) w->chunk.max_time = time;
+	w->chunk.ids[(rec->fid & 0x7FF) >> 5] |= 1u << (rec->fid & 0x1F);
+	w->header.records++;
+	if (++w->chunk.records == FRINDEX_CHUNK) frindex_write_chunk(w);
+	return w->error ? -1 : 0;
+}
+
+int FrIndex_Finish(frindex_writer *w)
+{
+	int error;
+
+	if (w->chunk.records != 0) frindex_write_chunk(w);
+	if (w->blocked != 0) frindex_write_block(w);
+	if (fseek(w->f, 0, SEEK_SET) != 0) w->error = 1;
+	else if (fwrite(&w->header, sizeof(w->header), 1, w->f) != 1) w->error = 1;
+	if (fclose(w->f) != 0) w->error = 1;
+	error = w->error;
+	free(w->buf);
+	free(w);
+	return error ? -1 : 0;
+}
+
+// a recording from a CPU of the other byte order, such as the big-endian
+// TMS570 read on a little-endian host
+static unsigned int frindex_swap32(unsigned int v)
+{
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v & 0xFF00) << 8) | (v << 24);
+}
+
+static unsigned short frindex_swap16(unsigned short v)
+{
+	return (unsigned short)((v >> 8) | (v << 8));
+}
+
+long FrIndex_Convert(const char *raw, const char *path, unsigned int flags)
+{
+	fr_trace_file header;
+	fr_trace_record rec;
+	unsigned int data[256];
+	frindex_writer *w;
+	FILE *f = fopen(raw, "rb");
+	long n = 0;
+	int swap, k;
+
+	if (f == NULL) return -1;
+	if (fread(&header, sizeof(header), 1, f) != 1)
+		header.magic = 0;
+	swap = header.magic == frindex_swap32(FR_TRACE_MAGIC);
+	if (swap)
+	{
+		header.magic = FR_TRACE_MAGIC;
+		header.version = frindex_swap32(header.version);
+		header.macro_per_cycle = frindex_swap32(header.macro_per_cycle);
+		header.macrotick_ns = frindex_swap32(header.macrotick_ns);
+	}
+	if (header.magic != FR_TRACE_MAGIC
+	    || (w = FrIndex_Create(path, flags, header.macro_per_cycle, header.macrotick_ns)) == NULL)
+	{
+		fclose(f);
+		return -1;
+	}
+	while (fread(&rec, sizeof(rec), 1, f) == 1)
+	{
+		if (fread(data, 4, rec.words, f) != rec.words)
+		{
+			n = -1;
+			break;
+		}
+		if (swap)
+		{
+			rec.time[0] = frindex_swap32(rec.time[0]);
+			rec.time[1] = frindex_swap32(rec.time[1]);
+			rec.fid = frindex_swap16(rec.fid);
+			rec.status = frindex_swap16(rec.status);
+			for (k = 0; k < rec.words; k++)
+				data[k] = frindex_swap32(data[k]);
+		}
+		if (FrIndex_Append(w, &rec, data) != 0)
+		{
+			n = -1;
+			break;
+		}
+		n++;
+	}
+	fclose(f);
+	if (FrIndex_Finish(w) != 0) n = -1;
+	return n;
+}
+
+//**********************************************************
+// Reader
+
+frindex_reader *FrIndex_Open(const char *path)
+{
+	frindex_reader *r;
+	frindex_block b;
+	unsigned long long at, *blocks = NULL;
+	struct stat st;
+	int fd, nblocks = 0, i, k;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+	r = calloc(1, sizeof(*r));
+	if (r == NULL || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(frindex_file))
+		goto fail;
+	r->size = (size_t)st.st_size;
+	r->map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (r->map == MAP_FAILED)
+	{
+		r->map = NULL;
+		goto fail;
+	}
+	close(fd);
+	fd = -1;
+	memcpy(&r->header, r->map, sizeof(r->header));
+	if (r->header.magic != FRINDEX_MAGIC || r->header.version != FRINDEX_VERSION)
+		goto fail;
+
+	// index blocks are chained from the last one backwards
+	r->chunks = malloc(sizeof(frindex_chunk) * (r->header.chunks + 1));
+	blocks = malloc(sizeof(*blocks) * (r->header.chunks / FRINDEX_BLOCK + 2));
+	if (r->chunks == NULL || blocks == NULL) goto fail;
+	for (at = r->header.last_index; at != 0; at = b.previous)
+	{
+		if (at + sizeof(b) > r->size || nblocks > (int)(r->header.chunks / FRINDEX_BLOCK + 1)) goto fail;
+		memcpy(&b, r->map + at, sizeof(b));
+		if (b.magic != FRINDEX_BLOCK_MAGIC || at + sizeof(b) + sizeof(frindex_chunk) * b.count > r->size)
+			goto fail;
+		blocks[nblocks++] = at;
+	}
+	for (i = nblocks - 1; i >= 0; i--)
+	{
+		memcpy(&b, r->map + blocks[i], sizeof(b));
+		if (r->count + (int)b.count > (int)r->header.chunks) goto fail;
+		memcpy(&r->chunks[r->count], r->map + blocks[i] + sizeof(b), sizeof(frindex_chunk) * b.count);
+		r->count += (int)b.count;
+	}
+	free(blocks);
+	blocks = NULL;
+
+	r->prefix_max = malloc(sizeof(unsigned long long) * (r->count + 1));
+	r->suffix_min = malloc(sizeof(unsigned long long) * (r->count + 1));
+	if (r->prefix_max == NULL || r->suffix_min == NULL) goto fail;
+	for (k = 0; k < r->count; k++)
+	{
+		if (r->chunks[k].offset + r->chunks[k].bytes > r->size) goto fail;
+		r->prefix_max[k] = k == 0 || r->chunks[k].max_time > r->prefix_max[k - 1]
+		                 ? r->chunks[k].max_time : r->prefix_max[k - 1];
+	}
+	for (k = r->count - 1; k >= 0; k--)
+		r->suffix_min[k] = k == r->count - 1 || r->chunks[k].min_time < r->suffix_min[k + 1]
+		                 ? r->chunks[k].min_time : r->suffix_min[k + 1];
+	return r;
+
+fail:
+	free(blocks);
+	if (fd >= 0) close(fd);
+	if (r != NULL) FrIndex_Close(r);
+	return NULL;
+}
+
+const frindex_file *FrIndex_Header(const frindex_reader *r)
+{
+	return &r->header;
+}
+
+void FrIndex_Close(frindex_reader *r)
+{
+	if (r->map != NULL) munmap((void *)r->map, r->size);
+	free(r->chunks);
+	free(r->prefix_max);
+	free(r->suffix_min);
+	free(r);
+}
+
+// Chunks decoded by one thread: a slice of the selected ones, each decoded
+// into frames of its own, joined in file order afterwards
+typedef struct frindex_job
+	{
+		const frindex_reader *r;
+		const int *select;
+		int count;
+		int fid;
+		unsigned long long t1, t2;
+		frindex_frame *frames;
+		long n, size;
+	} frindex_job;
+
+// -1 if out of memory, or if a record runs past the end of the chunk or
+// claims more than 64 payload words
+static int frindex_decode(frindex_job *j, const frindex_chunk *c)
+{
+	const unsigned char *p = j->r->map + c->offset, *end = p + c->bytes;
+	int delta = (j->r->header.flags & FRINDEX_DELTA) != 0;
+	unsigned long long time = c->first_time, z;
+	unsigned short fid;
+	frindex_frame *f;
+	int shift, words;
+
+	while (p < end)
+	{
+		if (delta)
+		{
+			z = 0;
+			shift = 0;
+			do
+			{
+				if (p == end || shift > 63) return -1;
+				z |= (unsigned long long)(*p & 0x7F) << shift;
+				shift += 7;
+			} while (*p++ & 0x80);
+			time += (unsigned long long)((long long)(z >> 1) ^ -(long long)(z & 0x1));
+		}
+		else
+		{
+			if (end - p < 8) return -1;
+			memcpy(&time, p, 8);
+			p += 8;
+		}
+		if (end - p < 8) return -1;
+		memcpy(&fid, p, 2);
+		words = p[7];
+		if (words > 64 || end - p < 8 + words * 4) return -1;
+		if ((j->fid < 0 || fid == j->fid) && time >= j->t1 && time <= j->t2)
+		{
+			if (j->n == j->size)
+			{
+				j->size = j->size ? 2 * j->size : 256;
+				f = realloc(j->frames, sizeof(frindex_frame) * j->size);
+				if (f == NULL) return -1;
+				j->frames = f;
+			}
+			f = &j->frames[j->n++];
+			f->time = time;
+			f->fid = fid;
+			f->cycle = p[2];
+			f->flags = p[3];
+			memcpy(&f->status, p + 4, 2);
+			f->pl = p[6];
+			f->words = (unsigned char)words;
+			memcpy(f->data, p + 8, (size_t)words * 4);
+		}
+		p += 8 + words * 4;
+	}
+	return 0;
+}
+
+static void *frindex_thread(void *arg)
+{
+	frindex_job *j = arg;
+	int i;
+
+	for (i = 0; i < j->count; i++)
+		if (frindex_decode(j, &j->r->chunks[j->select[i]]) != 0)
+		{
+			j->n = -1;
+			break;
+		}
+	return NULL;
+}
+
+long FrIndex_Query(frindex_reader *r, int fid, unsigned long long t1, unsigned long long t2,
+                   int threads, frindex_frame **out, int *chunks)
+{
+	frindex_job job[64];
+	pthread_t tid[64];
+	int started[64];
+	int *select, lo, hi, mid, first, last, n = 0, i, k;
+	long total = 0;
+
+	*out = NULL;
+	if (chunks != NULL) *chunks = 0;
+	// first chunk that may reach t1, last one that may start before t2
+	for (lo = 0, hi = r->count; lo < hi; )
+	{
+		mid = (lo + hi) / 2;
+		if (r->prefix_max[mid] < t1) lo = mid + 1; else hi = mid;
+	}
+	first = lo;
+	for (lo = first, hi = r->count; lo < hi; )
+	{
+		mid = (lo + hi) / 2;
+		if (r->suffix_min[mid] <= t2) lo = mid + 1; else hi = mid;
+	}
+	last = lo;
+
+	select = malloc(sizeof(int) * (last - first + 1));
+	if (select == NULL) return -1;
+	for (k = first; k < last; k++)
+		if (r->chunks[k].max_time >= t1 && r->chunks[k].min_time <= t2
+		    && (fid < 0 || ((r->chunks[k].ids[(fid & 0x7FF) >> 5] >> (fid & 0x1F)) & 0x1)))
+			select[n++] = k;
+	if (chunks != NULL) *chunks = n;
+
+	if (threads > 64) threads = 64;
+	if (threads > n) threads = n;
+	if (threads < 1) threads = 1;
+	memset(job, 0, sizeof(job));
+	for (i = 0; i < threads; i++)
+	{
+		job[i].r = r;
+		job[i].select = select + (long)n * i / threads;
+		job[i].count = (int)((long)n * (i + 1) / threads - (long)n * i / threads);
+		job[i].fid = fid;
+		job[i].t1 = t1;
+		job[i].t2 = t2;
+	}
+	if (threads == 1)
+		frindex_thread(&job[0]);
+	else
+	{
+		for (i = 0; i < threads; i++)
+		{
+			started[i] = pthread_create(&tid[i], NULL, frindex_thread, &job[i]) == 0;
+			if (!started[i]) frindex_thread(&job[i]);
+		}
+		for (i = 0; i < threads; i++)
+			if (started[i]) pthread_join(tid[i], NULL);
+	}
+	free(select);
+
+	for (i = 0; i < threads; i++)
+		total = job[i].n < 0 || total < 0 ? -1 : total + job[i].n;
+	if (total > 0)
+	{
+		*out = malloc(sizeof(frindex_frame) * total);
+		if (*out == NULL) total = -1;
+	}
+	for (i = 0, k = 0; total > 0 && i < threads; k += job[i].n, i++)
+		memcpy(*out + k, job[i].frames, sizeof(frindex_frame) * job[i].n);
+	for (i = 0; i < threads; i++)
+		free(job[i].frames);
+	return total;
+}
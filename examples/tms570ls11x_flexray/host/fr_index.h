@@ -0,0 +1,115 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Indexed FlexRay trace files
+ *
+ *    Chunked form of the bus trace written by Fr_Trace.c. Records are
+ *    grouped into chunks of up to FRINDEX_CHUNK records; after every
+ *    FRINDEX_BLOCK chunks an index block lists their offsets, time
+ *    range and a bitmap of the frame IDs they hold. The reader maps
+ *    the file and answers (ID, t1..t2) by binary search over the
+ *    chunk times and the ID bitmaps, decoding only the chunks that
+ *    can match, on several threads.
+ *
+ *******************************************************************/
+
+#ifndef FR_INDEX_H
+#define FR_INDEX_H
+
+#include "Fr.h"
+
+// File layout, all in the byte order of the writing host:
+//     frindex_file                       header, last_index filled in at the end
+//     chunk, chunk, .. index block       FRINDEX_BLOCK chunks per index block
+//     chunk, .. index block              the last one may be shorter
+// A chunk is a run of records: time, then fid (2 bytes), cycle, flags,
+// status (2 bytes), pl, words (1 byte each) and words payload words of
+// 4 bytes. Time is 8 bytes, or with FRINDEX_DELTA the zigzag LEB128
+// difference to the previous record of the chunk (the first one to the
+// chunk's first_time). An index block is a frindex_block and count
+// frindex_chunk entries.
+#define FRINDEX_MAGIC      0x49544652      // "FRTI"
+#define FRINDEX_BLOCK_MAGIC 0x58495246     // "FRIX"
+#define FRINDEX_VERSION    1
+#define FRINDEX_CHUNK      1024            // records per chunk
+#define FRINDEX_BLOCK      64              // chunks per index block
+#define FRINDEX_IDS        2048            // 11-bit frame IDs
+
+// frindex_file.flags
+#define FRINDEX_DELTA      0x1             // delta encoded times
+
+typedef struct frindex_file
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned int flags;
+		unsigned int macro_per_cycle;
+		unsigned int macrotick_ns;
+		unsigned int chunks;
+		unsigned long long records;
+		unsigned long long last_index;      // offset of the last index block, 0 if none
+	} frindex_file;
+
+typedef struct frindex_chunk
+	{
+		unsigned long long offset;
+		unsigned long long first_time;      // time of the first record
+		unsigned long long min_time;
+		unsigned long long max_time;
+		unsigned int records;
+		unsigned int bytes;
+		unsigned int ids[FRINDEX_IDS / 32]; // bit fid set if the chunk holds the ID
+	} frindex_chunk;
+
+typedef struct frindex_block
+	{
+		unsigned int magic;
+		unsigned int count;                 // frindex_chunk entries that follow
+		unsigned long long previous;        // offset of the index block before, 0 if none
+	} frindex_block;
+
+// One decoded record
+typedef struct frindex_frame
+	{
+		unsigned long long time;            // global time, macroticks
+		unsigned short fid;
+		unsigned char cycle;
+		unsigned char flags;                // FR_TRACE_CH_A, FR_TRACE_CH_B, FR_TRACE_COMMIT
+		unsigned short status;
+		unsigned char pl;
+		unsigned char words;
+		unsigned int data[64];
+	} frindex_frame;
+
+typedef struct frindex_writer frindex_writer;
+typedef struct frindex_reader frindex_reader;
+
+// Writing: records in any time order; Finish writes the open chunk, the
+// last index block and the header. 0 on success, -1 on a file error.
+frindex_writer *FrIndex_Create(const char *path, unsigned int flags, unsigned int macro_per_cycle,
+                               unsigned int macrotick_ns);
+int FrIndex_Append(frindex_writer *w, const fr_trace_record *rec, const unsigned int *data);
+int FrIndex_Finish(frindex_writer *w);
+
+// Converts a Fr_Trace.c recording (fr_trace_file and records), written in
+// either byte order: a byte-swapped magic has every header and record field
+// and payload word swapped, as from the big-endian TMS570. Returns the
+// records converted, -1 if raw is no trace or a file failed.
+long FrIndex_Convert(const char *raw, const char *path, unsigned int flags);
+
+// Reading: FrIndex_Open maps the file and loads the index blocks.
+frindex_reader *FrIndex_Open(const char *path);
+const frindex_file *FrIndex_Header(const frindex_reader *r);
+void FrIndex_Close(frindex_reader *r);
+
+// Frames with ID fid (-1: all) and t1 <= time <= t2 in file order, decoded
+// on up to threads threads into *out (malloc'd, free by the caller).
+// Returns the count, -1 if out of memory or a selected chunk is corrupt.
+// *chunks, when given, receives the number of chunks decoded. A query that
+// selects every chunk (a common ID over the whole file) decodes as fast as
+// a linear scan once the map is resident; the first one on a reader also
+// pays for faulting in the map, about twice a linear scan of a recording
+// already in memory.
+long FrIndex_Query(frindex_reader *r, int fid, unsigned long long t1, unsigned long long t2,
+                   int threads, frindex_frame **out, int *chunks);
+
+#endif
@@ -0,0 +1,330 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Indexed trace file check and benchmark
+ *
+ *    Writes a synthetic Fr_Trace.c recording of a busy cluster,
+ *    converts it with FrIndex_Convert (plain and delta encoded times)
+ *    and checks FrIndex_Query against a linear scan of the recording
+ *    for narrow and wide (ID, time) queries, timing both and the
+ *    query on 1 and several threads, that a corrupt chunk fails
+ *    the query, and that a big-endian recording converts to the same
+ *    file.
+ *
+ *******************************************************************/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "fr_index.h"
+
+#define INDEX_MPC       5000        // macroticks per cycle
+#define INDEX_IDS       60          // 1..40 every cycle, 41..60 every 2nd..16th cycle
+#define INDEX_THREADS   4
+
+static long records = 1000000;
+static unsigned char *raw;          // the recording, as read back
+static long raw_size;
+static char raw_path[256], plain_path[256], delta_path[256], bad_path[256], be_path[256];
+
+static double index_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long index_file_size(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+/***********************************************************************
+	index_write_raw
+	Recording of records frames. Per cycle: IDs 1..40 in their static
+	slots, 41..60 with repetition 2, 4, 8, 16 in the dynamic segment.
+	Every eighth frame is a commit record stamped a little before the
+	receive records around it, as Fr_TxCommit stamps at hand-over.
+***********************************************************************/
+
+static void index_write_raw(void)
+{
+	fr_trace_file header = { FR_TRACE_MAGIC, FR_TRACE_VERSION, INDEX_MPC, 1000 };
+	fr_trace_record rec;
+	unsigned int data[64];
+	unsigned long long time;
+	long n = 0, cycle;
+	int fid, k;
+	FILE *f = fopen(raw_path, "wb");
+
+	if (f == NULL)
+	{
+		perror(raw_path);
+		exit(1);
+	}
+	fwrite(&header, sizeof(header), 1, f);
+	for (cycle = 0; n < records; cycle++)
+		for (fid = 1; fid <= INDEX_IDS && n < records; fid++)
+		{
+			if (fid > 40 && (cycle & ((1 << (1 + (fid - 41) % 4)) - 1)) != 0) continue;
+			time = (unsigned long long)cycle * INDEX_MPC + (unsigned long long)fid * 60;
+			rec.flags = FR_TRACE_CH_A | FR_TRACE_CH_B;
+			if (n % 8 == 7)
+			{
+				time -= 90;
+				rec.flags = FR_TRACE_COMMIT | FR_TRACE_CH_A;
+			}
+			rec.time[0] = (unsigned int)time;
+			rec.time[1] = (unsigned int)(time >> 32);
+			rec.fid = (unsigned short)fid;
+			rec.cycle = (unsigned char)(cycle & 0x3F);
+			rec.status = 0x0003;
+			rec.pl = (unsigned char)(fid <= 40 ? 16 : 2 * (fid - 40));
+			rec.words = (unsigned char)FR_DATA_WORDS(rec.pl);
+			for (k = 0; k < rec.words; k++)
+				data[k] = ((unsigned int)fid << 24) ^ (unsigned int)(cycle * 131 + k);
+			fwrite(&rec, sizeof(rec), 1, f);
+			fwrite(data, 4, rec.words, f);
+			n++;
+		}
+	fclose(f);
+}
+
+static void index_load_raw(void)
+{
+	FILE *f = fopen(raw_path, "rb");
+
+	raw_size = index_file_size(raw_path);
+	raw = malloc(raw_size);
+	if (f == NULL || raw == NULL || fread(raw, 1, raw_size, f) != (size_t)raw_size)
+	{
+		fprintf(stderr, "cannot read %s\n", raw_path);
+		exit(1);
+	}
+	fclose(f);
+}
+
+// what a query had to do before the index: walk every record
+static long index_linear(int fid, unsigned long long t1, unsigned long long t2, unsigned long long *sum)
+{
+	const unsigned char *p = raw + sizeof(fr_trace_file), *end = raw + raw_size;
+	fr_trace_record rec;
+	unsigned long long time;
+	unsigned int data0;
+	long n = 0;
+
+	*sum = 0;
+	while (p + sizeof(rec) <= end)
+	{
+		memcpy(&rec, p, sizeof(rec));
+		time = ((unsigned long long)rec.time[1] << 32) | rec.time[0];
+		if ((fid < 0 || rec.fid == fid) && time >= t1 && time <= t2)
+		{
+			memcpy(&data0, p + sizeof(rec), 4);
+			*sum += time ^ data0;
+			n++;
+		}
+		p += sizeof(rec) + rec.words * 4;
+	}
+	return n;
+}
+
+static unsigned long index_errors;
+
+static void index_query(frindex_reader *r, const char *label, int fid, unsigned long long t1,
+                        unsigned long long t2)
+{
+	frindex_frame *frames;
+	unsigned long long sum, check;
+	double start, linear, one, many;
+	long n, expect, k;
+	int chunks, threads;
+
+	start = index_seconds();
+	expect = index_linear(fid, t1, t2, &check);
+	linear = index_seconds() - start;
+
+	start = index_seconds();
+	n = FrIndex_Query(r, fid, t1, t2, 1, &frames, &chunks);
+	one = index_seconds() - start;
+	free(frames);
+
+	threads = INDEX_THREADS;
+	start = index_seconds();
+	n = FrIndex_Query(r, fid, t1, t2, threads, &frames, &chunks);
+	many = index_seconds() - start;
+	for (k = 0, sum = 0; k < n; k++)
+		sum += frames[k].time ^ frames[k].data[0];
+	free(frames);
+	if (n != expect || sum != check) index_errors++;
+
+	printf("  %-26s %8ld frames, %5d/%d chunks  linear %9.3f ms  index %9.3f ms  %d threads %9.3f ms\n",
+	       label, n, chunks, FrIndex_Header(r)->chunks, linear * 1e3, one * 1e3, threads, many * 1e3);
+}
+
+static void index_file(const char *path, const char *label)
+{
+	frindex_reader *r;
+	// about 45 frames a cycle
+	unsigned long long mid = (unsigned long long)(records / 45 / 2) * INDEX_MPC;
+	double start = index_seconds();
+
+	r = FrIndex_Open(path);
+	if (r == NULL)
+	{
+		fprintf(stderr, "FrIndex_Open %s failed\n", path);
+		exit(1);
+	}
+	printf("%s: %ld bytes (%.1f%% of the recording), %llu records, %u chunks, opened in %.3f ms\n",
+	       label, index_file_size(path), 100.0 * index_file_size(path) / raw_size,
+	       FrIndex_Header(r)->records, FrIndex_Header(r)->chunks, (index_seconds() - start) * 1e3);
+	index_query(r, "ID 7, 10 cycles", 7, mid, mid + 10 * INDEX_MPC);
+	index_query(r, "all IDs, 10 cycles", -1, mid, mid + 10 * INDEX_MPC);
+	index_query(r, "ID 7, whole file", 7, 0, ~0ULL);
+	index_query(r, "ID 100 (absent), whole file", 100, 0, ~0ULL);
+	index_query(r, "ID 60, second half", 60, mid, ~0ULL);
+	FrIndex_Close(r);
+}
+
+/***********************************************************************
+	index_corrupt
+	Copy of the plain file whose first record claims 200 payload words:
+	a query that decodes its chunk must fail instead of reading past it.
+***********************************************************************/
+
+static void index_corrupt(void)
+{
+	frindex_reader *r;
+	frindex_frame *frames = NULL;
+	FILE *f = fopen(plain_path, "rb"), *g = fopen(bad_path, "wb");
+	long size = index_file_size(plain_path), n;
+	unsigned char *buf = malloc(size);
+
+	if (f == NULL || g == NULL || buf == NULL || fread(buf, 1, size, f) != (size_t)size)
+	{
+		fprintf(stderr, "cannot copy %s\n", plain_path);
+		exit(1);
+	}
+	buf[sizeof(frindex_file) + 8 + 7] = 200;
+	fwrite(buf, 1, size, g);
+	fclose(f);
+	fclose(g);
+	free(buf);
+
+	r = FrIndex_Open(bad_path);
+	n = r == NULL ? 0 : FrIndex_Query(r, -1, 0, ~0ULL, 1, &frames, NULL);
+	printf("corrupt chunk: query returns %ld\n", n);
+	if (n != -1) index_errors++;
+	free(frames);
+	if (r != NULL) FrIndex_Close(r);
+	remove(bad_path);
+}
+
+/***********************************************************************
+	index_big_endian
+	The recording as the big-endian TMS570 writes it, every header and
+	record field and payload word byte-swapped: FrIndex_Convert must
+	make the same file of it as of the little-endian one.
+***********************************************************************/
+
+static void index_swap(unsigned char *p, int n)
+{
+	unsigned char c;
+	int i;
+
+	for (i = 0; i < n / 2; i++)
+	{
+		c = p[i];
+		p[i] = p[n - 1 - i];
+		p[n - 1 - i] = c;
+	}
+}
+
+static void index_big_endian(void)
+{
+	fr_trace_record rec;
+	unsigned char *be = malloc(raw_size), *a, *b;
+	long at, size, n, k;
+	FILE *f, *g;
+	int same;
+
+	if (be == NULL)
+		exit(1);
+	memcpy(be, raw, raw_size);
+	for (k = 0; k < (long)sizeof(fr_trace_file); k += 4)
+		index_swap(be + k, 4);
+	for (at = sizeof(fr_trace_file); at + (long)sizeof(rec) <= raw_size; )
+	{
+		memcpy(&rec, raw + at, sizeof(rec));
+		index_swap(be + at + offsetof(fr_trace_record, time), 4);
+		index_swap(be + at + offsetof(fr_trace_record, time) + 4, 4);
+		index_swap(be + at + offsetof(fr_trace_record, fid), 2);
+		index_swap(be + at + offsetof(fr_trace_record, status), 2);
+		at += sizeof(rec);
+		for (k = 0; k < rec.words; k++, at += 4)
+			index_swap(be + at, 4);
+	}
+	f = fopen(raw_path, "wb");
+	if (f == NULL || fwrite(be, 1, raw_size, f) != (size_t)raw_size)
+		exit(1);
+	fclose(f);
+	free(be);
+
+	n = FrIndex_Convert(raw_path, be_path, 0);
+	size = index_file_size(be_path);
+	a = malloc(size > 0 ? size : 1);
+	b = malloc(size > 0 ? size : 1);
+	f = fopen(plain_path, "rb");
+	g = fopen(be_path, "rb");
+	same = size > 0 && size == index_file_size(plain_path) && a != NULL && b != NULL && f != NULL && g != NULL
+	       && fread(a, 1, size, f) == (size_t)size && fread(b, 1, size, g) == (size_t)size && memcmp(a, b, size) == 0;
+	if (f != NULL) fclose(f);
+	if (g != NULL) fclose(g);
+	printf("big-endian recording: %ld records, %s\n", n, same ? "same file as little-endian" : "DIFFERENT file");
+	if (n != records || !same) index_errors++;
+	free(a);
+	free(b);
+	remove(be_path);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+	double start;
+	long n;
+
+	if (argc > 1) records = atol(argv[1]);
+	if (records <= 0) records = 1;
+	snprintf(raw_path, sizeof(raw_path), "%s/fr_index_bench.raw", dir);
+	snprintf(plain_path, sizeof(plain_path), "%s/fr_index_bench.fri", dir);
+	snprintf(delta_path, sizeof(delta_path), "%s/fr_index_bench_delta.fri", dir);
+	snprintf(bad_path, sizeof(bad_path), "%s/fr_index_bench_bad.fri", dir);
+	snprintf(be_path, sizeof(be_path), "%s/fr_index_bench_be.fri", dir);
+
+	index_write_raw();
+	index_load_raw();
+	printf("recording: %ld records, %ld bytes\n", records, raw_size);
+
+	start = index_seconds();
+	n = FrIndex_Convert(raw_path, plain_path, 0);
+	printf("FrIndex_Convert: %ld records in %.3f s\n", n, index_seconds() - start);
+	if (n != records) index_errors++;
+	n = FrIndex_Convert(raw_path, delta_path, FRINDEX_DELTA);
+	if (n != records) index_errors++;
+
+	index_file(plain_path, "indexed");
+	index_file(delta_path, "indexed, delta times");
+	index_corrupt();
+	index_big_endian();
+	printf("%lu errors\n", index_errors);
+
+	remove(raw_path);
+	remove(plain_path);
+	remove(delta_path);
+	free(raw);
+	return index_errors != 0;
+}
@@ -0,0 +1,168 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Replay of recorded bus traffic into fr_sim
+ *
+ *    Frames are scheduled by the cycle counter they were received in
+ *    (RDHS3.RCC, frindex_frame.cycle), unwrapped into a running cycle
+ *    c; the record times only order the frames of a cycle and tell
+ *    how many rounds of 64 cycles a long silence skipped. Recorded
+ *    cycle c is replayed in the simulated cycle with counter c & 63:
+ *    its frames are queued during cycle c - 1 with that cycle value,
+ *    so the model delivers them in their slots of cycle c, and the
+ *    application step that follows handles the start of cycle c.
+ *    Frames of a cycle that no buffer took are flushed one cycle
+ *    later and counted.
+ *
+ *******************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "fr_replay.h"
+
+static double frreplay_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void frreplay_sleep_until(double t)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)t;
+	ts.tv_nsec = (long)((t - (double)ts.tv_sec) * 1e9);
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// Running cycle of the receive record f, the one before it in cycle at and
+// at time at_time: the first cycle from at on with counter f->cycle, plus
+// the whole rounds of 64 cycles that the time in between says were skipped
+static unsigned long long frreplay_cycle(const frindex_frame *f, unsigned long long at,
+                                         unsigned long long at_time, unsigned int mpc)
+{
+	unsigned long long c = at + ((f->cycle - at) & 0x3F), est;
+
+	if (f->time > at_time)
+	{
+		est = at + (f->time - at_time) / mpc;
+		if (est >= c + 32) c += (est - c + 32) / 64 * 64;
+	}
+	return c;
+}
+
+// Queues the receive records of cycles up to c for cycle counter c & 63;
+// *at and *at_time follow the last record queued
+static long frreplay_queue(fr_sim *sim, const frindex_frame *frames, long k, long count,
+                           unsigned long long c, unsigned long long *at, unsigned long long *at_time,
+                           unsigned int mpc, fr_replay_stats *stats)
+{
+	fr_sim_frame f;
+	unsigned long long fc;
+
+	memset(&f, 0, sizeof(f));
+	for (; k < count; k++)
+	{
+		if (frames[k].flags & FR_TRACE_COMMIT) continue;
+		fc = frreplay_cycle(&frames[k], *at, *at_time, mpc);
+		if (fc > c) break;
+		*at = fc;
+		*at_time = frames[k].time;
+		f.fid = frames[k].fid;
+		f.cycle = frames[k].cycle & 0x3F;
+		f.channels = frames[k].flags & (FR_TRACE_CH_A | FR_TRACE_CH_B);
+		f.pl = frames[k].pl;
+		memcpy(f.data, frames[k].data, sizeof(unsigned int) * frames[k].words);
+		if (!FrSim_QueueRx(sim, &f)) stats->dropped++;
+		stats->frames++;
+	}
+	return k;
+}
+
+/***********************************************************************
+	FrReplay_Run
+	Replays the cycles of the first to one past the last receive record,
+	numbered from the first one's counter nearest its time, paced
+	to the wall clock at cfg->speed, and times each application step:
+	simulated time less the time skipped in busy-waits and idle in
+	FrSim_WaitForInterrupt against cfg->deadline_ut, and host time.
+***********************************************************************/
+
+int FrReplay_Run(fr_sim *sim, fr_ctx *ctx, fr_replay_step step, const frindex_frame *frames, long count,
+                 const fr_replay_cfg *cfg, fr_replay_stats *stats)
+{
+	fr_sim_stats before, after;
+	unsigned int mpc = cfg->macro_per_cycle;
+	unsigned long long c, c0, last, at, at_time, est;
+	unsigned long deadline = cfg->deadline_ut, busy;
+	double cycle_s = (double)mpc * cfg->macrotick_ns * 1e-9, wall0, now, host;
+	long k = 0, i;
+	int guard, missed;
+
+	memset(stats, 0, sizeof(*stats));
+	if (count <= 0 || mpc == 0) return 0;
+	if (deadline == 0) deadline = ctx->config.gtu1 & 0xFFFFF;   // microticks per cycle
+	for (k = 0; k < count && (frames[k].flags & FR_TRACE_COMMIT); k++);
+	if (k == count) return 0;
+	i = k;
+	est = frames[i].time / mpc;
+	c0 = est - ((est - frames[i].cycle) & 0x3F);   // last cycle up to est with its counter
+	if (c0 > est || est - c0 >= 32) c0 += 64;
+	at = last = c0;
+	at_time = frames[i].time;
+	for (; i < count; i++)
+		if (!(frames[i].flags & FR_TRACE_COMMIT))
+		{
+			last = frreplay_cycle(&frames[i], last, at_time, mpc);
+			at_time = frames[i].time;
+		}
+	at_time = frames[k].time;
+
+	// run the application until the cycle before the first recorded one
+	for (guard = 0; FrSim_Cycle(sim) != (int)((c0 - 1) & 0x3F) && guard < 65; guard++)
+		step(ctx);
+
+	wall0 = frreplay_seconds();
+	for (c = c0; c <= last + 1; c++)
+	{
+		stats->unmatched += FrSim_FlushRx(sim, (int)((c - 2) & 0x3F));
+		k = frreplay_queue(sim, frames, k, count, c, &at, &at_time, mpc, stats);
+
+		if (cfg->speed > 0)
+		{
+			double target = wall0 + (double)(c - c0) * cycle_s / cfg->speed;
+			now = frreplay_seconds();
+			if (now < target)
+				frreplay_sleep_until(target);
+			else if (now - target > cycle_s / cfg->speed)
+				stats->late++;
+		}
+
+		FrSim_GetStats(sim, &before);
+		now = frreplay_seconds();
+		step(ctx);
+		host = (frreplay_seconds() - now) * 1e6;
+		FrSim_GetStats(sim, &after);
+
+		busy = (unsigned long)((after.now_ut - before.now_ut) - (after.skipped_ut - before.skipped_ut)
+		                       - (after.idle_ut - before.idle_ut));
+		missed = busy > deadline;
+		if (after.cycles - before.cycles > 1)
+		{
+			stats->overruns++;
+			missed = 1;
+		}
+		if (missed && stats->misses++ == 0) stats->first_miss = c;
+		stats->cycles++;
+		stats->busy_ut += busy;
+		if (busy > stats->busy_max_ut) stats->busy_max_ut = busy;
+		stats->host_us += host;
+		if (host > stats->host_max_us) stats->host_max_us = host;
+		if (cfg->report != 0) cfg->report(cfg->arg, c, busy, host, missed);
+		if (FrSim_PocState(sim) != FRSIM_POC_NORMAL_ACTIVE) return -1;
+	}
+	stats->unmatched += FrSim_FlushRx(sim, -1);
+	stats->seconds = frreplay_seconds() - wall0;
+	return 0;
+}
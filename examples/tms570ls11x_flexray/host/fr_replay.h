@@ -0,0 +1,62 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Replay of recorded bus traffic into fr_sim
+ *
+ *    Feeds the receive records of a trace, cycle by cycle, into the
+ *    simulated controller's RX path and runs one step of the node's
+ *    application per cycle (transmit_check_node_x, or
+ *    Fr_EventWait + Fr_EventDispatch with the user callbacks). The
+ *    simulated cycle counter is aligned with the recording first, so
+ *    cycle filtered buffers see the frames in the cycles they were
+ *    recorded in, and the same trace gives the same run every time.
+ *
+ *******************************************************************/
+
+#ifndef FR_REPLAY_H
+#define FR_REPLAY_H
+
+#include "fr_sim.h"
+#include "fr_index.h"
+
+// One cycle of the application: returns after handling the next cycle start
+typedef int (*fr_replay_step)(fr_ctx *ctx);
+
+// Called after each replayed cycle
+typedef void (*fr_replay_report)(void *arg, unsigned long long cycle, unsigned long busy_ut,
+                                 double host_us, int missed);
+
+typedef struct fr_replay_cfg
+	{
+		double speed;                   // 1 real time, N N-times, 0 as fast as possible
+		unsigned long deadline_ut;      // application work per cycle, 0: cycle length
+		unsigned int macro_per_cycle;   // of the recording, frindex_file
+		unsigned int macrotick_ns;
+		fr_replay_report report;        // may be 0
+		void *arg;
+	} fr_replay_cfg;
+
+typedef struct fr_replay_stats
+	{
+		unsigned long cycles;           // cycles replayed, empty ones included
+		unsigned long frames;           // receive records queued
+		unsigned long unmatched;        // frames no buffer took in their cycle
+		unsigned long dropped;          // frames over the simulator inbox
+		unsigned long misses;           // cycles over deadline_ut
+		unsigned long overruns;         // steps that took more than one cycle
+		unsigned long late;             // cycles started behind the wall-clock schedule
+		unsigned long long first_miss;  // trace cycle of the first miss
+		unsigned long long busy_ut;     // simulated application time, all cycles
+		unsigned long busy_max_ut;
+		double host_us;                 // host time in the application steps
+		double host_max_us;
+		double seconds;                 // wall-clock time of the replay
+	} fr_replay_stats;
+
+// Replays frames[0..count-1] (time order, commit records skipped) into the
+// node ctx on sim, each frame in a cycle with its recorded cycle counter.
+// The node must be in NORMAL_ACTIVE with its application set up. Returns
+// 0, -1 if the node fell out of NORMAL_ACTIVE.
+int FrReplay_Run(fr_sim *sim, fr_ctx *ctx, fr_replay_step step, const frindex_frame *frames, long count,
+                 const fr_replay_cfg *cfg, fr_replay_stats *stats);
+
+#endif
@@ -0,0 +1,270 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Trace replay check and benchmark
+ *
+ *    Records a synthetic trace of node A's bus as an indexed file,
+ *    replays it into node A on fr_sim with transmit_check_node_a and
+ *    with the interrupt driven events_node_a, and checks that the
+ *    application sees every frame it would have seen on the bus, in
+ *    the cycle it was recorded in even though the recorder's clock
+ *    drifts against the cluster, and that two replays give the same
+ *    run. Reports application time per
+ *    cycle as fast as possible, at 10x and at real time, and the
+ *    cycles over a deadline.
+ *
+ *******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fr_replay.h"
+
+#define REPLAY_BAD      97          // every 97th frame 2 carries a wrong payload
+#define REPLAY_GAP      500         // node B silent in cycles 500..509
+#define REPLAY_OFFSET   4000        // recorder time base ahead of the cycle start, MT
+#define REPLAY_DRIFT    3           // and gaining this many MT a cycle
+
+static fr_sim *sim;
+static FRAY_ST *regs;
+static fr_ctx node;
+static long cycles = 2000;
+static char path[256];
+static unsigned long expect_rx, expect_errors, expect_unmatched;
+
+static unsigned long replay_clock(void)
+{
+	return (unsigned long)FrSim_Now(sim);
+}
+
+static void replay_idle(fr_ctx *ctx)
+{
+	(void)ctx;
+	FrSim_WaitForInterrupt(sim);
+}
+
+static void replay_isr(void *ctx)
+{
+	Fr_EventIsr(ctx);
+}
+
+// Slot 2's channel B copy (buffer #3, not used by events_node_a): its
+// payload starts with the recorded cycle, which must stay the same number
+// of cycles behind the one it is read out in
+static int replay_lag;
+static unsigned long replay_slips;
+
+static void replay_slot2(fr_ctx *ctx, int buffer, volatile unsigned long *rdds)
+{
+	int lag = (ctx->rx_stamp.cycle - (int)rdds[0]) & 0x3F;
+
+	(void)buffer;
+	if (replay_lag < 0) replay_lag = lag;
+	else if (lag != replay_lag) replay_slips++;
+}
+
+// everything up to and including the next cycle start: node A also takes
+// the TI0 interrupt in between
+static int replay_events_step(fr_ctx *ctx)
+{
+	unsigned long cycles = ctx->stats.cycles;
+
+	while (ctx->stats.cycles == cycles)
+	{
+		Fr_EventWait(ctx);
+		Fr_EventDispatch(ctx, FR_EVENT_DEPTH);
+	}
+	return 0;
+}
+
+static void replay_append(frindex_writer *w, unsigned long long time, int fid, int cycle, int flags,
+                          int pl, const unsigned int *data)
+{
+	fr_trace_record rec;
+
+	rec.time[0] = (unsigned int)time;
+	rec.time[1] = (unsigned int)(time >> 32);
+	rec.fid = (unsigned short)fid;
+	rec.cycle = (unsigned char)(cycle & 0x3F);
+	rec.flags = (unsigned char)flags;
+	rec.status = (unsigned short)(flags & 0x3);
+	rec.pl = (unsigned char)pl;
+	rec.words = (unsigned char)FR_DATA_WORDS(pl);
+	FrIndex_Append(w, &rec, data);
+}
+
+/***********************************************************************
+	replay_record
+	What node A saw in cycles 1000.. of a recording: frame 2 from node B
+	every cycle but in a 10 cycle gap, frame 10 on channel A every 2nd
+	cycle, frames 3 and 4 of other nodes (no buffer in node A) and frame
+	10 on channel B only every 16th cycle (wrong channel), plus node A's
+	own commit records. The recorder's clock is not the cluster's: it
+	runs REPLAY_OFFSET ahead of the cycle start and gains REPLAY_DRIFT
+	MT a cycle, so by time some cycles hold two of a frame and others
+	none; only the cycle counters place the frames right.
+***********************************************************************/
+
+static void replay_record(void)
+{
+	frindex_writer *w = FrIndex_Create(path, FRINDEX_DELTA, 5600, 1000);
+	unsigned int data[64] = { 0 };
+	unsigned long long base;
+	long c, cycle;
+
+	if (w == NULL)
+	{
+		perror(path);
+		exit(1);
+	}
+	for (c = 0; c < cycles; c++)
+	{
+		cycle = 1000 + c;
+		base = (unsigned long long)cycle * 5600 + REPLAY_OFFSET + (unsigned long long)c * REPLAY_DRIFT;
+		data[0] = (unsigned int)cycle;
+		replay_append(w, base + 100, 1, (int)cycle, FR_TRACE_COMMIT | FR_TRACE_CH_A | FR_TRACE_CH_B, 9, data);
+		if (c < REPLAY_GAP || c >= REPLAY_GAP + 10)
+		{
+			data[1] = c % REPLAY_BAD == 0 ? 0xDEADBEEF : 0x87654321;
+			replay_append(w, base + 200, 2, (int)cycle, FR_TRACE_CH_A | FR_TRACE_CH_B, 9, data);
+			expect_rx++;
+			if (c % REPLAY_BAD == 0) expect_errors++;
+		}
+		replay_append(w, base + 300, 3, (int)cycle, FR_TRACE_CH_A | FR_TRACE_CH_B, 9, data);
+		replay_append(w, base + 400, 4, (int)cycle, FR_TRACE_CH_A, 9, data);
+		expect_unmatched += 2;
+		if ((c & 1) == 0)
+			replay_append(w, base + 2000, 10, (int)cycle, FR_TRACE_CH_A, 8, data);
+		if ((c & 15) == 1)
+		{
+			replay_append(w, base + 2100, 10, (int)cycle, FR_TRACE_CH_B, 8, data);
+			expect_unmatched++;
+		}
+	}
+	if (FrIndex_Finish(w) != 0)
+	{
+		fprintf(stderr, "cannot write %s\n", path);
+		exit(1);
+	}
+}
+
+static void replay_start(int events)
+{
+	FrSim_Reset(sim);
+	Fr_CtxInit(&node, regs);
+	configure_initialize_node_a(&node);
+	Fr_StartCommunication(regs);
+	while ((regs->CCSV_UN.CCSV_UL & 0x3F) != FRSIM_POC_NORMAL_ACTIVE);
+	FrSim_SetIrqHandler(sim, 1, NULL, NULL);
+	if (events)
+	{
+		Fr_EventInit(&node, replay_clock, replay_idle);
+		events_node_a(&node);
+		Fr_OnBuffer(&node, 3, replay_slot2);
+		FrSim_SetIrqHandler(sim, 1, replay_isr, &node);
+		regs->SIR_UN.SIR_UL = 0xFFFFFFFF;
+	}
+}
+
+// hash of the per-cycle application times, equal for equal runs
+static unsigned long long replay_hash;
+
+static void replay_report(void *arg, unsigned long long cycle, unsigned long busy_ut, double host_us, int missed)
+{
+	(void)arg;
+	(void)host_us;
+	replay_hash = (replay_hash ^ (cycle * 64 + busy_ut * 2 + (unsigned long long)missed)) * 1099511628211ULL;
+}
+
+static unsigned long replay_errors;
+
+static void replay_run(const char *label, int events, double speed, unsigned long deadline,
+                       const frindex_frame *frames, long count, unsigned long long *hash)
+{
+	fr_replay_cfg cfg = { speed, deadline, 5600, 1000, replay_report, NULL };
+	fr_replay_stats st;
+	unsigned long rx, errors;
+
+	replay_start(events);
+	rx = node.stats.rx_frames;
+	errors = node.stats.rx_errors;
+	replay_hash = 14695981039346656037ULL;
+	replay_lag = -1;
+	replay_slips = 0;
+	if (FrReplay_Run(sim, &node, events ? replay_events_step : transmit_check_node_a,
+	                 frames, count, &cfg, &st) != 0)
+		replay_errors++;
+	rx = node.stats.rx_frames - rx;
+	errors = node.stats.rx_errors - errors;
+	printf("%-32s %5lu cycles %6.3f s  busy %6.1f ut/cycle (max %4lu)  host %6.2f us/cycle (max %7.2f)\n",
+	       label, st.cycles, st.seconds, (double)st.busy_ut / st.cycles, st.busy_max_ut,
+	       st.host_us / st.cycles, st.host_max_us);
+	printf("  %lu frames, %lu unmatched, %lu dropped, %lu rx, %lu payload errors, %lu overruns, %lu late, "
+	       "%lu cycles over %lu ut",
+	       st.frames, st.unmatched, st.dropped, rx, errors, st.overruns, st.late, st.misses,
+	       deadline ? deadline : (unsigned long)(node.config.gtu1 & 0xFFFFF));
+	if (st.misses != 0)
+		printf(" (first: cycle %llu)", st.first_miss);
+	if (events)
+		printf(", %lu cycle slips", replay_slips);
+	printf("\n");
+	if (replay_slips != 0) replay_errors++;
+	if (hash != NULL)
+	{
+		if (*hash != 0 && *hash != replay_hash) replay_errors++;
+		*hash = replay_hash;
+	}
+	if (count == 0 || frames[count - 1].time >= (1000ULL + cycles - 1) * 5600)
+		if (rx != expect_rx || errors != expect_errors || st.unmatched != expect_unmatched)
+			replay_errors++;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+	frindex_reader *r;
+	frindex_frame *frames;
+	unsigned long long hash = 0, events_hash = 0;
+	long count, part;
+
+	if (argc > 1) cycles = atol(argv[1]);
+	if (cycles < 20) cycles = 20;
+	snprintf(path, sizeof(path), "%s/fr_replay_bench.fri", dir);
+	replay_record();
+	r = FrIndex_Open(path);
+	count = r != NULL ? FrIndex_Query(r, -1, 0, ~0ULL, 4, &frames, NULL) : -1;
+	if (count <= 0)
+	{
+		fprintf(stderr, "cannot read %s\n", path);
+		return 1;
+	}
+
+	sim = FrSim_Create();
+	if (sim == NULL)
+	{
+		fprintf(stderr, "FrSim_Create failed\n");
+		return 1;
+	}
+	regs = FrSim_Regs(sim);
+	printf("%ld cycles recorded, %ld records, %lu frames for buffer 2 (%lu bad)\n",
+	       cycles, count, expect_rx, expect_errors);
+
+	replay_run("transmit_check_node_a, max speed", 0, 0, 0, frames, count, &hash);
+	replay_run("transmit_check_node_a, again", 0, 0, 0, frames, count, &hash);
+	replay_run("events_node_a, max speed", 1, 0, 0, frames, count, &events_hash);
+	replay_run("events_node_a, again", 1, 0, 0, frames, count, &events_hash);
+	replay_run("transmit_check_node_a, 40 ut", 0, 0, 40, frames, count, NULL);
+
+	// the first 50 and 500 cycles paced to the wall clock
+	for (part = 0; part < count && frames[part].time < 1050ULL * 5600; part++);
+	replay_run("events_node_a, real time", 1, 1, 0, frames, part, NULL);
+	for (part = 0; part < count && frames[part].time < 1500ULL * 5600; part++);
+	replay_run("events_node_a, 10x", 1, 10, 0, frames, part, NULL);
+
+	printf("%lu errors\n", replay_errors);
+	free(frames);
+	FrIndex_Close(r);
+	remove(path);
+	FrSim_Destroy(sim);
+	return replay_errors != 0;
+}
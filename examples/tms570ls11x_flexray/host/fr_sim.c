@@ -0,0 +1,1419 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Host-side behavioural model of the FRAY_ST registers
+ *
+ *******************************************************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "fr_sim.h"
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error "fr_sim traps register accesses with x86-64 single-stepping, Linux/x86-64 only"
+#endif
+
+// Model timing, in microticks
+#define FRSIM_ACCESS_UT       1     // one host access to a CC register
+#define FRSIM_SWAP_UT         2     // host <-> shadow buffer swap
+#define FRSIM_XFER_BASE_UT    4     // shadow <-> message RAM transfer setup
+#define FRSIM_XFER_WORD_UT    1     // per 32-bit word transferred
+#define FRSIM_POC_CMD_UT      16    // PBSY after an accepted POC command
+#define FRSIM_CLEAR_RAMS_UT   (FRSIM_MRAM_WORDS / 4)
+#define FRSIM_STARTUP_CYCLES  8     // cycles from RUN to NORMAL_ACTIVE
+
+#define FRSIM_MAX_SIMS        64
+#define FRSIM_NEVER           (~0ULL)
+#define FRSIM_TF              0x100 // EFLAGS trap flag
+
+#define REG(name)             offsetof(struct fray_registers, name)
+#define REGW                  ((long)sizeof(unsigned long))
+
+struct fr_sim
+	{
+	FRAY_ST *regs;
+	size_t map_len;
+	unsigned long long now;
+	unsigned long epoch;              // bumped on every state change
+	long spin_off;                    // last register read, -1 after a write
+	unsigned long spin_pc;            // instruction that read it
+	unsigned long spin_epoch;
+
+	unsigned int mram[FRSIM_MRAM_WORDS];
+	unsigned int txrq[FRSIM_MAX_BUFFERS / 32];
+	unsigned int ndat[FRSIM_MAX_BUFFERS / 32];
+	unsigned int mbsc[FRSIM_MAX_BUFFERS / 32];
+
+	// input buffer: shadow contents and the request waiting for a swap
+	unsigned long ib_data[64];
+	unsigned long ib_hdr[3];
+	int ib_mask;                      // LHSS/LDSS/STXRS of the shadow transfer
+	int ib_buf;                       // IBRS
+	int ib_req_buf;                   // IBRH waiting for the swap, -1 if none
+	int ib_req_mask;
+	int ib_last_ibrh;
+	unsigned long long ib_swap_at;
+	unsigned long long ib_done_at;
+
+	// output buffer: shadow contents and the transfer in progress
+	unsigned long ob_data[64];
+	unsigned long ob_hdr[4];          // RDHS1..3, MBS
+	int ob_mask;
+	int ob_buf;                       // buffer in the shadow
+	int ob_host_buf;                  // OBRH, buffer in the host view
+	int ob_host_mask;
+	int ob_last_obrs;
+	unsigned long long ob_done_at;
+
+	// protocol operation control
+	int poc;
+	int poc_next;                     // entered when PBSY clears
+	unsigned long long pbsy_until;
+	unsigned long succ1;              // SUCC1 configuration bits
+	int cmd;                          // CMD as read back
+	int unlock;                       // 1 after 0xCE, 2 after 0x31
+	int coldstart;
+	int halt_req;
+	int fault;                        // FrSim_Fault: state entered at the next cycle start, 0 for none
+	int startup_left;
+
+	// schedule, latched from the GTU registers on RUN
+	int running;
+	int cycle;
+	unsigned long long this_cycle;    // start of the current cycle
+	unsigned long long next_cycle;    // start of the next cycle
+	unsigned long long cycle_ut;
+	int ut_per_mt;
+	int static_slots;
+	int static_slot_mt;
+	int apo_mt;
+	int minislots;
+	int minislot_mt;
+	int ms_apo_mt;
+	int fids[2 * FRSIM_MAX_BUFFERS + FRSIM_INBOX_SIZE];   // frame IDs to serve, ascending
+	int nfids;
+	int slot_idx;                     // next entry of fids[] in this cycle
+	unsigned long long t0_at;         // absolute timer 0 (T0C), FRSIM_NEVER when not armed
+	unsigned long long t1_at;         // relative timer 1 (T1C)
+	int sync_seen[4];                 // sync frames received this double cycle, SFS.VSAE, VSAO, VSBE, VSBO
+
+	// receive FIFO (buffers fifo_first..LCB), latched from MRC, FRF, FRFM, FCL on RUN
+	int fifo_first;                   // FRSIM_MAX_BUFFERS without a FIFO
+	int fifo_depth;
+	int fifo_get;                     // next entry to read, relative to fifo_first
+	int fifo_count;
+	int fifo_overrun;
+	unsigned long frf;
+	unsigned long frfm;
+	int fifo_critical;
+
+	fr_sim_frame inbox[FRSIM_INBOX_SIZE];
+	int inbox_count;
+
+	fr_sim_tx_hook tx_hook;
+	void *tx_ctx;
+	int bus_fids[FRSIM_MAX_BUFFERS];  // slots of the other nodes, FrSim_SetBus
+	int bus_count;
+	fr_sim_slot_hook slot_hook;
+	void *slot_ctx;
+	fr_sim_irq irq[2];                // eray_int0, eray_int1
+	void *irq_ctx[2];
+	fr_sim_stats stats;
+	};
+
+static fr_sim *frsim_table[FRSIM_MAX_SIMS];
+static pthread_mutex_t frsim_table_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t frsim_once = PTHREAD_ONCE_INIT;
+
+// access being single-stepped on this thread
+static __thread fr_sim *frsim_cur;
+static __thread long frsim_off;
+static __thread int frsim_wr;
+static __thread unsigned long frsim_old;
+
+
+/***********************************************************************
+	Helpers
+***********************************************************************/
+
+#define BIT_SET(a, n)   ((a)[(n) >> 5] |=  (1u << ((n) & 31)))
+#define BIT_CLR(a, n)   ((a)[(n) >> 5] &= ~(1u << ((n) & 31)))
+#define BIT_TST(a, n)   (((a)[(n) >> 5] >> ((n) & 31)) & 1u)
+
+static void frsim_open(fr_sim *sim)
+{
+	mprotect((void *)sim->regs, sim->map_len, PROT_READ | PROT_WRITE);
+}
+
+static void frsim_close(fr_sim *sim)
+{
+	mprotect((void *)sim->regs, sim->map_len, PROT_NONE);
+}
+
+static unsigned long *frsim_reg(fr_sim *sim, long off)
+{
+	return (unsigned long *)((char *)sim->regs + off);
+}
+
+static int frsim_buffers(fr_sim *sim)
+{
+	int lcb = (sim->regs->MRC_UN.MRC_UL >> 16) & 0x7F;
+	return lcb + 1;
+}
+
+static int frsim_data_words(unsigned int h2)
+{
+	return (((h2 >> 16) & 0x7F) + 1) / 2;
+}
+
+static int frsim_is_config(fr_sim *sim)
+{
+	return sim->poc == FRSIM_POC_DEFAULT_CONFIG || sim->poc == FRSIM_POC_CONFIG;
+}
+
+static int frsim_is_normal(fr_sim *sim)
+{
+	return sim->poc == FRSIM_POC_NORMAL_ACTIVE || sim->poc == FRSIM_POC_NORMAL_PASSIVE;
+}
+
+// cycle filter code: the highest set bit gives the repetition, the bits
+// below it the base cycle; 0 matches every cycle
+static int frsim_cycle_match(int cyc, int cycle)
+{
+	int rep = 64;
+
+	if (cyc == 0) return 1;
+	while ((cyc & rep) == 0) rep >>= 1;
+	return (cycle & (rep - 1)) == (cyc & (rep - 1));
+}
+
+// slot action point relative to cycle start, FRSIM_NEVER past the dynamic segment
+static unsigned long long frsim_slot_time(fr_sim *sim, int fid)
+{
+	int mt;
+
+	if (fid <= sim->static_slots)
+		mt = (fid - 1) * sim->static_slot_mt + sim->apo_mt;
+	else if (fid - sim->static_slots <= sim->minislots)
+		mt = sim->static_slots * sim->static_slot_mt
+		   + (fid - sim->static_slots - 1) * sim->minislot_mt + sim->ms_apo_mt;
+	else
+		return FRSIM_NEVER;
+	return (unsigned long long)mt * sim->ut_per_mt;
+}
+
+static int frsim_add_fid(fr_sim *sim, int n, int fid)
+{
+	int i;
+
+	if (fid == 0) return n;
+	for (i = 0; i < n && sim->fids[i] < fid; i++);
+	if (i < n && sim->fids[i] == fid) return n;
+	memmove(&sim->fids[i + 1], &sim->fids[i], (n - i) * sizeof(int));
+	sim->fids[i] = fid;
+	return n + 1;
+}
+
+static void frsim_rebuild_fids(fr_sim *sim)
+{
+	int b, i;
+	int n = 0;
+
+	for (b = 0; b < sim->fifo_first; b++)
+		n = frsim_add_fid(sim, n, sim->mram[4 * b] & 0x7FF);
+	for (i = 0; i < sim->bus_count; i++)
+		n = frsim_add_fid(sim, n, sim->bus_fids[i]);
+	// with a FIFO every frame on the bus may be received
+	if (sim->fifo_depth)
+		for (i = 0; i < sim->inbox_count; i++)
+			n = frsim_add_fid(sim, n, sim->inbox[i].fid & 0x7FF);
+	sim->nfids = n;
+
+	// resume after the slots already passed in this cycle
+	sim->slot_idx = 0;
+	if (sim->running)
+		while (sim->slot_idx < n
+		       && frsim_slot_time(sim, sim->fids[sim->slot_idx]) <= sim->now - sim->this_cycle)
+			sim->slot_idx++;
+}
+
+static unsigned long long frsim_next_slot(fr_sim *sim)
+{
+	unsigned long long t;
+
+	while (sim->slot_idx < sim->nfids)
+	{
+		t = frsim_slot_time(sim, sim->fids[sim->slot_idx]);
+		if (t != FRSIM_NEVER) return sim->this_cycle + t;
+		sim->slot_idx++;
+	}
+	return FRSIM_NEVER;
+}
+
+static unsigned long long frsim_next_event(fr_sim *sim)
+{
+	unsigned long long t = sim->pbsy_until, s;
+
+	if (sim->ib_swap_at < t) t = sim->ib_swap_at;
+	if (sim->ib_done_at < t) t = sim->ib_done_at;
+	if (sim->ob_done_at < t) t = sim->ob_done_at;
+	if (sim->running)
+	{
+		if (sim->t0_at < t) t = sim->t0_at;
+		if (sim->t1_at < t) t = sim->t1_at;
+		if (sim->next_cycle < t) t = sim->next_cycle;
+		s = frsim_next_slot(sim);
+		if (s < t) t = s;
+	}
+	return t;
+}
+
+static void frsim_deadlock(void)
+{
+	static const char msg[] = "fr_sim: busy-wait on a register with no pending event\n";
+	write(2, msg, sizeof(msg) - 1);
+	abort();
+}
+
+
+/***********************************************************************
+	Register image
+	Keeps the status registers in the mapped block in step with the model.
+***********************************************************************/
+
+static void frsim_sync(fr_sim *sim)
+{
+	FRAY_ST *r = sim->regs;
+	unsigned long v;
+
+	v  = (sim->ib_done_at != FRSIM_NEVER) ? 0x80000000UL : 0;
+	v |= (unsigned long)(sim->ib_buf & 0x3F) << 16;
+	v |= (sim->ib_req_buf >= 0) ? 0x8000 : 0;
+	v |= sim->ib_last_ibrh & 0x3F;
+	r->IBCR_UN.IBCR_UL = v;
+	r->IBCM_UN.IBCM_UL = (r->IBCM_UN.IBCM_UL & 0x7) | ((unsigned long)(sim->ib_mask & 0x7) << 16);
+
+	v  = (unsigned long)(sim->ob_host_buf & 0x3F) << 16;
+	v |= (sim->ob_done_at != FRSIM_NEVER) ? 0x8000 : 0;
+	v |= sim->ob_last_obrs & 0x3F;
+	r->OBCR_UN.OBCR_UL = v;
+	r->OBCM_UN.OBCM_UL = (r->OBCM_UN.OBCM_UL & 0x3) | ((unsigned long)(sim->ob_host_mask & 0x3) << 16);
+
+	r->SUCC1_UN.SUCC1_UL = sim->succ1 | (sim->pbsy_until != FRSIM_NEVER ? 0x80 : 0) | (sim->cmd & 0xF);
+	r->CCSV_UN.CCSV_UL = (sim->poc & 0x3F) | (sim->coldstart ? 0x2000 : 0);
+
+	if (sim->running && sim->now >= sim->this_cycle && sim->ut_per_mt)
+		r->MTCCV_UN.MTCCV_UL = ((unsigned long)(sim->cycle & 0x3F) << 16)
+		                     | (((sim->now - sim->this_cycle) / sim->ut_per_mt) & 0x3FFF);
+	else
+		r->MTCCV_UN.MTCCV_UL = 0;
+
+	r->TXRQ1_UN.TXRQ1_UL = sim->txrq[0];
+	r->TXRQ2_UN.TXRQ2_UL = sim->txrq[1];
+	r->NDAT1_UN.NDAT1_UL = sim->ndat[0];
+	r->NDAT2_UN.NDAT2_UL = sim->ndat[1];
+	r->MBSC1_UN.MBSC1_UL = sim->mbsc[0];
+	r->MBSC2_UN.MBSC2_UL = sim->mbsc[1];
+
+	r->FSR_UN.FSR_UL = ((unsigned long)(sim->fifo_count & 0xFF) << 8) | (sim->fifo_overrun ? 0x4 : 0)
+	                 | (sim->fifo_depth && sim->fifo_count >= sim->fifo_critical ? 0x2 : 0)
+	                 | (sim->fifo_count ? 0x1 : 0);
+}
+
+
+/***********************************************************************
+	Input buffer
+	IBCR write -> host/shadow swap -> shadow to message RAM transfer.
+***********************************************************************/
+
+static void frsim_ib_swap(fr_sim *sim)
+{
+	FRAY_ST *r = sim->regs;
+	unsigned long t;
+	unsigned int h2;
+	int i, words;
+
+	for (i = 0; i < 64; i++)
+	{
+		t = r->WRDS[i];
+		r->WRDS[i] = sim->ib_data[i];
+		sim->ib_data[i] = t;
+	}
+	t = r->WRHS1_UN.WRHS1_UL; r->WRHS1_UN.WRHS1_UL = sim->ib_hdr[0]; sim->ib_hdr[0] = t;
+	t = r->WRHS2_UN.WRHS2_UL; r->WRHS2_UN.WRHS2_UL = sim->ib_hdr[1]; sim->ib_hdr[1] = t;
+	t = r->WRHS3_UN.WRHS3_UL; r->WRHS3_UN.WRHS3_UL = sim->ib_hdr[2]; sim->ib_hdr[2] = t;
+
+	sim->ib_buf = sim->ib_req_buf;
+	sim->ib_mask = sim->ib_req_mask;
+	sim->ib_req_buf = -1;
+	sim->ib_swap_at = FRSIM_NEVER;
+
+	h2 = (sim->ib_mask & 0x1) ? sim->ib_hdr[1] : sim->mram[4 * sim->ib_buf + 1];
+	words  = (sim->ib_mask & 0x1) ? 3 : 0;
+	words += (sim->ib_mask & 0x2) ? frsim_data_words(h2) : 0;
+	sim->ib_done_at = sim->now + FRSIM_XFER_BASE_UT + words * FRSIM_XFER_WORD_UT;
+}
+
+static void frsim_ib_commit(fr_sim *sim)
+{
+	int b = sim->ib_buf;
+	unsigned int *hdr = &sim->mram[4 * b];
+	int i, dp, words;
+
+	if (sim->ib_mask & 0x1)          // LHSS
+	{
+		hdr[0] = sim->ib_hdr[0] & 0x3F7F07FF;
+		hdr[1] = sim->ib_hdr[1] & 0x007F07FF;
+		hdr[2] = sim->ib_hdr[2] & 0x7FF;
+		hdr[3] = 0;
+		BIT_CLR(sim->txrq, b);
+		BIT_CLR(sim->ndat, b);
+		BIT_CLR(sim->mbsc, b);
+		frsim_rebuild_fids(sim);
+	}
+	if (sim->ib_mask & 0x2)          // LDSS
+	{
+		dp = hdr[2] & 0x7FF;
+		words = frsim_data_words(hdr[1]);
+		if (dp + words > FRSIM_MRAM_WORDS)
+		{
+			sim->stats.mram_errors++;
+			words = FRSIM_MRAM_WORDS - dp;
+		}
+		for (i = 0; i < words; i++)
+			sim->mram[dp + i] = (unsigned int)sim->ib_data[i];
+	}
+	if ((sim->ib_mask & 0x4) && (hdr[0] & (1u << 26)))   // STXRS on a TX buffer
+		BIT_SET(sim->txrq, b);
+
+	sim->ib_done_at = FRSIM_NEVER;
+	sim->stats.ib_transfers++;
+	if (sim->ib_req_buf >= 0)
+		sim->ib_swap_at = sim->now + FRSIM_SWAP_UT;
+}
+
+static void frsim_ib_request(fr_sim *sim, unsigned long ibcr)
+{
+	if (sim->ib_req_buf >= 0)
+		sim->stats.ib_overruns++;
+	sim->ib_req_buf = ibcr & 0x3F;
+	sim->ib_req_mask = sim->regs->IBCM_UN.IBCM_UL & 0x7;
+	sim->ib_last_ibrh = sim->ib_req_buf;
+	if (sim->ib_done_at == FRSIM_NEVER && sim->ib_swap_at == FRSIM_NEVER)
+		sim->ib_swap_at = sim->now + FRSIM_SWAP_UT;
+}
+
+
+/***********************************************************************
+	Output buffer
+	OBCR.REQ -> message RAM to shadow transfer, OBCR.VIEW -> swap.
+***********************************************************************/
+
+static void frsim_ob_commit(fr_sim *sim)
+{
+	int b = sim->ob_buf;
+	unsigned int *hdr = &sim->mram[4 * b];
+	int i, dp, words;
+
+	if (sim->ob_mask & 0x1)          // RHSS
+	{
+		for (i = 0; i < 4; i++)
+			sim->ob_hdr[i] = hdr[i];
+		BIT_CLR(sim->mbsc, b);
+	}
+	if (sim->ob_mask & 0x2)          // RDSS
+	{
+		dp = hdr[2] & 0x7FF;
+		words = frsim_data_words(hdr[1]);
+		if (dp + words > FRSIM_MRAM_WORDS)
+		{
+			sim->stats.mram_errors++;
+			words = FRSIM_MRAM_WORDS - dp;
+		}
+		for (i = 0; i < words; i++)
+			sim->ob_data[i] = sim->mram[dp + i];
+		BIT_CLR(sim->ndat, b);
+	}
+	sim->ob_done_at = FRSIM_NEVER;
+	sim->stats.ob_transfers++;
+}
+
+static void frsim_ob_request(fr_sim *sim, unsigned long obcr)
+{
+	FRAY_ST *r = sim->regs;
+	unsigned long t;
+	int i, words;
+
+	sim->ob_last_obrs = obcr & 0x3F;
+	if ((obcr & (1 << 8)) && sim->ob_done_at == FRSIM_NEVER)   // VIEW
+	{
+		for (i = 0; i < 64; i++)
+		{
+			t = r->RDDS[i];
+			r->RDDS[i] = sim->ob_data[i];
+			sim->ob_data[i] = t;
+		}
+		t = r->RDHS1_UN.RDHS1_UL; r->RDHS1_UN.RDHS1_UL = sim->ob_hdr[0]; sim->ob_hdr[0] = t;
+		t = r->RDHS2_UN.RDHS2_UL; r->RDHS2_UN.RDHS2_UL = sim->ob_hdr[1]; sim->ob_hdr[1] = t;
+		t = r->RDHS3_UN.RDHS3_UL; r->RDHS3_UN.RDHS3_UL = sim->ob_hdr[2]; sim->ob_hdr[2] = t;
+		t = r->MBS_UN.MBS_UL;     r->MBS_UN.MBS_UL     = sim->ob_hdr[3]; sim->ob_hdr[3] = t;
+		sim->ob_host_buf = sim->ob_buf;
+		sim->ob_host_mask = sim->ob_mask;
+	}
+	if ((obcr & (1 << 9)) && sim->ob_done_at == FRSIM_NEVER)   // REQ
+	{
+		sim->ob_buf = obcr & 0x3F;
+		if (sim->fifo_depth && sim->ob_buf == sim->fifo_first)
+		{
+			// the FIFO is read through its first buffer, oldest entry first
+			sim->ob_buf = sim->fifo_first + sim->fifo_get;
+			if (sim->fifo_count)
+			{
+				sim->fifo_get = (sim->fifo_get + 1) % sim->fifo_depth;
+				sim->fifo_count--;
+			}
+			sim->fifo_overrun = 0;
+		}
+		sim->ob_mask = r->OBCM_UN.OBCM_UL & 0x3;
+		words  = (sim->ob_mask & 0x1) ? 4 : 0;
+		words += (sim->ob_mask & 0x2) ? frsim_data_words(sim->mram[4 * sim->ob_buf + 1]) : 0;
+		sim->ob_done_at = sim->now + FRSIM_XFER_BASE_UT + words * FRSIM_XFER_WORD_UT;
+	}
+}
+
+
+/***********************************************************************
+	Protocol operation control
+***********************************************************************/
+
+static void frsim_poc_go(fr_sim *sim, int state, unsigned long long ut)
+{
+	sim->poc_next = state;
+	sim->pbsy_until = sim->now + ut;
+}
+
+static int frsim_latch_schedule(fr_sim *sim)
+{
+	FRAY_ST *r = sim->regs;
+	int mt_per_cycle;
+
+	sim->cycle_ut       = r->GTUC1_UN.GTUC1_UL & 0xFFFFF;
+	mt_per_cycle        = r->GTUC2_UN.GTUC2_UL & 0x3FFF;
+	sim->static_slots   = (r->GTUC7_UN.GTUC7_UL >> 16) & 0x3FF;
+	sim->static_slot_mt = r->GTUC7_UN.GTUC7_UL & 0x3FF;
+	sim->minislots      = (r->GTUC8_UN.GTUC8_UL >> 16) & 0x1FFF;
+	sim->minislot_mt    = r->GTUC8_UN.GTUC8_UL & 0x3F;
+	sim->apo_mt         = r->GTUC9_UN.GTUC9_UL & 0x3F;
+	sim->ms_apo_mt      = (r->GTUC9_UN.GTUC9_UL >> 8) & 0x1F;
+	if (sim->cycle_ut == 0 || mt_per_cycle == 0) return 0;
+	sim->ut_per_mt = (int)(sim->cycle_ut / mt_per_cycle);
+
+	sim->fifo_first = (r->MRC_UN.MRC_UL >> 8) & 0x7F;
+	if (sim->fifo_first < frsim_buffers(sim))
+		sim->fifo_depth = frsim_buffers(sim) - sim->fifo_first;
+	else
+	{
+		sim->fifo_first = FRSIM_MAX_BUFFERS;
+		sim->fifo_depth = 0;
+	}
+	sim->fifo_get = sim->fifo_count = sim->fifo_overrun = 0;
+	sim->frf = r->FRF_UN.FRF_UL;
+	sim->frfm = r->FRFM_UN.FRFM_UL;
+	sim->fifo_critical = r->FCL_UN.FCL_UL & 0xFF;
+	frsim_rebuild_fids(sim);
+	return sim->ut_per_mt != 0;
+}
+
+static void frsim_poc_done(fr_sim *sim)
+{
+	int was_running_state = (sim->poc & 0x20) || frsim_is_normal(sim);
+
+	sim->pbsy_until = FRSIM_NEVER;
+	sim->poc = sim->poc_next;
+	if (sim->poc & 0x20)
+	{
+		if (!was_running_state)
+		{
+			sim->running = 1;
+			sim->cycle = 63;
+			sim->next_cycle = sim->now;
+			sim->this_cycle = sim->now;
+			sim->slot_idx = sim->nfids;
+			sim->startup_left = FRSIM_STARTUP_CYCLES;
+		}
+	}
+	else if (!frsim_is_normal(sim))
+		sim->running = 0;
+}
+
+static void frsim_clear_rams(fr_sim *sim)
+{
+	memset(sim->mram, 0, sizeof(sim->mram));
+	memset(sim->txrq, 0, sizeof(sim->txrq));
+	memset(sim->ndat, 0, sizeof(sim->ndat));
+	memset(sim->mbsc, 0, sizeof(sim->mbsc));
+	sim->nfids = 0;
+	sim->slot_idx = 0;
+}
+
+// returns 1 when the command is accepted
+static int frsim_command(fr_sim *sim, int cmd)
+{
+	int poc = sim->poc;
+	int config = frsim_is_config(sim);
+	int normal = frsim_is_normal(sim);
+	int startup = (poc & 0x20) != 0;
+
+	if (sim->pbsy_until != FRSIM_NEVER) return 0;
+
+	switch (cmd)
+	{
+	case CMD_CONFIG:
+		if (config || poc == FRSIM_POC_READY || poc == FRSIM_POC_HALT || poc == FRSIM_POC_MONITOR_MODE)
+		{
+			frsim_poc_go(sim, FRSIM_POC_CONFIG, FRSIM_POC_CMD_UT);
+			return 1;
+		}
+		break;
+	case CMD_READY:
+		if (poc == FRSIM_POC_CONFIG)
+		{
+			if (sim->unlock != 2) break;
+			frsim_poc_go(sim, FRSIM_POC_READY, FRSIM_POC_CMD_UT);
+			return 1;
+		}
+		if (normal || startup || poc == FRSIM_POC_MONITOR_MODE)
+		{
+			frsim_poc_go(sim, FRSIM_POC_READY, FRSIM_POC_CMD_UT);
+			return 1;
+		}
+		break;
+	case CMD_WAKEUP:
+		if (poc == FRSIM_POC_READY)
+		{
+			frsim_poc_go(sim, FRSIM_POC_READY, FRSIM_POC_CMD_UT);
+			return 1;
+		}
+		break;
+	case CMD_RUN:
+		if (poc == FRSIM_POC_READY && frsim_latch_schedule(sim))
+		{
+			frsim_poc_go(sim, sim->coldstart ? FRSIM_POC_COLDSTART_LISTEN : FRSIM_POC_INTEGRATION_LISTEN,
+			             FRSIM_POC_CMD_UT);
+			return 1;
+		}
+		break;
+	case CMD_ALL_SLOTS:
+	case CMD_SEND_MTS:
+	case CMD_ASYNCHRONOUS_TRANSFER_MODE:
+		if (poc == FRSIM_POC_READY || normal) return 1;
+		break;
+	case CMD_HALT:
+		if (normal)
+		{
+			sim->halt_req = 1;
+			return 1;
+		}
+		break;
+	case CMD_FREEZE:
+		sim->running = 0;
+		sim->poc = FRSIM_POC_HALT;
+		sim->poc_next = FRSIM_POC_HALT;
+		return 1;
+	case CMD_ALLOW_COLDSTART:
+		if (poc == FRSIM_POC_READY || startup || normal)
+		{
+			sim->coldstart = 1;
+			return 1;
+		}
+		break;
+	case CMD_RESET_STATUS_INDICATORS:
+		return 1;
+	case CMD_MONITOR_MODE:
+		if (poc == FRSIM_POC_CONFIG)
+		{
+			frsim_poc_go(sim, FRSIM_POC_MONITOR_MODE, FRSIM_POC_CMD_UT);
+			return 1;
+		}
+		break;
+	case CMD_CLEAR_RAMS:
+		if (config)
+		{
+			frsim_clear_rams(sim);
+			frsim_poc_go(sim, poc, FRSIM_CLEAR_RAMS_UT);
+			return 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+
+/***********************************************************************
+	Bus activity
+***********************************************************************/
+
+// absolute timer 0: T0MO macroticks into the cycles selected by T0CC
+static void frsim_t0_arm(fr_sim *sim)
+{
+	unsigned long t0c = sim->regs->T0C_UN.T0C_UL;
+	unsigned long long t;
+
+	sim->t0_at = FRSIM_NEVER;
+	if (!sim->running || !(t0c & 0x1) || !sim->ut_per_mt) return;
+	if (!frsim_cycle_match((t0c >> 8) & 0x7F, sim->cycle)) return;
+	t = sim->this_cycle + ((t0c >> 16) & 0x3FFF) * (unsigned long long)sim->ut_per_mt;
+	if (t >= sim->now) sim->t0_at = t;
+}
+
+static void frsim_t0_fire(fr_sim *sim)
+{
+	sim->t0_at = FRSIM_NEVER;
+	sim->regs->SIR_UN.SIR_UL |= 0x100;           // TI0
+	if (!(sim->regs->T0C_UN.T0C_UL & 0x2))       // single shot, T0MS = 0
+		sim->regs->T0C_UN.T0C_UL &= ~0x1UL;
+}
+
+// relative timer 1: T1MC macroticks after it is started, counted while
+// communication runs
+static void frsim_t1_arm(fr_sim *sim)
+{
+	unsigned long t1c = sim->regs->T1C_UN.T1C_UL;
+
+	sim->t1_at = FRSIM_NEVER;
+	if (!sim->running || !(t1c & 0x1) || !sim->ut_per_mt) return;
+	sim->t1_at = sim->now + ((t1c >> 16) & 0x3FFF) * (unsigned long long)sim->ut_per_mt;
+}
+
+static void frsim_t1_fire(fr_sim *sim)
+{
+	unsigned long t1c = sim->regs->T1C_UN.T1C_UL;
+
+	sim->t1_at = FRSIM_NEVER;
+	sim->regs->SIR_UN.SIR_UL |= 0x200;           // TI1
+	if (t1c & 0x2)                               // continuous, T1MS = 1
+		sim->t1_at = sim->now + ((t1c >> 16) & 0x3FFF) * (unsigned long long)sim->ut_per_mt;
+	else
+		sim->regs->T1C_UN.T1C_UL &= ~0x1UL;
+}
+
+// SFS valid sync frame counters of the double cycle that ended
+static void frsim_sync_frames(fr_sim *sim)
+{
+	unsigned long sfs = 0;
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		sfs |= (unsigned long)(sim->sync_seen[i] > 15 ? 15 : sim->sync_seen[i]) << (4 * i);
+		sim->sync_seen[i] = 0;
+	}
+	sim->regs->SFS_UN.SFS_UL = (sim->regs->SFS_UN.SFS_UL & ~0xFFFFUL) | sfs;
+}
+
+static void frsim_cycle_start(fr_sim *sim)
+{
+	sim->this_cycle = sim->next_cycle;
+	sim->next_cycle += sim->cycle_ut;
+	sim->cycle = (sim->cycle + 1) & 0x3F;
+	sim->slot_idx = 0;
+	sim->stats.cycles++;
+	sim->regs->SIR_UN.SIR_UL |= 0x4;             // CYCS
+	if ((sim->cycle & 0x1) == 0)
+		frsim_sync_frames(sim);
+
+	if (sim->fault == FRSIM_POC_NORMAL_PASSIVE && sim->poc == FRSIM_POC_NORMAL_ACTIVE)
+	{
+		sim->fault = 0;
+		sim->poc = FRSIM_POC_NORMAL_PASSIVE;
+		sim->poc_next = FRSIM_POC_NORMAL_PASSIVE;
+		sim->regs->EIR_UN.EIR_UL |= 0x1;         // PEMC
+	}
+	if (sim->fault == FRSIM_POC_HALT && frsim_is_normal(sim))
+	{
+		sim->fault = 0;
+		sim->halt_req = 1;
+		sim->regs->EIR_UN.EIR_UL |= 0x1;         // PEMC
+	}
+	if (sim->halt_req)
+	{
+		sim->halt_req = 0;
+		sim->running = 0;
+		sim->poc = FRSIM_POC_HALT;
+		sim->poc_next = FRSIM_POC_HALT;
+		sim->t0_at = FRSIM_NEVER;
+		sim->t1_at = FRSIM_NEVER;
+		if (sim->slot_hook) sim->slot_hook(sim->slot_ctx, sim->cycle, -1);
+		return;
+	}
+	if ((sim->poc & 0x20) && --sim->startup_left <= 0)
+	{
+		sim->poc = FRSIM_POC_NORMAL_ACTIVE;
+		sim->poc_next = FRSIM_POC_NORMAL_ACTIVE;
+		sim->regs->SIR_UN.SIR_UL |= 0x2000;      // SUCS
+	}
+	frsim_t0_arm(sim);
+	if (sim->slot_hook) sim->slot_hook(sim->slot_ctx, sim->cycle, 0);
+}
+
+static void frsim_transmit(fr_sim *sim, int b)
+{
+	unsigned int *hdr = &sim->mram[4 * b];
+	fr_sim_frame frame;
+	int i, dp, words;
+
+	frame.fid = hdr[0] & 0x7FF;
+	frame.cycle = sim->cycle;
+	frame.channels = ((hdr[0] >> 24) & 0x1 ? FRSIM_CH_A : 0) | ((hdr[0] >> 25) & 0x1 ? FRSIM_CH_B : 0);
+	frame.pl = (hdr[1] >> 16) & 0x7F;
+	frame.sync = (b == 0) && (sim->succ1 & 0x200);
+	frame.sfi  = (b == 0) && (sim->succ1 & 0x100);
+	dp = hdr[2] & 0x7FF;
+	words = frsim_data_words(hdr[1]);
+	if (dp + words > FRSIM_MRAM_WORDS) words = FRSIM_MRAM_WORDS - dp;
+	for (i = 0; i < words; i++)
+		frame.data[i] = sim->mram[dp + i];
+	for (; i < 64; i++)
+		frame.data[i] = 0;
+
+	if (sim->tx_hook) sim->tx_hook(sim->tx_ctx, &frame);
+	sim->stats.tx_frames++;
+	if (hdr[0] & (1u << 28))                     // single-shot
+		BIT_CLR(sim->txrq, b);
+	hdr[3] = (frame.channels & FRSIM_CH_A ? 0x100 : 0) | (frame.channels & FRSIM_CH_B ? 0x200 : 0);
+	sim->regs->SIR_UN.SIR_UL |= 0x8;             // TXI
+}
+
+// copies inbox frame n into buffer b with the receive status, removes it from the inbox
+static void frsim_store(fr_sim *sim, int b, int n, int ch)
+{
+	unsigned int *hdr = &sim->mram[4 * b];
+	fr_sim_frame *f = &sim->inbox[n];
+	int i, dp, words;
+
+	dp = hdr[2] & 0x7FF;
+	words = (((f->pl < (int)((hdr[1] >> 16) & 0x7F)) ? f->pl : (int)((hdr[1] >> 16) & 0x7F)) + 1) / 2;
+	if (dp + words > FRSIM_MRAM_WORDS)
+	{
+		sim->stats.mram_errors++;
+		words = FRSIM_MRAM_WORDS - dp;
+	}
+	for (i = 0; i < words; i++)
+		sim->mram[dp + i] = f->data[i];
+	hdr[1] = (hdr[1] & 0x007F07FF) | ((unsigned int)(f->pl & 0x7F) << 24);
+	hdr[2] = (hdr[2] & 0x7FF) | ((unsigned int)sim->cycle << 16) | (1u << 27)
+	       | ((f->sync & 0x1) << 26) | ((f->sfi & 0x1) << 25);
+	hdr[3] = ((f->channels & ch & FRSIM_CH_A) ? 0x1 : 0) | ((f->channels & ch & FRSIM_CH_B) ? 0x2 : 0);
+	sim->stats.rx_frames++;
+
+	// a buffer of one channel takes that channel's copy only
+	f->channels &= ~ch;
+	if (f->channels != 0) return;
+	sim->inbox_count--;
+	memmove(f, f + 1, (sim->inbox_count - n) * sizeof(*f));
+}
+
+static int frsim_receive(fr_sim *sim, int b)
+{
+	unsigned int *hdr = &sim->mram[4 * b];
+	fr_sim_frame *f;
+	int ch = (hdr[0] >> 24) & 0x3;
+	int n;
+
+	for (n = 0; n < sim->inbox_count; n++)
+	{
+		f = &sim->inbox[n];
+		if (f->fid != (int)(hdr[0] & 0x7FF)) continue;
+		if (f->cycle >= 0 && f->cycle != sim->cycle) continue;
+		if ((f->channels & ch) == 0) continue;
+
+		frsim_store(sim, b, n, ch);
+		BIT_SET(sim->ndat, b);
+		BIT_SET(sim->mbsc, b);
+		sim->regs->SIR_UN.SIR_UL |= 0x10;        // RXI
+		return 1;
+	}
+	return 0;
+}
+
+// frame without a dedicated buffer: into the FIFO unless the rejection filter
+// (FRF/FRFM) matches; a full FIFO loses its oldest entry
+static void frsim_fifo_receive(fr_sim *sim, int fid)
+{
+	static const int fifo_ch[4] = { FRSIM_CH_A | FRSIM_CH_B, FRSIM_CH_B, FRSIM_CH_A, 0 };
+	int ch = fifo_ch[sim->frf & 0x3];
+	int mfid = (sim->frfm >> 2) & 0x7FF;
+	fr_sim_frame *f = NULL;
+	unsigned int *hdr;
+	int n, b, filtered;
+
+	for (n = 0; n < sim->inbox_count; n++)
+	{
+		f = &sim->inbox[n];
+		if (f->fid != fid) continue;
+		if (f->cycle >= 0 && f->cycle != sim->cycle) continue;
+		break;
+	}
+	if (n == sim->inbox_count) return;
+
+	filtered = (((fid ^ (int)(sim->frf >> 2)) & ~mfid & 0x7FF) == 0)
+	        && frsim_cycle_match((sim->frf >> 16) & 0x7F, sim->cycle);
+	if ((f->channels & ch) == 0 || filtered
+	    || ((sim->frf & (1 << 23)) && fid <= sim->static_slots))              // RSS
+	{
+		sim->stats.fifo_rejected++;
+		sim->inbox_count--;
+		memmove(f, f + 1, (sim->inbox_count - n) * sizeof(*f));
+		return;
+	}
+
+	if (sim->fifo_count == sim->fifo_depth)
+	{
+		sim->fifo_get = (sim->fifo_get + 1) % sim->fifo_depth;
+		sim->fifo_count--;
+		sim->fifo_overrun = 1;
+		sim->stats.fifo_overruns++;
+	}
+	b = sim->fifo_first + (sim->fifo_get + sim->fifo_count) % sim->fifo_depth;
+	hdr = &sim->mram[4 * b];
+	hdr[0] = (hdr[0] & ~0x037F07FFu) | ((unsigned int)(f->channels & ch) << 24) | (unsigned int)fid;
+	frsim_store(sim, b, n, ch);
+	sim->fifo_count++;
+	sim->stats.fifo_frames++;
+	sim->regs->SIR_UN.SIR_UL |= 0x20;            // RFNE
+	if (sim->fifo_count >= sim->fifo_critical)
+		sim->regs->SIR_UN.SIR_UL |= 0x40;        // RFCL
+}
+
+// transmit pass, the slot hook (frames of other nodes are queued there), receive pass
+static void frsim_slot(fr_sim *sim)
+{
+	int fid = sim->fids[sim->slot_idx++];
+	int nbuf = frsim_buffers(sim);
+	int normal = frsim_is_normal(sim);
+	int b, ch, dedicated = 0;
+	unsigned int h1;
+	fr_sim_frame *f;
+
+	if (nbuf > sim->fifo_first) nbuf = sim->fifo_first;
+	if (nbuf > FRSIM_MAX_BUFFERS) nbuf = FRSIM_MAX_BUFFERS;
+	for (b = 0; b < nbuf && sim->poc == FRSIM_POC_NORMAL_ACTIVE; b++)
+	{
+		h1 = sim->mram[4 * b];
+		if ((int)(h1 & 0x7FF) != fid || !(h1 & (1u << 26)) || !BIT_TST(sim->txrq, b)) continue;
+		if (!frsim_cycle_match((h1 >> 16) & 0x7F, sim->cycle)) continue;
+		frsim_transmit(sim, b);
+		break;
+	}
+	if (sim->slot_hook) sim->slot_hook(sim->slot_ctx, sim->cycle, fid);
+	if (!normal) return;
+
+	// one frame per channel in the slot, the first queued
+	for (b = 0, ch = 0; b < sim->inbox_count; b++)
+	{
+		f = &sim->inbox[b];
+		if (f->fid != fid || (f->cycle >= 0 && f->cycle != sim->cycle)) continue;
+		if (f->sync && (f->channels & ~ch & FRSIM_CH_A)) sim->sync_seen[sim->cycle & 0x1]++;
+		if (f->sync && (f->channels & ~ch & FRSIM_CH_B)) sim->sync_seen[2 + (sim->cycle & 0x1)]++;
+		ch |= f->channels;
+	}
+
+	for (b = 0; b < nbuf; b++)
+	{
+		h1 = sim->mram[4 * b];
+		if ((int)(h1 & 0x7FF) != fid) continue;
+		if (!frsim_cycle_match((h1 >> 16) & 0x7F, sim->cycle)) continue;
+		dedicated = 1;
+		if (!(h1 & (1u << 26)))
+			frsim_receive(sim, b);
+	}
+	if (!dedicated && sim->fifo_depth)
+		frsim_fifo_receive(sim, fid);
+}
+
+
+/***********************************************************************
+	Time
+***********************************************************************/
+
+static void frsim_fire(fr_sim *sim)
+{
+	unsigned long long now = sim->now;
+
+	if (sim->pbsy_until <= now) frsim_poc_done(sim);
+	if (sim->ib_done_at <= now) frsim_ib_commit(sim);
+	if (sim->ib_swap_at <= now) frsim_ib_swap(sim);
+	if (sim->ob_done_at <= now) frsim_ob_commit(sim);
+	if (sim->running && sim->t0_at <= now) frsim_t0_fire(sim);
+	if (sim->running && sim->t1_at <= now) frsim_t1_fire(sim);
+	if (sim->running && sim->next_cycle <= now) frsim_cycle_start(sim);
+	else if (sim->running && frsim_next_slot(sim) <= now) frsim_slot(sim);
+	sim->epoch++;
+}
+
+static void frsim_advance(fr_sim *sim, unsigned long long t)
+{
+	unsigned long long e;
+
+	while ((e = frsim_next_event(sim)) <= t)
+	{
+		if (e > sim->now) sim->now = e;
+		frsim_fire(sim);
+	}
+	if (t > sim->now) sim->now = t;
+}
+
+
+/***********************************************************************
+	Host accesses
+***********************************************************************/
+
+static void frsim_before(fr_sim *sim, long off, int wr, unsigned long pc)
+{
+	unsigned long long e;
+
+	frsim_advance(sim, sim->now + FRSIM_ACCESS_UT);
+	if (wr)
+	{
+		sim->stats.writes++;
+		sim->spin_off = -1;
+		return;
+	}
+	sim->stats.reads++;
+	// the same load instruction re-reading an unchanged register is a busy-wait
+	if (off == sim->spin_off && pc == sim->spin_pc && sim->epoch == sim->spin_epoch)
+	{
+		if (off == REG(MTCCV_UN) && sim->running)
+			e = sim->now + sim->ut_per_mt;
+		else
+			e = frsim_next_event(sim);
+		if (e == FRSIM_NEVER) frsim_deadlock();
+		sim->stats.skipped_ut += e - sim->now;
+		frsim_advance(sim, e);
+	}
+	frsim_sync(sim);
+	sim->spin_off = off;
+	sim->spin_pc = pc;
+	sim->spin_epoch = sim->epoch;
+}
+
+static void frsim_after_write(fr_sim *sim, long off, unsigned long old)
+{
+	unsigned long *reg = frsim_reg(sim, off);
+	unsigned long val = *reg;
+	int cmd;
+
+	sim->epoch++;
+	if (off != REG(LCK_UN) && off != REG(SUCC1_UN))
+		sim->unlock = 0;
+
+	switch (off)
+	{
+	case REG(LCK_UN):
+		// CLK as written through LCK_UL or, on a little-endian host, through LCK_ST
+		cmd = (int)((val & 0xFF) | ((val >> 24) & 0xFF));
+		if (cmd == 0xCE) sim->unlock = 1;
+		else if (cmd == 0x31 && sim->unlock == 1) sim->unlock = 2;
+		else sim->unlock = 0;
+		*reg = 0;
+		break;
+
+	case REG(SUCC1_UN):
+		// bits 31:28 are reserved; a non-zero value there is a SUCC1_ST.cmd_B4
+		// store from a little-endian host
+		cmd = (int)((val >> 28) & 0xF);
+		if (cmd == 0) cmd = (int)(val & 0xF);
+		if (frsim_is_config(sim))
+			sim->succ1 = val & 0x0FFFFB00;
+		sim->cmd = frsim_command(sim, cmd) ? cmd : CMD_command_not_accepted;
+		sim->unlock = 0;
+		break;
+
+	case REG(EIR_UN):
+	case REG(SIR_UN):
+		*reg = old & ~val;
+		break;
+
+	case REG(IBCR_UN):
+		frsim_ib_request(sim, val);
+		break;
+
+	case REG(OBCR_UN):
+		frsim_ob_request(sim, val);
+		break;
+
+	case REG(T0C_UN):
+		frsim_t0_arm(sim);
+		break;
+
+	case REG(T1C_UN):
+		frsim_t1_arm(sim);
+		break;
+
+	case REG(SUCC2_UN): case REG(SUCC3_UN): case REG(NEMC_UN):
+	case REG(PRTC1_UN): case REG(PRTC2_UN): case REG(MHDC_UN):
+	case REG(GTUC1_UN): case REG(GTUC2_UN): case REG(GTUC3_UN): case REG(GTUC4_UN):
+	case REG(GTUC5_UN): case REG(GTUC6_UN): case REG(GTUC7_UN): case REG(GTUC8_UN):
+	case REG(GTUC9_UN): case REG(GTUC10_UN): case REG(GTUC11_UN):
+	case REG(MRC_UN): case REG(FRF_UN): case REG(FRFM_UN):
+		if (!frsim_is_config(sim))
+		{
+			*reg = old;
+			sim->stats.config_locked++;
+		}
+		break;
+
+	default:
+		// output buffer and status registers are read-only
+		if ((off >= REG(RDDS) && off <= REG(MBS_UN)) || (off >= REG(CCSV_UN) && off <= REG(ACS_UN)))
+			*reg = old;
+		break;
+	}
+	frsim_sync(sim);
+}
+
+static void frsim_segv(int sig, siginfo_t *si, void *ctx)
+{
+	ucontext_t *uc = ctx;
+	char *addr = si->si_addr;
+	fr_sim *sim = NULL;
+	int i;
+
+	for (i = 0; i < FRSIM_MAX_SIMS; i++)
+	{
+		fr_sim *s = frsim_table[i];
+		if (s && addr >= (char *)s->regs && addr < (char *)s->regs + s->map_len)
+		{
+			sim = s;
+			break;
+		}
+	}
+	if (sim == NULL)
+	{
+		// not ours: let the access fault again with the default action
+		signal(sig, SIG_DFL);
+		return;
+	}
+
+	frsim_open(sim);
+	frsim_cur = sim;
+	frsim_off = (addr - (char *)sim->regs) & ~(REGW - 1);
+	frsim_wr  = (uc->uc_mcontext.gregs[REG_ERR] & 0x2) != 0;
+	frsim_before(sim, frsim_off, frsim_wr, uc->uc_mcontext.gregs[REG_RIP]);
+	// after the model has caught up: a flag set by an event during this
+	// access must survive a write-1-to-clear of the others
+	frsim_old = *frsim_reg(sim, frsim_off);
+	uc->uc_mcontext.gregs[REG_EFL] |= FRSIM_TF;
+}
+
+static void frsim_trap(int sig, siginfo_t *si, void *ctx)
+{
+	ucontext_t *uc = ctx;
+	fr_sim *sim = frsim_cur;
+
+	(void)si;
+	if (sim == NULL)
+	{
+		signal(sig, SIG_DFL);
+		raise(sig);
+		return;
+	}
+	uc->uc_mcontext.gregs[REG_EFL] &= ~FRSIM_TF;
+	frsim_cur = NULL;
+	if (frsim_wr)
+		frsim_after_write(sim, frsim_off, frsim_old);
+	frsim_close(sim);
+}
+
+static void frsim_install(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_sigaction = frsim_segv;
+	sigaction(SIGSEGV, &sa, NULL);
+	sa.sa_sigaction = frsim_trap;
+	sigaction(SIGTRAP, &sa, NULL);
+}
+
+
+/***********************************************************************
+	FrSim_Create
+	Maps a protected FRAY_ST block and brings the model out of reset.
+***********************************************************************/
+
+fr_sim *FrSim_Create(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	fr_sim *sim;
+	void *map;
+	int i;
+
+	pthread_once(&frsim_once, frsim_install);
+
+	sim = calloc(1, sizeof(*sim));
+	if (sim == NULL) return NULL;
+	sim->map_len = (sizeof(FRAY_ST) + page - 1) & ~(size_t)(page - 1);
+	map = mmap(NULL, sim->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+	{
+		free(sim);
+		return NULL;
+	}
+	sim->regs = (FRAY_ST *)map;
+
+	pthread_mutex_lock(&frsim_table_lock);
+	for (i = 0; i < FRSIM_MAX_SIMS && frsim_table[i]; i++);
+	if (i < FRSIM_MAX_SIMS) frsim_table[i] = sim;
+	pthread_mutex_unlock(&frsim_table_lock);
+	if (i == FRSIM_MAX_SIMS)
+	{
+		munmap(map, sim->map_len);
+		free(sim);
+		return NULL;
+	}
+
+	FrSim_Reset(sim);
+	return sim;
+}
+
+void FrSim_Destroy(fr_sim *sim)
+{
+	int i;
+
+	if (sim == NULL) return;
+	pthread_mutex_lock(&frsim_table_lock);
+	for (i = 0; i < FRSIM_MAX_SIMS; i++)
+		if (frsim_table[i] == sim) frsim_table[i] = NULL;
+	pthread_mutex_unlock(&frsim_table_lock);
+	munmap((void *)sim->regs, sim->map_len);
+	free(sim);
+}
+
+
+/***********************************************************************
+	FrSim_Reset
+	Hardware reset: DEFAULT_CONFIG with the automatic CLEAR_RAMS running.
+	The TX hook is kept.
+***********************************************************************/
+
+void FrSim_Reset(fr_sim *sim)
+{
+	frsim_open(sim);
+	memset((void *)sim->regs, 0, sim->map_len);
+
+	sim->now = 0;
+	sim->epoch = 0;
+	sim->spin_off = -1;
+	frsim_clear_rams(sim);
+	memset(sim->ib_data, 0, sizeof(sim->ib_data));
+	memset(sim->ib_hdr, 0, sizeof(sim->ib_hdr));
+	memset(sim->ob_data, 0, sizeof(sim->ob_data));
+	memset(sim->ob_hdr, 0, sizeof(sim->ob_hdr));
+	sim->ib_mask = sim->ib_buf = sim->ib_last_ibrh = 0;
+	sim->ib_req_buf = -1;
+	sim->ib_req_mask = 0;
+	sim->ib_swap_at = sim->ib_done_at = FRSIM_NEVER;
+	sim->ob_mask = sim->ob_buf = sim->ob_host_buf = sim->ob_host_mask = sim->ob_last_obrs = 0;
+	sim->ob_done_at = FRSIM_NEVER;
+
+	sim->poc = FRSIM_POC_DEFAULT_CONFIG;
+	sim->succ1 = 0;
+	sim->cmd = 0;
+	sim->unlock = 0;
+	sim->coldstart = 0;
+	sim->halt_req = 0;
+	sim->fault = 0;
+	sim->running = 0;
+	sim->cycle = 0;
+	sim->this_cycle = sim->next_cycle = 0;
+	sim->t0_at = FRSIM_NEVER;
+	sim->t1_at = FRSIM_NEVER;
+	memset(sim->sync_seen, 0, sizeof(sim->sync_seen));
+	frsim_poc_go(sim, FRSIM_POC_DEFAULT_CONFIG, FRSIM_CLEAR_RAMS_UT);
+
+	sim->fifo_first = FRSIM_MAX_BUFFERS;
+	sim->fifo_depth = sim->fifo_get = sim->fifo_count = sim->fifo_overrun = 0;
+	sim->inbox_count = 0;
+	memset(&sim->stats, 0, sizeof(sim->stats));
+	frsim_sync(sim);
+	frsim_close(sim);
+}
+
+
+/***********************************************************************
+	Accessors
+***********************************************************************/
+
+FRAY_ST *FrSim_Regs(fr_sim *sim)
+{
+	return sim->regs;
+}
+
+unsigned long long FrSim_Now(fr_sim *sim)
+{
+	return sim->now;
+}
+
+int FrSim_PocState(fr_sim *sim)
+{
+	return sim->poc;
+}
+
+/***********************************************************************
+	FrSim_Fault
+	Error counters at the SUCC3 limits: at the next cycle start a node
+	in NORMAL_ACTIVE goes to NORMAL_PASSIVE (WCP, stops transmitting) or
+	a node in NORMAL_ACTIVE/PASSIVE halts (WCF), with EIR.PEMC set.
+***********************************************************************/
+
+void FrSim_Fault(fr_sim *sim, int poc)
+{
+	sim->fault = poc;
+}
+
+int FrSim_Cycle(fr_sim *sim)
+{
+	return sim->cycle;
+}
+
+unsigned int FrSim_ReadMram(fr_sim *sim, int word)
+{
+	return (word >= 0 && word < FRSIM_MRAM_WORDS) ? sim->mram[word] : 0;
+}
+
+void FrSim_SetTxHook(fr_sim *sim, fr_sim_tx_hook hook, void *ctx)
+{
+	sim->tx_hook = hook;
+	sim->tx_ctx = ctx;
+}
+
+void FrSim_GetStats(fr_sim *sim, fr_sim_stats *stats)
+{
+	*stats = sim->stats;
+	stats->now_ut = sim->now;
+}
+
+
+/***********************************************************************
+	FrSim_QueueRx
+	Queues a frame that is received in the next matching slot by the RX
+	buffer configured with its frame ID.  Returns 0 when the inbox is full.
+***********************************************************************/
+
+int FrSim_QueueRx(fr_sim *sim, const fr_sim_frame *frame)
+{
+	if (sim->inbox_count == FRSIM_INBOX_SIZE)
+	{
+		sim->stats.rx_dropped++;
+		return 0;
+	}
+	sim->inbox[sim->inbox_count++] = *frame;
+	if (sim->fifo_depth)
+		frsim_rebuild_fids(sim);
+	return 1;
+}
+
+
+/***********************************************************************
+	FrSim_FlushRx
+	Removes the queued frames of cycle counter value cycle (-1: all)
+	that no buffer took, e.g. after their cycle has passed.  Returns
+	the number removed.
+***********************************************************************/
+
+int FrSim_FlushRx(fr_sim *sim, int cycle)
+{
+	int n, kept = 0;
+
+	for (n = 0; n < sim->inbox_count; n++)
+		if (cycle >= 0 && sim->inbox[n].cycle != cycle)
+			sim->inbox[kept++] = sim->inbox[n];
+	n = sim->inbox_count - kept;
+	sim->inbox_count = kept;
+	if (sim->fifo_depth && n)
+		frsim_rebuild_fids(sim);
+	return n;
+}
+
+/***********************************************************************
+	FrSim_SetBus
+	Connects the model to a bus shared with other models: the slots of
+	fids[] are served in every cycle whether or not a buffer uses them,
+	and hook is called at every cycle start and in every served slot
+	between the transmit and the receive pass. A NULL hook disconnects.
+	Returns -1 for more than FRSIM_MAX_BUFFERS slots.
+***********************************************************************/
+
+int FrSim_SetBus(fr_sim *sim, const int *fids, int count, fr_sim_slot_hook hook, void *ctx)
+{
+	int i;
+
+	if (count < 0 || count > FRSIM_MAX_BUFFERS) return -1;
+	if (hook == NULL) count = 0;
+	for (i = 0; i < count; i++)
+		sim->bus_fids[i] = fids[i] & 0x7FF;
+	sim->bus_count = count;
+	sim->slot_hook = hook;
+	sim->slot_ctx = ctx;
+	frsim_rebuild_fids(sim);
+	return 0;
+}
+
+/***********************************************************************
+	FrSim_WaitForInterrupt
+	Models WFI followed by interrupt entry: advances the model to the
+	first event that asserts an enabled interrupt line (SIR & SIES,
+	routed by SILS, gated by ILE) and calls that line's handler.  The
+	handler runs outside the trap, it may access the registers.
+	Returns the simulated time spent waiting.
+***********************************************************************/
+
+static int frsim_irq_lines(fr_sim *sim)
+{
+	FRAY_ST *r = sim->regs;
+	unsigned long sir = r->SIR_UN.SIR_UL & r->SIES_UN.SIES_UL;
+	int lines = 0;
+
+	if (sir & ~r->SILS_UN.SILS_UL) lines |= 0x1;
+	if (sir & r->SILS_UN.SILS_UL) lines |= 0x2;
+	return lines & (int)r->ILE_UN.ILE_UL;
+}
+
+void FrSim_SetIrqHandler(fr_sim *sim, int line, fr_sim_irq handler, void *ctx)
+{
+	sim->irq[line & 1] = handler;
+	sim->irq_ctx[line & 1] = ctx;
+}
+
+unsigned long long FrSim_WaitForInterrupt(fr_sim *sim)
+{
+	unsigned long long t0 = sim->now, e;
+	int lines, line;
+
+	frsim_open(sim);
+	while ((lines = frsim_irq_lines(sim)) == 0)
+	{
+		e = frsim_next_event(sim);
+		if (e == FRSIM_NEVER) frsim_deadlock();
+		frsim_advance(sim, e);
+	}
+	frsim_sync(sim);
+	sim->spin_off = -1;
+	sim->stats.idle_ut += sim->now - t0;
+	frsim_close(sim);
+
+	for (line = 0; line < 2; line++)
+		if ((lines & (1 << line)) && sim->irq[line])
+			sim->irq[line](sim->irq_ctx[line]);
+	return sim->now - t0;
+}
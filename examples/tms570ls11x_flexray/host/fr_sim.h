@@ -0,0 +1,110 @@
+/*******************************************************************
+ *
+ *    DESCRIPTION: Host-side behavioural model of the FRAY_ST registers
+ *
+ *    The model owns a FRAY_ST register block that the unmodified driver
+ *    (Fr.c, FlexRay.c) accesses through plain volatile loads and stores.
+ *    The block is kept PROT_NONE; every access faults, the model updates
+ *    its state around the single-stepped instruction and the block is
+ *    protected again.  Linux on x86-64 only.
+ *
+ *    Time is counted in microticks (ut, 25 ns at the 40 MHz CC clock);
+ *    each register access costs FRSIM_ACCESS_UT.  A register read twice
+ *    in a row without any state change is treated as a busy-wait and the
+ *    clock skips to the next model event.
+ *
+ *******************************************************************/
+
+#ifndef FR_SIM_H
+#define FR_SIM_H
+
+#include "Fr.h"
+
+// POC states as reported in CCSV.POCS
+//
+#define FRSIM_POC_DEFAULT_CONFIG             0x00
+#define FRSIM_POC_READY                      0x01
+#define FRSIM_POC_NORMAL_ACTIVE              0x02
+#define FRSIM_POC_NORMAL_PASSIVE             0x03
+#define FRSIM_POC_HALT                       0x04
+#define FRSIM_POC_MONITOR_MODE               0x05
+#define FRSIM_POC_CONFIG                     0x0F
+#define FRSIM_POC_COLDSTART_LISTEN           0x21
+#define FRSIM_POC_INTEGRATION_LISTEN         0x27
+
+#define FRSIM_MRAM_WORDS                     2048
+#define FRSIM_MAX_BUFFERS                    128
+#define FRSIM_INBOX_SIZE                     256
+
+// Channel bits used in fr_sim_frame.channels
+#define FRSIM_CH_A                           0x1
+#define FRSIM_CH_B                           0x2
+
+typedef struct fr_sim fr_sim;
+
+// A frame on the bus, as delivered to an RX buffer or produced by a TX buffer
+typedef struct fr_sim_frame
+	{
+	int fid;                   // frame ID (slot)
+	int cycle;                 // cycle counter, -1 = next matching cycle (RX only)
+	int channels;              // FRSIM_CH_A | FRSIM_CH_B
+	int pl;                    // payload length in 2-byte words
+	int sync;                  // sync frame indicator
+	int sfi;                   // startup frame indicator
+	unsigned int data[64];
+	} fr_sim_frame;
+
+typedef struct fr_sim_stats
+	{
+	unsigned long long now_ut;       // simulated time since reset
+	unsigned long long skipped_ut;   // time skipped by busy-wait detection
+	unsigned long long idle_ut;      // time spent in FrSim_WaitForInterrupt
+	unsigned long long reads;        // register reads by the host
+	unsigned long long writes;       // register writes by the host
+	unsigned long cycles;            // communication cycles started
+	unsigned long ib_transfers;      // input buffer -> message RAM transfers
+	unsigned long ob_transfers;      // message RAM -> output buffer transfers
+	unsigned long ib_overruns;       // IBCR written while IBSYH was still set
+	unsigned long tx_frames;
+	unsigned long rx_frames;
+	unsigned long rx_dropped;        // inbox full
+	unsigned long fifo_frames;       // frames stored in the receive FIFO
+	unsigned long fifo_rejected;     // frames rejected by the FIFO filter
+	unsigned long fifo_overruns;     // FIFO entries lost, FIFO full
+	unsigned long mram_errors;       // data section outside the message RAM
+	unsigned long config_locked;     // config register written outside CONFIG
+	} fr_sim_stats;
+
+// Called in the model's context for every frame sent from a TX buffer.
+// Runs inside the trap handler: no stdio, no malloc.
+typedef void (*fr_sim_tx_hook)(void *ctx, const fr_sim_frame *frame);
+
+// Called in the model's context at every cycle start (fid 0) and in every
+// served slot between the transmit and the receive pass (fid), fid -1 when
+// the controller halts. Frames queued with FrSim_QueueRx from the hook are
+// received in the same slot.
+typedef void (*fr_sim_slot_hook)(void *ctx, int cycle, int fid);
+
+// Interrupt handler for eray_int0/eray_int1, taken from FrSim_WaitForInterrupt
+typedef void (*fr_sim_irq)(void *ctx);
+
+//**********************************************************
+// Functions
+fr_sim *FrSim_Create(void);
+void FrSim_Destroy(fr_sim *sim);
+void FrSim_Reset(fr_sim *sim);
+FRAY_ST *FrSim_Regs(fr_sim *sim);
+unsigned long long FrSim_Now(fr_sim *sim);
+int FrSim_PocState(fr_sim *sim);
+int FrSim_Cycle(fr_sim *sim);
+void FrSim_Fault(fr_sim *sim, int poc);
+int FrSim_QueueRx(fr_sim *sim, const fr_sim_frame *frame);
+int FrSim_FlushRx(fr_sim *sim, int cycle);
+void FrSim_SetTxHook(fr_sim *sim, fr_sim_tx_hook hook, void *ctx);
+int FrSim_SetBus(fr_sim *sim, const int *fids, int count, fr_sim_slot_hook hook, void *ctx);
+void FrSim_GetStats(fr_sim *sim, fr_sim_stats *stats);
+unsigned int FrSim_ReadMram(fr_sim *sim, int word);
+void FrSim_SetIrqHandler(fr_sim *sim, int line, fr_sim_irq handler, void *ctx);
+unsigned long long FrSim_WaitForInterrupt(fr_sim *sim);
+
+#endif